@@ -0,0 +1,120 @@
+#!/usr/bin/python
+# -*- coding: utf-8 -*-
+
+# Description: Convert the columnar result files of wfiot_simulation
+# (--output_format=columnar, and the window_metrics_<N>.bin time series)
+# to .csv files
+#
+# The files are written by ColumnarWriter (obstacle module): a header with
+# the name and type of each column, then chunks of rows, column by column.
+# A file still being written can be converted up to its last chunk.
+#
+# To run:
+# $ python columnar_to_csv.py rssi_results.bin
+#     -> rssi_results.bin.txt, the lines of the csv output format (a name
+#        of its own, so that the rssi_results.txt of a csv run is kept)
+# $ python columnar_to_csv.py window_metrics_0.bin --header --output window_metrics_0.csv
+#
+# In a notebook:
+# >>> from columnar_to_csv import read_columnar
+# >>> columns = read_columnar("rssi_results.bin")  # {name: list of values}
+# >>> df = pandas.DataFrame(columns)
+
+
+# libs
+import csv
+import sys
+import struct
+import argparse
+from array import array
+from pathlib import Path
+
+
+MAGIC = b"NS3COLMN"
+VERSION = 1
+BYTE_ORDER = 0x01020304
+
+# type of a column -> (array typecode, size in bytes)
+TYPES = {
+    0: ("I", 4),  # UINT32
+    1: ("Q", 8),  # UINT64
+    2: ("d", 8),  # DOUBLE
+}
+
+
+#---- read the columns of a columnar file
+def read_columnar(filename):
+
+    data = Path(filename).read_bytes()
+
+    if data[:8] != MAGIC:
+        raise ValueError("%s is not a columnar file" % filename)
+    version, byte_order, n_columns = struct.unpack_from("<III", data, 8)
+    if version != VERSION or byte_order != BYTE_ORDER:
+        raise ValueError("%s: version %d of another host" % (filename, version))
+
+    # columns names and types
+    pos = 20
+    names = []
+    types = []
+    for _ in range(n_columns):
+        column_type, length = struct.unpack_from("<II", data, pos)
+        pos += 8
+        names.append(data[pos:pos + length].decode("utf-8"))
+        types.append(TYPES[column_type])
+        pos += length
+
+    # chunks
+    values = [array(typecode) for typecode, _ in types]
+    while pos + 4 <= len(data):
+        (n_rows,) = struct.unpack_from("<I", data, pos)
+        size = 4 + n_rows * sum(size for _, size in types)
+        if pos + size > len(data):
+            break  # chunk being written
+        pos += 4
+        for column, (_, column_size) in enumerate(types):
+            values[column].frombytes(data[pos:pos + n_rows * column_size])
+            pos += n_rows * column_size
+
+    return {name: values[column].tolist() for column, name in enumerate(names)}
+
+
+#---- write the columns as csv rows
+def write_csv(columns, csv_filename, header, precision):
+
+    names = list(columns.keys())
+    # same formatting as the csv output format (ostream, 6 significant digits)
+    def format_value(value):
+        if isinstance(value, float):
+            return "%.*g" % (precision, value)
+        return str(value)
+
+    with open(csv_filename, "w", newline="") as file:
+        writer = csv.writer(file, lineterminator="\n")
+        if header:
+            writer.writerow(names)
+        for row in zip(*(columns[name] for name in names)):
+            writer.writerow([format_value(value) for value in row])
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert columnar result files to csv")
+    parser.add_argument("files", nargs="+", help="columnar files (.bin)")
+    parser.add_argument("--output", help="csv file (a single input only; default: the input with .bin.txt)")
+    parser.add_argument("--header", action="store_true", help="write the names of the columns first")
+    parser.add_argument("--precision", type=int, default=6, help="significant digits of the floating point values")
+    args = parser.parse_args()
+
+    if args.output and len(args.files) > 1:
+        sys.exit("--output takes a single input file")
+
+    for filename in args.files:
+        columns = read_columnar(filename)
+        csv_filename = args.output or str(Path(filename).with_suffix(".bin.txt"))
+        write_csv(columns, csv_filename, args.header, args.precision)
+        n_rows = len(next(iter(columns.values()))) if columns else 0
+        print("%s: %d rows -> %s" % (filename, n_rows, csv_filename))
+
+
+if __name__ == "__main__":
+    main()
@@ -25,6 +25,39 @@
  * $ cd NS3_BASE_DIR
  * $ conda activate ns3-buildings
  * $ ./waf --run "simulation-many-lorawan-applications_with_random_nodes_artigo --simu_repeat=1 --channel_model=okumura&nakagami --n_devices_without_dataset=0"
+ *
+ * With --workers=N (0 = one per core) the replications after the first
+ * one run in N forked processes at once (see ReplicationRunner); the
+ * first one runs in the main process, as the others reuse its SF
+ * assignment. The datasets, node positions, SF assignment and (with
+ * --precompute_links) link matrix are built once and shared by every
+ * replication; the peak RSS of each worker is printed at the end.
+ * With --sf_threads=N the first replication evaluates the ED x GW links of
+ * the SF assignment on N threads; the channel model must then be
+ * deterministic (log-distance, okumura, obstacles), not okumura&nakagami.
+ * With --sf_planner the SF and uplink channel of each ED are planned from
+ * the offered load of its application (pure ALOHA per SF and channel, see
+ * LorawanMacHelper::PlanSpreadingFactors) instead of the fastest SF it
+ * can use; the predicted PDR is printed.
+ * With --sf_plan=<file> the SF assignment (and, with --sf_planner, the
+ * uplink channel of each ED) is read from the file if it exists, and
+ * written to it by the first replication otherwise. A plan made with
+ * --sf_planner is only read with --sf_planner, and the other way around.
+ *
+ * With --cache_links the received powers computed for the SF assignment
+ * are kept (LinkBudgetCache) and reused by the RSSI coverage dump of every
+ * replication, instead of evaluating each ED x GW link again. The random
+ * parts of the channel (e.g., Nakagami) are then drawn once per link.
+ *
+ * Every --metrics_window (10min by default) the PDR, offered load,
+ * occupied gateway reception paths and collisions per SF of the window
+ * are appended to window_metrics_<replication>.bin (see
+ * LoraMetricsExporter), so long runs can be followed while they run.
+ *
+ * With --output_format=columnar, rssi_results, network_position and
+ * phy_results are written as typed columns to .bin files (ColumnarWriter)
+ * instead of .txt; columnar_to_csv.py converts them back to csv lines
+ * (in .bin.txt files, next to the .txt files of csv runs).
  */
 
 
@@ -39,13 +72,24 @@
 #include "ns3/lora-helper.h"
 #include "ns3/mobility-helper.h"
 #include "ns3/forwarder-helper.h" 
+#include "ns3/link-budget-cache.h"
 #include "ns3/network-server-helper.h"
 #include "ns3/periodic-sender-helper.h"
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <limits>
+#include <cstring>
 // #include <ns3/spectrum-module.h>
 #include <ns3/okumura-hata-propagation-loss-model.h>
 #include "ns3/correlated-shadowing-propagation-loss-model.h"
+#include "ns3/precomputed-link-loss-model.h"
+#include "ns3/replication-runner.h"
+#include "ns3/lora-metrics-collector.h"
+#include "ns3/lora-metrics-exporter.h"
+#include "ns3/columnar-writer.h"
+#include "ns3/uinteger.h"
+#include "ns3/string.h"
 // #include "ns3/flow-monitor-helper.h"
 
 // energy-harvester
@@ -72,17 +116,6 @@ struct device{
     double SF;
 };
 
-struct spf{
-    double S;
-    double R;
-    Time delay;
-};
-
-struct packet_id_controll{
-  uint64_t id;
-  int repeat;
-};
-
 struct unicamp_battery_bins{ // armazenará dataset de coletores de pilhas e baterias
     double id;
     string name;
@@ -118,15 +151,26 @@ struct unicamp_smart_meters{ // armazenará dataset de conteiners n reciclaveis
 // Instantiate of data structures
 uint8_t SF_QTD = 6; // AU 915 MHz and EU 868 MHz
 
+// applications of the end devices (index of the metrics per application)
+enum application{
+  APP_BATTERY,
+  APP_CONTAINER,
+  APP_SMART_METER,
+  APP_AIR_MONITORING,
+  APP_LOCALIZATION
+};
+const char *application_names[] = {"battery", "container", "smart_meter", "air_monitoring", "localization"};
+const double application_periods[] = {56 * 3600.0, 6 * 3600.0, 15 * 60.0, 10.0, 1.0}; // packet interval (s)
+const uint32_t application_packet_sizes[] = {5, 31, 49, 20, 32}; // payload (bytes)
+
 vector<device> deviceList;
-vector<device> deviceList_aux;
-vector<spf> spreadFList;
-map <uint64_t, int> pacote_sf;
-map <uint64_t, Time> pacote_ds; // send
-map <uint64_t, Time> pacote_dr; // receive
-map <uint64_t, int> pacote_; // receive
+vector<uint8_t> sf_plan; // data rate of each ED, assigned by the first replication
+string sf_plan_file = ""; // SF plan kept across runs (read if it exists, written otherwise)
+uint32_t sfThreads = 1; // threads evaluating the links of the SF assignment (deterministic channels only)
+bool sf_planner = false; // plan SF and channels from the offered load, instead of the fastest SF
+vector<uint8_t> channel_plan; // uplink channel of each ED, planned by the first replication
+Ptr<LoraMetricsCollector> metrics; // sent, received, duplicates and delay per SF, online
 vector<double> distances;
-vector<packet_id_controll> packet_controll;
 NodeContainer gateways;
 
 // dataset structs
@@ -136,6 +180,10 @@ vector<unicamp_smart_meters> unicamp_smart_meters_dataset;
 
 // Channel model
 std::string channel_model = "";
+bool precompute_links = false; // serve deterministic losses from an ED x GW matrix
+Ptr<PrecomputedLinkLossModel> precomputed_loss;
+bool cache_links = false; // keep the received power of every ED x GW link
+Ptr<LinkBudgetCache> link_budget;
 
 // Network settings
 int nDevices = 0; // sera sobrescrito
@@ -149,7 +197,10 @@ double regionalFrequency = 915e6; // frequency band AU 915 MHz
 // Simulation settings
 int nSimulationRepeat = 0;
 int nSimulation = 0;
+int nWorkers = 1; // replications run at once (forked processes), 0 = one per core
+uint32_t firstRun = 7; // RngSeedManager run number of the first replication
 Time simulationTime = Hours(1); // 1 semana
+Time metricsWindow = Minutes(10); // windows of the metrics time series, 0 = none
 //Time simulationTime = Seconds(60); // 5 minutos
 
 // Input dataset file names
@@ -166,10 +217,18 @@ string net_position_file = ""; // device position by SF results
 string net_result_file = ""; // network metrics file (pdr e per)
 string delay_result_file = ""; // delay result file
 string phy_result_file = ""; // phy result file
+string output_format = "csv"; // csv (text) or columnar (typed columns, see columnar_to_csv.py)
+
+// Results of the current replication, by file name, written out by
+// flush_results (or sent to the main process, see serialize_results):
+// csv lines, and the values of the columnar files (see result_row)
+union result_value {
+  uint64_t u; // UINT32 and UINT64 columns
+  double d;   // DOUBLE columns
+};
+map<string, ostringstream> pending_results;
+map<string, vector<result_value>> pending_columns;
 
-long double count_send_pkts = 0.;
-long double count_receiv_pkts = 0.;
-long double count_repeat_pkts = 0.;
 
 /* -----------------------------------------------------------------------------
 *     MAIN
@@ -178,71 +237,205 @@ long double count_repeat_pkts = 0.;
 
 // -------- Functions --------
 
-void initialize_structs(){
-  deviceList.resize(nDevices);
-  spreadFList.resize(SF_QTD);
-  distances.resize(SF_QTD);
+// columns of the result files that have a columnar format (none for the others)
+vector<pair<string, ColumnarWriter::Type>> columnar_schema(const string &file_name){
+  if (file_name == rssi_result_file){
+    return {{"gw_id", ColumnarWriter::UINT32}, {"ed_id", ColumnarWriter::UINT32},
+            {"rssi", ColumnarWriter::DOUBLE}, {"distance", ColumnarWriter::DOUBLE}};
+  }
+  if (file_name == net_position_file){
+    return {{"ed_id", ColumnarWriter::UINT32}, {"ed_x", ColumnarWriter::DOUBLE}, {"ed_y", ColumnarWriter::DOUBLE},
+            {"ed_z", ColumnarWriter::DOUBLE}, {"sf", ColumnarWriter::UINT32}, {"gw_id", ColumnarWriter::UINT32},
+            {"gw_x", ColumnarWriter::DOUBLE}, {"gw_y", ColumnarWriter::DOUBLE}, {"gw_z", ColumnarWriter::DOUBLE},
+            {"distance", ColumnarWriter::DOUBLE}};
+  }
+  if (file_name == phy_result_file){
+    return {{"gw_id", ColumnarWriter::UINT32}, {"received", ColumnarWriter::UINT64},
+            {"interfered", ColumnarWriter::UINT64}, {"no_more_receivers", ColumnarWriter::UINT64},
+            {"under_sensitivity", ColumnarWriter::UINT64}, {"lost", ColumnarWriter::UINT64}};
+  }
+  return {};
 }
 
-void cleaning_structs(){
-  pacote_sf.clear();
-  pacote_ds.clear();
-  pacote_dr.clear();
-  packet_controll.clear();
-  deviceList.clear();
-  spreadFList.clear();
-  distances.clear();
+bool is_columnar(const string &file_name){
+  return output_format == "columnar" && !columnar_schema(file_name).empty();
+}
 
-  unicamp_battery_bins_dataset.clear();
-  unicamp_conteiner_bins_dataset.clear();
-  unicamp_smart_meters_dataset.clear();
+// buffer of the lines of a csv result file, for the current replication
+ostream& result_stream(const string &file_name){
+  return pending_results[file_name];
 }
 
-// Count Sent Packet per SF
-void PacketTraceDevice(Ptr<Packet const> pacote){
-    uint32_t id =  Simulator::GetContext ();
-    pacote_sf.insert({pacote->GetUid(), deviceList[id].SF});
-    Time sendTime = Simulator::Now ();
-    pacote_ds.insert({pacote->GetUid(), sendTime});
-    spreadFList[deviceList[id].SF].S++;   
-    count_send_pkts = count_send_pkts +1;
-    // cout <<"\n[SIMU " << nSimulation << "] "<<"Num of Packets sent: " << count_send_pkts << " - ";
-
-    packet_controll.push_back({pacote->GetUid(), 0});
+// rows of a result file that may be columnar: each value is kept as is
+// for a columnar file, and formatted into a csv line otherwise
+//   result_row row(rssi_result_file);
+//   row << gwId << nodeId << rxPower << distance;
+//   row.end();
+class result_row {
+public:
+  explicit result_row(const string &file_name) : m_field(0) {
+    if (is_columnar(file_name)){
+      for (auto &column : columnar_schema(file_name)){
+        m_types.push_back(column.second);
+      }
+      m_values = &pending_columns[file_name];
+    }else{
+      m_lines = &pending_results[file_name];
+    }
+  }
+
+  // next value of the row
+  template <typename T>
+  result_row& operator<<(T value){
+    if (m_types.empty()){
+      *m_lines << (m_field > 0 ? "," : "") << value;
+    }else{
+      NS_ASSERT_MSG(m_field < m_types.size(), "Too many values in a row");
+      result_value v;
+      if (m_types[m_field] == ColumnarWriter::DOUBLE){
+        v.d = static_cast<double>(value);
+      }else{
+        v.u = static_cast<uint64_t>(value);
+      }
+      m_values->push_back(v);
+    }
+    m_field++;
+    return *this;
+  }
+
+  // ends the row, the next values start another one
+  void end(){
+    if (m_types.empty()){
+      *m_lines << "\n";
+    }else{
+      NS_ASSERT_MSG(m_field == m_types.size(), "Missing values in a row");
+    }
+    m_field = 0;
+  }
+
+private:
+  vector<ColumnarWriter::Type> m_types; // empty for a csv file
+  vector<result_value> *m_values = nullptr;
+  ostream *m_lines = nullptr;
+  uint32_t m_field;
+};
+
+// append the values of a columnar file to <name>.bin, as one chunk
+void append_columnar_result(const string &file_name, const vector<result_value> &values){
+  vector<pair<string, ColumnarWriter::Type>> schema = columnar_schema(file_name);
+  ColumnarWriter writer;
+  for (auto &column : schema){
+    writer.AddColumn(column.first, column.second);
+  }
+  uint64_t n_rows = values.size() / schema.size();
+  writer.SetRowsPerChunk(max<uint64_t>(min<uint64_t>(n_rows, numeric_limits<uint32_t>::max()), 1));
+
+  string logFile = output_results_path + file_name.substr(0, file_name.rfind('.')) + ".bin";
+  if (!writer.Append(logFile)){
+    cout << "[ERROR] Could not append the results to " << logFile << endl;
+    return;
+  }
+
+  const result_value *value = values.data();
+  for (uint64_t row = 0; row < n_rows; row++){
+    for (uint32_t column = 0; column < schema.size(); column++, value++){
+      switch (schema[column].second){
+        case ColumnarWriter::UINT32:
+          writer.WriteU32(column, static_cast<uint32_t>(value->u));
+          break;
+        case ColumnarWriter::UINT64:
+          writer.WriteU64(column, value->u);
+          break;
+        case ColumnarWriter::DOUBLE:
+          writer.WriteDouble(column, value->d);
+          break;
+      }
+    }
+    writer.EndRow();
+  }
+  writer.Close();
 }
 
-// Count Received Packet per SF
-void PacketTraceGW(Ptr<Packet const> pacote){
-    u_int64_t pkid = pacote->GetUid();
+// append the buffered lines to a csv result file
+void append_result(const string &file_name, const string &lines){
+  ofstream os;
+  string logFile = output_results_path + file_name;
+  os.open (logFile.c_str (), std::ofstream::out | std::ofstream::app);
+  os << lines;
+  os.close();
+}
 
-    for (auto& pckt : packet_controll) {
-        
-        // if pckt is not repetead
-        if ((pckt.id == pkid) && pckt.repeat == 0)
-        {
-            int sf = pacote_sf.at(pkid);
-            Time receivedTime = Simulator :: Now ();
-            Time sent = pacote_ds.at(pkid);
-            pacote_dr.insert({pkid, receivedTime - sent});
-            spreadFList[sf].R++;
-            count_receiv_pkts = count_receiv_pkts + 1;
-            
-            pckt.repeat = 1;
-        }
-        else if ((pckt.id == pkid) && pckt.repeat == 1){
-          count_repeat_pkts = count_repeat_pkts + 1;
-        }
+void flush_results(){
+  for (auto &result : pending_results){
+    append_result(result.first, result.second.str());
+  }
+  for (auto &result : pending_columns){
+    append_columnar_result(result.first, result.second);
+  }
+  pending_results.clear();
+  pending_columns.clear();
+}
+
+// buffered results as one string, for the main process:
+// "t name\nsize\nlines" per csv file, "c name\nsize\nvalues" per
+// columnar file (the values as bytes, both processes run on this host)
+string serialize_results(){
+  ostringstream os;
+  for (auto &result : pending_results){
+    string lines = result.second.str();
+    os << "t " << result.first << "\n" << lines.size() << "\n" << lines;
+  }
+  for (auto &result : pending_columns){
+    size_t size = result.second.size() * sizeof(result_value);
+    os << "c " << result.first << "\n" << size << "\n";
+    os.write(reinterpret_cast<const char *>(result.second.data()), size);
+  }
+  pending_results.clear();
+  pending_columns.clear();
+  return os.str();
+}
+
+void append_serialized_results(const string &serialized){
+  size_t pos = 0;
+  while (pos < serialized.size()){
+    size_t end_name = serialized.find('\n', pos);
+    size_t end_size = serialized.find('\n', end_name + 1);
+    char kind = serialized[pos];
+    string file_name = serialized.substr(pos + 2, end_name - pos - 2);
+    size_t size = stoul(serialized.substr(end_name + 1, end_size - end_name - 1));
+    if (kind == 'c'){
+      vector<result_value> values(size / sizeof(result_value));
+      memcpy(values.data(), serialized.data() + end_size + 1, values.size() * sizeof(result_value));
+      append_columnar_result(file_name, values);
+    }else{
+      append_result(file_name, serialized.substr(end_size + 1, size));
     }
-    // cout << "\tReceive: " << count_receiv_pkts;
+    pos = end_size + 1 + size;
+  }
+}
+
+void initialize_structs(){
+  deviceList.resize(nDevices);
+  metrics = CreateObject<LoraMetricsCollector> ();
+  metrics->SetAttribute ("NSpreadingFactors", UintegerValue (SF_QTD));
+  distances.resize(SF_QTD);
+}
 
+void cleaning_structs(){
+  deviceList.clear();
+  metrics = 0;
+  distances.clear();
+  gateways = NodeContainer (); // the nodes of the last run are gone
+  // the datasets are part of the scenario snapshot, they are kept
 }
 
 void SimulationLog(double interval){
 
   cout <<"[SIMU " << nSimulation << "]";
-  cout <<"\tsent: " << count_send_pkts;
-  cout <<"\treceived: " << count_receiv_pkts;
-  cout <<"\trepeated: " << count_repeat_pkts << endl;
+  cout <<"\tsent: " << metrics->GetNSent();
+  cout <<"\treceived: " << metrics->GetNReceived();
+  cout <<"\trepeated: " << metrics->GetNDuplicates();
+  cout <<"\tin flight: " << metrics->GetNInFlight() << endl;
 
   Simulator::Schedule(Seconds(interval), &SimulationLog, interval);
 }
@@ -250,10 +443,8 @@ void SimulationLog(double interval){
 // write in an output file the position of devices, distance from gateway and positions (x,y) per SF
 void GetDevicePositionsPerSF(NodeContainer endDevices, NodeContainer gateways){    
     // open log file for output
-    string sf;
-    ofstream os;
-    string logFile = output_results_path + net_position_file;
-    os.open (logFile.c_str (), std::ofstream::out| std::ofstream::app);
+    uint32_t sf;
+    result_row row(net_position_file);
         
     for(NodeContainer::Iterator gw = gateways.Begin (); gw != gateways.End (); ++gw){
         uint32_t gwId = (*gw)->GetId(); 
@@ -268,32 +459,30 @@ void GetDevicePositionsPerSF(NodeContainer endDevices, NodeContainer gateways){
         
           // Prints position and velocities
           if(deviceList[nodeId].SF == 0){
-            sf = "12";
+            sf = 12;
           }else if(deviceList[nodeId].SF == 1){
-            sf = "11";
+            sf = 11;
           }else if(deviceList[nodeId].SF == 2){
-            sf = "10";
+            sf = 10;
           }else if(deviceList[nodeId].SF == 3){
-            sf = "9";
+            sf = 9;
           }else if(deviceList[nodeId].SF == 4){
-            sf = "8";
+            sf = 8;
           }else{
-            sf = "7";
+            sf = 7;
           }
 
           // id ED, x,y,z ED, SF, id GW, x,y,z GW, distance
-          os << nodeId << "," << pos.x << "," << pos.y << "," << pos.z << "," << sf << "," ;
-          os << gwId << "," << posgw.x << "," << posgw.y << "," << posgw.z << ",";
-          os << position << "\n" ; 
+          row << nodeId << pos.x << pos.y << pos.z << sf;
+          row << gwId << posgw.x << posgw.y << posgw.z;
+          row << position;
+          row.end();
         }
      }
-    os.close();
 }
 
 void GetGWRSSI(NodeContainer endDevices, NodeContainer gateways,Ptr<LoraChannel> channel){
-  ofstream os_rssi_file;
-  string logFile = output_results_path + rssi_result_file;
-  os_rssi_file.open (logFile.c_str (), std::ofstream::out | std::ofstream::app);
+  result_row rssi_row(rssi_result_file);
 
   for(NodeContainer::Iterator gw = gateways.Begin (); gw != gateways.End (); ++gw){
       uint32_t gwId = (*gw)->GetId(); 
@@ -308,10 +497,17 @@ void GetGWRSSI(NodeContainer endDevices, NodeContainer gateways,Ptr<LoraChannel>
         // std:: cout << channel->GetRxPower(20, mobModel, mobModelG) << " - distance from GW "
         // << position << std::endl ;
 
-        os_rssi_file << gwId << "," << nodeId << "," << channel->GetRxPower(txEndDevice, mobModel, mobModelG) << "," <<  position << "\n" ; 
+        double rxPower = cache_links ? link_budget->GetRxPower(txEndDevice, mobModel, mobModelG)
+                                     : channel->GetRxPower(txEndDevice, mobModel, mobModelG);
+        rssi_row << gwId << nodeId << rxPower << position;
+        rssi_row.end();
       }
   } 
-  os_rssi_file.close();
+
+  if (cache_links){
+    cout << "[INFO] Link budget cache: " << link_budget->GetNHits() << " hits, "
+         << link_budget->GetNMisses() << " misses" << endl;
+  }
 }
 
 // https://www.nsnam.org/doxygen/classns3_1_1_csv_reader.html
@@ -530,6 +726,7 @@ Ptr<PropagationLossModel> SetChannelPropagation(std::string channel_propag_selec
   Ptr<OkumuraHataPropagationLossModel> okumuraloss;
   Ptr<CorrelatedShadowingPropagationLossModel> shadowing;
   Ptr<PropagationLossModel> final_loss;
+  Ptr<PropagationLossModel> stochastic_loss; // evaluated on every transmission
 
   if (channel_propag_select == "log-distance"){
     logDistLoss = CreateObject<LogDistancePropagationLossModel> ();
@@ -566,7 +763,7 @@ Ptr<PropagationLossModel> SetChannelPropagation(std::string channel_propag_selec
     // Create the correlated shadowing component
     shadowing = CreateObject<CorrelatedShadowingPropagationLossModel> ();
     shadowing->SetAttribute("CorrelationDistance",  DoubleValue(110.0));
-    logDistLoss->SetNext (shadowing); // Aggregate shadowing to the logdistance loss
+    stochastic_loss = shadowing; // Aggregate shadowing to the logdistance loss
     final_loss = logDistLoss;
   }
   else if (channel_propag_select == "okumura"){
@@ -585,16 +782,46 @@ Ptr<PropagationLossModel> SetChannelPropagation(std::string channel_propag_selec
     okumuraLoss->SetAttribute("Frequency",DoubleValue(regionalFrequency));
     // okumuraLoss->SetAttribute("Environment", EnumValue (SubUrbanEnvironment));
     // okumuraLoss->SetAttribute("CitySize", EnumValue (SmallCity));
-    okumuraLoss->SetNext(nakagami);
     okumuraLoss->Initialize();
+    stochastic_loss = nakagami;
     final_loss = okumuraLoss;
   }
 
+  if (precompute_links){
+    // deterministic stages are evaluated once per link (see runSimulation),
+    // stochastic stages are still applied on every transmission
+    precomputed_loss = CreateObject<PrecomputedLinkLossModel> ();
+    precomputed_loss->SetDeterministicModel (final_loss);
+    if (stochastic_loss != 0){
+      precomputed_loss->SetNext (stochastic_loss);
+    }
+    return precomputed_loss;
+  }
+
+  if (stochastic_loss != 0){
+    final_loss->SetNext (stochastic_loss);
+  }
   return final_loss;
 }
 
+// Application of the ED at index i of endDevices (-1 if none), as the
+// application containers of runSimulation split them
+int application_of(int i, int numRandomDevices){
+  int bounds[] = {int(unicamp_battery_bins_dataset.size()), int(unicamp_conteiner_bins_dataset.size()),
+                  int(unicamp_smart_meters_dataset.size()), numRandomDevices, numRandomDevices};
+  for (int app = APP_BATTERY; app <= APP_LOCALIZATION; app++){
+    if (i < bounds[app]){
+      return app;
+    }
+    i -= bounds[app];
+  }
+  return -1;
+}
+
 // Simulation Code
-LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListPositionAllocator> nodePositionAllocator, Ptr<LoraChannel> channel){
+// Runs the simulation and returns every counter of metrics, taken
+// before the simulator is destroyed
+LoraMetricsCollector::Summary runSimulation(int numDevices, int numRandomDevices, Ptr<ListPositionAllocator> nodePositionAllocator, Ptr<LoraChannel> channel){
 
   Ptr<LoraChannel> channel_propag = channel;
 
@@ -603,7 +830,7 @@ LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListP
   phyHelper.SetChannel (channel_propag);
   LorawanMacHelper macHelper = LorawanMacHelper (); // Create the LorawanMacHelper
   LoraHelper helper = LoraHelper ();   // Create the LoraHelper
-  helper.EnablePacketTracking ();
+  // packets are counted by metrics (LoraMetricsCollector) while the simulation runs
 
   // Node devices Mobility
   MobilityHelper mobility; 
@@ -638,11 +865,59 @@ LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListP
   macHelper.SetDeviceType (LorawanMacHelper::GW);
   macHelper.SetRegion (LorawanMacHelper::Australia);
   helper.Install (phyHelper, macHelper, gateways);
+
+  // All nodes are in place (ConstantPositionMobilityModel): evaluate
+  // the deterministic losses of every ED x GW and ED x ED link once.
+  // The nodes of the next replications are at the same positions, so
+  // they reuse the matrix of the snapshot
+  if (precompute_links){
+    if (precomputed_loss->GetNLinks () == 0 || !precomputed_loss->Bind (endDevices, gateways)){
+      precomputed_loss->Precompute (endDevices, gateways);
+    }
+  }
+
+  // The links of the nodes at the same positions as in the previous
+  // replication are kept, the others are evaluated by this channel
+  if (cache_links){
+    link_budget->SetChannel (channel_propag);
+    link_budget->Bind (endDevices, gateways);
+  }
       
   // Set SF automatically based on position and RX power
   vector<int> sf;
-  if (nSimulation == 0){
-    vector<int> sf_up = macHelper.SetSpreadingFactorsUp (endDevices, gateways, channel_propag);
+  if (nSimulation == 0 && !sf_plan.empty()){
+    // SF (and channel) plan of a previous run (--sf_plan)
+    sf = LorawanMacHelper::ApplySpreadingFactors (endDevices, sf_plan);
+    if (!channel_plan.empty()){
+      LorawanMacHelper::ApplyChannels (endDevices, channel_plan);
+    }
+  }
+  else if (nSimulation == 0){
+    vector<int> sf_up;
+    if (sf_planner){
+      // link budgets, and the packet interval and payload of the application of each ED
+      vector<double> rx_power = LorawanMacHelper::GetHighestRxPower (endDevices, gateways, channel_propag);
+      vector<Time> intervals (numDevices, Time (0));
+      vector<uint32_t> packet_sizes (numDevices, 0);
+      for (int i = 0; i < numDevices; i++){
+        int app = application_of (i, numRandomDevices);
+        if (app >= 0){
+          intervals[i] = Seconds (application_periods[app]);
+          packet_sizes[i] = application_packet_sizes[app];
+        }
+      }
+      double predicted_pdr = 0;
+      sf_up = LorawanMacHelper::PlanSpreadingFactors (endDevices, rx_power, intervals, packet_sizes,
+                                                      2, true, channel_plan, predicted_pdr);
+      sf_up[3] = sf_up[3] + sf_up[6]; // out of range, sent at DR2
+      cout << "\n[INFO] SF planner predicted PDR: " << predicted_pdr << endl;
+    }
+    else if (cache_links){
+      sf_up = macHelper.SetSpreadingFactorsUp (endDevices, gateways, link_budget);
+    }
+    else{
+      sf_up = macHelper.SetSpreadingFactorsUpBatch (endDevices, gateways, channel_propag, sfThreads);
+    }
     sf = sf_up;
 
     for (NodeContainer::Iterator j = endDevices.Begin (); j != endDevices.End (); ++j){
@@ -656,21 +931,18 @@ LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListP
       }
     }
     sf[4] = sf[5] = sf[6] = 0;  
+
+    sf_plan = LorawanMacHelper::GetSpreadingFactors (endDevices);
+    if (sf_plan_file != "" && !LorawanMacHelper::SaveSpreadingFactors (sf_plan_file, sf_plan, channel_plan)){
+      cout << "[ERROR] Could not write the SF plan " << sf_plan_file << endl;
+    }
   }
   else{
-    std::vector<int> sf_manually (4, 0); // DR0-DR13
-    int sf_result_per_node = 0;
-    // 563 numero total de nodes - dps deixar inteligente
-    for(int i = 0; i < nDevices; i++){
-      sf_result_per_node = macHelper.SetSpreadingFactorsGivenDistributionManually (endDevices, gateways, i, deviceList_aux[i].SF);
-
-      if (sf_result_per_node == 5) sf_manually[0] = sf_manually[0] + 1;
-      else if (sf_result_per_node == 4) sf_manually[1] = sf_manually[1] + 1;
-      else if (sf_result_per_node == 3) sf_manually[2] = sf_manually[2] + 1;
-      else sf_manually[3] = sf_manually[3] + 1;
+    // the SF assignment of the first replication, in one pass
+    sf = LorawanMacHelper::ApplySpreadingFactors (endDevices, sf_plan);
+    if (!channel_plan.empty()){
+      LorawanMacHelper::ApplyChannels (endDevices, channel_plan);
     }
-    sf = sf_manually;
-    
   }
   // Set SF manually based on position and RX power - AU 915 MHz
   // vector<double> distribution(6, 0); // só estou usando do SF7 - SF12
@@ -708,7 +980,7 @@ LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListP
       }else{
           deviceList[id].SF = 0;
       }*/
-      mac->TraceConnectWithoutContext("SentNewPacket", MakeCallback(&PacketTraceDevice));
+      metrics->ConnectEndDevice(id, mac, deviceList[id].SF);
   }
   
   // All GW
@@ -726,7 +998,7 @@ LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListP
       Ptr<LorawanMac> mac = loraNetDevice->GetMac()->GetObject<LorawanMac>();
 
       cout << "GW id:" << id << endl;
-      mac->TraceConnectWithoutContext("ReceivedPacket", MakeCallback(&PacketTraceGW));
+      metrics->ConnectGateway(id, mac, loraNetDevice->GetPhy());
   }
 
 
@@ -748,28 +1020,28 @@ LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListP
   // ---- Creation of packet intervals and payload sizes for each type of node application:
   //  - batteries, containers, smart meters, air_monitoring, indoor/outdoor, localization
   PeriodicSenderHelper appHelper_battery = PeriodicSenderHelper ();
-  appHelper_battery.SetPeriod (Hours(56)); // 7 dias -> 1176 horas, 1176/3 => 3x na semana
+  appHelper_battery.SetPeriod (Seconds(application_periods[APP_BATTERY])); // 56 h: 7 dias -> 1176 horas, 1176/3 => 3x na semana
   //appHelper_battery.SetPeriod (Hours(24)); 
-  appHelper_battery.SetPacketSize (5); // bytes
+  appHelper_battery.SetPacketSize (application_packet_sizes[APP_BATTERY]); // bytes
 
   PeriodicSenderHelper appHelper_container = PeriodicSenderHelper ();
-  appHelper_container.SetPeriod (Hours(6)); // 4x dia
+  appHelper_container.SetPeriod (Seconds(application_periods[APP_CONTAINER])); // 6 h: 4x dia
   //appHelper_container.SetPeriod (Hours(24)); // 4x dia
-  appHelper_container.SetPacketSize (31);
+  appHelper_container.SetPacketSize (application_packet_sizes[APP_CONTAINER]);
 
   PeriodicSenderHelper appHelper_smart_meter = PeriodicSenderHelper ();
-  appHelper_smart_meter.SetPeriod (Minutes(15));
+  appHelper_smart_meter.SetPeriod (Seconds(application_periods[APP_SMART_METER])); // 15 min
   //appHelper_smart_meter.SetPeriod (Hours(24));
-  appHelper_smart_meter.SetPacketSize (49); // 3 correntes, 3 angulos, 3 tensoes, 3 fpotencia, 1 frequencia
+  appHelper_smart_meter.SetPacketSize (application_packet_sizes[APP_SMART_METER]); // 3 correntes, 3 angulos, 3 tensoes, 3 fpotencia, 1 frequencia
 
   PeriodicSenderHelper appHelper_air_monitoring = PeriodicSenderHelper ();
-  appHelper_air_monitoring.SetPeriod (Seconds(10));
+  appHelper_air_monitoring.SetPeriod (Seconds(application_periods[APP_AIR_MONITORING])); // 10 s
   //appHelper_air_monitoring.SetPeriod (Hours(24));
-  appHelper_air_monitoring.SetPacketSize (20);
+  appHelper_air_monitoring.SetPacketSize (application_packet_sizes[APP_AIR_MONITORING]);
 
   PeriodicSenderHelper appHelper_localization = PeriodicSenderHelper ();
-  appHelper_localization.SetPeriod (Seconds(1));
-  appHelper_localization.SetPacketSize (32);
+  appHelper_localization.SetPeriod (Seconds(application_periods[APP_LOCALIZATION])); // 1 s
+  appHelper_localization.SetPacketSize (application_packet_sizes[APP_LOCALIZATION]);
   // ----
 
   // Separation of nodes into:
@@ -784,13 +1056,16 @@ LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListP
   int size_max = int(unicamp_battery_bins_dataset.size());
   for(int i = 0; i < size_max; i++){
     endDevices_pilhas.Add(endDevices.Get(i));
+    metrics->SetApplication(endDevices.Get(i)->GetId(), APP_BATTERY);
   }
   for(int i = size_max; i < (size_max + int(unicamp_conteiner_bins_dataset.size())); i++){
     endDevices_conteiners.Add(endDevices.Get(i));
+    metrics->SetApplication(endDevices.Get(i)->GetId(), APP_CONTAINER);
   }
   size_max = size_max + int(unicamp_conteiner_bins_dataset.size());
   for(int i = size_max; i < (size_max + int(unicamp_smart_meters_dataset.size())); i++){
     endDevices_smart_meter.Add(endDevices.Get(i));
+    metrics->SetApplication(endDevices.Get(i)->GetId(), APP_SMART_METER);
   }
   size_max = size_max + int(unicamp_smart_meters_dataset.size());
   cout << "\n[INFO] Size max: " << size_max << "\n" << endl ;
@@ -798,10 +1073,12 @@ LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListP
   // Random nodes
   for(int i = size_max; i < (size_max + numRandomDevices); i++){
     endDevices_air_monitoring.Add(endDevices.Get(i));
+    metrics->SetApplication(endDevices.Get(i)->GetId(), APP_AIR_MONITORING);
   }
   size_max = size_max + numRandomDevices;
   for(int i = size_max; i < (size_max + numRandomDevices); i++){
     endDevices_localization.Add(endDevices.Get(i));
+    metrics->SetApplication(endDevices.Get(i)->GetId(), APP_LOCALIZATION);
   }
   cout << "\n[INFO] Size max: " << size_max + numRandomDevices << "\n" << endl ;
 
@@ -834,61 +1111,66 @@ LoraPacketTracker& runSimulation(int numDevices, int numRandomDevices, Ptr<ListP
   Ptr<RandomVariableStream> rv = CreateObjectWithAttributes<UniformRandomVariable> (
       "Min", DoubleValue (0), "Max", DoubleValue (10));
 
+  // metrics per time window, written while the simulation runs
+  Ptr<LoraMetricsExporter> exporter;
+  if (metricsWindow > Time(0)){
+    exporter = CreateObject<LoraMetricsExporter> ();
+    exporter->SetAttribute ("Window", TimeValue (metricsWindow));
+    exporter->SetAttribute ("FileName", StringValue (output_results_path + "window_metrics_" + to_string(nSimulation) + ".bin"));
+    exporter->SetCollector (metrics);
+    exporter->SetSpreadingFactorNames ({"sf12", "sf11", "sf10", "sf9", "sf8", "sf7"});
+    if (!exporter->Start ()){
+      cout << "[ERROR] Could not write the metrics time series" << endl;
+    }
+  }
+
   // Start simulation
   appContainer.Start (Seconds (0));
   Simulator::Schedule(Seconds(0.00), &SimulationLog, 120.0);
   Simulator::Stop (appStopTime);
   Simulator::Run ();
+  if (exporter != 0){
+    exporter->Stop ();
+  }
+  // the path occupancy of the summary is integrated up to Simulator::Now
+  LoraMetricsCollector::Summary summary = metrics->GetSummary();
   Simulator::Destroy ();
 
   // Get Device Positionn/SF
   if (nSimulation == 0){
     GetDevicePositionsPerSF(endDevices, gateways);
-    deviceList_aux = deviceList;
     //cout << "\n+++++++++++++++ oi\n";
   }
 
   // GET RX POWER - LoRa Coverage
   GetGWRSSI(endDevices, gateways, channel_propag);
 
-  // Pacotes enviados e recebidos
-  return helper.GetPacketTracker ();
   // helper.DoPrintDeviceStatus(endDevices, gateways, "resultados.txt");
-}
 
-void getSimulationResults(LoraPacketTracker& tracker){
+  return summary;
+}
 
-  Time appStopTime = simulationTime;
-  int iterator = nDevices; 
+// summary: every counter of the run, kept by metrics while it ran
+void getSimulationResults(const LoraMetricsCollector::Summary &summary){
 
   // Metricas da Camada Física
-  ofstream phy_file;
-  string logFile = output_results_path + phy_result_file;
-  phy_file.open (logFile.c_str (), std::ofstream::out | std::ofstream::app); 
+  result_row phy_row(phy_result_file);
   cout << "\n\n- Evaluate the performance at PHY level of a specific gateway: \n";
-  for (int gw = 0; gw != nGateways; ++gw){
-      vector <int> output = tracker.CountPhyPacketsPerGw(Seconds(0), appStopTime, iterator);
-      cout << "GwID " << gw << "\nReceived: " << output.at(1) << "\nInterfered: " << output.at(2)
-      << "\nNoMoreReceivers: " << output.at(3) << "\nUnderSensitivity: " << output.at(4) << "\nLost: " << output.at(5) << "\n";
+  for (int gw = 0; gw != int(summary.gateway.size()); ++gw){
+      const LoraMetricsCollector::PhyCounters &output = summary.gateway[gw];
+      cout << "GwID " << gw << "\nReceived: " << output.received << "\nInterfered: " << output.interfered
+      << "\nNoMoreReceivers: " << output.noMoreReceivers << "\nUnderSensitivity: " << output.underSensitivity << "\nLost: " << output.lost << "\n";
 
-      phy_file << gw << "," << output.at(1) << "," << output.at(2) << "," << output.at(3) << "," << output.at(4) << "," << output.at(5) << "\n";
-      iterator += 1;
+      phy_row << gw << output.received << output.interfered << output.noMoreReceivers << output.underSensitivity << output.lost;
+      phy_row.end();
   }
-  phy_file.close();
 
   // Metricas da Rede completa
   cout << "\n- Evaluate the global performance at MAC level of the whole network: \n";
-  string s =  tracker.CountMacPacketsGlobally (Seconds (0), appStopTime);
-  stringstream ss(s);
-  string item;
-  vector< string> splittedStrings;
-  while ( getline(ss, item, ' ')) {
-    splittedStrings.push_back(item);
-  }
 
   //pdr: https://www.sciencedirect.com/topics/computer-science/packet-delivery-ratio
-  double sent =  stod(splittedStrings[0]);
-  double receiv = stod(splittedStrings[1]);
+  double sent = summary.total.sent;
+  double receiv = summary.total.received;
   double PER = ( sent - receiv )/receiv;
   double PLR = ( sent - receiv )/sent;
   double PDR = receiv/sent;
@@ -897,41 +1179,84 @@ void getSimulationResults(LoraPacketTracker& tracker){
   cout << "Packet loss rate: " << PLR << "\n";
   cout << "Packet delivery rate: " << PDR << "\n";
 
-  ofstream network_file;
-  logFile = output_results_path + net_result_file;
-  network_file.open (logFile.c_str (), std::ofstream::out | std::ofstream::app);
-  network_file << sent << "," << receiv << "," << PER << "," << PLR << "," << PDR << "\n";
-  network_file.close();
+  result_stream(net_result_file) << sent << "," << receiv << "," << PER << "," << PLR << "," << PDR << "\n";
   
-  // Somatorio de delays por per SF 
-  for(auto i = pacote_dr.begin(); i != pacote_dr.end(); i++){
-    int SF = pacote_sf[i->first];
-    spreadFList[SF].delay += i->second;
-  }
-
-  ofstream delay_file;
-  logFile = output_results_path + delay_result_file;
-  delay_file.open (logFile.c_str (), std::ofstream::out | std::ofstream::app);
+  // sent, received and sum of the delays per SF are kept by metrics
+  ostream& delay_file = result_stream(delay_result_file);
   int cont_sf = 12;
   // cout << "\n- Nº of Pkts sent, received, Average delay per SF (ms), Average delay per SF (ns) & Somatorio de delays per SF:\n";
   cout << "\n- Nº of Pkts sent, received per SF\n";
-  for ( vector<spf>::iterator i = spreadFList.begin(); i!= spreadFList.end(); ++i){
-    // if(i->delay != Time(0)){
-    //   cout << i->S << " " << i->R <<  " " << (i->delay/i->R).GetMilliSeconds()  << " " << i->delay/i->R  << " " << i->delay << "\n";
-    //   delay_file << i->S << "," << i->R << "," << (i->delay/i->R).GetMilliSeconds() << "," << i->delay/i->R << "," << i->delay << "\n";
-    //   i->S = i->R  = 0;
-    //   i->delay = Time(0);
+  for (uint8_t i = 0; i < SF_QTD; i++){
+    // if(metrics->GetTotalDelay(i) != Time(0)){
+    //   cout << metrics->GetNSent(i) << " " << metrics->GetNReceived(i) <<  " " << metrics->GetMeanDelay(i).GetMilliSeconds()  << " " << metrics->GetMeanDelay(i)  << " " << metrics->GetTotalDelay(i) << "\n";
+    //   delay_file << metrics->GetNSent(i) << "," << metrics->GetNReceived(i) << "," << metrics->GetMeanDelay(i).GetMilliSeconds() << "," << metrics->GetMeanDelay(i) << "," << metrics->GetTotalDelay(i) << "\n";
     // }
     // else{  
-    cout << cont_sf << " " << i->S << " " << i->R << "\n";
-    delay_file << cont_sf << "," << i->S << "," << i->R << "\n";
+    cout << cont_sf << " " << summary.sf[i].sent << " " << summary.sf[i].received << "\n";
+    delay_file << cont_sf << "," << summary.sf[i].sent << "," << summary.sf[i].received << "\n";
     cont_sf = cont_sf -1;
-    i->S = i->R = 0;
-    i->delay = Time(0);
     // }  
   }
   cont_sf = 12;
-  delay_file.close();
+
+  cout << "\n- Nº of Pkts sent, received, PHY interfered, no more receivers, under sensitivity per application\n";
+  for (int app = 0; app < int(summary.application.size()); app++){
+    const LoraMetricsCollector::Counters &counters = summary.application[app];
+    cout << application_names[app] << " " << counters.sent << " " << counters.received << " " << counters.phy.interfered
+         << " " << counters.phy.noMoreReceivers << " " << counters.phy.underSensitivity << "\n";
+  }
+}
+
+// Runs replication nSimulation and buffers its results (see result_stream)
+void runReplication(int seed, Ptr<PropagationLossModel> propagation_model, Ptr<ListPositionAllocator> nodePositionAllocator){
+  nDevices += nDevices_without_dataset*2;
+  // Multiplicado por 2, pois são 2 aplicações sem dataset e 
+  // cada uma delas terá a qtd de nodes setada pela flag 'nDevices_without_dataset'. As aplicações sao:
+  //    - Monitoramento de ar
+  //    - Smart Parking
+
+  cout << "\n[INFO]: Simulation Seed: " << seed << " Run: " << firstRun + nSimulation;
+  cout << "\n[INFO]: Loading node datasets... ";  
+  cout << "\n[INFO] unicamp_battery_bins_dataset: " << unicamp_battery_bins_dataset.size() << endl;
+  cout << "[INFO] unicamp_conteiner_bins_dataset: " << unicamp_conteiner_bins_dataset.size() << endl;
+  cout << "[INFO] unicamp_smart_meter_dataset: " << unicamp_smart_meters_dataset.size() << endl;
+  cout << "[INFO] number of devices without dataset: " << nDevices_without_dataset << endl;
+  cout << "[INFO] Total number of devices: " << nDevices << endl;
+
+  initialize_structs(); // Structs Inicialization
+
+  Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel> ();
+  Ptr<LoraChannel> channel = CreateObject<LoraChannel> (propagation_model, delay);        
+  LoraMetricsCollector::Summary summary = runSimulation(nDevices, (int)nDevices_without_dataset/2, nodePositionAllocator, channel); // run simulation
+  
+  getSimulationResults(summary); // calculate results
+
+  // Final Log Overview
+  cout << "\n[INFO]: Simulation Seed: " << seed << " Run: " << firstRun + nSimulation;
+  cout << "\n[INFO] unicamp_battery_bins_dataset: " << unicamp_battery_bins_dataset.size() << endl;
+  cout << "[INFO] unicamp_conteiner_bins_dataset: " << unicamp_conteiner_bins_dataset.size() << endl;
+  cout << "[INFO] unicamp_smart_meter_dataset: " << unicamp_smart_meters_dataset.size() << endl;
+  cout << "[INFO] number of devices without dataset: " << nDevices_without_dataset*2 << endl;
+  cout << "[INFO] Total number of devices: " << nDevices << endl;
+  cout <<"[INFO] Simu " << nSimulation;
+  cout <<"\tsent: " << summary.total.sent;
+  cout <<"\treceived: " << summary.total.received;
+  cout <<"\trepeated: " << summary.total.duplicates << endl;      
+}
+
+// Brings the state back to the one before runReplication
+void resetReplication(){
+  // --------- Clean all values ---------
+  // clean structs
+  cleaning_structs(); 
+
+  // clean variables
+  nDevices = 0;
+  nDevices_without_dataset = nDevices_without_dataset;
+
+  // The datasets, node positions, SF assignment (sf_plan) and link
+  // matrix of the snapshot are kept as they are
+  nDevices = unicamp_battery_bins_dataset.size() + unicamp_conteiner_bins_dataset.size() + unicamp_smart_meters_dataset.size();
 }
 
 int main (int argc, char *argv[])
@@ -940,7 +1265,19 @@ int main (int argc, char *argv[])
       cmd.AddValue ("simu_repeat", "Number of Simulation Repeat", nSimulationRepeat);
       cmd.AddValue ("channel_model", "Channel Model", channel_model);
       cmd.AddValue ("n_devices_without_dataset", "Number of nodes without dataset", nDevices_without_dataset);
+      cmd.AddValue ("precompute_links", "Precompute deterministic link losses (static nodes only)", precompute_links);
+      cmd.AddValue ("cache_links", "Reuse the RX power of the SF assignment in the RSSI results", cache_links);
+      cmd.AddValue ("sf_plan", "SF plan file: read if it exists, else written by the first replication", sf_plan_file);
+      cmd.AddValue ("sf_threads", "Threads evaluating the links of the SF assignment (0 = one per core; deterministic channel models only)", sfThreads);
+      cmd.AddValue ("sf_planner", "Plan SF and uplink channels from the offered load of the applications", sf_planner);
+      cmd.AddValue ("workers", "Replications run at once in forked processes (0 = one per core)", nWorkers);
+      cmd.AddValue ("output_format", "Format of the RSSI, position and PHY results: csv or columnar", output_format);
+      cmd.AddValue ("metrics_window", "Windows of the metrics time series, e.g. 10min (0 = none)", metricsWindow);
       cmd.Parse (argc, argv);
+      if (output_format != "csv" && output_format != "columnar"){
+        cout << "[ERROR] Unknown output format " << output_format << " (csv or columnar)" << endl;
+        return 1;
+      }
      
       // Set up logging
       LogComponentEnable ("lorawan-unicamp-3d", LOG_LEVEL_ALL);
@@ -963,71 +1300,71 @@ int main (int argc, char *argv[])
 
       // Set position nodes
       Ptr<ListPositionAllocator> nodePositionAllocator = SetNodePositions(nDevices_without_dataset);
+
+      // SF plan of a previous run with the same nodes
+      if (sf_plan_file != "" && ifstream(sf_plan_file).good()){
+        if (!LorawanMacHelper::LoadSpreadingFactors (sf_plan_file, sf_plan, channel_plan)
+            || sf_plan.size() != (size_t) (nDevices + nDevices_without_dataset*2)){
+          cout << "[ERROR] " << sf_plan_file << " is not an SF plan for " << nDevices + nDevices_without_dataset*2 << " devices" << endl;
+          return 1;
+        }
+        // the planner is not run again: the plan must have been made with the same option
+        if (sf_planner && channel_plan.empty()){
+          cout << "[ERROR] --sf_planner is set, but " << sf_plan_file << " was not planned with it (no channel plan)" << endl;
+          return 1;
+        }
+        if (!sf_planner && !channel_plan.empty()){
+          cout << "[ERROR] " << sf_plan_file << " was planned with --sf_planner (it has a channel plan), which is not set" << endl;
+          return 1;
+        }
+        cout << "[INFO] SF plan read from " << sf_plan_file << endl;
+      }
       
       // Set propagation loss
       Ptr<PropagationLossModel> propagation_model = SetChannelPropagation(channel_model);
+      if (sfThreads != 1 && !LorawanMacHelper::IsDeterministic (propagation_model)){
+        cout << "[ERROR] --sf_threads needs a deterministic channel model, not " << channel_model << endl;
+        return 1;
+      }
+      if (cache_links){
+        link_budget = CreateObject<LinkBudgetCache> ();
+      }
      
-      for(nSimulation = 0; nSimulation < nSimulationRepeat; nSimulation++){
-        // generate a different seed for each simulation 
-        srand(time(0));
-        int seed = rand();
-        RngSeedManager::SetSeed (seed); 
-        RngSeedManager::SetRun (7); 
- 
-        nDevices += nDevices_without_dataset*2;
-        // Multiplicado por 2, pois são 2 aplicações sem dataset e 
-        // cada uma delas terá a qtd de nodes setada pela flag 'nDevices_without_dataset'. As aplicações sao:
-        //    - Monitoramento de ar
-        //    - Smart Parking
-
-        cout << "\n[INFO]: Simulation Seed: " << seed;  
-        cout << "\n[INFO]: Loading node datasets... ";  
-        cout << "\n[INFO] unicamp_battery_bins_dataset: " << unicamp_battery_bins_dataset.size() << endl;
-        cout << "[INFO] unicamp_conteiner_bins_dataset: " << unicamp_conteiner_bins_dataset.size() << endl;
-        cout << "[INFO] unicamp_smart_meter_dataset: " << unicamp_smart_meters_dataset.size() << endl;
-        cout << "[INFO] number of devices without dataset: " << nDevices_without_dataset << endl;
-        cout << "[INFO] Total number of devices: " << nDevices << endl;
-
-        initialize_structs(); // Structs Inicialization
-
-        Ptr<PropagationDelayModel> delay = CreateObject<ConstantSpeedPropagationDelayModel> ();
-        Ptr<LoraChannel> channel = CreateObject<LoraChannel> (propagation_model, delay);        
-        LoraPacketTracker& tracker = runSimulation(nDevices, (int)nDevices_without_dataset/2, nodePositionAllocator, channel); // run simulation
-        
-        getSimulationResults(tracker); // calculate results
-
-        // Final Log Overview
-        cout << "\n[INFO]: Simulation Seed: " << seed;   
-        cout << "\n[INFO] unicamp_battery_bins_dataset: " << unicamp_battery_bins_dataset.size() << endl;
-        cout << "[INFO] unicamp_conteiner_bins_dataset: " << unicamp_conteiner_bins_dataset.size() << endl;
-        cout << "[INFO] unicamp_smart_meter_dataset: " << unicamp_smart_meters_dataset.size() << endl;
-        cout << "[INFO] number of devices without dataset: " << nDevices_without_dataset*2 << endl;
-        cout << "[INFO] Total number of devices: " << nDevices << endl;
-        cout <<"[INFO] Simu " << nSimulation;
-        cout <<"\tsent: " << count_send_pkts;
-        cout <<"\treceived: " << count_receiv_pkts;
-        cout <<"\trepeated: " << count_repeat_pkts << endl;      
+      // one seed for the whole sweep, one run number per replication
+      srand(time(0));
+      int seed = rand();
+      RngSeedManager::SetSeed (seed);
+
+      int nSequential = (nWorkers == 1) ? nSimulationRepeat : min(nSimulationRepeat, 1);
+      for(nSimulation = 0; nSimulation < nSequential; nSimulation++){
+        RngSeedManager::SetRun (firstRun + nSimulation);
+        runReplication(seed, propagation_model, nodePositionAllocator);
+        flush_results();
+        resetReplication();
+      }
 
-        
-        // --------- Clean all values ---------
-        // clean structs
-        cleaning_structs(); 
-
-        // clean Tracker
-        tracker.~LoraPacketTracker();
-
-        // clean variables
-        count_send_pkts = 0;
-        count_receiv_pkts = 0;
-        count_repeat_pkts = 0;
-        nDevices = 0;
-        nDevices_without_dataset = nDevices_without_dataset;
-
-        // Load datasets Again
-        read_battery_bin_dataset(nodes_battery_dataset); 
-        read_conteiner_bin_dataset(nodes_conteiner_dataset);
-        read_smart_meter_dataset(nodes_smart_meter_dataset);
-        nDevices = unicamp_battery_bins_dataset.size() + unicamp_conteiner_bins_dataset.size() + unicamp_smart_meters_dataset.size();
+      if (nSequential < nSimulationRepeat){
+        // the other replications start from the snapshot left by the first
+        // one (datasets, positions, SF assignment, link matrix), each in a
+        // process of its own that shares it copy-on-write
+        ReplicationRunner runner (nWorkers);
+        cout << "\n[INFO] Running replications " << nSequential << " to " << nSimulationRepeat - 1
+             << " on " << runner.GetNWorkers() << " workers" << endl;
+        vector<ReplicationRunner::Result> results = runner.Run (firstRun + nSequential, nSimulationRepeat - nSequential,
+          [&] (uint32_t run) {
+            nSimulation = run - firstRun;
+            runReplication(seed, propagation_model, nodePositionAllocator);
+            return serialize_results();
+          });
+        for (auto &result : results){
+          if (!result.ok){
+            cout << "[ERROR] Replication " << result.run - firstRun << " failed" << endl;
+            continue;
+          }
+          cout << "[INFO] Replication " << result.run - firstRun << " peak RSS: " << result.maxRss << " KiB" << endl;
+          append_serialized_results(result.output);
+        }
+        cout << "[INFO] Main process peak RSS: " << ReplicationRunner::GetMaxRss() << " KiB" << endl;
       }
 
       return 0;
@@ -0,0 +1,207 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include "ns3/async-record-writer.h"
+
+namespace ns3 {
+namespace lorawan {
+
+NS_LOG_COMPONENT_DEFINE ("AsyncRecordWriter");
+
+namespace {
+
+// the lines are written to the file in blocks of about this size
+const std::streamoff WRITE_BYTES = 1 << 16;
+
+} // anonymous namespace
+
+AsyncRecordWriter::AsyncRecordWriter ()
+  : m_capacity (1 << 16),
+    m_recordSize (0),
+    m_open (false),
+    m_nStalls (0),
+    m_nDropped (0),
+    m_head (0),
+    m_tail (0),
+    m_stop (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+AsyncRecordWriter::~AsyncRecordWriter ()
+{
+  NS_LOG_FUNCTION (this);
+
+  Close ();
+}
+
+void
+AsyncRecordWriter::SetCapacity (uint32_t capacity)
+{
+  NS_LOG_FUNCTION (this << capacity);
+
+  m_capacity = 1;
+  while (m_capacity < capacity)
+    {
+      m_capacity *= 2;
+    }
+}
+
+bool
+AsyncRecordWriter::Open (const std::string &filename, uint32_t recordSize, Formatter formatter, bool append)
+{
+  NS_LOG_FUNCTION (this << filename << recordSize << append);
+  NS_ASSERT_MSG (recordSize > 0, "Records of 0 bytes");
+
+  Close ();
+  m_file.open (filename.c_str (), std::ios::out | (append ? std::ios::app : std::ios::trunc));
+  if (!(m_file.is_open ()))
+    {
+      NS_LOG_ERROR ("Could not open " << filename << " for writing.");
+      return false;
+    }
+
+  m_recordSize = recordSize;
+  m_ring.assign (static_cast<uint64_t> (m_capacity) * m_recordSize, 0);
+  m_formatter = formatter;
+  m_nStalls = 0;
+  m_nDropped = 0;
+  m_head.store (0);
+  m_tail.store (0);
+  m_stop.store (false);
+  m_thread = std::thread (&AsyncRecordWriter::Run, this);
+  m_destroyEvent = Simulator::ScheduleDestroy (&AsyncRecordWriter::Close, this);
+  m_open = true;
+  return true;
+}
+
+bool
+AsyncRecordWriter::IsOpen (void) const
+{
+  // not m_file.is_open (): the file belongs to the background thread
+  return m_open;
+}
+
+void
+AsyncRecordWriter::Write (const void *record)
+{
+  if (!m_open)
+    {
+      // no ring to copy the record to, in any build
+      if (m_nDropped++ == 0)
+        {
+          NS_LOG_WARN ("Record written to a closed file, dropped (and so are the next ones).");
+        }
+      return;
+    }
+
+  uint64_t head = m_head.load (std::memory_order_relaxed);
+  if (head - m_tail.load (std::memory_order_acquire) >= m_capacity)
+    {
+      m_nStalls++;
+      while (head - m_tail.load (std::memory_order_acquire) >= m_capacity)
+        {
+          std::this_thread::yield ();
+        }
+    }
+  std::memcpy (&m_ring[(head & (m_capacity - 1)) * m_recordSize], record, m_recordSize);
+  m_head.store (head + 1, std::memory_order_release);
+}
+
+void
+AsyncRecordWriter::Run (void)
+{
+  std::ostringstream lines;
+  uint64_t tail = m_tail.load (std::memory_order_relaxed);
+  while (true)
+    {
+      // read before head, so that the records written before the stop are seen
+      bool stop = m_stop.load (std::memory_order_acquire);
+      uint64_t head = m_head.load (std::memory_order_acquire);
+      for (; tail != head; tail++)
+        {
+          m_formatter (lines, &m_ring[(tail & (m_capacity - 1)) * m_recordSize]);
+          m_tail.store (tail + 1, std::memory_order_release);
+          if (lines.tellp () >= WRITE_BYTES)
+            {
+              m_file << lines.str ();
+              lines.str ("");
+            }
+        }
+
+      // nothing to format: write what is left, and wait for more
+      if (lines.tellp () > 0)
+        {
+          m_file << lines.str ();
+          lines.str ("");
+        }
+      if (stop)
+        {
+          break;
+        }
+      m_file.flush ();
+      std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
+  m_file.flush ();
+}
+
+void
+AsyncRecordWriter::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_open = false;
+  if (m_thread.joinable ())
+    {
+      Simulator::Cancel (m_destroyEvent);
+      m_stop.store (true, std::memory_order_release);
+      m_thread.join ();
+      NS_LOG_INFO ("Wrote " << m_head.load () << " records (" << m_nStalls << " stalls).");
+    }
+  if (m_file.is_open ())
+    {
+      m_file.close ();
+    }
+}
+
+uint64_t
+AsyncRecordWriter::GetNRecords (void) const
+{
+  return m_head.load (std::memory_order_relaxed);
+}
+
+uint64_t
+AsyncRecordWriter::GetNStalls (void) const
+{
+  return m_nStalls;
+}
+
+uint64_t
+AsyncRecordWriter::GetNDropped (void) const
+{
+  return m_nDropped;
+}
+
+} // namespace lorawan
+} // namespace ns3
@@ -0,0 +1,158 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef ASYNC_RECORD_WRITER_H
+#define ASYNC_RECORD_WRITER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ns3/event-id.h"
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * \ingroup lorawan
+ * \brief Writes records to a text file from a background thread
+ *
+ * The simulator thread only copies fixed-size records (plain structs)
+ * into a single producer, single consumer ring; a background thread
+ * formats them into lines and writes them to the file in large blocks.
+ * Write never waits on the file, only on a full ring (counted, see
+ * GetNStalls), when the background thread falls behind.
+ *
+ * The formatter runs on the background thread: it may only read the
+ * record it is given, not the simulator state.
+ *
+ * Every record written is in the file once Close returns. Close is
+ * called on Simulator::Destroy (and by the destructor), so a writer
+ * opened during a simulation is complete when Simulator::Destroy returns.
+ */
+class AsyncRecordWriter
+{
+public:
+  /**
+   * \brief Formats a record into lines of the file
+   */
+  typedef std::function<void (std::ostream &os, const void *record)> Formatter;
+
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  AsyncRecordWriter ();
+
+  /**
+   * \brief Destructor, closes the file
+   * \return none
+   */
+  ~AsyncRecordWriter ();
+
+  /**
+   * \brief Sets the number of records the ring holds, for the next Open
+   * \param capacity the number of records (rounded up to a power of 2)
+   * \return none
+   */
+  void SetCapacity (uint32_t capacity);
+
+  /**
+   * \brief Opens a file and starts the background thread. Any file open
+   * before is closed.
+   * \param filename the file
+   * \param recordSize the size of the records, in bytes
+   * \param formatter formats a record
+   * \param append add the lines after the ones of the file, or truncate it
+   * \return false if the file cannot be opened
+   */
+  bool Open (const std::string &filename, uint32_t recordSize, Formatter formatter, bool append);
+
+  /**
+   * \brief Tells whether the file is open
+   * \return true if the file is open
+   */
+  bool IsOpen (void) const;
+
+  /**
+   * \brief Queues a record, to be formatted and written by the background
+   * thread. Only one thread may call Write. A record written while the
+   * file is not open is dropped (see GetNDropped).
+   * \param record the record (recordSize bytes, copied)
+   * \return none
+   */
+  void Write (const void *record);
+
+  /**
+   * \brief Waits until every record is written, then closes the file and
+   * stops the background thread
+   * \return none
+   */
+  void Close (void);
+
+  /**
+   * \brief Gets the number of records written since the file was opened
+   * \return the number of records
+   */
+  uint64_t GetNRecords (void) const;
+
+  /**
+   * \brief Gets the number of records that waited for room in the ring
+   * \return the number of stalls
+   */
+  uint64_t GetNStalls (void) const;
+
+  /**
+   * \brief Gets the number of records dropped because the file was not open
+   * \return the number of dropped records
+   */
+  uint64_t GetNDropped (void) const;
+
+private:
+  AsyncRecordWriter (const AsyncRecordWriter &);
+  AsyncRecordWriter &operator= (const AsyncRecordWriter &);
+
+  // background thread: formats the records and writes them to the file
+  void Run (void);
+
+  uint32_t m_capacity;            // records in the ring (a power of 2)
+  uint32_t m_recordSize;
+  std::vector<char> m_ring;
+  Formatter m_formatter;
+  std::ofstream m_file;
+  std::thread m_thread;
+  EventId m_destroyEvent;         // Close on Simulator::Destroy
+  bool m_open;                    // Open succeeded, and Close not called
+  uint64_t m_nStalls;
+  uint64_t m_nDropped;
+
+  // the producer and the consumer each write one of these, keep them
+  // on cache lines of their own
+  alignas (64) std::atomic<uint64_t> m_head; // records written
+  alignas (64) std::atomic<uint64_t> m_tail; // records formatted
+  alignas (64) std::atomic<bool> m_stop;
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* ASYNC_RECORD_WRITER_H */
@@ -0,0 +1,284 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "ns3/log.h"
+
+#include "ns3/columnar-writer.h"
+
+namespace ns3 {
+namespace lorawan {
+
+NS_LOG_COMPONENT_DEFINE ("ColumnarWriter");
+
+namespace {
+
+// Bump COLUMNAR_VERSION whenever the layout changes.
+const char COLUMNAR_MAGIC[8] = {'N', 'S', '3', 'C', 'O', 'L', 'M', 'N'};
+const uint32_t COLUMNAR_VERSION = 1;
+const uint32_t COLUMNAR_BYTE_ORDER = 0x01020304;
+
+// at most this many rows are reserved per column when the file is opened
+const size_t MAX_RESERVED_ROWS = 1 << 16;
+
+void
+WriteU32To (std::ostream &file, uint32_t value)
+{
+  file.write (reinterpret_cast<const char *> (&value), sizeof (value));
+}
+
+} // anonymous namespace
+
+ColumnarWriter::ColumnarWriter ()
+  : m_rowsPerChunk (1),
+    m_nBuffered (0),
+    m_nRows (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+ColumnarWriter::~ColumnarWriter ()
+{
+  NS_LOG_FUNCTION (this);
+
+  Close ();
+}
+
+uint32_t
+ColumnarWriter::AddColumn (const std::string &name, Type type)
+{
+  NS_LOG_FUNCTION (this << name << type);
+  NS_ASSERT_MSG (!m_file.is_open (), "Column " << name << " added after the file was opened");
+
+  m_names.push_back (name);
+  m_types.push_back (type);
+  m_data.push_back (std::vector<char> ());
+  return m_names.size () - 1;
+}
+
+void
+ColumnarWriter::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Close ();
+  m_names.clear ();
+  m_types.clear ();
+  m_data.clear ();
+}
+
+uint32_t
+ColumnarWriter::GetNColumns (void) const
+{
+  return m_names.size ();
+}
+
+void
+ColumnarWriter::SetRowsPerChunk (uint32_t rowsPerChunk)
+{
+  NS_LOG_FUNCTION (this << rowsPerChunk);
+
+  m_rowsPerChunk = std::max<uint32_t> (rowsPerChunk, 1);
+}
+
+uint32_t
+ColumnarWriter::GetSize (Type type)
+{
+  return (type == UINT32) ? 4 : 8;
+}
+
+std::string
+ColumnarWriter::GetHeader (void) const
+{
+  std::ostringstream header;
+  header.write (COLUMNAR_MAGIC, sizeof (COLUMNAR_MAGIC));
+  WriteU32To (header, COLUMNAR_VERSION);
+  WriteU32To (header, COLUMNAR_BYTE_ORDER);
+  WriteU32To (header, m_names.size ());
+  for (uint32_t column = 0; column < m_names.size (); column++)
+    {
+      WriteU32To (header, m_types[column]);
+      WriteU32To (header, m_names[column].size ());
+      header.write (m_names[column].data (), m_names[column].size ());
+    }
+  return header.str ();
+}
+
+bool
+ColumnarWriter::OpenFile (const std::string &filename, std::ios::openmode mode, bool writeHeader)
+{
+  Close ();
+  m_file.open (filename.c_str (), std::ios::out | std::ios::binary | mode);
+  if (!(m_file.is_open ()))
+    {
+      NS_LOG_ERROR ("Could not open " << filename << " for writing.");
+      return false;
+    }
+
+  if (writeHeader)
+    {
+      std::string header = GetHeader ();
+      m_file.write (header.data (), header.size ());
+    }
+  for (uint32_t column = 0; column < m_names.size (); column++)
+    {
+      m_data[column].clear ();
+      // in size_t, and capped: a writer that only writes on Flush or
+      // Close sets a huge chunk, the buffers then grow as needed
+      size_t rows = std::min<size_t> (m_rowsPerChunk, MAX_RESERVED_ROWS);
+      m_data[column].reserve (rows * GetSize (m_types[column]));
+    }
+  m_nBuffered = 0;
+  m_nRows = 0;
+  m_file.flush ();
+  return static_cast<bool> (m_file);
+}
+
+bool
+ColumnarWriter::Open (const std::string &filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  return OpenFile (filename, std::ios::trunc, true);
+}
+
+bool
+ColumnarWriter::Append (const std::string &filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  // the rows can only follow rows of the same columns
+  std::string header = GetHeader ();
+  std::ifstream existing (filename.c_str (), std::ios::in | std::ios::binary);
+  if (existing.is_open () && (existing.peek () != std::ifstream::traits_type::eof ()))
+    {
+      std::string existingHeader (header.size (), '\0');
+      existing.read (&existingHeader[0], existingHeader.size ());
+      if (!existing || (existingHeader != header))
+        {
+          NS_LOG_ERROR ("File " << filename << " has other columns.");
+          return false;
+        }
+      existing.close ();
+      return OpenFile (filename, std::ios::app, false);
+    }
+  existing.close ();
+  return OpenFile (filename, std::ios::trunc, true);
+}
+
+bool
+ColumnarWriter::IsOpen (void) const
+{
+  return m_file.is_open ();
+}
+
+void
+ColumnarWriter::Write (uint32_t column, Type type, const void *value)
+{
+  NS_ASSERT_MSG (column < m_names.size (), "No column " << column);
+  NS_ASSERT_MSG (m_types[column] == type, "Column " << m_names[column] << " is not of type " << type);
+
+  std::vector<char> &data = m_data[column];
+  data.insert (data.end (), static_cast<const char *> (value), static_cast<const char *> (value) + GetSize (type));
+}
+
+void
+ColumnarWriter::WriteU32 (uint32_t column, uint32_t value)
+{
+  Write (column, UINT32, &value);
+}
+
+void
+ColumnarWriter::WriteU64 (uint32_t column, uint64_t value)
+{
+  Write (column, UINT64, &value);
+}
+
+void
+ColumnarWriter::WriteDouble (uint32_t column, double value)
+{
+  Write (column, DOUBLE, &value);
+}
+
+void
+ColumnarWriter::EndRow (void)
+{
+  m_nBuffered++;
+  m_nRows++;
+  for (uint32_t column = 0; column < m_names.size (); column++)
+    {
+      NS_ASSERT_MSG (m_data[column].size () == m_nBuffered * GetSize (m_types[column]),
+                     "Column " << m_names[column] << " set " << m_data[column].size () / GetSize (m_types[column])
+                               << " times for " << m_nBuffered << " rows");
+    }
+
+  if (m_nBuffered >= m_rowsPerChunk)
+    {
+      Flush ();
+    }
+}
+
+bool
+ColumnarWriter::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (!(m_file.is_open ()))
+    {
+      return false;
+    }
+  if (m_nBuffered > 0)
+    {
+      WriteU32To (m_file, m_nBuffered);
+      for (std::vector<std::vector<char> >::iterator it = m_data.begin (); it != m_data.end (); ++it)
+        {
+          m_file.write (it->data (), it->size ());
+          it->clear ();
+        }
+      m_nBuffered = 0;
+    }
+  m_file.flush ();
+  if (!m_file)
+    {
+      NS_LOG_ERROR ("Could not write a chunk of " << m_names.size () << " columns.");
+      return false;
+    }
+  return true;
+}
+
+void
+ColumnarWriter::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_file.is_open ())
+    {
+      Flush ();
+      m_file.close ();
+    }
+}
+
+uint64_t
+ColumnarWriter::GetNRows (void) const
+{
+  return m_nRows;
+}
+
+} // namespace lorawan
+} // namespace ns3
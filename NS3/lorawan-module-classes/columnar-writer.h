@@ -0,0 +1,200 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef COLUMNAR_WRITER_H
+#define COLUMNAR_WRITER_H
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Writes a table of typed columns to a binary file, in chunks
+ *
+ * The rows are buffered column by column and written as a chunk every
+ * RowsPerChunk rows (and on Flush and Close), so that a file being written
+ * can be read up to its last chunk. The file is:
+ * - a header: the magic "NS3COLMN", the version, 0x01020304 (to check the
+ *   byte order), the number of columns (uint32_t each), then for each
+ *   column its type and the length of its name (uint32_t each) and the
+ *   name;
+ * - chunks: the number of rows (uint32_t), then the values of each column
+ *   for these rows, one column after the other.
+ *
+ * The values use the byte order and the floating point format of the host.
+ * Several runs may append their rows to the same file (see Append), as
+ * long as they write the same columns.
+ */
+class ColumnarWriter
+{
+public:
+  /**
+   * \brief Type of the values of a column
+   */
+  enum Type
+  {
+    UINT32 = 0, //!< uint32_t
+    UINT64 = 1, //!< uint64_t
+    DOUBLE = 2  //!< double
+  };
+
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  ColumnarWriter ();
+
+  /**
+   * \brief Destructor, closes the file
+   * \return none
+   */
+  ~ColumnarWriter ();
+
+  /**
+   * \brief Adds a column. The columns are added before the file is opened.
+   * \param name the name of the column
+   * \param type the type of its values
+   * \return the index of the column
+   */
+  uint32_t AddColumn (const std::string &name, Type type);
+
+  /**
+   * \brief Closes the file and removes every column
+   * \return none
+   */
+  void Clear (void);
+
+  /**
+   * \brief Gets the number of columns
+   * \return the number of columns
+   */
+  uint32_t GetNColumns (void) const;
+
+  /**
+   * \brief Sets the number of rows buffered before a chunk is written.
+   * Room for at most 65536 rows is reserved when the file is opened, the
+   * buffers grow beyond that as the rows come.
+   * \param rowsPerChunk the number of rows (at least 1)
+   * \return none
+   */
+  void SetRowsPerChunk (uint32_t rowsPerChunk);
+
+  /**
+   * \brief Creates the file (truncated if it exists) and writes the header
+   * \param filename the file
+   * \return false if the file cannot be written
+   */
+  bool Open (const std::string &filename);
+
+  /**
+   * \brief Opens a file to add rows after the ones it has. The file is
+   * created if it does not exist or is empty.
+   * \param filename the file
+   * \return false if the file has other columns, or cannot be written
+   */
+  bool Append (const std::string &filename);
+
+  /**
+   * \brief Tells whether the file is open
+   * \return true if the file is open
+   */
+  bool IsOpen (void) const;
+
+  /**
+   * \brief Sets the value of a UINT32 column in the current row
+   * \param column the column
+   * \param value the value
+   * \return none
+   */
+  void WriteU32 (uint32_t column, uint32_t value);
+
+  /**
+   * \brief Sets the value of a UINT64 column in the current row
+   * \param column the column
+   * \param value the value
+   * \return none
+   */
+  void WriteU64 (uint32_t column, uint64_t value);
+
+  /**
+   * \brief Sets the value of a DOUBLE column in the current row
+   * \param column the column
+   * \param value the value
+   * \return none
+   */
+  void WriteDouble (uint32_t column, double value);
+
+  /**
+   * \brief Ends the current row, every column must have been set. The
+   * chunk is written once it has RowsPerChunk rows.
+   * \return none
+   */
+  void EndRow (void);
+
+  /**
+   * \brief Writes the rows buffered as a chunk, and flushes the file
+   * \return false if the file cannot be written
+   */
+  bool Flush (void);
+
+  /**
+   * \brief Flushes and closes the file. The columns are kept.
+   * \return none
+   */
+  void Close (void);
+
+  /**
+   * \brief Gets the number of rows ended since the file was opened
+   * \return the number of rows
+   */
+  uint64_t GetNRows (void) const;
+
+private:
+  ColumnarWriter (const ColumnarWriter &);
+  ColumnarWriter &operator= (const ColumnarWriter &);
+
+  // the header of a file with the columns
+  std::string GetHeader (void) const;
+
+  // opens the file with the given mode, and writes the header if asked to
+  bool OpenFile (const std::string &filename, std::ios::openmode mode, bool writeHeader);
+
+  // appends a value to the buffer of a column of the given type
+  void Write (uint32_t column, Type type, const void *value);
+
+  // size of the values of a type, in bytes
+  static uint32_t GetSize (Type type);
+
+  std::vector<std::string> m_names;
+  std::vector<Type> m_types;
+  std::vector<std::vector<char> > m_data; // values of the rows buffered, by column
+  uint32_t m_rowsPerChunk;
+  uint32_t m_nBuffered;                   // rows buffered
+  uint64_t m_nRows;
+  std::ofstream m_file;
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* COLUMNAR_WRITER_H */
@@ -0,0 +1,260 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "ns3/link-budget-cache.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+namespace lorawan {
+
+NS_LOG_COMPONENT_DEFINE ("LinkBudgetCache");
+
+NS_OBJECT_ENSURE_REGISTERED (LinkBudgetCache);
+
+namespace {
+
+bool
+SamePosition (const Vector &a, const Vector &b)
+{
+  return (a.x == b.x) && (a.y == b.y) && (a.z == b.z);
+}
+
+const double UNKNOWN = std::numeric_limits<double>::quiet_NaN ();
+
+} // anonymous namespace
+
+TypeId
+LinkBudgetCache::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LinkBudgetCache")
+    .SetParent<Object> ()
+    .SetGroupName ("lorawan")
+    .AddConstructor<LinkBudgetCache> ();
+  return tid;
+}
+
+LinkBudgetCache::LinkBudgetCache () : m_nHits (0), m_nMisses (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+LinkBudgetCache::~LinkBudgetCache ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LinkBudgetCache::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_channel = 0;
+  Unbind ();
+  Object::DoDispose ();
+}
+
+void
+LinkBudgetCache::Unbind (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (std::vector<Ptr<MobilityModel> >::iterator it = m_edMobility.begin (); it != m_edMobility.end (); ++it)
+    {
+      (*it)->TraceDisconnectWithoutContext ("CourseChange",
+                                            MakeCallback (&LinkBudgetCache::CourseChange, this));
+    }
+  for (std::vector<Ptr<MobilityModel> >::iterator it = m_gwMobility.begin (); it != m_gwMobility.end (); ++it)
+    {
+      (*it)->TraceDisconnectWithoutContext ("CourseChange",
+                                            MakeCallback (&LinkBudgetCache::CourseChange, this));
+    }
+  m_edIndex.clear ();
+  m_gwIndex.clear ();
+  m_edMobility.clear ();
+  m_gwMobility.clear ();
+}
+
+void
+LinkBudgetCache::SetChannel (Ptr<LoraChannel> channel)
+{
+  NS_LOG_FUNCTION (this << channel);
+
+  m_channel = channel;
+}
+
+Ptr<LoraChannel>
+LinkBudgetCache::GetChannel (void) const
+{
+  return m_channel;
+}
+
+void
+LinkBudgetCache::Bind (NodeContainer endDevices, NodeContainer gateways)
+{
+  NS_LOG_FUNCTION (this << endDevices.GetN () << gateways.GetN ());
+
+  uint32_t nEd = endDevices.GetN ();
+  uint32_t nGw = gateways.GetN ();
+  uint32_t oldNGw = m_gwPosition.size ();
+
+  std::vector<Ptr<MobilityModel> > edMobility (nEd);
+  std::vector<Ptr<MobilityModel> > gwMobility (nGw);
+  std::vector<Vector> edPosition (nEd);
+  std::vector<Vector> gwPosition (nGw);
+  std::vector<bool> edKept (nEd);
+  std::vector<bool> gwKept (nGw);
+  for (uint32_t i = 0; i < nEd; i++)
+    {
+      edMobility[i] = endDevices.Get (i)->GetObject<MobilityModel> ();
+      NS_ASSERT (edMobility[i] != 0);
+      edPosition[i] = edMobility[i]->GetPosition ();
+      edKept[i] = (i < m_edPosition.size ()) && SamePosition (edPosition[i], m_edPosition[i]);
+    }
+  for (uint32_t g = 0; g < nGw; g++)
+    {
+      gwMobility[g] = gateways.Get (g)->GetObject<MobilityModel> ();
+      NS_ASSERT (gwMobility[g] != 0);
+      gwPosition[g] = gwMobility[g]->GetPosition ();
+      gwKept[g] = (g < oldNGw) && SamePosition (gwPosition[g], m_gwPosition[g]);
+    }
+
+  // keep the links whose two ends did not move
+  std::vector<double> loss (static_cast<uint64_t> (nEd) * nGw, UNKNOWN);
+  uint32_t nKept = 0;
+  for (uint32_t i = 0; i < nEd; i++)
+    {
+      if (!edKept[i])
+        {
+          continue;
+        }
+      for (uint32_t g = 0; g < nGw; g++)
+        {
+          if (gwKept[g])
+            {
+              loss[static_cast<uint64_t> (i) * nGw + g] = m_loss[static_cast<uint64_t> (i) * oldNGw + g];
+              nKept++;
+            }
+        }
+    }
+  NS_LOG_INFO ("Bound " << nEd << " end devices and " << nGw << " gateways, "
+               << nKept << " links kept.");
+
+  // listen to the new nodes only (a node bound again is connected once)
+  Unbind ();
+  for (uint32_t i = 0; i < nEd; i++)
+    {
+      m_edIndex[PeekPointer (edMobility[i])] = i;
+      edMobility[i]->TraceConnectWithoutContext ("CourseChange",
+                                                 MakeCallback (&LinkBudgetCache::CourseChange, this));
+    }
+  for (uint32_t g = 0; g < nGw; g++)
+    {
+      m_gwIndex[PeekPointer (gwMobility[g])] = g;
+      gwMobility[g]->TraceConnectWithoutContext ("CourseChange",
+                                                 MakeCallback (&LinkBudgetCache::CourseChange, this));
+    }
+  m_edMobility.swap (edMobility);
+  m_gwMobility.swap (gwMobility);
+  m_edPosition.swap (edPosition);
+  m_gwPosition.swap (gwPosition);
+  m_loss.swap (loss);
+}
+
+void
+LinkBudgetCache::CourseChange (Ptr<const MobilityModel> mobility)
+{
+  uint32_t nGw = m_gwPosition.size ();
+  Vector position = mobility->GetPosition ();
+
+  std::unordered_map<const MobilityModel *, uint32_t>::const_iterator it =
+      m_edIndex.find (PeekPointer (mobility));
+  if (it != m_edIndex.end () && !SamePosition (position, m_edPosition[it->second]))
+    {
+      NS_LOG_DEBUG ("End device " << it->second << " moved to " << position << ".");
+      m_edPosition[it->second] = position;
+      std::fill (m_loss.begin () + static_cast<uint64_t> (it->second) * nGw,
+                 m_loss.begin () + static_cast<uint64_t> (it->second + 1) * nGw, UNKNOWN);
+    }
+
+  it = m_gwIndex.find (PeekPointer (mobility));
+  if (it != m_gwIndex.end () && !SamePosition (position, m_gwPosition[it->second]))
+    {
+      NS_LOG_DEBUG ("Gateway " << it->second << " moved to " << position << ".");
+      m_gwPosition[it->second] = position;
+      for (uint64_t link = it->second; link < m_loss.size (); link += nGw)
+        {
+          m_loss[link] = UNKNOWN;
+        }
+    }
+}
+
+double
+LinkBudgetCache::GetRxPower (double txPowerDbm, Ptr<MobilityModel> endDevice,
+                             Ptr<MobilityModel> gateway)
+{
+  NS_ASSERT_MSG (m_channel != 0, "No channel to evaluate the links");
+
+  std::unordered_map<const MobilityModel *, uint32_t>::const_iterator ed =
+      m_edIndex.find (PeekPointer (endDevice));
+  std::unordered_map<const MobilityModel *, uint32_t>::const_iterator gw =
+      m_gwIndex.find (PeekPointer (gateway));
+  if (ed == m_edIndex.end () || gw == m_gwIndex.end ())
+    {
+      m_nMisses++;
+      return m_channel->GetRxPower (txPowerDbm, endDevice, gateway);
+    }
+
+  double &loss = m_loss[static_cast<uint64_t> (ed->second) * m_gwPosition.size () + gw->second];
+  if (std::isnan (loss))
+    {
+      m_nMisses++;
+      loss = txPowerDbm - m_channel->GetRxPower (txPowerDbm, endDevice, gateway);
+    }
+  else
+    {
+      m_nHits++;
+    }
+  return txPowerDbm - loss;
+}
+
+void
+LinkBudgetCache::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  std::fill (m_loss.begin (), m_loss.end (), UNKNOWN);
+  m_nHits = 0;
+  m_nMisses = 0;
+}
+
+uint64_t
+LinkBudgetCache::GetNHits (void) const
+{
+  return m_nHits;
+}
+
+uint64_t
+LinkBudgetCache::GetNMisses (void) const
+{
+  return m_nMisses;
+}
+
+} // namespace lorawan
+} // namespace ns3
@@ -0,0 +1,148 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LINK_BUDGET_CACHE_H
+#define LINK_BUDGET_CACHE_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/object.h"
+#include "ns3/vector.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/lora-channel.h"
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * Keeps the loss of every end device to gateway link of a LoraChannel, so
+ * that the received powers computed to assign the spreading factors
+ * (LorawanMacHelper::SetSpreadingFactorsUp) are reused by the coverage
+ * dumps and by the next replications.
+ *
+ * The nodes are given with Bind. A link is evaluated by the channel the
+ * first time it is asked for, then served from the cache until one of its
+ * nodes moves: the cache listens to the "CourseChange" trace of the
+ * mobility models, and forgets the links of a node whose position changed.
+ * Binding the nodes of a new replication keeps the links whose nodes are
+ * at the same positions as before. The cache holds the mobility models it
+ * is bound to, and stops listening to them on the next Bind and when it
+ * is disposed.
+ *
+ * The loss of a link is evaluated once: with a loss model that has random
+ * components (e.g., Nakagami fading, random shadowing), every later use
+ * gets the same draw. Use another channel, or Clear, when the loss model
+ * changes.
+ */
+class LinkBudgetCache : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  LinkBudgetCache ();
+  virtual ~LinkBudgetCache ();
+
+  /**
+   * Set the channel that evaluates the links not in the cache. The links
+   * in the cache are kept.
+   *
+   * \param channel The channel.
+   */
+  void SetChannel (Ptr<LoraChannel> channel);
+
+  /**
+   * Get the channel that evaluates the links not in the cache.
+   *
+   * \return The channel.
+   */
+  Ptr<LoraChannel> GetChannel (void) const;
+
+  /**
+   * Index the end devices and gateways whose links are cached, in container
+   * order. The links of the nodes at the same index and position as in the
+   * previous Bind are kept, the others are forgotten.
+   *
+   * \param endDevices The end devices.
+   * \param gateways The gateways.
+   */
+  void Bind (NodeContainer endDevices, NodeContainer gateways);
+
+  /**
+   * Get the power received by a gateway from an end device (or the other
+   * way round, the links are symmetric). Links between nodes that were not
+   * bound are evaluated by the channel every time.
+   *
+   * \param txPowerDbm The transmission power, in dBm.
+   * \param endDevice The mobility model of the end device.
+   * \param gateway The mobility model of the gateway.
+   * \return The received power, in dBm.
+   */
+  double GetRxPower (double txPowerDbm, Ptr<MobilityModel> endDevice,
+                     Ptr<MobilityModel> gateway);
+
+  /**
+   * Forget every link (the nodes stay bound).
+   */
+  void Clear (void);
+
+  /**
+   * Get the number of links served from the cache.
+   *
+   * \return The number of hits.
+   */
+  uint64_t GetNHits (void) const;
+
+  /**
+   * Get the number of links evaluated by the channel.
+   *
+   * \return The number of misses.
+   */
+  uint64_t GetNMisses (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /**
+   * "CourseChange" sink: forget the links of the node if it moved.
+   */
+  void CourseChange (Ptr<const MobilityModel> mobility);
+
+  /**
+   * Disconnect from the mobility models of the bound nodes, and release them.
+   */
+  void Unbind (void);
+
+  Ptr<LoraChannel> m_channel;
+  std::vector<Ptr<MobilityModel> > m_edMobility; //!< Mobility model of the bound end devices
+  std::vector<Ptr<MobilityModel> > m_gwMobility; //!< Mobility model of the bound gateways
+  //! End device, by mobility model (kept alive by m_edMobility)
+  std::unordered_map<const MobilityModel *, uint32_t> m_edIndex;
+  //! Gateway, by mobility model (kept alive by m_gwMobility)
+  std::unordered_map<const MobilityModel *, uint32_t> m_gwIndex;
+  std::vector<Vector> m_edPosition; //!< Position of the end devices, when their links were kept
+  std::vector<Vector> m_gwPosition; //!< Position of the gateways, when their links were kept
+  std::vector<double> m_loss; //!< Loss of the links (dB), end device major; NaN if unknown
+  uint64_t m_nHits;
+  uint64_t m_nMisses;
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* LINK_BUDGET_CACHE_H */
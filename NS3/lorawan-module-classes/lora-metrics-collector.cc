@@ -0,0 +1,532 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+
+#include "ns3/log.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+
+#include "ns3/lora-metrics-collector.h"
+
+NS_LOG_COMPONENT_DEFINE ("LoraMetricsCollector");
+
+namespace ns3 {
+namespace lorawan {
+
+NS_OBJECT_ENSURE_REGISTERED (LoraMetricsCollector);
+
+namespace {
+
+void
+ClearPhy (LoraMetricsCollector::PhyCounters &phy)
+{
+  phy.received = 0;
+  phy.interfered = 0;
+  phy.noMoreReceivers = 0;
+  phy.underSensitivity = 0;
+  phy.lost = 0;
+}
+
+void
+ClearCounters (LoraMetricsCollector::Counters &counters)
+{
+  counters.sent = 0;
+  counters.received = 0;
+  counters.duplicates = 0;
+  counters.delay = Time (0);
+  ClearPhy (counters.phy);
+}
+
+void
+AddPhy (LoraMetricsCollector::PhyCounters &sum, const LoraMetricsCollector::PhyCounters &phy)
+{
+  sum.received += phy.received;
+  sum.interfered += phy.interfered;
+  sum.noMoreReceivers += phy.noMoreReceivers;
+  sum.underSensitivity += phy.underSensitivity;
+  sum.lost += phy.lost;
+}
+
+void
+CountPhy (LoraMetricsCollector::PhyCounters &phy, LoraMetricsCollector::PhyOutcome outcome)
+{
+  switch (outcome)
+    {
+    case LoraMetricsCollector::PHY_RECEIVED:
+      phy.received++;
+      break;
+    case LoraMetricsCollector::PHY_INTERFERED:
+      phy.interfered++;
+      break;
+    case LoraMetricsCollector::PHY_NO_MORE_RECEIVERS:
+      phy.noMoreReceivers++;
+      break;
+    case LoraMetricsCollector::PHY_UNDER_SENSITIVITY:
+      phy.underSensitivity++;
+      break;
+    case LoraMetricsCollector::PHY_LOST_BECAUSE_TX:
+      phy.lost++;
+      break;
+    }
+}
+
+} // anonymous namespace
+
+TypeId
+LoraMetricsCollector::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoraMetricsCollector")
+
+  .SetParent<Object> ()
+	.SetGroupName ("lorawan")
+  .AddConstructor<LoraMetricsCollector> ()
+	.AddAttribute ("NSpreadingFactors",
+								 "Number of spreading factors (indices 0 to NSpreadingFactors - 1); "
+								 "setting it clears the counters",
+								 UintegerValue (6),
+								 MakeUintegerAccessor (&LoraMetricsCollector::SetNSpreadingFactors,
+																			 &LoraMetricsCollector::GetNSpreadingFactors),
+								 MakeUintegerChecker<uint32_t> (1, 256))
+	.AddAttribute ("RetireAfter",
+								 "Time after which a sent packet is dropped, as no gateway can receive it anymore "
+								 "(must be longer than the longest time on air)",
+								 TimeValue (Seconds (10)),
+								 MakeTimeAccessor (&LoraMetricsCollector::m_retireAfter),
+								 MakeTimeChecker ());
+
+  return tid;
+}
+
+LoraMetricsCollector::LoraMetricsCollector ()
+  : m_nSf (6),
+    m_retireAfter (Seconds (10)),
+    m_sf (6),
+    m_nLate (0)
+{
+  NS_LOG_FUNCTION (this);
+
+  Reset ();
+}
+
+LoraMetricsCollector::~LoraMetricsCollector ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoraMetricsCollector::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_packets.Clear ();
+  std::vector<uint8_t> ().swap (m_nodeSf);
+  std::vector<uint8_t> ().swap (m_nodeApp);
+  std::vector<uint32_t> ().swap (m_nodeGw);
+  Object::DoDispose ();
+}
+
+void
+LoraMetricsCollector::SetNSpreadingFactors (uint32_t nSf)
+{
+  NS_LOG_FUNCTION (this << nSf);
+
+  m_nSf = nSf;
+  m_sf.resize (m_nSf);
+  Reset ();
+}
+
+uint32_t
+LoraMetricsCollector::GetNSpreadingFactors (void) const
+{
+  return m_nSf;
+}
+
+uint32_t
+LoraMetricsCollector::GetNGateways (void) const
+{
+  return m_gw.size ();
+}
+
+bool
+LoraMetricsCollector::ConnectEndDevice (uint32_t nodeId, Ptr<Object> mac, uint8_t sf)
+{
+  NS_LOG_FUNCTION (this << nodeId << mac << (uint32_t) sf);
+
+  SetSpreadingFactor (nodeId, sf);
+  return mac->TraceConnectWithoutContext ("SentNewPacket",
+                                          MakeCallback (&LoraMetricsCollector::SentNewPacket, this));
+}
+
+bool
+LoraMetricsCollector::ConnectGateway (uint32_t nodeId, Ptr<Object> mac, Ptr<Object> phy)
+{
+  NS_LOG_FUNCTION (this << nodeId << mac << phy);
+
+  if (nodeId >= m_nodeGw.size ())
+    {
+      m_nodeGw.resize (nodeId + 1, NO_GATEWAY);
+    }
+  if (m_nodeGw[nodeId] == NO_GATEWAY)
+    {
+      m_nodeGw[nodeId] = m_gw.size ();
+      PhyCounters phyCounters;
+      ClearPhy (phyCounters);
+      m_gw.push_back (phyCounters);
+      PathOccupancy paths = {0, 0, 0.0};
+      m_paths.push_back (paths);
+      m_pathsChanged.push_back (Simulator::Now ());
+    }
+
+  bool connected = mac->TraceConnectWithoutContext ("ReceivedPacket",
+                                                    MakeCallback (&LoraMetricsCollector::NotifyReceived, this));
+  if (phy != 0)
+    {
+      connected &= phy->TraceConnectWithoutContext ("ReceivedPacket",
+                                                    MakeCallback (&LoraMetricsCollector::PhyReceived, this));
+      connected &= phy->TraceConnectWithoutContext ("LostPacketBecauseInterference",
+                                                    MakeCallback (&LoraMetricsCollector::PhyInterfered, this));
+      connected &= phy->TraceConnectWithoutContext ("LostPacketBecauseNoMoreReceivers",
+                                                    MakeCallback (&LoraMetricsCollector::PhyNoMoreReceivers, this));
+      connected &= phy->TraceConnectWithoutContext ("LostPacketBecauseUnderSensitivity",
+                                                    MakeCallback (&LoraMetricsCollector::PhyUnderSensitivity, this));
+      connected &= phy->TraceConnectWithoutContext ("NoReceptionBecauseTransmitting",
+                                                    MakeCallback (&LoraMetricsCollector::PhyLostBecauseTx, this));
+      connected &= phy->TraceConnectWithoutContext ("OccupiedReceptionPaths",
+                                                    MakeCallback (&LoraMetricsCollector::OccupiedReceptionPaths, this));
+    }
+  return connected;
+}
+
+void
+LoraMetricsCollector::SetSpreadingFactor (uint32_t nodeId, uint8_t sf)
+{
+  NS_LOG_FUNCTION (this << nodeId << (uint32_t) sf);
+  NS_ASSERT_MSG (sf < m_nSf, "Spreading factor " << (uint32_t) sf << " out of range");
+
+  if (nodeId >= m_nodeSf.size ())
+    {
+      m_nodeSf.resize (nodeId + 1, 0);
+    }
+  m_nodeSf[nodeId] = sf;
+}
+
+void
+LoraMetricsCollector::SetApplication (uint32_t nodeId, uint8_t application)
+{
+  NS_LOG_FUNCTION (this << nodeId << (uint32_t) application);
+
+  if (nodeId >= m_nodeApp.size ())
+    {
+      m_nodeApp.resize (nodeId + 1, 0);
+    }
+  m_nodeApp[nodeId] = application;
+  GetApplicationCounters (application);
+}
+
+LoraMetricsCollector::Counters &
+LoraMetricsCollector::GetApplicationCounters (uint8_t application)
+{
+  while (application >= m_app.size ())
+    {
+      Counters counters;
+      ClearCounters (counters);
+      m_app.push_back (counters);
+    }
+  return m_app[application];
+}
+
+void
+LoraMetricsCollector::SentNewPacket (Ptr<const Packet> packet)
+{
+  NotifySent (Simulator::GetContext (), packet);
+}
+
+void
+LoraMetricsCollector::NotifySent (uint32_t nodeId, Ptr<const Packet> packet)
+{
+  NS_LOG_FUNCTION (this << nodeId << packet);
+
+  Time now = Simulator::Now ();
+  // no gateway can still be receiving the packets sent before
+  m_packets.Retire (now - m_retireAfter);
+
+  uint8_t sf = (nodeId < m_nodeSf.size ()) ? m_nodeSf[nodeId] : 0;
+  uint8_t application = (nodeId < m_nodeApp.size ()) ? m_nodeApp[nodeId] : 0;
+  m_packets.Send (packet->GetUid (), nodeId, sf, now);
+  m_sf[sf].sent++;
+  GetApplicationCounters (application).sent++;
+}
+
+void
+LoraMetricsCollector::NotifyReceived (Ptr<const Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+
+  Time now = Simulator::Now ();
+  const PacketStateTable::Entry *entry = m_packets.Receive (packet->GetUid (), now);
+  if (entry == 0)
+    {
+      NS_LOG_DEBUG ("Packet " << packet->GetUid () << " received after it was retired.");
+      m_nLate++;
+      return;
+    }
+
+  uint8_t application = (entry->sender < m_nodeApp.size ()) ? m_nodeApp[entry->sender] : 0;
+  Counters &sfCounters = m_sf[entry->sf];
+  Counters &appCounters = GetApplicationCounters (application);
+  if (entry->duplicates > 0)
+    {
+      sfCounters.duplicates++;
+      appCounters.duplicates++;
+      return;
+    }
+  Time delay = now - entry->sent;
+  sfCounters.received++;
+  sfCounters.delay += delay;
+  appCounters.received++;
+  appCounters.delay += delay;
+}
+
+void
+LoraMetricsCollector::NotifyPhyOutcome (Ptr<const Packet> packet, uint32_t gatewayNodeId, PhyOutcome outcome)
+{
+  NS_LOG_FUNCTION (this << packet << gatewayNodeId << outcome);
+
+  if ((gatewayNodeId < m_nodeGw.size ()) && (m_nodeGw[gatewayNodeId] != NO_GATEWAY))
+    {
+      CountPhy (m_gw[m_nodeGw[gatewayNodeId]], outcome);
+    }
+
+  // the outcome is known before the MAC reception, the packet is in flight
+  const PacketStateTable::Entry *entry = m_packets.Find (packet->GetUid ());
+  if (entry == 0)
+    {
+      return;
+    }
+  uint8_t application = (entry->sender < m_nodeApp.size ()) ? m_nodeApp[entry->sender] : 0;
+  CountPhy (m_sf[entry->sf].phy, outcome);
+  CountPhy (GetApplicationCounters (application).phy, outcome);
+}
+
+void
+LoraMetricsCollector::PhyReceived (Ptr<const Packet> packet, uint32_t gatewayNodeId)
+{
+  NotifyPhyOutcome (packet, gatewayNodeId, PHY_RECEIVED);
+}
+
+void
+LoraMetricsCollector::PhyInterfered (Ptr<const Packet> packet, uint32_t gatewayNodeId)
+{
+  NotifyPhyOutcome (packet, gatewayNodeId, PHY_INTERFERED);
+}
+
+void
+LoraMetricsCollector::PhyNoMoreReceivers (Ptr<const Packet> packet, uint32_t gatewayNodeId)
+{
+  NotifyPhyOutcome (packet, gatewayNodeId, PHY_NO_MORE_RECEIVERS);
+}
+
+void
+LoraMetricsCollector::PhyUnderSensitivity (Ptr<const Packet> packet, uint32_t gatewayNodeId)
+{
+  NotifyPhyOutcome (packet, gatewayNodeId, PHY_UNDER_SENSITIVITY);
+}
+
+void
+LoraMetricsCollector::PhyLostBecauseTx (Ptr<const Packet> packet, uint32_t gatewayNodeId)
+{
+  NotifyPhyOutcome (packet, gatewayNodeId, PHY_LOST_BECAUSE_TX);
+}
+
+void
+LoraMetricsCollector::OccupiedReceptionPaths (int oldValue, int newValue)
+{
+  uint32_t nodeId = Simulator::GetContext ();
+  if ((nodeId >= m_nodeGw.size ()) || (m_nodeGw[nodeId] == NO_GATEWAY))
+    {
+      return;
+    }
+
+  uint32_t gw = m_nodeGw[nodeId];
+  Time now = Simulator::Now ();
+  PathOccupancy &paths = m_paths[gw];
+  paths.pathSeconds += paths.current * (now - m_pathsChanged[gw]).GetSeconds ();
+  paths.current = std::max (newValue, 0);
+  paths.peak = std::max (paths.peak, paths.current);
+  m_pathsChanged[gw] = now;
+}
+
+void
+LoraMetricsCollector::ResetPeakOccupancy (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (std::vector<PathOccupancy>::iterator it = m_paths.begin (); it != m_paths.end (); ++it)
+    {
+      it->peak = it->current;
+    }
+}
+
+LoraMetricsCollector::Summary
+LoraMetricsCollector::GetSummary (void) const
+{
+  NS_LOG_FUNCTION (this);
+
+  Summary summary;
+  summary.gateway = m_gw;
+  summary.occupancy = m_paths;
+  Time now = Simulator::Now ();
+  for (uint32_t gw = 0; gw < m_paths.size (); gw++)
+    {
+      summary.occupancy[gw].pathSeconds += m_paths[gw].current * (now - m_pathsChanged[gw]).GetSeconds ();
+    }
+  summary.sf = m_sf;
+  summary.application = m_app;
+
+  ClearCounters (summary.total);
+  for (std::vector<Counters>::const_iterator it = m_sf.begin (); it != m_sf.end (); ++it)
+    {
+      summary.total.sent += it->sent;
+      summary.total.received += it->received;
+      summary.total.duplicates += it->duplicates;
+      summary.total.delay += it->delay;
+    }
+  // every attempt counts at its gateway, even for a packet already retired
+  for (std::vector<PhyCounters>::const_iterator it = m_gw.begin (); it != m_gw.end (); ++it)
+    {
+      AddPhy (summary.total.phy, *it);
+    }
+  return summary;
+}
+
+uint64_t
+LoraMetricsCollector::GetNSent (void) const
+{
+  uint64_t sent = 0;
+  for (std::vector<Counters>::const_iterator it = m_sf.begin (); it != m_sf.end (); ++it)
+    {
+      sent += it->sent;
+    }
+  return sent;
+}
+
+uint64_t
+LoraMetricsCollector::GetNSent (uint8_t sf) const
+{
+  return (sf < m_nSf) ? m_sf[sf].sent : 0;
+}
+
+uint64_t
+LoraMetricsCollector::GetNReceived (void) const
+{
+  uint64_t received = 0;
+  for (std::vector<Counters>::const_iterator it = m_sf.begin (); it != m_sf.end (); ++it)
+    {
+      received += it->received;
+    }
+  return received;
+}
+
+uint64_t
+LoraMetricsCollector::GetNReceived (uint8_t sf) const
+{
+  return (sf < m_nSf) ? m_sf[sf].received : 0;
+}
+
+uint64_t
+LoraMetricsCollector::GetNDuplicates (void) const
+{
+  uint64_t duplicates = 0;
+  for (std::vector<Counters>::const_iterator it = m_sf.begin (); it != m_sf.end (); ++it)
+    {
+      duplicates += it->duplicates;
+    }
+  return duplicates;
+}
+
+uint64_t
+LoraMetricsCollector::GetNLate (void) const
+{
+  return m_nLate;
+}
+
+Time
+LoraMetricsCollector::GetTotalDelay (uint8_t sf) const
+{
+  return (sf < m_nSf) ? m_sf[sf].delay : Time (0);
+}
+
+Time
+LoraMetricsCollector::GetMeanDelay (uint8_t sf) const
+{
+  if ((sf >= m_nSf) || (m_sf[sf].received == 0))
+    {
+      return Time (0);
+    }
+  return m_sf[sf].delay / static_cast<int64_t> (m_sf[sf].received);
+}
+
+double
+LoraMetricsCollector::GetPdr (void) const
+{
+  uint64_t sent = GetNSent ();
+  return (sent > 0) ? (double) GetNReceived () / sent : 0.0;
+}
+
+double
+LoraMetricsCollector::GetPer (void) const
+{
+  uint64_t received = GetNReceived ();
+  return (received > 0) ? ((double) GetNSent () - received) / received : 0.0;
+}
+
+uint32_t
+LoraMetricsCollector::GetNInFlight (void) const
+{
+  return m_packets.GetSize ();
+}
+
+void
+LoraMetricsCollector::Reset (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (std::vector<Counters>::iterator it = m_sf.begin (); it != m_sf.end (); ++it)
+    {
+      ClearCounters (*it);
+    }
+  for (std::vector<Counters>::iterator it = m_app.begin (); it != m_app.end (); ++it)
+    {
+      ClearCounters (*it);
+    }
+  for (std::vector<PhyCounters>::iterator it = m_gw.begin (); it != m_gw.end (); ++it)
+    {
+      ClearPhy (*it);
+    }
+  for (uint32_t gw = 0; gw < m_paths.size (); gw++)
+    {
+      m_paths[gw].peak = m_paths[gw].current;
+      m_paths[gw].pathSeconds = 0.0;
+      m_pathsChanged[gw] = Simulator::Now ();
+    }
+  m_packets.Clear ();
+  m_nLate = 0;
+}
+
+} // namespace lorawan
+} // namespace ns3
@@ -0,0 +1,357 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef LORA_METRICS_COLLECTOR_H
+#define LORA_METRICS_COLLECTOR_H
+
+#include <vector>
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/packet.h"
+
+#include "ns3/packet-state-table.h"
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Aggregates the uplink metrics of a LoRaWAN scenario while it runs
+ *
+ * The collector is connected to the "SentNewPacket" trace of the end
+ * device MACs, and to the "ReceivedPacket" trace of the gateway MACs and
+ * the reception outcome traces of the gateway PHYs. It keeps counters
+ * for the whole network, per spreading factor and per application:
+ * - packets sent;
+ * - packets received by at least one gateway MAC, and the duplicate
+ *   receptions;
+ * - the delay of the first reception;
+ * - the outcome of every reception attempt at a gateway PHY (received,
+ *   interfered, no more receivers, under sensitivity, lost because the
+ *   gateway was transmitting), also kept per gateway;
+ * - the occupation of the reception paths of every gateway (the
+ *   "OccupiedReceptionPaths" trace of its PHY), integrated over time.
+ *
+ * These are the numbers that LoraPacketTracker::CountMacPacketsGlobally
+ * and CountPhyPacketsPerGw compute by scanning every packet of the run,
+ * for the whole run. Here they are known at any time (GetSummary), in
+ * counters whose size is fixed once the nodes are connected.
+ *
+ * A packet is only kept until its receptions are over: packets sent
+ * more than RetireAfter ago are dropped, oldest first, so that the memory
+ * is bounded by the packets in flight, whatever the simulated time. A
+ * reception of a packet that was already dropped is counted as late.
+ *
+ * The spreading factor is whatever index the scenario uses for it (e.g.,
+ * the data rate), from 0 to NSpreadingFactors - 1. Applications are
+ * indices as well, set per end device with SetApplication (0 by default).
+ */
+class LoraMetricsCollector : public Object
+{
+public:
+  // inherited from Object
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Outcome of a reception attempt at a gateway PHY
+   */
+  enum PhyOutcome
+  {
+    PHY_RECEIVED,
+    PHY_INTERFERED,
+    PHY_NO_MORE_RECEIVERS,
+    PHY_UNDER_SENSITIVITY,
+    PHY_LOST_BECAUSE_TX
+  };
+
+  /**
+   * \brief Reception attempts at the gateway PHYs, by outcome
+   */
+  struct PhyCounters
+  {
+    uint64_t received;         //!< correctly received
+    uint64_t interfered;       //!< lost because of interference
+    uint64_t noMoreReceivers;  //!< lost because every reception path was busy
+    uint64_t underSensitivity; //!< lost because the signal was too weak
+    uint64_t lost;             //!< lost because the gateway was transmitting
+  };
+
+  /**
+   * \brief Counters of a set of packets (all, a spreading factor, an
+   * application)
+   */
+  struct Counters
+  {
+    uint64_t sent;       //!< packets sent
+    uint64_t received;   //!< packets received by at least one gateway MAC
+    uint64_t duplicates; //!< receptions of packets already received
+    Time delay;          //!< sum of the delays (send to first reception)
+    PhyCounters phy;     //!< reception attempts, summed over the gateways
+  };
+
+  /**
+   * \brief Occupation of the reception paths of a gateway
+   */
+  struct PathOccupancy
+  {
+    uint32_t current;   //!< paths occupied now
+    uint32_t peak;      //!< most paths occupied at once, since the last ResetPeakOccupancy
+    double pathSeconds; //!< occupied paths integrated over time, up to now
+  };
+
+  /**
+   * \brief Every counter of the collector
+   */
+  struct Summary
+  {
+    Counters total;                   //!< all the packets
+    std::vector<PhyCounters> gateway; //!< by gateway, in connection order
+    std::vector<PathOccupancy> occupancy; //!< by gateway, in connection order
+    std::vector<Counters> sf;         //!< by spreading factor
+    std::vector<Counters> application; //!< by application
+  };
+
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  LoraMetricsCollector ();
+
+  /**
+   * \brief Deconstructor
+   * \return none
+   */
+  virtual ~LoraMetricsCollector ();
+
+  /**
+   * \brief Connects the collector to the "SentNewPacket" trace of an end
+   * device MAC
+   * \param nodeId the id of the node of the end device (the packets are
+   * sent in its context)
+   * \param mac the end device MAC
+   * \param sf the spreading factor of the end device
+   * \return true if the trace was connected
+   */
+  bool ConnectEndDevice (uint32_t nodeId, Ptr<Object> mac, uint8_t sf);
+
+  /**
+   * \brief Connects the collector to the "ReceivedPacket" trace of a
+   * gateway MAC and to the reception outcome and "OccupiedReceptionPaths"
+   * traces of its PHY. The gateways are numbered in the order they are
+   * connected.
+   * \param nodeId the id of the node of the gateway
+   * \param mac the gateway MAC
+   * \param phy the gateway PHY (may be 0, then no PHY outcome is counted)
+   * \return true if every trace was connected
+   */
+  bool ConnectGateway (uint32_t nodeId, Ptr<Object> mac, Ptr<Object> phy);
+
+  /**
+   * \brief Sets the spreading factor of an end device, for its next packets
+   * \param nodeId the id of the node of the end device
+   * \param sf the spreading factor
+   * \return none
+   */
+  void SetSpreadingFactor (uint32_t nodeId, uint8_t sf);
+
+  /**
+   * \brief Sets the application of an end device
+   * \param nodeId the id of the node of the end device
+   * \param application the application index
+   * \return none
+   */
+  void SetApplication (uint32_t nodeId, uint8_t application);
+
+  /**
+   * \brief Records a packet sent by an end device (the "SentNewPacket"
+   * sink, for scenarios that connect the traces themselves)
+   * \param nodeId the id of the node of the end device
+   * \param packet the packet
+   * \return none
+   */
+  void NotifySent (uint32_t nodeId, Ptr<const Packet> packet);
+
+  /**
+   * \brief Records a packet received by a gateway MAC (the "ReceivedPacket"
+   * sink, for scenarios that connect the traces themselves)
+   * \param packet the packet
+   * \return none
+   */
+  void NotifyReceived (Ptr<const Packet> packet);
+
+  /**
+   * \brief Records the outcome of a reception attempt at a gateway PHY
+   * \param packet the packet
+   * \param gatewayNodeId the id of the node of the gateway
+   * \param outcome the outcome
+   * \return none
+   */
+  void NotifyPhyOutcome (Ptr<const Packet> packet, uint32_t gatewayNodeId, PhyOutcome outcome);
+
+  /**
+   * \brief Gets the number of spreading factors
+   * \return the number of spreading factors
+   */
+  uint32_t GetNSpreadingFactors (void) const;
+
+  /**
+   * \brief Gets the number of gateways connected
+   * \return the number of gateways
+   */
+  uint32_t GetNGateways (void) const;
+
+  /**
+   * \brief Gets every counter, in one go
+   * \return the counters
+   */
+  Summary GetSummary (void) const;
+
+  /**
+   * \brief Gets the number of packets sent
+   * \return the number of packets sent
+   */
+  uint64_t GetNSent (void) const;
+
+  /**
+   * \brief Gets the number of packets sent with a spreading factor
+   * \param sf the spreading factor
+   * \return the number of packets sent
+   */
+  uint64_t GetNSent (uint8_t sf) const;
+
+  /**
+   * \brief Gets the number of packets received by at least one gateway
+   * \return the number of packets received
+   */
+  uint64_t GetNReceived (void) const;
+
+  /**
+   * \brief Gets the number of packets with a spreading factor received by
+   * at least one gateway
+   * \param sf the spreading factor
+   * \return the number of packets received
+   */
+  uint64_t GetNReceived (uint8_t sf) const;
+
+  /**
+   * \brief Gets the number of receptions of packets already received
+   * (by another gateway)
+   * \return the number of duplicate receptions
+   */
+  uint64_t GetNDuplicates (void) const;
+
+  /**
+   * \brief Gets the number of receptions of packets that were already
+   * retired, or never sent by a connected end device
+   * \return the number of late receptions
+   */
+  uint64_t GetNLate (void) const;
+
+  /**
+   * \brief Gets the sum of the delays (send to first reception) of the
+   * packets received with a spreading factor
+   * \param sf the spreading factor
+   * \return the sum of the delays
+   */
+  Time GetTotalDelay (uint8_t sf) const;
+
+  /**
+   * \brief Gets the mean delay (send to first reception) of the packets
+   * received with a spreading factor
+   * \param sf the spreading factor
+   * \return the mean delay (0 if no packet was received)
+   */
+  Time GetMeanDelay (uint8_t sf) const;
+
+  /**
+   * \brief Gets the packet delivery ratio, received / sent
+   * \return the PDR (0 if no packet was sent)
+   */
+  double GetPdr (void) const;
+
+  /**
+   * \brief Gets the packet error rate, (sent - received) / received
+   * \return the PER (0 if no packet was received)
+   */
+  double GetPer (void) const;
+
+  /**
+   * \brief Starts a new peak of occupied reception paths for every gateway,
+   * from the paths occupied now (e.g., at the start of a time window)
+   * \return none
+   */
+  void ResetPeakOccupancy (void);
+
+  /**
+   * \brief Gets the number of packets held (sent less than RetireAfter ago)
+   * \return the number of packets in flight
+   */
+  uint32_t GetNInFlight (void) const;
+
+  /**
+   * \brief Clears every counter and packet (e.g., between replications);
+   * the connected nodes are kept
+   * \return none
+   */
+  void Reset (void);
+
+protected:
+  // inherited from Object
+  virtual void DoDispose (void);
+
+private:
+  // sets the number of spreading factors, and clears the counters
+  void SetNSpreadingFactors (uint32_t nSf);
+
+  // "SentNewPacket" sink, the node is the simulator context
+  void SentNewPacket (Ptr<const Packet> packet);
+
+  // gateway PHY sinks
+  void PhyReceived (Ptr<const Packet> packet, uint32_t gatewayNodeId);
+  void PhyInterfered (Ptr<const Packet> packet, uint32_t gatewayNodeId);
+  void PhyNoMoreReceivers (Ptr<const Packet> packet, uint32_t gatewayNodeId);
+  void PhyUnderSensitivity (Ptr<const Packet> packet, uint32_t gatewayNodeId);
+  void PhyLostBecauseTx (Ptr<const Packet> packet, uint32_t gatewayNodeId);
+
+  // "OccupiedReceptionPaths" sink, the gateway is the simulator context
+  void OccupiedReceptionPaths (int oldValue, int newValue);
+
+  // the counters of an application (added on first use)
+  Counters &GetApplicationCounters (uint8_t application);
+
+  static constexpr uint32_t NO_GATEWAY = 0xffffffff;
+
+  uint32_t m_nSf;                     // number of spreading factors
+  Time m_retireAfter;                 // packets sent before now - m_retireAfter are dropped
+  std::vector<Counters> m_sf;         // counters, by spreading factor
+  std::vector<Counters> m_app;        // counters, by application
+  std::vector<PhyCounters> m_gw;      // reception attempts, by gateway
+  std::vector<PathOccupancy> m_paths; // reception paths, by gateway
+  std::vector<Time> m_pathsChanged;   // last change of the occupied paths, by gateway
+  std::vector<uint8_t> m_nodeSf;      // spreading factor, by node id
+  std::vector<uint8_t> m_nodeApp;     // application, by node id
+  std::vector<uint32_t> m_nodeGw;     // gateway index, by node id
+  PacketStateTable m_packets;         // packets in flight
+  uint64_t m_nLate;
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* LORA_METRICS_COLLECTOR_H */
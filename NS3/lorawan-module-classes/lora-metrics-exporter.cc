@@ -0,0 +1,215 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <sstream>
+
+#include "ns3/log.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+
+#include "ns3/lora-metrics-exporter.h"
+
+NS_LOG_COMPONENT_DEFINE ("LoraMetricsExporter");
+
+namespace ns3 {
+namespace lorawan {
+
+NS_OBJECT_ENSURE_REGISTERED (LoraMetricsExporter);
+
+TypeId
+LoraMetricsExporter::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LoraMetricsExporter")
+
+  .SetParent<Object> ()
+	.SetGroupName ("lorawan")
+  .AddConstructor<LoraMetricsExporter> ()
+	.AddAttribute ("Window",
+								 "Length of the time windows",
+								 TimeValue (Minutes (10)),
+								 MakeTimeAccessor (&LoraMetricsExporter::m_window),
+								 MakeTimeChecker (NanoSeconds (1)))
+	.AddAttribute ("FileName",
+								 "File the windows are written to (see ColumnarWriter)",
+								 StringValue ("lora-metrics.bin"),
+								 MakeStringAccessor (&LoraMetricsExporter::m_filename),
+								 MakeStringChecker ())
+	.AddAttribute ("RowsPerChunk",
+								 "Number of windows written to the file at once",
+								 UintegerValue (1),
+								 MakeUintegerAccessor (&LoraMetricsExporter::m_rowsPerChunk),
+								 MakeUintegerChecker<uint32_t> (1));
+
+  return tid;
+}
+
+LoraMetricsExporter::LoraMetricsExporter ()
+  : m_window (Minutes (10)),
+    m_filename ("lora-metrics.bin"),
+    m_rowsPerChunk (1)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+LoraMetricsExporter::~LoraMetricsExporter ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+LoraMetricsExporter::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Simulator::Cancel (m_event);
+  m_writer.Close ();
+  m_collector = 0;
+  Object::DoDispose ();
+}
+
+void
+LoraMetricsExporter::SetCollector (Ptr<LoraMetricsCollector> collector)
+{
+  NS_LOG_FUNCTION (this << collector);
+
+  m_collector = collector;
+}
+
+void
+LoraMetricsExporter::SetSpreadingFactorNames (const std::vector<std::string> &names)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_sfNames = names;
+}
+
+bool
+LoraMetricsExporter::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_collector != 0, "No collector to export");
+
+  // the columns depend on the number of gateways and spreading factors
+  m_writer.Clear ();
+  m_writer.AddColumn ("time", ColumnarWriter::DOUBLE);
+  m_writer.AddColumn ("window", ColumnarWriter::DOUBLE);
+  m_writer.AddColumn ("sent", ColumnarWriter::UINT64);
+  m_writer.AddColumn ("received", ColumnarWriter::UINT64);
+  m_writer.AddColumn ("duplicates", ColumnarWriter::UINT64);
+  m_writer.AddColumn ("pdr", ColumnarWriter::DOUBLE);
+  m_writer.AddColumn ("offered_load", ColumnarWriter::DOUBLE);
+  for (uint32_t gw = 0; gw < m_collector->GetNGateways (); gw++)
+    {
+      std::ostringstream name;
+      name << "gw" << gw << "_paths_";
+      m_writer.AddColumn (name.str () + "mean", ColumnarWriter::DOUBLE);
+      m_writer.AddColumn (name.str () + "peak", ColumnarWriter::UINT32);
+    }
+  for (uint32_t sf = 0; sf < m_collector->GetNSpreadingFactors (); sf++)
+    {
+      std::ostringstream name;
+      if (sf < m_sfNames.size ())
+        {
+          name << m_sfNames[sf] << "_";
+        }
+      else
+        {
+          name << "sf" << sf << "_";
+        }
+      m_writer.AddColumn (name.str () + "sent", ColumnarWriter::UINT64);
+      m_writer.AddColumn (name.str () + "received", ColumnarWriter::UINT64);
+      m_writer.AddColumn (name.str () + "interfered", ColumnarWriter::UINT64);
+    }
+  m_writer.SetRowsPerChunk (m_rowsPerChunk);
+  if (!m_writer.Open (m_filename))
+    {
+      return false;
+    }
+
+  m_windowStart = Simulator::Now ();
+  m_collector->ResetPeakOccupancy ();
+  m_last = m_collector->GetSummary ();
+  Simulator::Cancel (m_event);
+  m_event = Simulator::Schedule (m_window, &LoraMetricsExporter::EndWindow, this);
+  return true;
+}
+
+void
+LoraMetricsExporter::Stop (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  Simulator::Cancel (m_event);
+  if (m_writer.IsOpen () && (Simulator::Now () > m_windowStart))
+    {
+      WriteWindow ();
+    }
+  m_writer.Close ();
+}
+
+void
+LoraMetricsExporter::EndWindow (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  WriteWindow ();
+  m_event = Simulator::Schedule (m_window, &LoraMetricsExporter::EndWindow, this);
+}
+
+void
+LoraMetricsExporter::WriteWindow (void)
+{
+  Time now = Simulator::Now ();
+  double window = (now - m_windowStart).GetSeconds ();
+  LoraMetricsCollector::Summary summary = m_collector->GetSummary ();
+  NS_ASSERT_MSG (summary.occupancy.size () == m_last.occupancy.size (), "Gateway connected after Start");
+
+  uint64_t sent = summary.total.sent - m_last.total.sent;
+  uint64_t received = summary.total.received - m_last.total.received;
+  uint32_t column = 0;
+  m_writer.WriteDouble (column++, now.GetSeconds ());
+  m_writer.WriteDouble (column++, window);
+  m_writer.WriteU64 (column++, sent);
+  m_writer.WriteU64 (column++, received);
+  m_writer.WriteU64 (column++, summary.total.duplicates - m_last.total.duplicates);
+  m_writer.WriteDouble (column++, (sent > 0) ? (double) received / sent : 0.0);
+  m_writer.WriteDouble (column++, (window > 0) ? sent / window : 0.0);
+  for (uint32_t gw = 0; gw < summary.occupancy.size (); gw++)
+    {
+      double pathSeconds = summary.occupancy[gw].pathSeconds - m_last.occupancy[gw].pathSeconds;
+      m_writer.WriteDouble (column++, (window > 0) ? pathSeconds / window : 0.0);
+      m_writer.WriteU32 (column++, summary.occupancy[gw].peak);
+    }
+  for (uint32_t sf = 0; sf < summary.sf.size (); sf++)
+    {
+      m_writer.WriteU64 (column++, summary.sf[sf].sent - m_last.sf[sf].sent);
+      m_writer.WriteU64 (column++, summary.sf[sf].received - m_last.sf[sf].received);
+      m_writer.WriteU64 (column++, summary.sf[sf].phy.interfered - m_last.sf[sf].phy.interfered);
+    }
+  m_writer.EndRow ();
+
+  NS_LOG_INFO ("Window ending at " << now.GetSeconds () << " s: " << sent << " sent, "
+               << received << " received.");
+
+  m_windowStart = now;
+  m_collector->ResetPeakOccupancy ();
+  m_last = summary;
+}
+
+} // namespace lorawan
+} // namespace ns3
@@ -0,0 +1,127 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef LORA_METRICS_EXPORTER_H
+#define LORA_METRICS_EXPORTER_H
+
+#include <string>
+#include <vector>
+
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+
+#include "ns3/columnar-writer.h"
+#include "ns3/lora-metrics-collector.h"
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * \ingroup lorawan
+ *
+ * \brief Writes the metrics of a LoraMetricsCollector per time window,
+ * while the simulation runs
+ *
+ * Every Window, the counters of the collector are compared with the ones
+ * of the end of the previous window, and a row is added to a ColumnarWriter
+ * file with, for the window:
+ * - time: the end of the window (s), window: its length (s);
+ * - sent, received, duplicates, pdr (received / sent), offered_load
+ *   (packets sent per second);
+ * - per gateway, gw<i>_paths_mean (occupied reception paths averaged over
+ *   the window) and gw<i>_paths_peak;
+ * - per spreading factor, <sf>_sent, <sf>_received and <sf>_interfered
+ *   (reception attempts lost because of interference, i.e., collisions).
+ *
+ * A packet counts in the window it is received, whatever the window it
+ * was sent in. The rows are written out every RowsPerChunk windows, so the
+ * file can be read while the simulation runs.
+ */
+class LoraMetricsExporter : public Object
+{
+public:
+  // inherited from Object
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  LoraMetricsExporter ();
+
+  /**
+   * \brief Deconstructor
+   * \return none
+   */
+  virtual ~LoraMetricsExporter ();
+
+  /**
+   * \brief Sets the collector whose metrics are written
+   * \param collector the collector
+   * \return none
+   */
+  void SetCollector (Ptr<LoraMetricsCollector> collector);
+
+  /**
+   * \brief Sets the names of the spreading factors in the columns (sf<i> by
+   * default, where i is the index of the collector)
+   * \param names the names, by spreading factor index
+   * \return none
+   */
+  void SetSpreadingFactorNames (const std::vector<std::string> &names);
+
+  /**
+   * \brief Opens FileName and schedules the first window, from now. The
+   * gateways must be connected to the collector already.
+   * \return false if the file cannot be written
+   */
+  bool Start (void);
+
+  /**
+   * \brief Writes the window in progress (if it is not empty) and closes
+   * the file. Call it before Simulator::Destroy.
+   * \return none
+   */
+  void Stop (void);
+
+protected:
+  // inherited from Object
+  virtual void DoDispose (void);
+
+private:
+  // adds the row of the window that ends now
+  void WriteWindow (void);
+
+  // WriteWindow, then schedules the next window
+  void EndWindow (void);
+
+  Ptr<LoraMetricsCollector> m_collector;
+  std::vector<std::string> m_sfNames;
+  Time m_window;
+  std::string m_filename;
+  uint32_t m_rowsPerChunk;
+  ColumnarWriter m_writer;
+  EventId m_event;
+  Time m_windowStart;
+  LoraMetricsCollector::Summary m_last; // counters at m_windowStart
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* LORA_METRICS_EXPORTER_H */
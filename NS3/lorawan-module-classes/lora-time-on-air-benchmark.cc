@@ -0,0 +1,143 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Compares the time on air table (LoraTimeOnAir) with the formula of
+ * LoraPhy::GetOnAirTime: checks that every entry of the table gives the
+ * same time on air, then times both over every packet of the table.
+ *
+ * RUN example (copy this file to scratch/):
+ * $ ./waf --run "lora-time-on-air-benchmark --rounds=20"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/packet.h"
+#include "ns3/lora-phy.h"
+#include "ns3/lora-time-on-air.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+using namespace ns3;
+using namespace lorawan;
+
+namespace {
+
+LoraTxParameters
+GetTxParameters (uint8_t sf, double bandwidthHz, uint8_t codingRate)
+{
+  LoraTxParameters params;
+  params.sf = sf;
+  params.headerDisabled = false;
+  params.codingRate = codingRate;
+  params.bandwidthHz = bandwidthHz;
+  params.nPreamble = 8;
+  params.crcEnabled = true;
+  params.lowDataRateOptimizationEnabled = LoraPhy::GetTSym (params) > MilliSeconds (16);
+  return params;
+}
+
+} // anonymous namespace
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t rounds = 10;
+
+  CommandLine cmd;
+  cmd.AddValue ("rounds", "Number of times every packet of the table is timed", rounds);
+  cmd.Parse (argc, argv);
+
+  const double bandwidths[] = {125000, 250000, 500000};
+
+  // Same time on air for every packet of the table
+  uint32_t nPackets = 0;
+  uint32_t nMismatches = 0;
+  for (uint8_t sf = LoraTimeOnAir::MIN_SF; sf <= LoraTimeOnAir::MAX_SF; sf++)
+    {
+      for (double bandwidthHz : bandwidths)
+        {
+          for (uint8_t codingRate = 1; codingRate <= LoraTimeOnAir::N_CODING_RATES; codingRate++)
+            {
+              LoraTxParameters params = GetTxParameters (sf, bandwidthHz, codingRate);
+              for (uint32_t size = 0; size <= LoraTimeOnAir::MAX_SIZE; size++)
+                {
+                  double formula = LoraPhy::GetOnAirTime (Create<Packet> (size), params).GetSeconds ();
+                  double table = LoraTimeOnAir::GetSeconds (sf, bandwidthHz, codingRate, size);
+                  if (std::abs (formula - table) > 1e-9)
+                    {
+                      std::cout << "SF" << unsigned (sf) << ", " << bandwidthHz << " Hz, 4/"
+                                << codingRate + 4 << ", " << size << " bytes: " << formula
+                                << " s (formula), " << table << " s (table)" << std::endl;
+                      nMismatches++;
+                    }
+                  nPackets++;
+                }
+            }
+        }
+    }
+  std::cout << nPackets << " packets, " << nMismatches << " mismatches" << std::endl;
+
+  // Time both over every packet, rounds times
+  double sum = 0; // keeps the loops from being optimized away
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  for (uint32_t round = 0; round < rounds; round++)
+    {
+      for (uint8_t sf = LoraTimeOnAir::MIN_SF; sf <= LoraTimeOnAir::MAX_SF; sf++)
+        {
+          for (double bandwidthHz : bandwidths)
+            {
+              for (uint8_t codingRate = 1; codingRate <= LoraTimeOnAir::N_CODING_RATES; codingRate++)
+                {
+                  LoraTxParameters params = GetTxParameters (sf, bandwidthHz, codingRate);
+                  for (uint32_t size = 0; size <= LoraTimeOnAir::MAX_SIZE; size++)
+                    {
+                      sum += LoraPhy::GetOnAirTime (Create<Packet> (size), params).GetSeconds ();
+                    }
+                }
+            }
+        }
+    }
+  std::chrono::duration<double> formulaTime = std::chrono::steady_clock::now () - start;
+
+  start = std::chrono::steady_clock::now ();
+  for (uint32_t round = 0; round < rounds; round++)
+    {
+      for (uint8_t sf = LoraTimeOnAir::MIN_SF; sf <= LoraTimeOnAir::MAX_SF; sf++)
+        {
+          for (double bandwidthHz : bandwidths)
+            {
+              for (uint8_t codingRate = 1; codingRate <= LoraTimeOnAir::N_CODING_RATES; codingRate++)
+                {
+                  for (uint32_t size = 0; size <= LoraTimeOnAir::MAX_SIZE; size++)
+                    {
+                      sum -= LoraTimeOnAir::GetSeconds (sf, bandwidthHz, codingRate, size);
+                    }
+                }
+            }
+        }
+    }
+  std::chrono::duration<double> tableTime = std::chrono::steady_clock::now () - start;
+
+  double nCalls = double (nPackets) * rounds;
+  std::cout << "Formula: " << formulaTime.count () * 1e9 / nCalls << " ns per packet" << std::endl;
+  std::cout << "Table: " << tableTime.count () * 1e9 / nCalls << " ns per packet" << std::endl;
+  std::cout << "Speedup: " << formulaTime.count () / tableTime.count () << "x (residual " << sum
+            << " s)" << std::endl;
+
+  return (nMismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,75 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ns3/lora-time-on-air.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+namespace lorawan {
+
+NS_LOG_COMPONENT_DEFINE ("LoraTimeOnAir");
+
+namespace {
+
+// Payload symbols of every packet, built by the compiler
+constexpr LoraTimeOnAir::Table PAYLOAD_SYMBOLS = LoraTimeOnAir::BuildTable ();
+
+// A few packets, checked against the formula of LoraPhy::GetOnAirTime
+static_assert (PAYLOAD_SYMBOLS[LoraTimeOnAir::GetIndex (7, 0, 1, 0)] == 13,
+               "SF7, 125 kHz, 4/5, empty payload");
+static_assert (PAYLOAD_SYMBOLS[LoraTimeOnAir::GetIndex (7, 0, 1, 20)] == 43,
+               "SF7, 125 kHz, 4/5, 20 bytes");
+static_assert (PAYLOAD_SYMBOLS[LoraTimeOnAir::GetIndex (12, 0, 1, 20)] == 28,
+               "SF12, 125 kHz, 4/5, 20 bytes (low data rate optimization)");
+static_assert (PAYLOAD_SYMBOLS[LoraTimeOnAir::GetIndex (12, 2, 4, 255)] == 352,
+               "SF12, 500 kHz, 4/8, 255 bytes");
+
+} // anonymous namespace
+
+double
+LoraTimeOnAir::GetSeconds (uint8_t sf, double bandwidthHz, uint8_t codingRate, uint32_t size,
+                           uint32_t nPreamble)
+{
+  uint32_t bandwidthIndex = (bandwidthHz == 125000) ? 0 : (bandwidthHz == 250000) ? 1 : 2;
+  NS_ASSERT_MSG (sf >= MIN_SF && sf <= MAX_SF, "No time on air for SF" << unsigned (sf));
+  NS_ASSERT_MSG (bandwidthHz == (125000 << bandwidthIndex),
+                 "No time on air for a bandwidth of " << bandwidthHz << " Hz");
+  NS_ASSERT_MSG (codingRate >= 1 && codingRate <= N_CODING_RATES,
+                 "No time on air for coding rate " << unsigned (codingRate));
+  NS_ASSERT_MSG (size <= MAX_SIZE, "No time on air for " << size << " bytes");
+
+  double tSym = (1 << sf) / bandwidthHz;
+  return (nPreamble + 4.25 + PAYLOAD_SYMBOLS[GetIndex (sf, bandwidthIndex, codingRate, size)]) *
+         tSym;
+}
+
+Time
+LoraTimeOnAir::Get (uint8_t sf, double bandwidthHz, uint8_t codingRate, uint32_t size,
+                    uint32_t nPreamble)
+{
+  return Seconds (GetSeconds (sf, bandwidthHz, codingRate, size, nPreamble));
+}
+
+Time
+LoraTimeOnAir::GetOffTime (Time onAir, double dutyCycle)
+{
+  NS_ASSERT_MSG (dutyCycle > 0 && dutyCycle <= 1, "Duty cycle " << dutyCycle);
+
+  return Seconds (onAir.GetSeconds () * (1 / dutyCycle - 1));
+}
+
+} // namespace lorawan
+} // namespace ns3
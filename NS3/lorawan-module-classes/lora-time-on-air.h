@@ -0,0 +1,152 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef LORA_TIME_ON_AIR_H
+#define LORA_TIME_ON_AIR_H
+
+#include <array>
+#include <stdint.h>
+
+#include "ns3/nstime.h"
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * Time on air of LoRa packets, from a table computed at build time.
+ *
+ * The table holds the number of payload symbols of every packet with an
+ * explicit header and a CRC, for SF7 to SF12, 125, 250 and 500 kHz, coding
+ * rates 4/5 to 4/8 and PHY payloads of 0 to 255 bytes, with the low data
+ * rate optimization on when the symbol lasts more than 16 ms (as the end
+ * device MACs do). The time on air is then the same as the one of
+ * LoraPhy::GetOnAirTime, without building a packet.
+ */
+class LoraTimeOnAir
+{
+public:
+  static constexpr uint8_t MIN_SF = 7; //!< Lowest spreading factor in the table
+  static constexpr uint8_t MAX_SF = 12; //!< Highest spreading factor in the table
+  static constexpr uint32_t N_BANDWIDTHS = 3; //!< 125, 250 and 500 kHz
+  static constexpr uint32_t N_CODING_RATES = 4; //!< 4/5 to 4/8
+  static constexpr uint32_t MAX_SIZE = 255; //!< Largest PHY payload in the table, in bytes
+
+  /**
+   * Compute the number of payload symbols of a packet, as LoraPhy::GetOnAirTime.
+   *
+   * \param sf The spreading factor.
+   * \param bandwidthIndex The bandwidth: 0 (125 kHz), 1 (250 kHz) or 2 (500 kHz).
+   * \param codingRate The coding rate, 1 (4/5) to 4 (4/8).
+   * \param size The size of the PHY payload, in bytes.
+   * \return The number of payload symbols.
+   */
+  static constexpr uint16_t
+  ComputePayloadSymbols (uint32_t sf, uint32_t bandwidthIndex, uint32_t codingRate, uint32_t size)
+  {
+    // Symbols of more than 16 ms: 2^sf / bandwidth > 0.016 s
+    int32_t lowDataRate = ((1u << sf) * 1000u > 16u * (125000u << bandwidthIndex)) ? 1 : 0;
+    int32_t num = 8 * int32_t (size) - 4 * int32_t (sf) + 28 + 16;
+    int32_t den = 4 * (int32_t (sf) - 2 * lowDataRate);
+    // Integer division rounds the negative numerators up already
+    int32_t blocks = (num > 0) ? (num + den - 1) / den : num / den;
+    int32_t symbols = blocks * (int32_t (codingRate) + 4);
+    return uint16_t (8 + ((symbols > 0) ? symbols : 0));
+  }
+
+  /**
+   * Get the index of a packet in the table.
+   *
+   * \param sf The spreading factor.
+   * \param bandwidthIndex The bandwidth index (see ComputePayloadSymbols).
+   * \param codingRate The coding rate, 1 (4/5) to 4 (4/8).
+   * \param size The size of the PHY payload, in bytes.
+   * \return The index.
+   */
+  static constexpr uint32_t
+  GetIndex (uint32_t sf, uint32_t bandwidthIndex, uint32_t codingRate, uint32_t size)
+  {
+    return (((sf - MIN_SF) * N_BANDWIDTHS + bandwidthIndex) * N_CODING_RATES + codingRate - 1) *
+               (MAX_SIZE + 1) +
+           size;
+  }
+
+  static constexpr uint32_t N_ENTRIES =
+      (MAX_SF - MIN_SF + 1) * N_BANDWIDTHS * N_CODING_RATES * (MAX_SIZE + 1);
+
+  typedef std::array<uint16_t, N_ENTRIES> Table;
+
+  /**
+   * Build the table of payload symbols.
+   *
+   * \return The number of payload symbols of every packet, by GetIndex.
+   */
+  static constexpr Table
+  BuildTable (void)
+  {
+    Table table{};
+    for (uint32_t sf = MIN_SF; sf <= MAX_SF; sf++)
+      {
+        for (uint32_t bandwidthIndex = 0; bandwidthIndex < N_BANDWIDTHS; bandwidthIndex++)
+          {
+            for (uint32_t codingRate = 1; codingRate <= N_CODING_RATES; codingRate++)
+              {
+                for (uint32_t size = 0; size <= MAX_SIZE; size++)
+                  {
+                    table[GetIndex (sf, bandwidthIndex, codingRate, size)] =
+                        ComputePayloadSymbols (sf, bandwidthIndex, codingRate, size);
+                  }
+              }
+          }
+      }
+    return table;
+  }
+
+  /**
+   * Get the time on air of a packet.
+   *
+   * \param sf The spreading factor (7 to 12).
+   * \param bandwidthHz The bandwidth (125000, 250000 or 500000 Hz).
+   * \param codingRate The coding rate, 1 (4/5) to 4 (4/8).
+   * \param size The size of the PHY payload, in bytes (up to 255).
+   * \param nPreamble The number of preamble symbols.
+   * \return The time on air, in seconds.
+   */
+  static double GetSeconds (uint8_t sf, double bandwidthHz, uint8_t codingRate, uint32_t size,
+                            uint32_t nPreamble = 8);
+
+  /**
+   * Get the time on air of a packet, as GetSeconds.
+   *
+   * \return The time on air.
+   */
+  static Time Get (uint8_t sf, double bandwidthHz, uint8_t codingRate, uint32_t size,
+                   uint32_t nPreamble = 8);
+
+  /**
+   * Get the time a device must stay silent after a transmission, in a sub
+   * band with a duty cycle limit.
+   *
+   * \param onAir The time on air of the transmission.
+   * \param dutyCycle The duty cycle (e.g., 0.01), 1 for none.
+   * \return The time off air.
+   */
+  static Time GetOffTime (Time onAir, double dutyCycle);
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* LORA_TIME_ON_AIR_H */
@@ -24,13 +24,27 @@
 #include "ns3/lora-net-device.h"
 #include "ns3/log.h"
 #include "ns3/random-variable-stream.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/propagation-loss-model.h"
+#include "ns3/pointer.h"
+#include "ns3/work-stealing-pool.h"
+#include "ns3/logical-lora-channel.h"
+#include "ns3/lora-time-on-air.h"
+#include "ns3/abort.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <limits>
 
 namespace ns3 {
 namespace lorawan {
 
 NS_LOG_COMPONENT_DEFINE ("LorawanMacHelper");
 
-LorawanMacHelper::LorawanMacHelper () : m_region (LorawanMacHelper::EU)
+LorawanMacHelper::LorawanMacHelper () : m_parameters (RegionalParameters::Get ("EU868"))
 {
 }
 
@@ -67,7 +81,39 @@ LorawanMacHelper::SetAddressGenerator (Ptr<LoraDeviceAddressGenerator> addrGen)
 void
 LorawanMacHelper::SetRegion (enum LorawanMacHelper::Regions region)
 {
-  m_region = region;
+  switch (region)
+    {
+    case LorawanMacHelper::EU:
+      m_parameters = RegionalParameters::Get ("EU868");
+      break;
+    case LorawanMacHelper::SingleChannel:
+      m_parameters = RegionalParameters::Get ("EU868-SingleChannel");
+      break;
+    case LorawanMacHelper::ALOHA:
+      m_parameters = RegionalParameters::Get ("ALOHA");
+      break;
+    case LorawanMacHelper::Australia:
+      m_parameters = RegionalParameters::Get ("AU915");
+      break;
+    default:
+      m_parameters = 0;
+      break;
+    }
+}
+
+void
+LorawanMacHelper::SetRegion (std::string name)
+{
+  m_parameters = RegionalParameters::Get (name);
+  NS_ABORT_MSG_IF (m_parameters == 0, "Unknown region " << name);
+}
+
+bool
+LorawanMacHelper::LoadRegionalParameters (std::string filename)
+{
+  NS_LOG_FUNCTION (filename);
+
+  return RegionalParameters::Load (filename);
 }
 
 Ptr<LorawanMac>
@@ -84,203 +130,54 @@ LorawanMacHelper::Create (Ptr<Node> node, Ptr<NetDevice> device) const
 
   // Add a basic list of channels based on the region where the device is
   // operating
-  if (m_deviceType == ED_A)
+  if (m_parameters == 0)
     {
-      Ptr<ClassAEndDeviceLorawanMac> edMac = mac->GetObject<ClassAEndDeviceLorawanMac> ();
-      switch (m_region)
-        {
-          case LorawanMacHelper::EU: {
-            ConfigureForEuRegion (edMac);
-            break;
-          }
-          case LorawanMacHelper::SingleChannel: {
-            ConfigureForSingleChannelRegion (edMac);
-            break;
-          }
-          case LorawanMacHelper::ALOHA: {
-            ConfigureForAlohaRegion (edMac);
-            break;
-          }
-          case LorawanMacHelper::Australia: {
-            // std:: cout << "!!ed Austrália!!!\n";
-            ConfigureForAuRegion (edMac);
-            break;
-          }          
-          default: {
-            NS_LOG_ERROR ("This region isn't supported yet!");
-            break;
-          }
-        }
+      NS_LOG_ERROR ("This region isn't supported yet!");
     }
-  else
+  else if (m_deviceType == ED_A)
     {
-      Ptr<GatewayLorawanMac> gwMac = mac->GetObject<GatewayLorawanMac> ();
-      switch (m_region)
-        {
-          case LorawanMacHelper::EU: {
-            ConfigureForEuRegion (gwMac);
-            break;
-          }
-          case LorawanMacHelper::SingleChannel: {
-            ConfigureForSingleChannelRegion (gwMac);
-            break;
-          }
-          case LorawanMacHelper::ALOHA: {
-            ConfigureForAlohaRegion (gwMac);
-            break;
-          }
-          case LorawanMacHelper::Australia: {
-            // std:: cout << "!!gw Austrália!!!\n";
-            ConfigureForAuRegion (gwMac);
-            break;
-          }
-          default: {
-            NS_LOG_ERROR ("This region isn't supported yet!");
-            break;
-          }
-        }
+      ConfigureEndDevice (mac->GetObject<ClassAEndDeviceLorawanMac> ());
     }
-  return mac;
-}
-
-void
-LorawanMacHelper::ConfigureForAlohaRegion (Ptr<ClassAEndDeviceLorawanMac> edMac) const
-{
-  NS_LOG_FUNCTION_NOARGS ();
-
-  ApplyCommonAlohaConfigurations (edMac);
-
-  /////////////////////////////////////////////////////
-  // TxPower -> Transmission power in dBm conversion //
-  /////////////////////////////////////////////////////
-  edMac->SetTxDbmForTxPower (std::vector<double>{16, 14, 12, 10, 8, 6, 4, 2});
-
-  ////////////////////////////////////////////////////////////
-  // Matrix to know which DataRate the GW will respond with //
-  ////////////////////////////////////////////////////////////
-  LorawanMac::ReplyDataRateMatrix matrix = {{{{0, 0, 0, 0, 0, 0}},
-                                             {{1, 0, 0, 0, 0, 0}},
-                                             {{2, 1, 0, 0, 0, 0}},
-                                             {{3, 2, 1, 0, 0, 0}},
-                                             {{4, 3, 2, 1, 0, 0}},
-                                             {{5, 4, 3, 2, 1, 0}},
-                                             {{6, 5, 4, 3, 2, 1}},
-                                             {{7, 6, 5, 4, 3, 2}}}};
-  edMac->SetReplyDataRateMatrix (matrix);
-
-  /////////////////////
-  // Preamble length //
-  /////////////////////
-  edMac->SetNPreambleSymbols (8);
-
-  //////////////////////////////////////
-  // Second receive window parameters //
-  //////////////////////////////////////
-  edMac->SetSecondReceiveWindowDataRate (0);
-  edMac->SetSecondReceiveWindowFrequency (869.525);
-}
-
-void
-LorawanMacHelper::ConfigureForAlohaRegion (Ptr<GatewayLorawanMac> gwMac) const
-{
-  NS_LOG_FUNCTION_NOARGS ();
-
-  ///////////////////////////////
-  // ReceivePath configuration //
-  ///////////////////////////////
-  Ptr<GatewayLoraPhy> gwPhy =
-      gwMac->GetDevice ()->GetObject<LoraNetDevice> ()->GetPhy ()->GetObject<GatewayLoraPhy> ();
-
-  ApplyCommonAlohaConfigurations (gwMac);
-
-  if (gwPhy) // If cast is successful, there's a GatewayLoraPhy
+  else
     {
-      NS_LOG_DEBUG ("Resetting reception paths");
-      gwPhy->ResetReceptionPaths ();
-
-      int receptionPaths = 0;
-      int maxReceptionPaths = 1;
-      while (receptionPaths < maxReceptionPaths)
-        {
-          gwPhy->GetObject<GatewayLoraPhy> ()->AddReceptionPath ();
-          receptionPaths++;
-        }
-      gwPhy->AddFrequency (868.1);
+      ConfigureGateway (mac->GetObject<GatewayLorawanMac> ());
     }
+  return mac;
 }
 
 void
-LorawanMacHelper::ApplyCommonAlohaConfigurations (Ptr<LorawanMac> lorawanMac) const
-{
-  NS_LOG_FUNCTION_NOARGS ();
-
-  //////////////
-  // SubBands //
-  //////////////
-
-  LogicalLoraChannelHelper channelHelper;
-  channelHelper.AddSubBand (868, 868.6, 1, 14); 
-
-  //////////////////////
-  // Default channels //
-  //////////////////////
-  Ptr<LogicalLoraChannel> lc1 = CreateObject<LogicalLoraChannel> (868.1, 0, 5);
-  channelHelper.AddChannel (lc1);
-
-  lorawanMac->SetLogicalLoraChannelHelper (channelHelper);
-
-  ///////////////////////////////////////////////
-  // DataRate -> SF, DataRate -> Bandwidth     //
-  // and DataRate -> MaxAppPayload conversions //
-  ///////////////////////////////////////////////
-  lorawanMac->SetSfForDataRate (std::vector<uint8_t>{12, 11, 10, 9, 8, 7, 7});
-  lorawanMac->SetBandwidthForDataRate (
-      std::vector<double>{125000, 125000, 125000, 125000, 125000, 125000, 250000});
-  lorawanMac->SetMaxAppPayloadForDataRate (
-      std::vector<uint32_t>{59, 59, 59, 123, 230, 230, 230, 230});
-}
-
-void
-LorawanMacHelper::ConfigureForEuRegion (Ptr<ClassAEndDeviceLorawanMac> edMac) const
+LorawanMacHelper::ConfigureEndDevice (Ptr<ClassAEndDeviceLorawanMac> edMac) const
 {
-  NS_LOG_FUNCTION_NOARGS ();
+  NS_LOG_FUNCTION (this << m_parameters->GetName ());
 
-  ApplyCommonEuConfigurations (edMac);
+  ConfigureMac (edMac, m_parameters->GetChannels ());
 
   /////////////////////////////////////////////////////
   // TxPower -> Transmission power in dBm conversion //
   /////////////////////////////////////////////////////
-  edMac->SetTxDbmForTxPower (std::vector<double>{16, 14, 12, 10, 8, 6, 4, 2});
+  edMac->SetTxDbmForTxPower (m_parameters->GetTxDbmForTxPower ());
 
   ////////////////////////////////////////////////////////////
   // Matrix to know which DataRate the GW will respond with //
   ////////////////////////////////////////////////////////////
-  LorawanMac::ReplyDataRateMatrix matrix = {{{{0, 0, 0, 0, 0, 0}},
-                                             {{1, 0, 0, 0, 0, 0}},
-                                             {{2, 1, 0, 0, 0, 0}},
-                                             {{3, 2, 1, 0, 0, 0}},
-                                             {{4, 3, 2, 1, 0, 0}},
-                                             {{5, 4, 3, 2, 1, 0}},
-                                             {{6, 5, 4, 3, 2, 1}},
-                                             {{7, 6, 5, 4, 3, 2}}}};
-  edMac->SetReplyDataRateMatrix (matrix);
+  edMac->SetReplyDataRateMatrix (m_parameters->GetReplyDataRateMatrix ());
 
   /////////////////////
   // Preamble length //
   /////////////////////
-  edMac->SetNPreambleSymbols (8);
+  edMac->SetNPreambleSymbols (m_parameters->GetNPreambleSymbols ());
 
   //////////////////////////////////////
   // Second receive window parameters //
   //////////////////////////////////////
-  edMac->SetSecondReceiveWindowDataRate (0);
-  edMac->SetSecondReceiveWindowFrequency (869.525);
+  edMac->SetSecondReceiveWindowDataRate (m_parameters->GetSecondReceiveWindowDataRate ());
+  edMac->SetSecondReceiveWindowFrequency (m_parameters->GetSecondReceiveWindowFrequency ());
 }
 
 void
-LorawanMacHelper::ConfigureForEuRegion (Ptr<GatewayLorawanMac> gwMac) const
+LorawanMacHelper::ConfigureGateway (Ptr<GatewayLorawanMac> gwMac) const
 {
-  NS_LOG_FUNCTION_NOARGS ();
+  NS_LOG_FUNCTION (this << m_parameters->GetName ());
 
   ///////////////////////////////
   // ReceivePath configuration //
@@ -288,35 +185,30 @@ LorawanMacHelper::ConfigureForEuRegion (Ptr<GatewayLorawanMac> gwMac) const
   Ptr<GatewayLoraPhy> gwPhy =
       gwMac->GetDevice ()->GetObject<LoraNetDevice> ()->GetPhy ()->GetObject<GatewayLoraPhy> ();
 
-  ApplyCommonEuConfigurations (gwMac);
+  ConfigureMac (gwMac, m_parameters->GetGatewayChannels ());
 
   if (gwPhy) // If cast is successful, there's a GatewayLoraPhy
     {
       NS_LOG_DEBUG ("Resetting reception paths");
       gwPhy->ResetReceptionPaths ();
 
-      std::vector<double> frequencies;
-      frequencies.push_back (868.1);
-      frequencies.push_back (868.3);
-      frequencies.push_back (868.5);
-
+      const std::vector<double> &frequencies = m_parameters->GetGatewayFrequencies ();
       for (auto &f : frequencies)
         {
           gwPhy->AddFrequency (f);
         }
 
-      int receptionPaths = 0;
-      int maxReceptionPaths = 8;
-      while (receptionPaths < maxReceptionPaths)
+      for (int receptionPaths = 0; receptionPaths < m_parameters->GetReceptionPaths ();
+           receptionPaths++)
         {
-          gwPhy->GetObject<GatewayLoraPhy> ()->AddReceptionPath ();
-          receptionPaths++;
+          gwPhy->AddReceptionPath ();
         }
     }
 }
 
 void
-LorawanMacHelper::ApplyCommonEuConfigurations (Ptr<LorawanMac> lorawanMac) const
+LorawanMacHelper::ConfigureMac (Ptr<LorawanMac> lorawanMac,
+                                const std::vector<RegionalParameters::Channel> &channels) const
 {
   NS_LOG_FUNCTION_NOARGS ();
 
@@ -325,19 +217,22 @@ LorawanMacHelper::ApplyCommonEuConfigurations (Ptr<LorawanMac> lorawanMac) const
   //////////////
 
   LogicalLoraChannelHelper channelHelper;
-  channelHelper.AddSubBand (868, 868.6, 0.01, 20);  // Lahis 14->20
-  channelHelper.AddSubBand (868.7, 869.2, 0.001, 20); // Lahis 14->20
-  channelHelper.AddSubBand (869.4, 869.65, 0.1, 27);
+  const std::vector<RegionalParameters::SubBand> &subBands = m_parameters->GetSubBands ();
+  for (auto &subBand : subBands)
+    {
+      channelHelper.AddSubBand (subBand.firstFrequency, subBand.lastFrequency, subBand.dutyCycle,
+                                subBand.maxTxPowerDbm);
+    }
 
   //////////////////////
   // Default channels //
   //////////////////////
-  Ptr<LogicalLoraChannel> lc1 = CreateObject<LogicalLoraChannel> (868.1, 0, 5);
-  Ptr<LogicalLoraChannel> lc2 = CreateObject<LogicalLoraChannel> (868.3, 0, 5);
-  Ptr<LogicalLoraChannel> lc3 = CreateObject<LogicalLoraChannel> (868.5, 0, 5);
-  channelHelper.AddChannel (lc1);
-  channelHelper.AddChannel (lc2);
-  channelHelper.AddChannel (lc3);
+  // Each MAC gets channels of its own: they keep its uplink state
+  for (auto &channel : channels)
+    {
+      channelHelper.AddChannel (CreateObject<LogicalLoraChannel> (
+          channel.frequency, channel.minDataRate, channel.maxDataRate));
+    }
 
   lorawanMac->SetLogicalLoraChannelHelper (channelHelper);
 
@@ -345,270 +240,183 @@ LorawanMacHelper::ApplyCommonEuConfigurations (Ptr<LorawanMac> lorawanMac) const
   // DataRate -> SF, DataRate -> Bandwidth     //
   // and DataRate -> MaxAppPayload conversions //
   ///////////////////////////////////////////////
-  lorawanMac->SetSfForDataRate (std::vector<uint8_t>{12, 11, 10, 9, 8, 7, 7});
-  lorawanMac->SetBandwidthForDataRate (
-      std::vector<double>{125000, 125000, 125000, 125000, 125000, 125000, 250000});
-  lorawanMac->SetMaxAppPayloadForDataRate (
-      std::vector<uint32_t>{59, 59, 59, 123, 230, 230, 230, 230});
+  lorawanMac->SetSfForDataRate (m_parameters->GetSfForDataRate ());
+  lorawanMac->SetBandwidthForDataRate (m_parameters->GetBandwidthForDataRate ());
+  lorawanMac->SetMaxAppPayloadForDataRate (m_parameters->GetMaxAppPayloadForDataRate ());
 }
 
-///////////////////////////////
-
-void
-LorawanMacHelper::ConfigureForSingleChannelRegion (Ptr<ClassAEndDeviceLorawanMac> edMac) const
+std::vector<int>
+LorawanMacHelper::SetSpreadingFactorsUp (NodeContainer endDevices, NodeContainer gateways,
+                                         Ptr<LoraChannel> channel)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
-  ApplyCommonSingleChannelConfigurations (edMac);
-
-  /////////////////////////////////////////////////////
-  // TxPower -> Transmission power in dBm conversion //
-  /////////////////////////////////////////////////////
-  edMac->SetTxDbmForTxPower (std::vector<double>{16, 14, 12, 10, 8, 6, 4, 2});
-
-  ////////////////////////////////////////////////////////////
-  // Matrix to know which DataRate the GW will respond with //
-  ////////////////////////////////////////////////////////////
-  LorawanMac::ReplyDataRateMatrix matrix = {{{{0, 0, 0, 0, 0, 0}},
-                                             {{1, 0, 0, 0, 0, 0}},
-                                             {{2, 1, 0, 0, 0, 0}},
-                                             {{3, 2, 1, 0, 0, 0}},
-                                             {{4, 3, 2, 1, 0, 0}},
-                                             {{5, 4, 3, 2, 1, 0}},
-                                             {{6, 5, 4, 3, 2, 1}},
-                                             {{7, 6, 5, 4, 3, 2}}}};
-  edMac->SetReplyDataRateMatrix (matrix);
+  return ComputeSpreadingFactorsUp (endDevices, gateways, channel, 0);
+}
 
-  /////////////////////
-  // Preamble length //
-  /////////////////////
-  edMac->SetNPreambleSymbols (8);
+std::vector<int>
+LorawanMacHelper::SetSpreadingFactorsUp (NodeContainer endDevices, NodeContainer gateways,
+                                         Ptr<LinkBudgetCache> linkBudget)
+{
+  NS_LOG_FUNCTION_NOARGS ();
 
-  //////////////////////////////////////
-  // Second receive window parameters //
-  //////////////////////////////////////
-  edMac->SetSecondReceiveWindowDataRate (0);
-  edMac->SetSecondReceiveWindowFrequency (869.525);
+  return ComputeSpreadingFactorsUp (endDevices, gateways, linkBudget->GetChannel (), linkBudget);
 }
 
-void
-LorawanMacHelper::ConfigureForSingleChannelRegion (Ptr<GatewayLorawanMac> gwMac) const
+std::vector<int>
+LorawanMacHelper::SetSpreadingFactorsUpBatch (NodeContainer endDevices, NodeContainer gateways,
+                                              Ptr<LoraChannel> channel, uint32_t nThreads)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
-  ///////////////////////////////
-  // ReceivePath configuration //
-  ///////////////////////////////
-  Ptr<GatewayLoraPhy> gwPhy =
-      gwMac->GetDevice ()->GetObject<LoraNetDevice> ()->GetPhy ()->GetObject<GatewayLoraPhy> ();
-
-  ApplyCommonEuConfigurations (gwMac);
+  WorkStealingPool pool (nThreads);
+  if (pool.GetNThreads () == 1)
+    {
+      return ComputeSpreadingFactorsUp (endDevices, gateways, channel, 0);
+    }
+  PointerValue loss;
+  channel->GetAttribute ("PropagationLossModel", loss);
+  if (!IsDeterministic (loss.Get<PropagationLossModel> ()))
+    {
+      NS_LOG_WARN ("The loss model of the channel does not only depend on the positions, "
+                   "evaluating the links on one thread.");
+      return ComputeSpreadingFactorsUp (endDevices, gateways, channel, 0);
+    }
 
-  if (gwPhy) // If cast is successful, there's a GatewayLoraPhy
+  // Gather the positions, MACs and sensitivities once
+  uint32_t nEd = endDevices.GetN ();
+  uint32_t nGw = gateways.GetN ();
+  std::vector<Vector> edPosition;
+  std::vector<Ptr<ClassAEndDeviceLorawanMac> > edMac;
+  std::vector<const double *> edSensitivity;
+  std::vector<Vector> gwPosition;
+  edPosition.reserve (nEd);
+  edMac.reserve (nEd);
+  edSensitivity.reserve (nEd);
+  gwPosition.reserve (nGw);
+  for (NodeContainer::Iterator j = endDevices.Begin (); j != endDevices.End (); ++j)
     {
-      NS_LOG_DEBUG ("Resetting reception paths");
-      gwPhy->ResetReceptionPaths ();
+      Ptr<MobilityModel> position = (*j)->GetObject<MobilityModel> ();
+      NS_ASSERT (position != 0);
+      Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice (0)->GetObject<LoraNetDevice> ();
+      NS_ASSERT (loraNetDevice != 0);
+      Ptr<ClassAEndDeviceLorawanMac> mac =
+          loraNetDevice->GetMac ()->GetObject<ClassAEndDeviceLorawanMac> ();
+      NS_ASSERT (mac != 0);
+      edPosition.push_back (position->GetPosition ());
+      edMac.push_back (mac);
+      edSensitivity.push_back (loraNetDevice->GetPhy ()->GetObject<EndDeviceLoraPhy> ()->sensitivity);
+    }
+  for (NodeContainer::Iterator j = gateways.Begin (); j != gateways.End (); ++j)
+    {
+      Ptr<MobilityModel> position = (*j)->GetObject<MobilityModel> ();
+      NS_ASSERT (position != 0);
+      gwPosition.push_back (position->GetPosition ());
+    }
 
-      std::vector<double> frequencies;
-      frequencies.push_back (868.1);
+  // The reference counts of the nodes' objects are not atomic: each worker
+  // evaluates the links between mobility models of its own, moved to the
+  // positions of the two nodes. The models IsDeterministic accepts only
+  // read these positions, so nothing else has to be aggregated to them
+  std::vector<Ptr<ConstantPositionMobilityModel> > edProbe (pool.GetNThreads ());
+  std::vector<Ptr<ConstantPositionMobilityModel> > gwProbe (pool.GetNThreads ());
+  for (uint32_t t = 0; t < pool.GetNThreads (); t++)
+    {
+      edProbe[t] = CreateObject<ConstantPositionMobilityModel> ();
+      gwProbe[t] = CreateObject<ConstantPositionMobilityModel> ();
+    }
 
-      for (auto &f : frequencies)
-        {
-          gwPhy->AddFrequency (f);
-        }
+  // Highest power received by a gateway from each end device (devices
+  // transmit at 20 dBm), in chunks of end devices taken by the workers
+  std::vector<double> highestRxPower (nEd);
+  pool.ParallelFor (nEd, 16, [&] (uint64_t begin, uint64_t end, uint32_t worker) {
+    for (uint64_t i = begin; i < end; i++)
+      {
+        edProbe[worker]->SetPosition (edPosition[i]);
+        double highest = -std::numeric_limits<double>::infinity ();
+        for (uint32_t g = 0; g < nGw; g++)
+          {
+            gwProbe[worker]->SetPosition (gwPosition[g]);
+            highest = std::max (highest, channel->GetRxPower (20, edProbe[worker], gwProbe[worker]));
+          }
+        highestRxPower[i] = highest;
+      }
+  });
+  NS_LOG_INFO ("Evaluated " << nEd << "x" << nGw << " links on " << pool.GetNThreads () << " threads.");
 
-      int receptionPaths = 0;
-      int maxReceptionPaths = 8;
-      while (receptionPaths < maxReceptionPaths)
+  // The lowest data rate the best gateway receives, as SetSpreadingFactorsUp
+  std::vector<int> sfQuantity (7, 0);
+  for (uint32_t i = 0; i < nEd; i++)
+    {
+      int k = 0;
+      while (k < 6 && highestRxPower[i] <= edSensitivity[i][k])
         {
-          gwPhy->GetObject<GatewayLoraPhy> ()->AddReceptionPath ();
-          receptionPaths++;
+          k++;
         }
+      // Device out of range (k == 6) is assigned SF12
+      edMac[i]->SetDataRate (std::max (5 - k, 0));
+      sfQuantity[k] = sfQuantity[k] + 1;
     }
-}
-
-void
-LorawanMacHelper::ApplyCommonSingleChannelConfigurations (Ptr<LorawanMac> lorawanMac) const
-{
-  NS_LOG_FUNCTION_NOARGS ();
-
-  //////////////
-  // SubBands //
-  //////////////
 
-  LogicalLoraChannelHelper channelHelper;
-  channelHelper.AddSubBand (868, 868.6, 0.01, 20); // Lahis14 ->20
-  channelHelper.AddSubBand (868.7, 869.2, 0.001, 20);
-  channelHelper.AddSubBand (869.4, 869.65, 0.1, 27);
-
-  //////////////////////
-  // Default channels //
-  //////////////////////
-  Ptr<LogicalLoraChannel> lc1 = CreateObject<LogicalLoraChannel> (868.1, 0, 5);
-  channelHelper.AddChannel (lc1);
-
-  lorawanMac->SetLogicalLoraChannelHelper (channelHelper);
-
-  ///////////////////////////////////////////////
-  // DataRate -> SF, DataRate -> Bandwidth     //
-  // and DataRate -> MaxAppPayload conversions //
-  ///////////////////////////////////////////////
-  lorawanMac->SetSfForDataRate (std::vector<uint8_t>{12, 11, 10, 9, 8, 7, 7});
-  lorawanMac->SetBandwidthForDataRate (
-      std::vector<double>{125000, 125000, 125000, 125000, 125000, 125000, 250000});
-  lorawanMac->SetMaxAppPayloadForDataRate (
-      std::vector<uint32_t>{59, 59, 59, 123, 230, 230, 230, 230});
-}
-
-
-void
-LorawanMacHelper::ConfigureForAuRegion (Ptr<ClassAEndDeviceLorawanMac> edMac) const
-{
-  NS_LOG_FUNCTION_NOARGS ();
-
-  ApplyCommonAuConfigurations (edMac);
-
-  /////////////////////////////////////////////////////
-  // TxPower -> Transmission power in dBm conversion //
-  /////////////////////////////////////////////////////
-  // Values based on:
-  // RP002-1.0.3 LoRaWAN® Regional Parameters 2021
-  // Table 43 : AU915-928 TX power table
-  edMac->SetTxDbmForTxPower (std::vector<double>{30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2});
-
-  ////////////////////////////////////////////////////////////
-  // Matrix to know which DataRate the GW will respond with //
-  ////////////////////////////////////////////////////////////
-  // Values based on:
-  // RP002-1.0.3 LoRaWAN® Regional Parameters 2021
-  // Table 47 : AU915-928 downlink RX1 data rate mapping
-  LorawanMac::ReplyDataRateMatrix matrix = {{{{8,  8,  8,  8,  8,  8}},
-                                             {{9,  8,  8,  8,  8,  8}},
-                                             {{10, 9,  8,  8,  8,  8}},
-                                             {{11, 10, 9,  8,  8,  8}},
-                                             {{12, 11, 10, 9,  8,  8}},
-                                             {{13, 12, 11, 10, 9,  8}},
-                                             {{13, 13, 12, 11, 10, 9}},
-                                             {{9,  8,  8,  8,  8,  8}}}};
-  edMac->SetReplyDataRateMatrix (matrix);
-
-  /////////////////////
-  // Preamble length //
-  /////////////////////
-  // Values based on:
-  // RP002-1.0.3 LoRaWAN® Regional Parameters 2021
-  //  4.1.2 LoRa settings
-  edMac->SetNPreambleSymbols (8);
-
-  //////////////////////////////////////
-  // Second receive window parameters //
-  //////////////////////////////////////
-  // Values based on:
-  // RP002-1.0.3 LoRaWAN® Regional Parameters 2021
-  // 2.8.7 AU915-928 Receive windows
-  edMac->SetSecondReceiveWindowDataRate (8);
-  edMac->SetSecondReceiveWindowFrequency (923.3);
+  return sfQuantity;
 }
 
-void
-LorawanMacHelper::ConfigureForAuRegion (Ptr<GatewayLorawanMac> gwMac) const
+bool
+LorawanMacHelper::IsDeterministic (Ptr<PropagationLossModel> model)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
-  ///////////////////////////////
-  // ReceivePath configuration //
-  ///////////////////////////////
-  Ptr<GatewayLoraPhy> gwPhy =
-      gwMac->GetDevice ()->GetObject<LoraNetDevice> ()->GetPhy ()->GetObject<GatewayLoraPhy> ();
-
-  ApplyCommonAuConfigurations (gwMac);
-
-  if (gwPhy) // If cast is successful, there's a GatewayLoraPhy
+  // Models whose loss only depends on the positions of the two mobility
+  // models, and that keep no state between calls. The obstacle models are
+  // found by name, so that this module does not need their headers
+  static const char *const positionOnly[] = {
+    "ns3::FriisPropagationLossModel",
+    "ns3::TwoRayGroundPropagationLossModel",
+    "ns3::LogDistancePropagationLossModel",
+    "ns3::ThreeLogDistancePropagationLossModel",
+    "ns3::FixedRssLossModel",
+    "ns3::RangePropagationLossModel",
+    "ns3::OkumuraHataPropagationLossModel",
+    "ns3::Cost231PropagationLossModel",
+    "ns3::ItuR1411LosPropagationLossModel",
+    "ns3::ItuR1411NlosOverRooftopPropagationLossModel",
+    "ns3::Kun2600MhzPropagationLossModel",
+    "ns3::ObstacleShadowingPropagationLossModel"};
+
+  for (; model != 0; model = model->GetNext ())
     {
-      NS_LOG_DEBUG ("Resetting reception paths");
-      gwPhy->ResetReceptionPaths ();
-
-      std::vector<double> frequencies;
-
-      // Values based on:
-      // RP002-1.0.3 LoRaWAN® Regional Parameters 2021
-      // 2.8.2 AU915-928 Band Channel Frequencies
-      // for (double gwch0_63 = 915.2; gwch0_63<=927.8+0.2; gwch0_63+=0.2){
-      //   frequencies.push_back (gwch0_63);
-      // }
-      for (double gwch64_71 = 915.9; gwch64_71<=927.1+1.6; gwch64_71+=1.6){
-        frequencies.push_back (gwch64_71);
-      }
-
-
-      for (auto &f : frequencies)
+      std::string name = model->GetInstanceTypeId ().GetName ();
+      bool known = std::find (std::begin (positionOnly), std::end (positionOnly), name)
+        != std::end (positionOnly);
+      if (name == "ns3::PrecomputedLinkLossModel")
         {
-          gwPhy->AddFrequency (f);
+          // finds the links by position, and evaluates the others
+          // with the model it wraps
+          PointerValue wrapped;
+          model->GetAttribute ("DeterministicModel", wrapped);
+          known = IsDeterministic (wrapped.Get<PropagationLossModel> ());
         }
-
-      int receptionPaths = 0;
-      int maxReceptionPaths = 8;
-      while (receptionPaths < maxReceptionPaths)
+      if (!known)
         {
-          gwPhy->GetObject<GatewayLoraPhy> ()->AddReceptionPath ();
-          receptionPaths++;
+          NS_LOG_DEBUG ("Loss model " << name << " is not known to only depend on the positions");
+          return false;
         }
     }
+  return true;
 }
 
-void
-LorawanMacHelper::ApplyCommonAuConfigurations (Ptr<LorawanMac> lorawanMac) const
-{
-  NS_LOG_FUNCTION_NOARGS ();
-
-  //////////////
-  // SubBands //
-  //////////////
-
-  LogicalLoraChannelHelper channelHelper;
-  channelHelper.AddSubBand (915, 928, 1, 30);
-
-  //////////////////////
-  // Default channels //
-  //////////////////////
-  // Values based on:
-  // RP002-1.0.3 LoRaWAN® Regional Parameters 2021
-  // 2.8.2 AU915-928 Band Channel Frequencies
-  // for (double gwch0_63 = 915.2; gwch0_63<=927.8+0.2; gwch0_63+=0.2){
-  //   Ptr<LogicalLoraChannel> lc1 = CreateObject<LogicalLoraChannel> (gwch0_63, 0, 5);
-  //   channelHelper.AddChannel (lc1);
-  // }
-  for (double gwch64_71 = 915.9; gwch64_71<=927.1+1.6; gwch64_71+=1.6){
-    Ptr<LogicalLoraChannel> lc1 = CreateObject<LogicalLoraChannel> (gwch64_71, 6, 6);
-    channelHelper.AddChannel (lc1);
-  }
- 
-  
-  lorawanMac->SetLogicalLoraChannelHelper (channelHelper);
-
-  ///////////////////////////////////////////////
-  // DataRate -> SF, DataRate -> Bandwidth     //
-  // and DataRate -> MaxAppPayload conversions //
-  ///////////////////////////////////////////////
-  // Values based on:
-  // RP002-1.0.3 LoRaWAN® Regional Parameters 2021
-  // Table 45: AU915-928 maximum payload size (repeater compatible)
-  lorawanMac->SetSfForDataRate (std::vector<uint8_t>{12, 11, 10, 9, 8, 7, 8, 0, 12, 11, 10, 9, 8, 7});
-  lorawanMac->SetBandwidthForDataRate (
-      std::vector<double>{125000, 125000, 125000, 125000, 125000, 125000, 500000, 0, 500000, 500000, 500000, 500000, 500000, 500000 });
-  lorawanMac->SetMaxAppPayloadForDataRate (
-      std::vector<uint32_t>{59, 59, 59, 123, 230, 230, 230, 58, 61, 137, 230, 230, 230, 230});
-}
-
-///////////////////////////////
-
-
 std::vector<int>
-LorawanMacHelper::SetSpreadingFactorsUp (NodeContainer endDevices, NodeContainer gateways,
-                                         Ptr<LoraChannel> channel)
+LorawanMacHelper::ComputeSpreadingFactorsUp (NodeContainer endDevices, NodeContainer gateways,
+                                             Ptr<LoraChannel> channel,
+                                             Ptr<LinkBudgetCache> linkBudget)
 {
   NS_LOG_FUNCTION_NOARGS ();
 
+  // Received power of a link, kept by the cache if there is one
+  auto getRxPower = [&] (Ptr<MobilityModel> ed, Ptr<MobilityModel> gw) {
+    return (linkBudget != 0) ? linkBudget->GetRxPower (20, ed, gw) : channel->GetRxPower (20, ed, gw);
+  };
+
   std::vector<int> sfQuantity (7, 0);
   for (NodeContainer::Iterator j = endDevices.Begin (); j != endDevices.End (); ++j)
     {
@@ -627,7 +435,7 @@ LorawanMacHelper::SetSpreadingFactorsUp (NodeContainer endDevices, NodeContainer
       Ptr<MobilityModel> bestGatewayPosition = bestGateway->GetObject<MobilityModel> ();
 
       // Assume devices transmit at 14 dBm
-      double highestRxPower = channel->GetRxPower (20, position, bestGatewayPosition); // Lahis 14->20
+      double highestRxPower = getRxPower (position, bestGatewayPosition); // Lahis 14->20
 
       for (NodeContainer::Iterator currentGw = gateways.Begin () + 1; currentGw != gateways.End ();
            ++currentGw)
@@ -635,7 +443,7 @@ LorawanMacHelper::SetSpreadingFactorsUp (NodeContainer endDevices, NodeContainer
           // Compute the power received from the current gateway
           Ptr<Node> curr = *currentGw;
           Ptr<MobilityModel> currPosition = curr->GetObject<MobilityModel> ();
-          double currentRxPower = channel->GetRxPower (20, position, currPosition); // Lahis dBm 14->20
+          double currentRxPower = getRxPower (position, currPosition); // Lahis dBm 14->20
 
           if (currentRxPower > highestRxPower)
             {
@@ -965,5 +773,404 @@ LorawanMacHelper::SetSpreadingFactorsGivenDistributionManually (NodeContainer en
   } // end loop on nodes
   return -1;
 } //  end function
+
+std::vector<int>
+LorawanMacHelper::ApplySpreadingFactors (NodeContainer endDevices,
+                                         const std::vector<uint8_t> &dataRates)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  NS_ASSERT_MSG (dataRates.size () == endDevices.GetN (),
+                 "The plan has " << dataRates.size () << " data rates for "
+                                 << endDevices.GetN () << " end devices");
+
+  std::vector<int> sfQuantity (7, 0);
+  std::vector<uint8_t>::const_iterator dataRate = dataRates.begin ();
+  for (NodeContainer::Iterator j = endDevices.Begin (); j != endDevices.End (); ++j, ++dataRate)
+    {
+      Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice (0)->GetObject<LoraNetDevice> ();
+      NS_ASSERT (loraNetDevice != 0);
+      Ptr<ClassAEndDeviceLorawanMac> mac =
+          loraNetDevice->GetMac ()->GetObject<ClassAEndDeviceLorawanMac> ();
+      NS_ASSERT (mac != 0);
+
+      if (*dataRate > 5)
+        {
+          NS_LOG_DEBUG ("Data rate " << unsigned (*dataRate) << " of node "
+                                     << (*j)->GetId () << " left as it is");
+          sfQuantity[6] = sfQuantity[6] + 1;
+          continue;
+        }
+      mac->SetDataRate (*dataRate);
+      sfQuantity[5 - *dataRate] = sfQuantity[5 - *dataRate] + 1;
+    }
+
+  return sfQuantity;
+}
+
+std::vector<uint8_t>
+LorawanMacHelper::GetSpreadingFactors (NodeContainer endDevices)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  std::vector<uint8_t> dataRates;
+  dataRates.reserve (endDevices.GetN ());
+  for (NodeContainer::Iterator j = endDevices.Begin (); j != endDevices.End (); ++j)
+    {
+      Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice (0)->GetObject<LoraNetDevice> ();
+      NS_ASSERT (loraNetDevice != 0);
+      Ptr<ClassAEndDeviceLorawanMac> mac =
+          loraNetDevice->GetMac ()->GetObject<ClassAEndDeviceLorawanMac> ();
+      NS_ASSERT (mac != 0);
+      dataRates.push_back (mac->GetDataRate ());
+    }
+
+  return dataRates;
+}
+
+namespace {
+
+// Header of the spreading factor plan files: magic, version, number of end
+// devices (uint32_t each, host byte order). Version 2 adds the number of
+// uplink channels (0 or the number of end devices) after the data rates
+const char SF_PLAN_MAGIC[8] = {'L', 'O', 'R', 'A', 'S', 'F', 'P', 'L'};
+const uint32_t SF_PLAN_VERSION = 2;
+
+} // anonymous namespace
+
+bool
+LorawanMacHelper::SaveSpreadingFactors (const std::string &filename,
+                                        const std::vector<uint8_t> &dataRates,
+                                        const std::vector<uint8_t> &channels)
+{
+  NS_LOG_FUNCTION (filename << dataRates.size () << channels.size ());
+  NS_ASSERT_MSG (channels.empty () || channels.size () == dataRates.size (),
+                 "One channel per end device");
+
+  std::ofstream file (filename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  uint32_t nEndDevices = dataRates.size ();
+  uint32_t nChannels = channels.size ();
+  file.write (SF_PLAN_MAGIC, sizeof (SF_PLAN_MAGIC));
+  file.write (reinterpret_cast<const char *> (&SF_PLAN_VERSION), sizeof (SF_PLAN_VERSION));
+  file.write (reinterpret_cast<const char *> (&nEndDevices), sizeof (nEndDevices));
+  file.write (reinterpret_cast<const char *> (dataRates.data ()), dataRates.size ());
+  file.write (reinterpret_cast<const char *> (&nChannels), sizeof (nChannels));
+  file.write (reinterpret_cast<const char *> (channels.data ()), channels.size ());
+  file.close ();
+  if (!file)
+    {
+      NS_LOG_ERROR ("Could not write the spreading factor plan to " << filename);
+      return false;
+    }
+  return true;
+}
+
+bool
+LorawanMacHelper::LoadSpreadingFactors (const std::string &filename,
+                                        std::vector<uint8_t> &dataRates,
+                                        std::vector<uint8_t> &channels)
+{
+  NS_LOG_FUNCTION (filename);
+
+  std::ifstream file (filename.c_str (), std::ios::in | std::ios::binary);
+  char magic[sizeof (SF_PLAN_MAGIC)];
+  uint32_t version = 0;
+  uint32_t nEndDevices = 0;
+  file.read (magic, sizeof (magic));
+  file.read (reinterpret_cast<char *> (&version), sizeof (version));
+  file.read (reinterpret_cast<char *> (&nEndDevices), sizeof (nEndDevices));
+  if (!file || !std::equal (magic, magic + sizeof (magic), SF_PLAN_MAGIC) ||
+      version < 1 || version > SF_PLAN_VERSION)
+    {
+      NS_LOG_ERROR (filename << " is not a spreading factor plan");
+      return false;
+    }
+
+  std::vector<uint8_t> plan (nEndDevices);
+  file.read (reinterpret_cast<char *> (plan.data ()), nEndDevices);
+  // plans of version 1 have no channels
+  uint32_t nChannels = 0;
+  if (file && version >= 2)
+    {
+      file.read (reinterpret_cast<char *> (&nChannels), sizeof (nChannels));
+    }
+  if (file && nChannels != 0 && nChannels != nEndDevices)
+    {
+      NS_LOG_ERROR ("The spreading factor plan " << filename << " has " << nChannels
+                    << " channels for " << nEndDevices << " end devices");
+      return false;
+    }
+  std::vector<uint8_t> channelPlan (nChannels);
+  file.read (reinterpret_cast<char *> (channelPlan.data ()), nChannels);
+  if (!file)
+    {
+      NS_LOG_ERROR ("The spreading factor plan " << filename << " is truncated");
+      return false;
+    }
+  dataRates.swap (plan);
+  channels.swap (channelPlan);
+  return true;
+}
+
+std::vector<double>
+LorawanMacHelper::GetHighestRxPower (NodeContainer endDevices, NodeContainer gateways,
+                                     Ptr<LoraChannel> channel)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  std::vector<double> highestRxPower;
+  highestRxPower.reserve (endDevices.GetN ());
+  for (NodeContainer::Iterator j = endDevices.Begin (); j != endDevices.End (); ++j)
+    {
+      Ptr<MobilityModel> position = (*j)->GetObject<MobilityModel> ();
+      NS_ASSERT (position != 0);
+      double highest = -std::numeric_limits<double>::infinity ();
+      for (NodeContainer::Iterator gw = gateways.Begin (); gw != gateways.End (); ++gw)
+        {
+          highest = std::max (highest,
+                              channel->GetRxPower (20, position, (*gw)->GetObject<MobilityModel> ()));
+        }
+      highestRxPower.push_back (highest);
+    }
+
+  return highestRxPower;
+}
+
+namespace {
+
+// Bytes the MAC adds to the application payload (MAC header, and frame
+// header with the port)
+const uint32_t MAC_OVERHEAD = 9;
+
+// Time on air (s) of an uplink packet at DR0 to DR5 (125 kHz, 4/5)
+double
+GetUplinkOnAirTime (uint32_t packetSize, uint8_t dataRate)
+{
+  return LoraTimeOnAir::GetSeconds (12 - dataRate, 125000, 1, packetSize + MAC_OVERHEAD);
+}
+
+// Expected packets received per second from the devices of a cell (a
+// spreading factor on a channel) of load G, S being the sum over the
+// devices of rate * exp (2 * own load)
+double
+GetCellThroughput (double load, double sum)
+{
+  return std::exp (-2 * load) * std::max (sum, 0.0);
+}
+
+} // anonymous namespace
+
+std::vector<int>
+LorawanMacHelper::PlanSpreadingFactors (NodeContainer endDevices,
+                                        const std::vector<double> &rxPower,
+                                        const std::vector<Time> &intervals,
+                                        const std::vector<uint32_t> &packetSizes,
+                                        uint8_t minDataRate, bool planChannels,
+                                        std::vector<uint8_t> &channels, double &predictedPdr)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+
+  uint32_t nEd = endDevices.GetN ();
+  NS_ASSERT_MSG (rxPower.size () == nEd && intervals.size () == nEd && packetSizes.size () == nEd,
+                 "One link budget, interval and packet size per end device");
+  NS_ASSERT (minDataRate <= 5);
+
+  std::vector<Ptr<ClassAEndDeviceLorawanMac> > edMac;
+  std::vector<const double *> edSensitivity;
+  edMac.reserve (nEd);
+  edSensitivity.reserve (nEd);
+  for (NodeContainer::Iterator j = endDevices.Begin (); j != endDevices.End (); ++j)
+    {
+      Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice (0)->GetObject<LoraNetDevice> ();
+      NS_ASSERT (loraNetDevice != 0);
+      Ptr<ClassAEndDeviceLorawanMac> mac =
+          loraNetDevice->GetMac ()->GetObject<ClassAEndDeviceLorawanMac> ();
+      NS_ASSERT (mac != 0);
+      edMac.push_back (mac);
+      edSensitivity.push_back (loraNetDevice->GetPhy ()->GetObject<EndDeviceLoraPhy> ()->sensitivity);
+    }
+
+  // A cell is a spreading factor on one channel (channel planning) or on
+  // every channel, the devices hopping over them
+  uint32_t nChannels = 1;
+  if (nEd > 0)
+    {
+      nChannels = std::max<uint32_t> (
+          1, edMac[0]->GetLogicalLoraChannelHelper ().GetChannelList ().size ());
+    }
+  uint32_t nCells = planChannels ? nChannels : 1;
+  double share = planChannels ? 1.0 : 1.0 / nChannels;
+
+  // Spreading factors are indexed as in sfQuantity: k = 5 - data rate
+  int slowest = 5 - minDataRate;
+  std::vector<double> rate (nEd, 0.0); // packets per second
+  std::vector<std::array<double, 6> > load (nEd); // Erlang in a cell, per k
+  std::vector<int> fastest (nEd);
+  std::vector<bool> inRange (nEd);
+  double totalRate = 0;
+  for (uint32_t i = 0; i < nEd; i++)
+    {
+      rate[i] = intervals[i].IsStrictlyPositive () ? 1.0 / intervals[i].GetSeconds () : 0.0;
+      totalRate += rate[i];
+      for (int k = 0; k < 6; k++)
+        {
+          load[i][k] = share * rate[i] * GetUplinkOnAirTime (packetSizes[i], 5 - k);
+        }
+
+      // The fastest data rate the best gateway receives; the devices out of
+      // range send at the slowest allowed one, and are never received
+      int k = 0;
+      while (k < 6 && rxPower[i] <= edSensitivity[i][k])
+        {
+          k++;
+        }
+      inRange[i] = (k <= slowest);
+      fastest[i] = std::min (k, slowest);
+    }
+
+  // Cell loads and throughput sums, for a given assignment
+  std::vector<int> sf (fastest);
+  std::vector<uint32_t> channel (nEd, 0);
+  std::vector<double> cellLoad (6 * nCells);
+  std::vector<double> cellSum (6 * nCells);
+  auto contribution = [&] (uint32_t i, int k) {
+    return inRange[i] ? rate[i] * std::exp (2 * load[i][k]) : 0.0;
+  };
+  auto sumCells = [&] () {
+    std::fill (cellLoad.begin (), cellLoad.end (), 0.0);
+    std::fill (cellSum.begin (), cellSum.end (), 0.0);
+    for (uint32_t i = 0; i < nEd; i++)
+      {
+        cellLoad[sf[i] * nCells + channel[i]] += load[i][sf[i]];
+        cellSum[sf[i] * nCells + channel[i]] += contribution (i, sf[i]);
+      }
+  };
+
+  // Start from the fastest data rates, on the least loaded channels
+  for (uint32_t i = 0; i < nEd; i++)
+    {
+      uint32_t cell = sf[i] * nCells;
+      channel[i] = std::min_element (cellLoad.begin () + cell, cellLoad.begin () + cell + nCells) -
+                   (cellLoad.begin () + cell);
+      cellLoad[cell + channel[i]] += load[i][sf[i]];
+    }
+  sumCells ();
+
+  // Move the devices, one at a time, to the cell that most increases the
+  // packets received, until no move does
+  const uint32_t maxSweeps = 50;
+  uint32_t sweep = 0;
+  uint32_t nMoves = 1;
+  for (; sweep < maxSweeps && nMoves > 0; sweep++)
+    {
+      nMoves = 0;
+      for (uint32_t i = 0; i < nEd; i++)
+        {
+          if (rate[i] == 0)
+            {
+              continue;
+            }
+          uint32_t from = sf[i] * nCells + channel[i];
+          double fromLoad = cellLoad[from] - load[i][sf[i]];
+          double fromSum = cellSum[from] - contribution (i, sf[i]);
+          double fromGain = GetCellThroughput (fromLoad, fromSum) -
+                            GetCellThroughput (cellLoad[from], cellSum[from]);
+
+          double bestGain = 1e-12 * totalRate;
+          int bestSf = -1;
+          uint32_t bestChannel = 0;
+          for (int k = inRange[i] ? fastest[i] : slowest; k <= slowest; k++)
+            {
+              for (uint32_t c = 0; c < nCells; c++)
+                {
+                  uint32_t to = k * nCells + c;
+                  if (to == from)
+                    {
+                      continue;
+                    }
+                  double gain = fromGain +
+                                GetCellThroughput (cellLoad[to] + load[i][k],
+                                                   cellSum[to] + contribution (i, k)) -
+                                GetCellThroughput (cellLoad[to], cellSum[to]);
+                  if (gain > bestGain)
+                    {
+                      bestGain = gain;
+                      bestSf = k;
+                      bestChannel = c;
+                    }
+                }
+            }
+          if (bestSf >= 0)
+            {
+              uint32_t to = bestSf * nCells + bestChannel;
+              cellLoad[from] = fromLoad;
+              cellSum[from] = fromSum;
+              cellLoad[to] += load[i][bestSf];
+              cellSum[to] += contribution (i, bestSf);
+              sf[i] = bestSf;
+              channel[i] = bestChannel;
+              nMoves++;
+            }
+        }
+      // do not let the rounding errors of the moves add up
+      sumCells ();
+      NS_LOG_DEBUG ("Sweep " << sweep << ": " << nMoves << " moves");
+    }
+
+  double received = 0;
+  for (uint32_t cell = 0; cell < cellLoad.size (); cell++)
+    {
+      received += GetCellThroughput (cellLoad[cell], cellSum[cell]);
+    }
+  predictedPdr = (totalRate > 0) ? received / totalRate : 0.0;
+  NS_LOG_INFO ("Planned " << nEd << " end devices on " << nCells << " channels in " << sweep
+                          << " sweeps, predicted PDR " << predictedPdr);
+
+  std::vector<int> sfQuantity (7, 0);
+  for (uint32_t i = 0; i < nEd; i++)
+    {
+      edMac[i]->SetDataRate (5 - sf[i]);
+      int index = inRange[i] ? sf[i] : 6;
+      sfQuantity[index] = sfQuantity[index] + 1;
+    }
+
+  channels.clear ();
+  if (planChannels)
+    {
+      channels.assign (channel.begin (), channel.end ());
+      ApplyChannels (endDevices, channels);
+    }
+
+  return sfQuantity;
+}
+
+void
+LorawanMacHelper::ApplyChannels (NodeContainer endDevices, const std::vector<uint8_t> &channels)
+{
+  NS_LOG_FUNCTION_NOARGS ();
+  NS_ASSERT_MSG (channels.size () == endDevices.GetN (), "One channel per end device");
+
+  std::vector<uint8_t>::const_iterator channel = channels.begin ();
+  for (NodeContainer::Iterator j = endDevices.Begin (); j != endDevices.End (); ++j, ++channel)
+    {
+      Ptr<LoraNetDevice> loraNetDevice = (*j)->GetDevice (0)->GetObject<LoraNetDevice> ();
+      NS_ASSERT (loraNetDevice != 0);
+
+      // Each MAC has channels of its own (see ConfigureMac)
+      std::vector<Ptr<LogicalLoraChannel> > list =
+          loraNetDevice->GetMac ()->GetLogicalLoraChannelHelper ().GetChannelList ();
+      NS_ASSERT (*channel < list.size ());
+      for (uint32_t c = 0; c < list.size (); c++)
+        {
+          if (c == *channel)
+            {
+              list[c]->SetEnabledForUplink ();
+            }
+          else
+            {
+              list[c]->DisableForUplink ();
+            }
+        }
+    }
+}
 } // namespace lorawan
 } // namespace ns3
\ No newline at end of file
@@ -30,6 +30,8 @@
 #include "ns3/gateway-lorawan-mac.h"
 #include "ns3/node-container.h"
 #include "ns3/random-variable-stream.h"
+#include "ns3/link-budget-cache.h"
+#include "ns3/regional-parameters.h"
 
 namespace ns3 {
 namespace lorawan {
@@ -89,6 +91,22 @@ public:
    */
   void SetRegion (enum Regions region);
 
+  /**
+   * Set the region in which the device is to operate, by the name of its
+   * regional parameters (see RegionalParameters).
+   *
+   * \param name The name of the region, built in or loaded.
+   */
+  void SetRegion (std::string name);
+
+  /**
+   * Add the regions of a regional parameters file, to be set by name.
+   *
+   * \param filename The file (see RegionalParameters for its format).
+   * \return False if the file cannot be read or has errors.
+   */
+  static bool LoadRegionalParameters (std::string filename);
+
   /**
    * Create the LorawanMac instance and connect it to a device
    *
@@ -110,6 +128,59 @@ public:
    */
   static std::vector<int> SetSpreadingFactorsUp (NodeContainer endDevices, NodeContainer gateways,
                                                  Ptr<LoraChannel> channel);
+
+  /**
+   * Set up the end device's data rates, as SetSpreadingFactorsUp above,
+   * with the received powers of the links kept by a LinkBudgetCache (and
+   * evaluated by its channel the first time).
+   */
+  static std::vector<int> SetSpreadingFactorsUp (NodeContainer endDevices, NodeContainer gateways,
+                                                 Ptr<LinkBudgetCache> linkBudget);
+
+  /**
+   * Set up the end device's data rates, as SetSpreadingFactorsUp above, for
+   * large numbers of end devices: the node positions are gathered once, the
+   * received power of every end device to gateway link is evaluated on
+   * several threads, then the data rates are set from the sensitivity of
+   * the end devices.
+   *
+   * With more than one thread the links are evaluated on a WorkStealingPool,
+   * between the node positions (on bare mobility models private to each
+   * thread, which a PrecomputedLinkLossModel finds by position), so every
+   * loss model of the channel must only depend on the positions and be
+   * safe to call from several threads at once (see IsDeterministic). If
+   * IsDeterministic rejects the loss model of the channel (e.g., a random
+   * or a buildings model), or with one thread, this is
+   * SetSpreadingFactorsUp, on the mobility models of the nodes.
+   *
+   * \param endDevices The end devices.
+   * \param gateways The gateways.
+   * \param channel The channel.
+   * \param nThreads The number of threads (0 means one per hardware thread).
+   * \return The number of end devices set to DR5, DR4, ..., DR0, and out of
+   * range, as SetSpreadingFactorsUp.
+   */
+  static std::vector<int> SetSpreadingFactorsUpBatch (NodeContainer endDevices,
+                                                      NodeContainer gateways,
+                                                      Ptr<LoraChannel> channel,
+                                                      uint32_t nThreads);
+
+  /**
+   * Check that a loss model, and every model chained after it with
+   * SetNext, is known to give the same loss on every call, from the
+   * positions of the two mobility models only: Friis, two-ray ground,
+   * log-distance, three log-distance, fixed RSS, range, Okumura-Hata,
+   * COST 231, ITU-R P.1411, Kun 2600 MHz and obstacle shadowing models,
+   * or a PrecomputedLinkLossModel wrapping such models. Any other model
+   * (e.g., random or fading models, the buildings models, which read the
+   * MobilityBuildingInfo of the nodes, or a MatrixPropagationLossModel,
+   * which finds the links by mobility model) is rejected.
+   *
+   * \param model The first model of the chain (e.g., the loss model of a
+   * LoraChannel).
+   * \return false if a model of the chain is not known to be deterministic.
+   */
+  static bool IsDeterministic (Ptr<PropagationLossModel> model);
   /**
    * Set up the end device's data rates according to the given distribution.
    */
@@ -120,6 +191,119 @@ public:
 static int SetSpreadingFactorsGivenDistributionManually (NodeContainer endDevices,
                                                                 NodeContainer gateways, int id, int SF);
 
+  /**
+   * Set the data rate of every end device, in one pass: dataRates[i] is the
+   * data rate of the i-th end device of the container (DR5 to DR0, see
+   * SetSpreadingFactorsUp). The end devices with a data rate above DR5 are
+   * left as they are.
+   *
+   * \param endDevices The end devices.
+   * \param dataRates The data rate of each end device.
+   * \return The number of end devices set to DR5, DR4, ..., DR0, and left
+   * as they are.
+   */
+  static std::vector<int> ApplySpreadingFactors (NodeContainer endDevices,
+                                                 const std::vector<uint8_t> &dataRates);
+
+  /**
+   * Get the data rate of every end device, in container order (the plan
+   * ApplySpreadingFactors restores).
+   *
+   * \param endDevices The end devices.
+   * \return The data rate of each end device.
+   */
+  static std::vector<uint8_t> GetSpreadingFactors (NodeContainer endDevices);
+
+  /**
+   * Save a spreading factor plan (the data rate of each end device) to a
+   * file, one byte per end device after a short header, followed by the
+   * uplink channel of each end device if there is a channel plan.
+   *
+   * \param filename The file.
+   * \param dataRates The data rate of each end device.
+   * \param channels The uplink channel of each end device (see
+   * ApplyChannels), or empty if the devices use every channel.
+   * \return False if the file cannot be written.
+   */
+  static bool SaveSpreadingFactors (const std::string &filename,
+                                    const std::vector<uint8_t> &dataRates,
+                                    const std::vector<uint8_t> &channels);
+
+  /**
+   * Load a spreading factor plan saved by SaveSpreadingFactors.
+   *
+   * \param filename The file.
+   * \param dataRates The data rate of each end device, filled.
+   * \param channels The uplink channel of each end device, filled (empty if
+   * the plan has no channels).
+   * \return False if the file cannot be read or is not a plan.
+   */
+  static bool LoadSpreadingFactors (const std::string &filename,
+                                    std::vector<uint8_t> &dataRates,
+                                    std::vector<uint8_t> &channels);
+
+  /**
+   * Get the highest power received by a gateway from each end device, in
+   * container order (devices transmit at 20 dBm, as SetSpreadingFactorsUp).
+   *
+   * \param endDevices The end devices.
+   * \param gateways The gateways.
+   * \param channel The channel.
+   * \return The highest received power of each end device, in dBm.
+   */
+  static std::vector<double> GetHighestRxPower (NodeContainer endDevices, NodeContainer gateways,
+                                                Ptr<LoraChannel> channel);
+
+  /**
+   * Set up the end device's data rates (and, optionally, uplink channels)
+   * from a model of the offered load, instead of the fastest data rate each
+   * device can use.
+   *
+   * Each end device sends a packet of packetSizes[i] bytes every
+   * intervals[i] (a zero interval means it does not send). The time on air
+   * of its packets at each data rate gives its load; the packets sent at the
+   * same spreading factor on the same channel collide as in pure ALOHA,
+   * i.e., a packet is received with probability exp (-2 G), G being the
+   * load of the other devices. Starting from the fastest data rate each
+   * device can use, the devices are moved, one at a time, to the data rate
+   * (and channel) that most increases the expected number of packets
+   * received, until no move does.
+   *
+   * Without channel planning the devices keep hopping over every uplink
+   * channel, which divides their load by the number of channels. With it,
+   * each device is given a single uplink channel (see ApplyChannels).
+   *
+   * \param endDevices The end devices.
+   * \param rxPower The highest received power of each end device, in dBm
+   * (see GetHighestRxPower).
+   * \param intervals The interval between the packets of each end device.
+   * \param packetSizes The application payload of each end device, in bytes.
+   * \param minDataRate The lowest data rate the devices may use.
+   * \param channels Filled with the uplink channel of each end device (the
+   * index in its channel list), if planned; left empty otherwise.
+   * \param planChannels Whether to plan the uplink channels.
+   * \param predictedPdr Filled with the expected packet delivery ratio.
+   * \return The number of end devices set to DR5, DR4, ..., DR0, and out of
+   * range, as SetSpreadingFactorsUp.
+   */
+  static std::vector<int> PlanSpreadingFactors (NodeContainer endDevices,
+                                                const std::vector<double> &rxPower,
+                                                const std::vector<Time> &intervals,
+                                                const std::vector<uint32_t> &packetSizes,
+                                                uint8_t minDataRate,
+                                                bool planChannels,
+                                                std::vector<uint8_t> &channels,
+                                                double &predictedPdr);
+
+  /**
+   * Restrict each end device to a single uplink channel, in one pass.
+   *
+   * \param endDevices The end devices.
+   * \param channels The uplink channel of each end device (the index in its
+   * channel list).
+   */
+  static void ApplyChannels (NodeContainer endDevices, const std::vector<uint8_t> &channels);
+
 
   /**
    * Set up the end device's data rates according to the given distribution.
@@ -151,74 +335,39 @@ static int SetSpreadingFactorsGivenDistributionManually (NodeContainer endDevice
 
 private:
   /**
-   * Perform region-specific configurations for the 868 MHz EU band.
+   * Set up the end device's data rates, with the received powers given by
+   * the cache if there is one, by the channel otherwise.
    */
-  void ConfigureForEuRegion (Ptr<ClassAEndDeviceLorawanMac> edMac) const;
+  static std::vector<int> ComputeSpreadingFactorsUp (NodeContainer endDevices,
+                                                     NodeContainer gateways,
+                                                     Ptr<LoraChannel> channel,
+                                                     Ptr<LinkBudgetCache> linkBudget);
 
   /**
-   * Perform region-specific configurations for the 868 MHz EU band.
+   * Perform the region-specific configurations of an end device.
    */
-  void ConfigureForEuRegion (Ptr<GatewayLorawanMac> gwMac) const;
+  void ConfigureEndDevice (Ptr<ClassAEndDeviceLorawanMac> edMac) const;
 
   /**
-   * Apply configurations that are common both for the GatewayLorawanMac and the
-   * ClassAEndDeviceLorawanMac classes.
+   * Perform the region-specific configurations of a gateway, and of its
+   * reception paths.
    */
-  void ApplyCommonEuConfigurations (Ptr<LorawanMac> lorawanMac) const;
-
-  /**
-   * Perform region-specific configurations for the SINGLECHANNEL band.
-   */
-  void ConfigureForSingleChannelRegion (Ptr<ClassAEndDeviceLorawanMac> edMac) const;
-
-  /**
-   * Perform region-specific configurations for the SINGLECHANNEL band.
-   */
-  void ConfigureForSingleChannelRegion (Ptr<GatewayLorawanMac> gwMac) const;
-
-  /**
-   * Apply configurations that are common both for the GatewayLorawanMac and the
-   * ClassAEndDeviceLorawanMac classes.
-   */
-  void ApplyCommonSingleChannelConfigurations (Ptr<LorawanMac> lorawanMac) const;
-
-  /**
-   * Perform region-specific configurations for the ALOHA band.
-   */
-  void ConfigureForAlohaRegion (Ptr<ClassAEndDeviceLorawanMac> edMac) const;
-
-  /**
-   * Perform region-specific configurations for the ALOHA band.
-   */
-  void ConfigureForAlohaRegion (Ptr<GatewayLorawanMac> gwMac) const;
-
-  /**
-   * Apply configurations that are common both for the GatewayLorawanMac and the
-   * ClassAEndDeviceLorawanMac classes.
-   */
-  void ApplyCommonAlohaConfigurations (Ptr<LorawanMac> lorawanMac) const;
-
-  /**
-   * Perform region-specific configurations for the 915-928 MHz AU band.
-   */
-  void ConfigureForAuRegion (Ptr<ClassAEndDeviceLorawanMac> edMac) const;
-
-  /**
-   * Perform region-specific configurations for the 915-928 MHz AU band.
-   */
-  void ConfigureForAuRegion (Ptr<GatewayLorawanMac> gwMac) const;
+  void ConfigureGateway (Ptr<GatewayLorawanMac> gwMac) const;
 
   /**
    * Apply configurations that are common both for the GatewayLorawanMac and the
    * ClassAEndDeviceLorawanMac classes.
+   *
+   * \param lorawanMac The MAC.
+   * \param channels The channels of the MAC.
    */
-  void ApplyCommonAuConfigurations (Ptr<LorawanMac> lorawanMac) const;
-
+  void ConfigureMac (Ptr<LorawanMac> lorawanMac,
+                     const std::vector<RegionalParameters::Channel> &channels) const;
 
   ObjectFactory m_mac;
   Ptr<LoraDeviceAddressGenerator> m_addrGen; //!< Pointer to the address generator to use
   enum DeviceType m_deviceType; //!< The kind of device to install
-  enum Regions m_region; //!< The region in which the device will operate
+  Ptr<RegionalParameters> m_parameters; //!< The region in which the device will operate
 };
 
 } // namespace lorawan
@@ -0,0 +1,629 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ns3/test.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/lora-phy.h"
+#include "ns3/lora-time-on-air.h"
+#include "ns3/columnar-writer.h"
+#include "ns3/async-record-writer.h"
+#include "ns3/regional-parameters.h"
+#include "ns3/lorawan-mac-helper.h"
+#include "ns3/packet-state-table.h"
+
+using namespace ns3;
+using namespace lorawan;
+
+namespace {
+
+// the whole content of a file
+std::string
+ReadFile (const std::string &filename)
+{
+  std::ifstream file (filename.c_str (), std::ios::in | std::ios::binary);
+  return std::string (std::istreambuf_iterator<char> (file), std::istreambuf_iterator<char> ());
+}
+
+// reads a value of type T at offset, and moves the offset past it
+template <typename T>
+T
+ReadValue (const std::string &data, size_t &offset)
+{
+  T value = T ();
+  if (offset + sizeof (T) <= data.size ())
+    {
+      std::memcpy (&value, data.data () + offset, sizeof (T));
+    }
+  offset += sizeof (T);
+  return value;
+}
+
+// a record of the AsyncRecordWriter test
+struct TestRecord
+{
+  uint32_t index;
+  double value;
+};
+
+// a complete region, to which the tests of RegionalParameters add lines
+const char *TEST_REGION = "region TEST\n"
+                          "sub_band 868 868.6 0.01 14\n"
+                          "channel 868.1 0 2\n"
+                          "data_rate 0 12 125000 59\n"
+                          "data_rate 1 11 125000 59\n"
+                          "data_rate 2 0 0 230          # not LoRa\n"
+                          "tx_power 14 12\n"
+                          "rx1_data_rate 2 2 1 0 0 0 0\n"
+                          "rx2 0 869.525\n";
+
+// the regions of text, or none if RegionalParameters::Parse fails
+bool
+ParseRegions (const std::string &text, std::vector<Ptr<RegionalParameters>> &regions)
+{
+  std::istringstream is (text);
+  return RegionalParameters::Parse (is, "test", regions);
+}
+
+} // namespace
+
+/**
+ * \ingroup lorawan
+ * The layout of the files of ColumnarWriter: header, chunks, and the
+ * rows appended by a second run.
+ */
+class ColumnarWriterTestCase : public TestCase
+{
+public:
+  ColumnarWriterTestCase ();
+  virtual ~ColumnarWriterTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+ColumnarWriterTestCase::ColumnarWriterTestCase ()
+  : TestCase ("Check the file format of ColumnarWriter")
+{
+}
+
+ColumnarWriterTestCase::~ColumnarWriterTestCase ()
+{
+}
+
+void
+ColumnarWriterTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("columnar-writer.bin");
+
+  ColumnarWriter writer;
+  uint32_t sf = writer.AddColumn ("sf", ColumnarWriter::UINT32);
+  uint32_t rssi = writer.AddColumn ("rssi", ColumnarWriter::DOUBLE);
+  writer.SetRowsPerChunk (2);
+  NS_TEST_ASSERT_MSG_EQ (writer.Open (filename), true, "Could not open " << filename);
+  for (uint32_t row = 0; row < 3; row++)
+    {
+      writer.WriteU32 (sf, 7 + row);
+      writer.WriteDouble (rssi, -100.5 - row);
+      writer.EndRow ();
+    }
+  writer.Close ();
+  NS_TEST_ASSERT_MSG_EQ (writer.GetNRows (), 3, "Wrong number of rows");
+
+  std::string data = ReadFile (filename);
+  size_t offset = 0;
+  NS_TEST_ASSERT_MSG_EQ (data.compare (0, 8, "NS3COLMN"), 0, "Wrong magic");
+  offset += 8;
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 1, "Wrong version");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 0x01020304, "Wrong byte order mark");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 2, "Wrong number of columns");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), ColumnarWriter::UINT32, "Wrong type of sf");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 2, "Wrong length of sf");
+  NS_TEST_ASSERT_MSG_EQ (data.compare (offset, 2, "sf"), 0, "Wrong name of sf");
+  offset += 2;
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), ColumnarWriter::DOUBLE, "Wrong type of rssi");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 4, "Wrong length of rssi");
+  NS_TEST_ASSERT_MSG_EQ (data.compare (offset, 4, "rssi"), 0, "Wrong name of rssi");
+  offset += 4;
+  size_t headerSize = offset;
+
+  // a full chunk of two rows, then the last row, written on Close
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 2, "Wrong rows in the first chunk");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 7, "Wrong sf of row 0");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 8, "Wrong sf of row 1");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<double> (data, offset), -100.5, "Wrong rssi of row 0");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<double> (data, offset), -101.5, "Wrong rssi of row 1");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 1, "Wrong rows in the second chunk");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (data, offset), 9, "Wrong sf of row 2");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<double> (data, offset), -102.5, "Wrong rssi of row 2");
+  NS_TEST_ASSERT_MSG_EQ (offset, data.size (), "Wrong size of the file");
+
+  // a second run adds a chunk after the ones of the file, without a header
+  NS_TEST_ASSERT_MSG_EQ (writer.Append (filename), true, "Could not append to " << filename);
+  writer.WriteU32 (sf, 12);
+  writer.WriteDouble (rssi, -130.0);
+  writer.EndRow ();
+  writer.Close ();
+  std::string appended = ReadFile (filename);
+  NS_TEST_ASSERT_MSG_EQ (appended.compare (0, data.size (), data), 0, "Append changed the rows of the file");
+  offset = data.size ();
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (appended, offset), 1, "Wrong rows in the appended chunk");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<uint32_t> (appended, offset), 12, "Wrong appended sf");
+  NS_TEST_ASSERT_MSG_EQ (ReadValue<double> (appended, offset), -130.0, "Wrong appended rssi");
+  NS_TEST_ASSERT_MSG_EQ (offset, appended.size (), "Wrong size of the appended file");
+
+  // rows of other columns are not appended
+  ColumnarWriter other;
+  other.AddColumn ("sf", ColumnarWriter::UINT64);
+  other.AddColumn ("rssi", ColumnarWriter::DOUBLE);
+  NS_TEST_ASSERT_MSG_EQ (other.Append (filename), false, "Rows of other columns appended");
+  NS_TEST_ASSERT_MSG_EQ (ReadFile (filename).size (), appended.size (), "A rejected append changed the file");
+  NS_TEST_ASSERT_MSG_GT (appended.size (), headerSize, "No chunk after the header");
+}
+
+/**
+ * \ingroup lorawan
+ * AsyncRecordWriter writes every record, in order, through a ring that
+ * wraps many times, and drops the records of a closed file.
+ */
+class AsyncRecordWriterTestCase : public TestCase
+{
+public:
+  AsyncRecordWriterTestCase ();
+  virtual ~AsyncRecordWriterTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+AsyncRecordWriterTestCase::AsyncRecordWriterTestCase ()
+  : TestCase ("Check the records written by AsyncRecordWriter")
+{
+}
+
+AsyncRecordWriterTestCase::~AsyncRecordWriterTestCase ()
+{
+}
+
+void
+AsyncRecordWriterTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("async-record-writer.txt");
+  AsyncRecordWriter::Formatter formatter = [] (std::ostream &os, const void *record) {
+    const TestRecord *r = static_cast<const TestRecord *> (record);
+    os << r->index << " " << r->value << "\n";
+  };
+
+  AsyncRecordWriter writer;
+  TestRecord record = {0, 0.0};
+  writer.Write (&record);
+  NS_TEST_ASSERT_MSG_EQ (writer.GetNDropped (), 1, "A record written before Open was not dropped");
+  NS_TEST_ASSERT_MSG_EQ (writer.IsOpen (), false, "The writer is open before Open");
+
+  // a ring of 8 records, wrapped many times
+  const uint32_t nRecords = 10000;
+  writer.SetCapacity (5);
+  NS_TEST_ASSERT_MSG_EQ (writer.Open (filename, sizeof (TestRecord), formatter, false), true,
+                         "Could not open " << filename);
+  NS_TEST_ASSERT_MSG_EQ (writer.GetNDropped (), 0, "Open did not reset the dropped records");
+  for (uint32_t i = 0; i < nRecords; i++)
+    {
+      record.index = i;
+      record.value = i * 0.5;
+      writer.Write (&record);
+    }
+  writer.Close ();
+  NS_TEST_ASSERT_MSG_EQ (writer.GetNRecords (), nRecords, "Wrong number of records");
+  NS_TEST_ASSERT_MSG_EQ (writer.IsOpen (), false, "The writer is open after Close");
+
+  writer.Write (&record);
+  NS_TEST_ASSERT_MSG_EQ (writer.GetNDropped (), 1, "A record written after Close was not dropped");
+
+  std::istringstream lines (ReadFile (filename));
+  uint32_t index = 0;
+  double value = 0;
+  uint32_t nLines = 0;
+  while (lines >> index >> value)
+    {
+      NS_TEST_ASSERT_MSG_EQ (index, nLines, "Record out of order");
+      NS_TEST_ASSERT_MSG_EQ (value, nLines * 0.5, "Wrong value of record " << nLines);
+      nLines++;
+    }
+  NS_TEST_ASSERT_MSG_EQ (nLines, nRecords, "Wrong number of lines");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup lorawan
+ * The time on air of the table is the one of LoraPhy::GetOnAirTime, for
+ * every packet of the table.
+ */
+class LoraTimeOnAirTestCase : public TestCase
+{
+public:
+  LoraTimeOnAirTestCase ();
+  virtual ~LoraTimeOnAirTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+LoraTimeOnAirTestCase::LoraTimeOnAirTestCase ()
+  : TestCase ("Check the time on air table against LoraPhy::GetOnAirTime")
+{
+}
+
+LoraTimeOnAirTestCase::~LoraTimeOnAirTestCase ()
+{
+}
+
+void
+LoraTimeOnAirTestCase::DoRun (void)
+{
+  const double bandwidths[] = {125000, 250000, 500000};
+  for (uint8_t sf = LoraTimeOnAir::MIN_SF; sf <= LoraTimeOnAir::MAX_SF; sf++)
+    {
+      for (double bandwidthHz : bandwidths)
+        {
+          for (uint8_t codingRate = 1; codingRate <= LoraTimeOnAir::N_CODING_RATES; codingRate++)
+            {
+              // as the end device MACs set them
+              LoraTxParameters params;
+              params.sf = sf;
+              params.headerDisabled = false;
+              params.codingRate = codingRate;
+              params.bandwidthHz = bandwidthHz;
+              params.nPreamble = 8;
+              params.crcEnabled = true;
+              params.lowDataRateOptimizationEnabled = LoraPhy::GetTSym (params) > MilliSeconds (16);
+              for (uint32_t size = 0; size <= LoraTimeOnAir::MAX_SIZE; size++)
+                {
+                  double formula = LoraPhy::GetOnAirTime (Create<Packet> (size), params).GetSeconds ();
+                  NS_TEST_ASSERT_MSG_EQ_TOL (LoraTimeOnAir::GetSeconds (sf, bandwidthHz, codingRate, size),
+                                             formula, 1e-9,
+                                             "SF" << unsigned (sf) << ", " << bandwidthHz << " Hz, 4/"
+                                                  << codingRate + 4 << ", " << size << " bytes");
+                }
+            }
+        }
+    }
+
+  // SF7, 125 kHz, 4/5, 20 bytes: 8 + 4.25 + 43 symbols of 1.024 ms
+  NS_TEST_ASSERT_MSG_EQ_TOL (LoraTimeOnAir::GetSeconds (7, 125000, 1, 20), 0.056576, 1e-9,
+                             "Wrong time on air of a 20 byte packet at SF7");
+  // 1% duty cycle: silent 99 times the time on air
+  NS_TEST_ASSERT_MSG_EQ_TOL (LoraTimeOnAir::GetOffTime (Seconds (1), 0.01).GetSeconds (), 99.0, 1e-9,
+                             "Wrong time off air");
+  NS_TEST_ASSERT_MSG_EQ (LoraTimeOnAir::GetOffTime (Seconds (1), 1).GetSeconds (), 0.0,
+                         "Time off air without a duty cycle limit");
+}
+
+/**
+ * \ingroup lorawan
+ * The regions read by RegionalParameters::Parse, the lines it rejects, and
+ * the US915-SB2 region of regional-parameters.txt.
+ */
+class RegionalParametersTestCase : public TestCase
+{
+public:
+  RegionalParametersTestCase ();
+  virtual ~RegionalParametersTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+RegionalParametersTestCase::RegionalParametersTestCase ()
+  : TestCase ("Check the regions read by RegionalParameters")
+{
+}
+
+RegionalParametersTestCase::~RegionalParametersTestCase ()
+{
+}
+
+void
+RegionalParametersTestCase::DoRun (void)
+{
+  std::vector<Ptr<RegionalParameters>> regions;
+  NS_TEST_ASSERT_MSG_EQ (ParseRegions (TEST_REGION, regions), true, "The test region was rejected");
+  NS_TEST_ASSERT_MSG_EQ (regions.size (), 1, "Wrong number of regions");
+  Ptr<RegionalParameters> region = regions[0];
+  NS_TEST_ASSERT_MSG_EQ (region->GetName (), "TEST", "Wrong name");
+  NS_TEST_ASSERT_MSG_EQ (region->GetSubBands ().size (), 1, "Wrong number of sub bands");
+  NS_TEST_ASSERT_MSG_EQ (region->GetSubBands ()[0].dutyCycle, 0.01, "Wrong duty cycle");
+  NS_TEST_ASSERT_MSG_EQ (region->GetChannels ().size (), 1, "Wrong number of channels");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (region->GetChannels ()[0].maxDataRate), 2, "Wrong max data rate");
+  NS_TEST_ASSERT_MSG_EQ (region->GetTxDbmForTxPower ().size (), 2, "Wrong number of powers");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (region->GetReplyDataRateMatrix ()[2][1]), 1, "Wrong RX1 data rate");
+  // the gateways use the channels of the end devices
+  NS_TEST_ASSERT_MSG_EQ (region->GetGatewayFrequencies ().size (), 1, "Wrong gateway frequencies");
+  NS_TEST_ASSERT_MSG_EQ (region->GetGatewayFrequencies ()[0], 868.1, "Wrong gateway frequency");
+
+  // a data rate LoRa does not use (as DR7, FSK, of EU868) has SF 0
+  NS_TEST_ASSERT_MSG_EQ (region->GetSfForDataRate ().size (), 3, "Wrong number of data rates");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (region->GetSfForDataRate ()[2]), 0, "Wrong SF of a data rate without LoRa");
+  NS_TEST_ASSERT_MSG_EQ (region->GetBandwidthForDataRate ()[2], 0.0, "Wrong bandwidth of a data rate without LoRa");
+  NS_TEST_ASSERT_MSG_EQ (region->GetMaxAppPayloadForDataRate ()[2], 230, "Wrong payload of a data rate without LoRa");
+  Ptr<RegionalParameters> eu868 = RegionalParameters::Get ("EU868");
+  NS_TEST_ASSERT_MSG_NE (eu868, 0, "No EU868 region");
+  NS_TEST_ASSERT_MSG_EQ (eu868->GetSfForDataRate ().size (), 8, "Wrong number of EU868 data rates");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (eu868->GetSfForDataRate ()[7]), 0, "Wrong SF of the EU868 DR7");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (eu868->GetSfForDataRate ()[6]), 7, "Wrong SF of the EU868 DR6");
+  NS_TEST_ASSERT_MSG_EQ (eu868->GetBandwidthForDataRate ()[6], 250000, "Wrong bandwidth of the EU868 DR6");
+
+  // lines the parser rejects: none of the regions of the text is kept
+  const char *malformed[] = {
+    "sub_band 868 868.6 0.01\n",        // a missing field
+    "preamble 8 12\n",                  // an extra field
+    "reception_paths eight\n",          // not a number
+    "channel 868.3 0 2 2\n",            // a count without its step
+    "bandwidth 125000\n",               // an unknown directive
+    "data_rate 4 8 125000 230\n",       // DR4 after DR2
+    "rx1_data_rate 8 7 6 5 4 3 2\n",    // a data rate with no RX1 row
+    "channel 868.3 0 3\n",              // a data rate the region does not define
+  };
+  for (const char *line : malformed)
+    {
+      regions.clear ();
+      NS_TEST_ASSERT_MSG_EQ (ParseRegions (std::string (TEST_REGION) + line, regions), false,
+                             "Line accepted: " << line);
+      NS_TEST_ASSERT_MSG_EQ (regions.size (), 0, "Regions kept after the line: " << line);
+    }
+  regions.clear ();
+  NS_TEST_ASSERT_MSG_EQ (ParseRegions (std::string ("preamble 8\n") + TEST_REGION, regions), false,
+                         "A directive before the first region was accepted");
+  NS_TEST_ASSERT_MSG_EQ (ParseRegions ("region EMPTY\n", regions), false,
+                         "A region without channels was accepted");
+  // comments and blank lines are skipped
+  NS_TEST_ASSERT_MSG_EQ (ParseRegions (std::string ("# regions\n\n") + TEST_REGION + "   # end\n", regions),
+                         true, "Comments were rejected");
+
+  std::string filename = std::string (NS_TEST_SOURCEDIR) + "/regional-parameters.txt";
+  NS_TEST_ASSERT_MSG_EQ (RegionalParameters::Load (filename), true, "Could not load " << filename);
+  Ptr<RegionalParameters> us915 = RegionalParameters::Get ("US915-SB2");
+  NS_TEST_ASSERT_MSG_NE (us915, 0, "No US915-SB2 region in " << filename);
+  // channels 8-15, 903.9 to 905.3 MHz, and channel 65
+  const std::vector<RegionalParameters::Channel> &channels = us915->GetChannels ();
+  NS_TEST_ASSERT_MSG_EQ (channels.size (), 9, "Wrong number of US915-SB2 channels");
+  for (uint32_t i = 0; i < 8; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ_TOL (channels[i].frequency, 903.9 + 0.2 * i, 1e-9, "Wrong frequency of channel " << i + 8);
+      NS_TEST_ASSERT_MSG_EQ (unsigned (channels[i].maxDataRate), 3, "Wrong max data rate of channel " << i + 8);
+    }
+  NS_TEST_ASSERT_MSG_EQ (channels[8].frequency, 904.6, "Wrong frequency of channel 65");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (channels[8].minDataRate), 4, "Wrong data rate of channel 65");
+  NS_TEST_ASSERT_MSG_EQ (us915->GetGatewayFrequencies ().size (), 9, "Wrong US915-SB2 gateway frequencies");
+  NS_TEST_ASSERT_MSG_EQ (us915->GetSfForDataRate ().size (), 14, "Wrong number of US915-SB2 data rates");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (us915->GetSfForDataRate ()[0]), 10, "Wrong SF of the US915-SB2 DR0");
+  NS_TEST_ASSERT_MSG_EQ (us915->GetBandwidthForDataRate ()[4], 500000, "Wrong bandwidth of the US915-SB2 DR4");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (us915->GetSfForDataRate ()[7]), 0, "Wrong SF of the US915-SB2 DR7");
+  NS_TEST_ASSERT_MSG_EQ (us915->GetTxDbmForTxPower ().size (), 15, "Wrong number of US915-SB2 powers");
+  NS_TEST_ASSERT_MSG_EQ (us915->GetTxDbmForTxPower ()[0], 30, "Wrong US915-SB2 TxPower 0");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (us915->GetReplyDataRateMatrix ()[4][0]), 13, "Wrong US915-SB2 RX1 data rate");
+  NS_TEST_ASSERT_MSG_EQ (unsigned (us915->GetSecondReceiveWindowDataRate ()), 8, "Wrong US915-SB2 RX2 data rate");
+  NS_TEST_ASSERT_MSG_EQ (us915->GetSecondReceiveWindowFrequency (), 923.3, "Wrong US915-SB2 RX2 frequency");
+}
+
+/**
+ * \ingroup lorawan
+ * The spreading factor plans of LorawanMacHelper: version 2 files, with
+ * and without channels, version 1 files, and truncated files.
+ */
+class SpreadingFactorPlanTestCase : public TestCase
+{
+public:
+  SpreadingFactorPlanTestCase ();
+  virtual ~SpreadingFactorPlanTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+SpreadingFactorPlanTestCase::SpreadingFactorPlanTestCase ()
+  : TestCase ("Check the spreading factor plan files")
+{
+}
+
+SpreadingFactorPlanTestCase::~SpreadingFactorPlanTestCase ()
+{
+}
+
+void
+SpreadingFactorPlanTestCase::DoRun (void)
+{
+  std::string filename = CreateTempDirFilename ("sf-plan.bin");
+  std::vector<uint8_t> dataRates = {5, 4, 0, 3, 5};
+  std::vector<uint8_t> channels = {0, 1, 2, 0, 1};
+  std::vector<uint8_t> loadedDataRates;
+  std::vector<uint8_t> loadedChannels (1, 7);
+
+  // version 2, without channels
+  NS_TEST_ASSERT_MSG_EQ (LorawanMacHelper::SaveSpreadingFactors (filename, dataRates, std::vector<uint8_t> ()),
+                         true, "Could not save " << filename);
+  NS_TEST_ASSERT_MSG_EQ (LorawanMacHelper::LoadSpreadingFactors (filename, loadedDataRates, loadedChannels),
+                         true, "Could not load " << filename);
+  NS_TEST_ASSERT_MSG_EQ ((loadedDataRates == dataRates), true, "Wrong data rates");
+  NS_TEST_ASSERT_MSG_EQ (loadedChannels.size (), 0, "Channels in a plan without channels");
+
+  // version 2, with channels
+  NS_TEST_ASSERT_MSG_EQ (LorawanMacHelper::SaveSpreadingFactors (filename, dataRates, channels), true,
+                         "Could not save " << filename);
+  std::string data = ReadFile (filename);
+  NS_TEST_ASSERT_MSG_EQ (data.size (), 8 + 4 + 4 + 5 + 4 + 5, "Wrong size of the plan");
+  NS_TEST_ASSERT_MSG_EQ (LorawanMacHelper::LoadSpreadingFactors (filename, loadedDataRates, loadedChannels),
+                         true, "Could not load " << filename);
+  NS_TEST_ASSERT_MSG_EQ ((loadedDataRates == dataRates), true, "Wrong data rates of a plan with channels");
+  NS_TEST_ASSERT_MSG_EQ ((loadedChannels == channels), true, "Wrong channels");
+
+  // the plans of version 1 have the data rates only
+  {
+    std::ofstream file (filename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+    uint32_t version = 1;
+    uint32_t nEndDevices = dataRates.size ();
+    file.write ("LORASFPL", 8);
+    file.write (reinterpret_cast<const char *> (&version), sizeof (version));
+    file.write (reinterpret_cast<const char *> (&nEndDevices), sizeof (nEndDevices));
+    file.write (reinterpret_cast<const char *> (dataRates.data ()), dataRates.size ());
+  }
+  loadedDataRates.clear ();
+  loadedChannels.assign (1, 7);
+  NS_TEST_ASSERT_MSG_EQ (LorawanMacHelper::LoadSpreadingFactors (filename, loadedDataRates, loadedChannels),
+                         true, "Could not load a plan of version 1");
+  NS_TEST_ASSERT_MSG_EQ ((loadedDataRates == dataRates), true, "Wrong data rates of a plan of version 1");
+  NS_TEST_ASSERT_MSG_EQ (loadedChannels.size (), 0, "Channels in a plan of version 1");
+
+  // every truncation of the plan with channels is rejected, and leaves
+  // the vectors as they are
+  for (size_t size = 0; size < data.size (); size++)
+    {
+      {
+        std::ofstream file (filename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write (data.data (), size);
+      }
+      loadedDataRates.assign (1, 9);
+      loadedChannels.assign (1, 9);
+      NS_TEST_ASSERT_MSG_EQ (LorawanMacHelper::LoadSpreadingFactors (filename, loadedDataRates, loadedChannels),
+                             false, "A plan truncated to " << size << " bytes was loaded");
+      NS_TEST_ASSERT_MSG_EQ (loadedDataRates.size (), 1, "A truncated plan changed the data rates");
+      NS_TEST_ASSERT_MSG_EQ (loadedChannels.size (), 1, "A truncated plan changed the channels");
+    }
+
+  // a newer version is not read
+  std::string newer = data;
+  uint32_t newerVersion = 3;
+  newer.replace (8, sizeof (newerVersion), reinterpret_cast<const char *> (&newerVersion), sizeof (newerVersion));
+  {
+    std::ofstream file (filename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+    file.write (newer.data (), newer.size ());
+  }
+  NS_TEST_ASSERT_MSG_EQ (LorawanMacHelper::LoadSpreadingFactors (filename, loadedDataRates, loadedChannels),
+                         false, "A plan of version 3 was loaded");
+}
+
+/**
+ * \ingroup lorawan
+ * PacketStateTable keeps finding the packets in flight while Retire drops
+ * the old ones, before and after it compacts the table.
+ */
+class PacketStateTableTestCase : public TestCase
+{
+public:
+  PacketStateTableTestCase ();
+  virtual ~PacketStateTableTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+PacketStateTableTestCase::PacketStateTableTestCase ()
+  : TestCase ("Check the packets kept by PacketStateTable")
+{
+}
+
+PacketStateTableTestCase::~PacketStateTableTestCase ()
+{
+}
+
+void
+PacketStateTableTestCase::DoRun (void)
+{
+  // packet 100 + i is sent at i s by node i % 3, more than the 16 first slots hold
+  PacketStateTable table;
+  const uint32_t nPackets = 40;
+  for (uint32_t i = 0; i < nPackets; i++)
+    {
+      table.Send (100 + i, i % 3, 7 + i % 6, Seconds (i));
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), nPackets, "Wrong number of packets");
+  // a UID already in the table is left as it is
+  table.Send (101, 9, 12, Seconds (100));
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), nPackets, "A UID was added twice");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (101)->sender, 1, "A UID sent again changed its packet");
+  NS_TEST_ASSERT_MSG_EQ (table.Receive (101, Seconds (2))->duplicates, 0, "Wrong first reception");
+  NS_TEST_ASSERT_MSG_EQ (table.Receive (101, Seconds (3))->duplicates, 1, "Wrong duplicate reception");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (101)->firstReceived, Seconds (2), "Wrong first reception time");
+
+  // fewer retired packets than live ones: they stay in place, but are not found
+  NS_TEST_ASSERT_MSG_EQ (table.Retire (Seconds (15)), 15, "Wrong number of retired packets");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), nPackets - 15, "Wrong number of packets after Retire");
+  NS_TEST_ASSERT_MSG_EQ (table.Begin ()->uid, 115, "Wrong oldest packet after Retire");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (101), 0, "A retired packet was found");
+  NS_TEST_ASSERT_MSG_EQ (table.Receive (114, Seconds (20)), 0, "A retired packet was received");
+  NS_TEST_ASSERT_MSG_EQ (table.Retire (Seconds (15)), 0, "Packets retired twice");
+
+  // as many retired packets as live ones: the table is compacted
+  NS_TEST_ASSERT_MSG_EQ (table.Retire (Seconds (25)), 10, "Wrong number of retired packets");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), nPackets - 25, "Wrong number of packets after the compaction");
+  NS_TEST_ASSERT_MSG_EQ (static_cast<uint32_t> (std::distance (table.Begin (), table.End ())), nPackets - 25,
+                         "Wrong packets iterated after the compaction");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (124), 0, "A packet dropped by the compaction was found");
+  uint32_t i = 25;
+  for (PacketStateTable::Iterator it = table.Begin (); it != table.End (); ++it, i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (it->uid, 100 + i, "Packet out of order after the compaction");
+      const PacketStateTable::Entry *entry = table.Find (100 + i);
+      NS_TEST_ASSERT_MSG_NE (entry, 0, "Packet " << 100 + i << " lost by the compaction");
+      NS_TEST_ASSERT_MSG_EQ (entry->sender, i % 3, "Wrong sender of packet " << 100 + i);
+      NS_TEST_ASSERT_MSG_EQ (unsigned (entry->sf), 7 + i % 6, "Wrong SF of packet " << 100 + i);
+      NS_TEST_ASSERT_MSG_EQ (entry->sent, Seconds (i), "Wrong send time of packet " << 100 + i);
+    }
+  NS_TEST_ASSERT_MSG_EQ (table.Receive (130, Seconds (31))->received, true,
+                         "A packet was not received after the compaction");
+
+  // the compacted table takes new packets
+  table.Send (200, 5, 9, Seconds (50));
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), nPackets - 24, "A new packet was not added");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (200)->sender, 5, "Wrong new packet");
+
+  NS_TEST_ASSERT_MSG_EQ (table.Retire (Seconds (100)), nPackets - 24, "Not every packet was retired");
+  NS_TEST_ASSERT_MSG_EQ (table.GetSize (), 0, "Packets left after retiring every one");
+  NS_TEST_ASSERT_MSG_EQ ((table.Begin () == table.End ()), true, "Packets iterated in an empty table");
+  NS_TEST_ASSERT_MSG_EQ (table.Find (200), 0, "A packet was found in an empty table");
+}
+
+/**
+ * \ingroup lorawan
+ * The test suite of the scenario utilities of lorawan-module-classes
+ */
+class LorawanUtilsTestSuite : public TestSuite
+{
+public:
+  LorawanUtilsTestSuite ();
+};
+
+LorawanUtilsTestSuite::LorawanUtilsTestSuite ()
+  : TestSuite ("lorawan-utils", UNIT)
+{
+  AddTestCase (new ColumnarWriterTestCase, TestCase::QUICK);
+  AddTestCase (new AsyncRecordWriterTestCase, TestCase::QUICK);
+  AddTestCase (new LoraTimeOnAirTestCase, TestCase::QUICK);
+  AddTestCase (new RegionalParametersTestCase, TestCase::QUICK);
+  AddTestCase (new SpreadingFactorPlanTestCase, TestCase::QUICK);
+  AddTestCase (new PacketStateTableTestCase, TestCase::QUICK);
+}
+
+static LorawanUtilsTestSuite lorawanUtilsTestSuite;
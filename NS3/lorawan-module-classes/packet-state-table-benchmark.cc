@@ -0,0 +1,188 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Replays the send/receive traces of a LoRaWAN scenario against the
+ * per-packet bookkeeping of the drivers.
+ *
+ * "table" is PacketStateTable. "scan" is what wfiot_simulation did
+ * before it: three std::map keyed by UID (SF, send time, delay) and a
+ * vector scanned from the start on every gateway reception. The scan is
+ * quadratic, so it is run on the first --scan packets only and its time
+ * for all the packets is extrapolated.
+ *
+ * ./waf --run "packet-state-table-benchmark --packets=1000000"
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/packet-state-table.h"
+
+using namespace ns3;
+using namespace lorawan;
+
+namespace {
+
+// a trace event: the send of a packet, or its receptions
+struct Event
+{
+  uint64_t uid;
+  uint8_t sf;
+  bool send;
+  uint8_t nGateways; // receptions (0 if the packet was lost)
+  Time time;
+};
+
+struct PacketIdControl
+{
+  uint64_t id;
+  int repeat;
+};
+
+// receptions of the packets: 0 (lost) to 3 gateways
+std::vector<Event>
+MakeTrace (uint32_t nPackets, uint32_t seed)
+{
+  std::mt19937 rng (seed);
+  std::uniform_int_distribution<int> sf (0, 5);
+  std::discrete_distribution<int> nGateways ({10, 50, 30, 10});
+
+  std::vector<Event> trace;
+  trace.reserve (nPackets * 2);
+  for (uint32_t i = 0; i < nPackets; i++)
+    {
+      Event send;
+      send.uid = 1000 + i;
+      send.sf = sf (rng);
+      send.send = true;
+      send.nGateways = 0;
+      send.time = NanoSeconds (i * 1000000LL);
+      trace.push_back (send);
+
+      Event receive = send;
+      receive.send = false;
+      receive.nGateways = nGateways (rng);
+      receive.time = NanoSeconds (i * 1000000LL + 50000000LL);
+      trace.push_back (receive);
+    }
+  return trace;
+}
+
+} // anonymous namespace
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nPackets = 1000000;
+  uint32_t nScan = 20000;
+  uint32_t seed = 1;
+
+  CommandLine cmd;
+  cmd.AddValue ("packets", "Number of packets sent", nPackets);
+  cmd.AddValue ("scan", "Number of packets replayed with the vector scan", nScan);
+  cmd.AddValue ("seed", "Seed of the trace", seed);
+  cmd.Parse (argc, argv);
+
+  nScan = std::min (nScan, nPackets);
+  std::vector<Event> trace = MakeTrace (nPackets, seed);
+
+  // table
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  PacketStateTable table;
+  uint64_t received = 0;
+  uint64_t duplicates = 0;
+  for (std::vector<Event>::const_iterator it = trace.begin (); it != trace.end (); ++it)
+    {
+      if (it->send)
+        {
+          table.Send (it->uid, 0, it->sf, it->time);
+          continue;
+        }
+      for (uint8_t g = 0; g < it->nGateways; g++)
+        {
+          const PacketStateTable::Entry *entry = table.Receive (it->uid, it->time);
+          if (entry->duplicates == 0)
+            {
+              received++;
+            }
+          else
+            {
+              duplicates++;
+            }
+        }
+    }
+  Time delay (0);
+  for (PacketStateTable::Iterator it = table.Begin (); it != table.End (); ++it)
+    {
+      if (it->received)
+        {
+          delay += it->firstReceived - it->sent;
+        }
+    }
+  double tableTime = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+  // maps and vector scan, on the first nScan packets
+  start = std::chrono::steady_clock::now ();
+  std::map<uint64_t, int> pacote_sf;
+  std::map<uint64_t, Time> pacote_ds;
+  std::map<uint64_t, Time> pacote_dr;
+  std::vector<PacketIdControl> packet_controll;
+  uint64_t scanReceived = 0;
+  for (std::vector<Event>::const_iterator it = trace.begin (); it != trace.begin () + 2 * nScan; ++it)
+    {
+      if (it->send)
+        {
+          pacote_sf.insert (std::make_pair (it->uid, it->sf));
+          pacote_ds.insert (std::make_pair (it->uid, it->time));
+          packet_controll.push_back ({it->uid, 0});
+          continue;
+        }
+      for (uint8_t g = 0; g < it->nGateways; g++)
+        {
+          for (std::vector<PacketIdControl>::iterator pckt = packet_controll.begin (); pckt != packet_controll.end (); ++pckt)
+            {
+              if ((pckt->id == it->uid) && pckt->repeat == 0)
+                {
+                  pacote_dr.insert (std::make_pair (it->uid, it->time - pacote_ds.at (it->uid)));
+                  scanReceived++;
+                  pckt->repeat = 1;
+                }
+            }
+        }
+    }
+  double scanTime = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+  double scale = (double) nPackets / nScan;
+
+  std::cout << nPackets << " packets sent, " << received << " received, "
+            << duplicates << " duplicates (mean delay "
+            << (received ? delay.GetSeconds () / received : 0.0) << " s)." << std::endl;
+  std::cout << std::fixed << std::setprecision (3);
+  std::cout << std::setw (8) << "table" << std::setw (12) << tableTime << " s"
+            << std::setw (12) << tableTime * 1e9 / nPackets << " ns/packet" << std::endl;
+  std::cout << std::setw (8) << "scan" << std::setw (12) << scanTime << " s"
+            << std::setw (12) << scanTime * 1e9 / nScan << " ns/packet ("
+            << nScan << " packets, " << scanReceived << " received; ~"
+            << scanTime * scale * scale << " s for " << nPackets << ")" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,200 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+
+#include "ns3/log.h"
+
+#include "ns3/packet-state-table.h"
+
+namespace ns3 {
+namespace lorawan {
+
+NS_LOG_COMPONENT_DEFINE ("PacketStateTable");
+
+namespace {
+
+// packet UIDs are consecutive: spread them over the slots
+inline uint64_t
+HashUid (uint64_t uid)
+{
+  uint64_t h = uid * 0x9e3779b97f4a7c15ULL;
+  return h ^ (h >> 32);
+}
+
+} // anonymous namespace
+
+PacketStateTable::PacketStateTable () :
+  m_first (0),
+  m_index (16, EMPTY),
+  m_mask (15)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+PacketStateTable::Reserve (uint32_t n)
+{
+  NS_LOG_FUNCTION (this << n);
+
+  m_entries.reserve (n);
+  if (2 * static_cast<uint64_t> (n) > m_index.size ())
+    {
+      Rehash (2 * n);
+    }
+}
+
+uint32_t
+PacketStateTable::Probe (uint64_t uid) const
+{
+  uint32_t slot = HashUid (uid) & m_mask;
+  while ((m_index[slot] != EMPTY) && (m_entries[m_index[slot]].uid != uid))
+    {
+      slot = (slot + 1) & m_mask;
+    }
+  return slot;
+}
+
+void
+PacketStateTable::Rehash (uint32_t nSlots)
+{
+  NS_LOG_FUNCTION (this << nSlots);
+
+  uint32_t size = 16;
+  while (size < nSlots)
+    {
+      size *= 2;
+    }
+  m_index.assign (size, EMPTY);
+  m_mask = size - 1;
+  for (uint32_t i = 0; i < m_entries.size (); i++)
+    {
+      m_index[Probe (m_entries[i].uid)] = i;
+    }
+}
+
+void
+PacketStateTable::Send (uint64_t uid, uint32_t sender, uint8_t sf, Time sent)
+{
+  // keep the index at most half full
+  if (2 * (static_cast<uint64_t> (m_entries.size ()) + 1) > m_index.size ())
+    {
+      Rehash (2 * m_index.size ());
+    }
+
+  uint32_t slot = Probe (uid);
+  if (m_index[slot] != EMPTY)
+    {
+      return;
+    }
+  m_index[slot] = m_entries.size ();
+
+  Entry entry;
+  entry.uid = uid;
+  entry.sender = sender;
+  entry.sent = sent;
+  entry.firstReceived = Time (0);
+  entry.duplicates = 0;
+  entry.sf = sf;
+  entry.received = false;
+  m_entries.push_back (entry);
+}
+
+const PacketStateTable::Entry *
+PacketStateTable::Receive (uint64_t uid, Time now)
+{
+  uint32_t slot = Probe (uid);
+  if ((m_index[slot] == EMPTY) || (m_index[slot] < m_first))
+    {
+      return 0;
+    }
+
+  Entry &entry = m_entries[m_index[slot]];
+  if (entry.received)
+    {
+      entry.duplicates++;
+    }
+  else
+    {
+      entry.received = true;
+      entry.firstReceived = now;
+    }
+  return &entry;
+}
+
+const PacketStateTable::Entry *
+PacketStateTable::Find (uint64_t uid) const
+{
+  uint32_t slot = Probe (uid);
+  if ((m_index[slot] == EMPTY) || (m_index[slot] < m_first))
+    {
+      return 0;
+    }
+  return &m_entries[m_index[slot]];
+}
+
+uint32_t
+PacketStateTable::Retire (Time sentBefore)
+{
+  uint32_t first = m_first;
+  while ((m_first < m_entries.size ()) && (m_entries[m_first].sent < sentBefore))
+    {
+      m_first++;
+    }
+  uint32_t retired = m_first - first;
+
+  // the retired entries stay in place (and in the index) until they are
+  // as many as the live ones, then they are dropped at once
+  if ((m_first > 0) && (2 * m_first >= m_entries.size ()))
+    {
+      m_entries.erase (m_entries.begin (), m_entries.begin () + m_first);
+      m_first = 0;
+      Rehash (m_index.size ());
+    }
+  return retired;
+}
+
+PacketStateTable::Iterator
+PacketStateTable::Begin (void) const
+{
+  return m_entries.begin () + m_first;
+}
+
+PacketStateTable::Iterator
+PacketStateTable::End (void) const
+{
+  return m_entries.end ();
+}
+
+uint32_t
+PacketStateTable::GetSize (void) const
+{
+  return m_entries.size () - m_first;
+}
+
+void
+PacketStateTable::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_entries.clear ();
+  m_first = 0;
+  std::fill (m_index.begin (), m_index.end (), EMPTY);
+}
+
+} // namespace lorawan
+} // namespace ns3
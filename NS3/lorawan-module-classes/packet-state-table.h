@@ -0,0 +1,152 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef PACKET_STATE_TABLE_H
+#define PACKET_STATE_TABLE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "ns3/nstime.h"
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * \ingroup lorawan
+ * \brief Per-packet bookkeeping of the scenario drivers, keyed by packet UID
+ *
+ * Holds, for every packet sent by an end device, its sender, spreading
+ * factor, send time, first reception time and number of duplicate receptions
+ * (the same packet received by several gateways). The entries are kept
+ * in a vector, in send order, and found through an open addressing
+ * index (linear probing, at most half full), so that a send or a
+ * reception costs O(1) whatever the number of packets.
+ *
+ * Packets whose receptions are over can be retired (Retire), oldest
+ * first, so that the memory stays bounded by the packets in flight.
+ */
+class PacketStateTable
+{
+public:
+  /**
+   * \brief State of a packet
+   */
+  struct Entry
+  {
+    uint64_t uid;        //!< the packet UID
+    uint32_t sender;     //!< node id of the end device
+    Time sent;           //!< send time
+    Time firstReceived;  //!< time of the first reception (if received)
+    uint32_t duplicates; //!< receptions after the first one
+    uint8_t sf;          //!< spreading factor (index used by the driver)
+    bool received;       //!< true once a gateway received the packet
+  };
+
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  PacketStateTable ();
+
+  /**
+   * \brief Makes room for n packets, so that no rehash happens before
+   * \param n the number of packets
+   * \return none
+   */
+  void Reserve (uint32_t n);
+
+  /**
+   * \brief Records a packet sent by an end device. A UID already in the
+   * table is left as it is.
+   * \param uid the packet UID
+   * \param sender the node id of the end device
+   * \param sf the spreading factor of the sender
+   * \param sent the send time
+   * \return none
+   */
+  void Send (uint64_t uid, uint32_t sender, uint8_t sf, Time sent);
+
+  /**
+   * \brief Records the reception of a packet by a gateway
+   * \param uid the packet UID
+   * \param now the reception time
+   * \return the entry of the packet (with received set and, for a
+   * duplicate, duplicates incremented), or 0 if it was never sent
+   */
+  const Entry *Receive (uint64_t uid, Time now);
+
+  /**
+   * \brief Finds a packet
+   * \param uid the packet UID
+   * \return the entry of the packet, or 0 if it was never sent
+   */
+  const Entry *Find (uint64_t uid) const;
+
+  /**
+   * \brief Drops the packets sent before the given time
+   * \param sentBefore the send time of the oldest packet to keep
+   * \return the number of packets dropped
+   */
+  uint32_t Retire (Time sentBefore);
+
+  /// iterator over the packets, in send order
+  typedef std::vector<Entry>::const_iterator Iterator;
+
+  /**
+   * \brief Gets an iterator to the oldest packet (not retired)
+   * \return the iterator
+   */
+  Iterator Begin (void) const;
+
+  /**
+   * \brief Gets an iterator past the newest packet
+   * \return the iterator
+   */
+  Iterator End (void) const;
+
+  /**
+   * \brief Gets the number of packets (not retired)
+   * \return the number of packets
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * \brief Drops every packet (the memory is kept for the next run)
+   * \return none
+   */
+  void Clear (void);
+
+private:
+  static constexpr uint32_t EMPTY = 0xffffffff;
+
+  // slot of uid in m_index, or of the empty slot where it belongs
+  uint32_t Probe (uint64_t uid) const;
+
+  // rebuilds m_index with (at least) the given number of slots
+  void Rehash (uint32_t nSlots);
+
+  std::vector<Entry> m_entries;  // the packets, in send order
+  uint32_t m_first;              // entries before m_first are retired
+  std::vector<uint32_t> m_index; // slot -> index in m_entries (or EMPTY)
+  uint32_t m_mask;               // m_index.size () - 1 (a power of 2)
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* PACKET_STATE_TABLE_H */
@@ -0,0 +1,576 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include "ns3/regional-parameters.h"
+#include "ns3/log.h"
+
+namespace ns3 {
+namespace lorawan {
+
+NS_LOG_COMPONENT_DEFINE ("RegionalParameters");
+
+NS_OBJECT_ENSURE_REGISTERED (RegionalParameters);
+
+namespace {
+
+// The regions LorawanMacHelper::SetRegion knows by enum. Values based on:
+// RP002-1.0.3 LoRaWAN® Regional Parameters 2021
+const char *BUILT_IN_REGIONS = R"REGIONS(
+region EU868
+sub_band 868 868.6 0.01 20       # Lahis 14->20
+sub_band 868.7 869.2 0.001 20    # Lahis 14->20
+sub_band 869.4 869.65 0.1 27
+channel 868.1 0 5 3 0.2
+reception_paths 8
+data_rate 0 12 125000 59
+data_rate 1 11 125000 59
+data_rate 2 10 125000 59
+data_rate 3 9 125000 123
+data_rate 4 8 125000 230
+data_rate 5 7 125000 230
+data_rate 6 7 250000 230
+data_rate 7 0 0 230              # FSK
+tx_power 16 14 12 10 8 6 4 2
+rx1_data_rate 0 0 0 0 0 0 0
+rx1_data_rate 1 1 0 0 0 0 0
+rx1_data_rate 2 2 1 0 0 0 0
+rx1_data_rate 3 3 2 1 0 0 0
+rx1_data_rate 4 4 3 2 1 0 0
+rx1_data_rate 5 5 4 3 2 1 0
+rx1_data_rate 6 6 5 4 3 2 1
+rx1_data_rate 7 7 6 5 4 3 2
+preamble 8
+rx2 0 869.525
+
+# EU868 gateways listening on a single channel
+region EU868-SingleChannel
+sub_band 868 868.6 0.01 20       # Lahis 14->20
+sub_band 868.7 869.2 0.001 20
+sub_band 869.4 869.65 0.1 27
+channel 868.1 0 5
+gateway_channel 868.1 0 5 3 0.2
+gateway_frequency 868.1
+reception_paths 8
+data_rate 0 12 125000 59
+data_rate 1 11 125000 59
+data_rate 2 10 125000 59
+data_rate 3 9 125000 123
+data_rate 4 8 125000 230
+data_rate 5 7 125000 230
+data_rate 6 7 250000 230
+data_rate 7 0 0 230
+tx_power 16 14 12 10 8 6 4 2
+rx1_data_rate 0 0 0 0 0 0 0
+rx1_data_rate 1 1 0 0 0 0 0
+rx1_data_rate 2 2 1 0 0 0 0
+rx1_data_rate 3 3 2 1 0 0 0
+rx1_data_rate 4 4 3 2 1 0 0
+rx1_data_rate 5 5 4 3 2 1 0
+rx1_data_rate 6 6 5 4 3 2 1
+rx1_data_rate 7 7 6 5 4 3 2
+preamble 8
+rx2 0 869.525
+
+# A single channel, no duty cycle, a single reception path
+region ALOHA
+sub_band 868 868.6 1 14
+channel 868.1 0 5
+reception_paths 1
+data_rate 0 12 125000 59
+data_rate 1 11 125000 59
+data_rate 2 10 125000 59
+data_rate 3 9 125000 123
+data_rate 4 8 125000 230
+data_rate 5 7 125000 230
+data_rate 6 7 250000 230
+data_rate 7 0 0 230
+tx_power 16 14 12 10 8 6 4 2
+rx1_data_rate 0 0 0 0 0 0 0
+rx1_data_rate 1 1 0 0 0 0 0
+rx1_data_rate 2 2 1 0 0 0 0
+rx1_data_rate 3 3 2 1 0 0 0
+rx1_data_rate 4 4 3 2 1 0 0
+rx1_data_rate 5 5 4 3 2 1 0
+rx1_data_rate 6 6 5 4 3 2 1
+rx1_data_rate 7 7 6 5 4 3 2
+preamble 8
+rx2 0 869.525
+
+region AU915
+sub_band 915 928 1 30
+channel 915.9 6 6 8 1.6          # 2.8.2 AU915-928 Band Channel Frequencies, channels 64-71
+reception_paths 8
+data_rate 0 12 125000 59         # Table 45: AU915-928 maximum payload size (repeater compatible)
+data_rate 1 11 125000 59
+data_rate 2 10 125000 59
+data_rate 3 9 125000 123
+data_rate 4 8 125000 230
+data_rate 5 7 125000 230
+data_rate 6 8 500000 230
+data_rate 7 0 0 58               # LR-FHSS
+data_rate 8 12 500000 61
+data_rate 9 11 500000 137
+data_rate 10 10 500000 230
+data_rate 11 9 500000 230
+data_rate 12 8 500000 230
+data_rate 13 7 500000 230
+tx_power 30 28 26 24 22 20 18 16 14 12 10 8 6 4 2   # Table 43: AU915-928 TX power table
+rx1_data_rate 0 8 8 8 8 8 8      # Table 47: AU915-928 downlink RX1 data rate mapping
+rx1_data_rate 1 9 8 8 8 8 8
+rx1_data_rate 2 10 9 8 8 8 8
+rx1_data_rate 3 11 10 9 8 8 8
+rx1_data_rate 4 12 11 10 9 8 8
+rx1_data_rate 5 13 12 11 10 9 8
+rx1_data_rate 6 13 13 12 11 10 9
+rx1_data_rate 7 9 8 8 8 8 8
+preamble 8                       # 4.1.2 LoRa settings
+rx2 8 923.3                      # 2.8.7 AU915-928 Receive windows
+)REGIONS";
+
+typedef std::map<std::string, Ptr<RegionalParameters>> Registry;
+
+// The regions, by name: the built in ones, then the loaded ones
+Registry &
+GetRegistry (void)
+{
+  static Registry registry;
+  if (registry.empty ())
+    {
+      std::istringstream is (BUILT_IN_REGIONS);
+      std::vector<Ptr<RegionalParameters>> regions;
+      if (!RegionalParameters::Parse (is, "built-in regions", regions))
+        {
+          NS_FATAL_ERROR ("Errors in the built-in regions");
+        }
+      for (std::vector<Ptr<RegionalParameters>>::iterator it = regions.begin ();
+           it != regions.end (); ++it)
+        {
+          registry[(*it)->GetName ()] = *it;
+        }
+    }
+  return registry;
+}
+
+// Frequencies are given in MHz, rounded to the kHz
+double
+GetChannelFrequency (double first, uint32_t index, double step)
+{
+  return std::round ((first + index * step) * 1000) / 1000;
+}
+
+} // anonymous namespace
+
+TypeId
+RegionalParameters::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::RegionalParameters")
+    .SetParent<Object> ()
+    .SetGroupName ("lorawan")
+    .AddConstructor<RegionalParameters> ();
+  return tid;
+}
+
+RegionalParameters::RegionalParameters ()
+  : m_receptionPaths (8),
+    m_replyDataRateMatrix (),
+    m_nPreambleSymbols (8),
+    m_rx2DataRate (0),
+    m_rx2Frequency (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+RegionalParameters::~RegionalParameters ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+Ptr<RegionalParameters>
+RegionalParameters::Get (const std::string &name)
+{
+  Registry &registry = GetRegistry ();
+  Registry::const_iterator it = registry.find (name);
+  return (it != registry.end ()) ? it->second : 0;
+}
+
+bool
+RegionalParameters::Load (const std::string &filename)
+{
+  NS_LOG_FUNCTION (filename);
+
+  std::ifstream file (filename.c_str ());
+  if (!file.is_open ())
+    {
+      NS_LOG_ERROR ("Could not open " << filename);
+      return false;
+    }
+  std::vector<Ptr<RegionalParameters>> regions;
+  if (!Parse (file, filename, regions))
+    {
+      return false;
+    }
+
+  Registry &registry = GetRegistry ();
+  for (std::vector<Ptr<RegionalParameters>>::iterator it = regions.begin (); it != regions.end ();
+       ++it)
+    {
+      NS_LOG_INFO ("Region " << (*it)->GetName () << " loaded from " << filename);
+      registry[(*it)->GetName ()] = *it;
+    }
+  return true;
+}
+
+std::vector<std::string>
+RegionalParameters::GetNames (void)
+{
+  std::vector<std::string> names;
+  Registry &registry = GetRegistry ();
+  for (Registry::const_iterator it = registry.begin (); it != registry.end (); ++it)
+    {
+      names.push_back (it->first);
+    }
+  return names;
+}
+
+bool
+RegionalParameters::Parse (std::istream &is, const std::string &source,
+                           std::vector<Ptr<RegionalParameters>> &regions)
+{
+  NS_LOG_FUNCTION (source);
+
+  std::vector<Ptr<RegionalParameters>> parsed;
+  Ptr<RegionalParameters> region;
+  bool ok = true;
+  std::string line;
+  uint32_t lineNumber = 0;
+  while (std::getline (is, line))
+    {
+      lineNumber++;
+      std::string::size_type comment = line.find ('#');
+      if (comment != std::string::npos)
+        {
+          line.erase (comment);
+        }
+      std::istringstream fields (line);
+      std::string directive;
+      if (!(fields >> directive))
+        {
+          continue;
+        }
+
+      std::ostringstream where;
+      where << source << ":" << lineNumber;
+      if (directive == "region")
+        {
+          if (region != 0)
+            {
+              ok = region->Finish (source) && ok;
+            }
+          region = CreateObject<RegionalParameters> ();
+          fields >> region->m_name;
+          parsed.push_back (region);
+        }
+      else if (region == 0)
+        {
+          NS_LOG_ERROR (where.str () << ": " << directive << " before the first region");
+          ok = false;
+          continue;
+        }
+      else if (directive == "sub_band")
+        {
+          SubBand subBand;
+          fields >> subBand.firstFrequency >> subBand.lastFrequency >> subBand.dutyCycle >>
+              subBand.maxTxPowerDbm;
+          region->m_subBands.push_back (subBand);
+        }
+      else if (directive == "channel" || directive == "gateway_channel")
+        {
+          double frequency = 0;
+          unsigned minDataRate = 0;
+          unsigned maxDataRate = 0;
+          uint32_t count = 1;
+          double step = 0;
+          fields >> frequency >> minDataRate >> maxDataRate;
+          if (fields >> count)
+            {
+              fields >> step;
+            }
+          else if (!fields.bad ())
+            {
+              fields.clear (std::ios::eofbit);
+            }
+          std::vector<Channel> &channels =
+              (directive == "channel") ? region->m_channels : region->m_gatewayChannels;
+          for (uint32_t i = 0; i < count; i++)
+            {
+              Channel channel = {GetChannelFrequency (frequency, i, step), uint8_t (minDataRate),
+                                 uint8_t (maxDataRate)};
+              channels.push_back (channel);
+            }
+        }
+      else if (directive == "gateway_frequency")
+        {
+          double frequency = 0;
+          uint32_t count = 1;
+          double step = 0;
+          fields >> frequency;
+          if (fields >> count)
+            {
+              fields >> step;
+            }
+          else if (!fields.bad ())
+            {
+              fields.clear (std::ios::eofbit);
+            }
+          for (uint32_t i = 0; i < count; i++)
+            {
+              region->m_gatewayFrequencies.push_back (GetChannelFrequency (frequency, i, step));
+            }
+        }
+      else if (directive == "reception_paths")
+        {
+          fields >> region->m_receptionPaths;
+        }
+      else if (directive == "data_rate")
+        {
+          unsigned dataRate = 0;
+          unsigned sf = 0;
+          double bandwidth = 0;
+          uint32_t maxAppPayload = 0;
+          fields >> dataRate >> sf >> bandwidth >> maxAppPayload;
+          if (fields && dataRate != region->m_sfForDataRate.size ())
+            {
+              NS_LOG_ERROR (where.str () << ": DR" << dataRate << " after DR"
+                                         << region->m_sfForDataRate.size () - 1);
+              ok = false;
+            }
+          region->m_sfForDataRate.push_back (sf);
+          region->m_bandwidthForDataRate.push_back (bandwidth);
+          region->m_maxAppPayloadForDataRate.push_back (maxAppPayload);
+        }
+      else if (directive == "tx_power")
+        {
+          region->m_txDbmForTxPower.clear ();
+          double dbm = 0;
+          while (fields >> dbm)
+            {
+              region->m_txDbmForTxPower.push_back (dbm);
+            }
+          if (!fields.bad () && fields.eof ())
+            {
+              fields.clear (std::ios::eofbit);
+            }
+        }
+      else if (directive == "rx1_data_rate")
+        {
+          unsigned dataRate = 0;
+          fields >> dataRate;
+          if (fields && dataRate >= region->m_replyDataRateMatrix.size ())
+            {
+              NS_LOG_ERROR (where.str () << ": no RX1 data rates for DR" << dataRate);
+              ok = false;
+              continue;
+            }
+          for (uint32_t offset = 0; offset < region->m_replyDataRateMatrix[0].size (); offset++)
+            {
+              unsigned reply = 0;
+              fields >> reply;
+              region->m_replyDataRateMatrix[dataRate][offset] = reply;
+            }
+        }
+      else if (directive == "preamble")
+        {
+          fields >> region->m_nPreambleSymbols;
+        }
+      else if (directive == "rx2")
+        {
+          unsigned dataRate = 0;
+          fields >> dataRate >> region->m_rx2Frequency;
+          region->m_rx2DataRate = dataRate;
+        }
+      else
+        {
+          NS_LOG_ERROR (where.str () << ": unknown directive " << directive);
+          ok = false;
+          continue;
+        }
+
+      // every field read, and nothing left
+      std::string extra;
+      if (fields.fail () || (fields >> extra))
+        {
+          NS_LOG_ERROR (where.str () << ": malformed " << directive);
+          ok = false;
+        }
+    }
+  if (region != 0)
+    {
+      ok = region->Finish (source) && ok;
+    }
+
+  if (ok)
+    {
+      regions.insert (regions.end (), parsed.begin (), parsed.end ());
+    }
+  return ok;
+}
+
+bool
+RegionalParameters::Finish (const std::string &source)
+{
+  NS_LOG_FUNCTION (this << source);
+
+  std::string problem;
+  if (m_name.empty ())
+    {
+      problem = "has no name";
+    }
+  else if (m_channels.empty ())
+    {
+      problem = "has no channels";
+    }
+  else if (m_sfForDataRate.empty ())
+    {
+      problem = "has no data rates";
+    }
+  else if (m_txDbmForTxPower.empty ())
+    {
+      problem = "has no transmission powers";
+    }
+  else if (m_rx2Frequency <= 0)
+    {
+      problem = "has no RX2 settings";
+    }
+  for (std::vector<Channel>::const_iterator it = m_channels.begin ();
+       problem.empty () && it != m_channels.end (); ++it)
+    {
+      if (it->minDataRate > it->maxDataRate || it->maxDataRate >= m_sfForDataRate.size ())
+        {
+          problem = "has channels with data rates it does not define";
+        }
+    }
+  if (!problem.empty ())
+    {
+      NS_LOG_ERROR (source << ": region " << m_name << " " << problem);
+      return false;
+    }
+
+  if (m_gatewayChannels.empty ())
+    {
+      m_gatewayChannels = m_channels;
+    }
+  if (m_gatewayFrequencies.empty ())
+    {
+      for (std::vector<Channel>::const_iterator it = m_gatewayChannels.begin ();
+           it != m_gatewayChannels.end (); ++it)
+        {
+          m_gatewayFrequencies.push_back (it->frequency);
+        }
+    }
+  return true;
+}
+
+std::string
+RegionalParameters::GetName (void) const
+{
+  return m_name;
+}
+
+const std::vector<RegionalParameters::SubBand> &
+RegionalParameters::GetSubBands (void) const
+{
+  return m_subBands;
+}
+
+const std::vector<RegionalParameters::Channel> &
+RegionalParameters::GetChannels (void) const
+{
+  return m_channels;
+}
+
+const std::vector<RegionalParameters::Channel> &
+RegionalParameters::GetGatewayChannels (void) const
+{
+  return m_gatewayChannels;
+}
+
+const std::vector<double> &
+RegionalParameters::GetGatewayFrequencies (void) const
+{
+  return m_gatewayFrequencies;
+}
+
+int
+RegionalParameters::GetReceptionPaths (void) const
+{
+  return m_receptionPaths;
+}
+
+const std::vector<uint8_t> &
+RegionalParameters::GetSfForDataRate (void) const
+{
+  return m_sfForDataRate;
+}
+
+const std::vector<double> &
+RegionalParameters::GetBandwidthForDataRate (void) const
+{
+  return m_bandwidthForDataRate;
+}
+
+const std::vector<uint32_t> &
+RegionalParameters::GetMaxAppPayloadForDataRate (void) const
+{
+  return m_maxAppPayloadForDataRate;
+}
+
+const std::vector<double> &
+RegionalParameters::GetTxDbmForTxPower (void) const
+{
+  return m_txDbmForTxPower;
+}
+
+const LorawanMac::ReplyDataRateMatrix &
+RegionalParameters::GetReplyDataRateMatrix (void) const
+{
+  return m_replyDataRateMatrix;
+}
+
+int
+RegionalParameters::GetNPreambleSymbols (void) const
+{
+  return m_nPreambleSymbols;
+}
+
+uint8_t
+RegionalParameters::GetSecondReceiveWindowDataRate (void) const
+{
+  return m_rx2DataRate;
+}
+
+double
+RegionalParameters::GetSecondReceiveWindowFrequency (void) const
+{
+  return m_rx2Frequency;
+}
+
+} // namespace lorawan
+} // namespace ns3
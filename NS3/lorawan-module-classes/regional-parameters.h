@@ -0,0 +1,169 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef REGIONAL_PARAMETERS_H
+#define REGIONAL_PARAMETERS_H
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "ns3/object.h"
+#include "ns3/lorawan-mac.h"
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * The parameters of a LoRaWAN region (RP002-1.0.3 LoRaWAN® Regional
+ * Parameters 2021): sub bands, channels, data rates, transmission powers,
+ * RX1 and RX2 settings and gateway reception paths.
+ *
+ * The regions are described by a compact text format, one directive per
+ * line ('#' starts a comment, frequencies in MHz):
+ *
+ *   region <name>
+ *   sub_band <first frequency> <last frequency> <duty cycle> <max tx power (dBm)>
+ *   channel <frequency> <min DR> <max DR> [<count> <step>]
+ *   gateway_channel <frequency> <min DR> <max DR> [<count> <step>]
+ *   gateway_frequency <frequency> [<count> <step>]
+ *   reception_paths <number of gateway reception paths>
+ *   data_rate <DR> <SF> <bandwidth (Hz)> <max app payload (bytes)>
+ *   tx_power <dBm of TxPower 0> <dBm of TxPower 1> ...
+ *   rx1_data_rate <uplink DR> <DR for RX1DROffset 0> ... <for offset 5>
+ *   preamble <number of symbols>
+ *   rx2 <DR> <frequency>
+ *
+ * The channel directives with a count add count channels, step MHz apart.
+ * The data rates are listed in order, from DR0; a data rate LoRa does not
+ * use has SF and bandwidth 0. Gateways use the end devices' channels and
+ * listen on their frequencies, unless gateway_channel or gateway_frequency
+ * are given.
+ *
+ * The EU868, EU868-SingleChannel, ALOHA and AU915 regions are built in;
+ * Load adds the regions of a file (e.g., regional-parameters.txt).
+ */
+class RegionalParameters : public Object
+{
+public:
+  static TypeId GetTypeId (void);
+
+  /**
+   * A sub band, with its duty cycle and power limits.
+   */
+  struct SubBand
+  {
+    double firstFrequency; //!< MHz
+    double lastFrequency; //!< MHz
+    double dutyCycle; //!< 1 for none
+    double maxTxPowerDbm; //!< dBm
+  };
+
+  /**
+   * A channel, and the data rates it can be used with.
+   */
+  struct Channel
+  {
+    double frequency; //!< MHz
+    uint8_t minDataRate;
+    uint8_t maxDataRate;
+  };
+
+  RegionalParameters ();
+  virtual ~RegionalParameters ();
+
+  /**
+   * Get a region, built in or loaded.
+   *
+   * \param name The name of the region.
+   * \return The region, 0 if there is none of this name.
+   */
+  static Ptr<RegionalParameters> Get (const std::string &name);
+
+  /**
+   * Add the regions of a file (replacing the regions of the same name).
+   *
+   * \param filename The file.
+   * \return False if the file cannot be read or has errors (no region is
+   * added then).
+   */
+  static bool Load (const std::string &filename);
+
+  /**
+   * Get the names of the regions, built in and loaded.
+   *
+   * \return The names.
+   */
+  static std::vector<std::string> GetNames (void);
+
+  /**
+   * Read the regions of a stream.
+   *
+   * \param is The stream.
+   * \param source The name of the stream, for the error messages.
+   * \param regions Filled with the regions read.
+   * \return False if there are errors.
+   */
+  static bool Parse (std::istream &is, const std::string &source,
+                     std::vector<Ptr<RegionalParameters>> &regions);
+
+  std::string GetName (void) const;
+
+  const std::vector<SubBand> &GetSubBands (void) const;
+  const std::vector<Channel> &GetChannels (void) const;
+  const std::vector<Channel> &GetGatewayChannels (void) const;
+  const std::vector<double> &GetGatewayFrequencies (void) const;
+  int GetReceptionPaths (void) const;
+
+  const std::vector<uint8_t> &GetSfForDataRate (void) const;
+  const std::vector<double> &GetBandwidthForDataRate (void) const;
+  const std::vector<uint32_t> &GetMaxAppPayloadForDataRate (void) const;
+  const std::vector<double> &GetTxDbmForTxPower (void) const;
+  const LorawanMac::ReplyDataRateMatrix &GetReplyDataRateMatrix (void) const;
+  int GetNPreambleSymbols (void) const;
+  uint8_t GetSecondReceiveWindowDataRate (void) const;
+  double GetSecondReceiveWindowFrequency (void) const;
+
+private:
+  /**
+   * Check that the region is complete, and fill the gateway channels and
+   * frequencies that were not given.
+   *
+   * \param source The name of the stream, for the error messages.
+   * \return False if the region is not complete.
+   */
+  bool Finish (const std::string &source);
+
+  std::string m_name;
+  std::vector<SubBand> m_subBands;
+  std::vector<Channel> m_channels;
+  std::vector<Channel> m_gatewayChannels;
+  std::vector<double> m_gatewayFrequencies;
+  int m_receptionPaths;
+  std::vector<uint8_t> m_sfForDataRate;
+  std::vector<double> m_bandwidthForDataRate;
+  std::vector<uint32_t> m_maxAppPayloadForDataRate;
+  std::vector<double> m_txDbmForTxPower;
+  LorawanMac::ReplyDataRateMatrix m_replyDataRateMatrix;
+  int m_nPreambleSymbols;
+  uint8_t m_rx2DataRate;
+  double m_rx2Frequency;
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* REGIONAL_PARAMETERS_H */
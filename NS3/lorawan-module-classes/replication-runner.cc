@@ -0,0 +1,233 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ns3/log.h"
+#include "ns3/fatal-error.h"
+#include "ns3/rng-seed-manager.h"
+
+#include "ns3/replication-runner.h"
+
+namespace ns3 {
+namespace lorawan {
+
+NS_LOG_COMPONENT_DEFINE ("ReplicationRunner");
+
+namespace {
+
+// a child process and the read end of its pipe
+struct Worker
+{
+  pid_t pid;
+  int fd;
+  uint32_t index;
+  std::string output;
+};
+
+bool
+WriteAll (int fd, const std::string &data)
+{
+  size_t done = 0;
+  while (done < data.size ())
+    {
+      ssize_t n = write (fd, data.data () + done, data.size () - done);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          return false;
+        }
+      done += n;
+    }
+  return true;
+}
+
+} // anonymous namespace
+
+ReplicationRunner::ReplicationRunner (uint32_t nWorkers) :
+  m_nWorkers (nWorkers)
+{
+  NS_LOG_FUNCTION (this << nWorkers);
+
+  if (m_nWorkers == 0)
+    {
+      m_nWorkers = std::max (1u, std::thread::hardware_concurrency ());
+    }
+}
+
+uint32_t
+ReplicationRunner::GetNWorkers (void) const
+{
+  return m_nWorkers;
+}
+
+uint64_t
+ReplicationRunner::GetMaxRss (void)
+{
+  struct rusage usage;
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    {
+      return 0;
+    }
+  // KiB on Linux
+  return usage.ru_maxrss;
+}
+
+std::vector<ReplicationRunner::Result>
+ReplicationRunner::Run (uint32_t firstRun, uint32_t nRuns, Replication replication) const
+{
+  NS_LOG_FUNCTION (this << firstRun << nRuns);
+
+  std::vector<Result> results (nRuns);
+  std::vector<Worker> active;
+  uint32_t next = 0;
+
+  while ((next < nRuns) || !active.empty ())
+    {
+      // keep m_nWorkers children busy
+      while ((active.size () < m_nWorkers) && (next < nRuns))
+        {
+          uint32_t run = firstRun + next;
+          int fds[2];
+          if (pipe (fds) != 0)
+            {
+              NS_FATAL_ERROR ("Could not create a pipe for replication " << run);
+            }
+          // the child would print the buffered output again
+          std::cout.flush ();
+          std::cerr.flush ();
+          std::fflush (0);
+
+          pid_t pid = fork ();
+          if (pid < 0)
+            {
+              NS_FATAL_ERROR ("Could not fork replication " << run);
+            }
+          if (pid == 0)
+            {
+              // child: run the replication, send its output, and leave
+              // without running the destructors of the parent state
+              close (fds[0]);
+              int status = 0;
+              try
+                {
+                  RngSeedManager::SetRun (run);
+                  if (!WriteAll (fds[1], replication (run)))
+                    {
+                      status = 1;
+                    }
+                }
+              catch (...)
+                {
+                  status = 1;
+                }
+              close (fds[1]);
+              std::cout.flush ();
+              std::cerr.flush ();
+              std::fflush (0);
+              _exit (status);
+            }
+
+          close (fds[1]);
+          Worker worker;
+          worker.pid = pid;
+          worker.fd = fds[0];
+          worker.index = next;
+          active.push_back (worker);
+          results[next].run = run;
+          results[next].ok = false;
+          results[next].maxRss = 0;
+          NS_LOG_INFO ("Replication " << run << " started in process " << pid << ".");
+          next++;
+        }
+
+      // gather the outputs; a child is done when its pipe is closed
+      std::vector<struct pollfd> fds (active.size ());
+      for (size_t i = 0; i < active.size (); i++)
+        {
+          fds[i].fd = active[i].fd;
+          fds[i].events = POLLIN;
+          fds[i].revents = 0;
+        }
+      if (poll (fds.data (), fds.size (), -1) < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          NS_FATAL_ERROR ("poll failed while waiting for the replications");
+        }
+
+      for (size_t i = fds.size (); i-- > 0; )
+        {
+          if (fds[i].revents == 0)
+            {
+              continue;
+            }
+          Worker &worker = active[i];
+          char buffer[65536];
+          ssize_t n = read (worker.fd, buffer, sizeof (buffer));
+          if (n > 0)
+            {
+              worker.output.append (buffer, n);
+              continue;
+            }
+          if ((n < 0) && (errno == EINTR))
+            {
+              continue;
+            }
+
+          close (worker.fd);
+          int status = 0;
+          struct rusage usage;
+          while ((wait4 (worker.pid, &status, 0, &usage) < 0) && (errno == EINTR))
+            {
+            }
+          Result &result = results[worker.index];
+          result.ok = WIFEXITED (status) && (WEXITSTATUS (status) == 0);
+          result.maxRss = usage.ru_maxrss;
+          if (result.ok)
+            {
+              result.output.swap (worker.output);
+            }
+          else
+            {
+              NS_LOG_WARN ("Replication " << result.run << " failed (status " << status << ").");
+            }
+          NS_LOG_INFO ("Replication " << result.run << " done (peak RSS " << result.maxRss << " KiB).");
+          active.erase (active.begin () + i);
+        }
+    }
+
+  return results;
+}
+
+} // namespace lorawan
+} // namespace ns3
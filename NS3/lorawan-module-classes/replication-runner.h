@@ -0,0 +1,108 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef REPLICATION_RUNNER_H
+#define REPLICATION_RUNNER_H
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace lorawan {
+
+/**
+ * \ingroup lorawan
+ * \brief Runs the replications of a scenario in forked worker processes
+ *
+ * The parent process sets the scenario up once (datasets, obstacle
+ * topology, channel, ...) and then calls Run: every replication is run
+ * by a child process forked from the parent, so it starts from a copy
+ * of the parent state (shared copy-on-write) and has a simulator of its
+ * own. Up to NWorkers children run at once. Each child sets its own
+ * RngSeedManager run number, runs the replication and sends its output
+ * back to the parent through a pipe; the outputs are returned in run
+ * order, so that the parent can write them to the result files.
+ *
+ * Whatever the parent builds before Run (a scenario snapshot: datasets,
+ * positions, SF assignment, topology, link matrices) is shared by the
+ * children for as long as they only read it. The peak resident set size
+ * of each child is reported with its result; it includes the pages still
+ * shared with the parent, so it is an upper bound of what the child added.
+ *
+ * The parent must not have other threads running when Run is called
+ * (e.g., no WorkStealingPool in flight).
+ */
+class ReplicationRunner
+{
+public:
+  /**
+   * \brief A replication, run in a child process; returns its output
+   * (any bytes, e.g., the lines of the result files)
+   */
+  typedef std::function<std::string (uint32_t run)> Replication;
+
+  /**
+   * \brief What a replication gave back
+   */
+  struct Result
+  {
+    uint32_t run;       //!< RngSeedManager run number of the replication
+    bool ok;            //!< false if the child failed (crash, non-zero exit)
+    std::string output; //!< output of the replication (empty if !ok)
+    uint64_t maxRss;    //!< peak resident set size of the child (KiB)
+  };
+
+  /**
+   * \brief Constructor
+   * \param nWorkers number of replications run at once (0 means one per
+   * hardware thread)
+   * \return none
+   */
+  explicit ReplicationRunner (uint32_t nWorkers);
+
+  /**
+   * \brief Gets the number of replications run at once
+   * \return the number of workers
+   */
+  uint32_t GetNWorkers (void) const;
+
+  /**
+   * \brief Runs replications firstRun to firstRun + nRuns - 1, each in a
+   * child process, and waits for all of them
+   * \param firstRun the RngSeedManager run number of the first replication
+   * \param nRuns the number of replications
+   * \param replication the replication
+   * \return the result of each replication, in run order
+   */
+  std::vector<Result> Run (uint32_t firstRun, uint32_t nRuns, Replication replication) const;
+
+  /**
+   * \brief Gets the peak resident set size of the calling process
+   * \return the peak resident set size (KiB)
+   */
+  static uint64_t GetMaxRss (void);
+
+private:
+  uint32_t m_nWorkers;
+};
+
+} // namespace lorawan
+} // namespace ns3
+
+#endif /* REPLICATION_RUNNER_H */
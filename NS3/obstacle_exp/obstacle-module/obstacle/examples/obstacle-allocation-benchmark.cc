@@ -0,0 +1,167 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Counts the heap allocations of the obstructed loss queries.
+ *
+ * "arena" is the current query path: the spatial index returns handles
+ * and the obstacles are read in place. "copies" replays, on top of the
+ * same query, what the path did before the obstacle arena: the range
+ * tree returned (center, Obstacle) keys by value, and the loop copied
+ * every candidate once more (id string and Polygon_2 each time).
+ *
+ * ./waf --run "obstacle-allocation-benchmark --buildings=predios_unicamp_dataset.xml"
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/topology.h"
+
+using namespace ns3;
+
+// every operator new of the program goes through here
+static std::atomic<uint64_t> g_allocations (0);
+
+void *
+operator new (std::size_t size)
+{
+  g_allocations++;
+  void *p = std::malloc (size == 0 ? 1 : size);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string buildings = "";
+  uint32_t nLinks = 10000;
+  double radius = 200;
+  uint32_t seed = 1;
+  std::string engine = "Inexact";
+
+  CommandLine cmd;
+  cmd.AddValue ("buildings", "Buildings file (SUMO poly XML)", buildings);
+  cmd.AddValue ("links", "Number of random links", nLinks);
+  cmd.AddValue ("radius", "Limiting radius of the obstacles of a link, for every index (meters)", radius);
+  cmd.AddValue ("seed", "Seed of the random links", seed);
+  cmd.AddValue ("engine", "Intersection engine (Exact or Inexact)", engine);
+  cmd.Parse (argc, argv);
+
+  if (buildings.empty ())
+    {
+      NS_FATAL_ERROR ("Usage: obstacle-allocation-benchmark --buildings=<file>");
+    }
+
+  Topology::LoadBuildings (buildings);
+  Topology *topology = Topology::GetTopology ();
+  Topology::GeometryEngine geometryEngine = (engine == "Exact") ? Topology::ENGINE_EXACT : Topology::ENGINE_INEXACT;
+
+  // random links over the map, from street level to rooftops
+  std::mt19937 rng (seed);
+  std::uniform_real_distribution<double> x (topology->GetMinX (), topology->GetMaxX ());
+  std::uniform_real_distribution<double> y (topology->GetMinY (), topology->GetMaxY ());
+  std::uniform_real_distribution<double> z (1.0, 30.0);
+  std::vector<std::pair<Vector, Vector> > links;
+  links.reserve (nLinks);
+  for (uint32_t i = 0; i < nLinks; i++)
+    {
+      links.push_back (std::make_pair (Vector (x (rng), y (rng), z (rng)), Vector (x (rng), y (rng), z (rng))));
+    }
+
+  std::cout << topology->GetNObstacles () << " obstacles, " << nLinks << " links, "
+            << engine << " engine." << std::endl;
+  std::cout << std::setw (10) << "index" << std::setw (10) << "path"
+            << std::setw (16) << "allocs/link" << std::setw (16) << "us/link"
+            << std::setw (16) << "candidates" << std::endl;
+
+  const Topology::SpatialIndex indices[] = {Topology::INDEX_RANGE_TREE, Topology::INDEX_BVH, Topology::INDEX_GRID};
+  const char *names[] = {"RangeTree", "Bvh", "Grid"};
+  std::vector<uint32_t> candidates;
+  std::vector<std::pair<Point, Obstacle> > outputList;
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      for (uint32_t copies = 0; copies < 2; copies++)
+        {
+          // warm up the scratch buffers
+          for (uint32_t l = 0; l < std::min<uint32_t> (nLinks, 100); l++)
+            {
+              topology->ComputeObstructedLoss (links[l].first, links[l].second, radius,
+                                               indices[i], geometryEngine, candidates);
+            }
+
+          double sum = 0.0;
+          uint64_t nCandidates = 0;
+          uint64_t before = g_allocations;
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+          for (uint32_t l = 0; l < nLinks; l++)
+            {
+              sum += topology->ComputeObstructedLoss (links[l].first, links[l].second, radius,
+                                                      indices[i], geometryEngine, candidates);
+              nCandidates += candidates.size ();
+              if (copies)
+                {
+                  outputList.clear ();
+                  for (std::vector<uint32_t>::iterator it = candidates.begin (); it != candidates.end (); ++it)
+                    {
+                      Obstacle &obstacle = topology->GetObstacle (*it);
+                      outputList.push_back (std::make_pair (obstacle.GetCenter (), obstacle));
+                    }
+                  for (std::vector<std::pair<Point, Obstacle> >::iterator it = outputList.begin (); it != outputList.end (); ++it)
+                    {
+                      Obstacle obstacle = it->second;
+                      sum += obstacle.GetHeight () * 0.0;
+                    }
+                }
+            }
+          double elapsed = std::chrono::duration<double, std::micro> (std::chrono::steady_clock::now () - start).count ();
+          uint64_t allocations = g_allocations - before;
+
+          std::cout << std::setw (10) << names[i] << std::setw (10) << (copies ? "copies" : "arena")
+                    << std::setw (16) << std::fixed << std::setprecision (2) << (double) allocations / nLinks
+                    << std::setw (16) << elapsed / nLinks
+                    << std::setw (16) << (double) nCandidates / nLinks
+                    << "   (checksum " << sum << ")" << std::endl;
+        }
+    }
+
+  return 0;
+}
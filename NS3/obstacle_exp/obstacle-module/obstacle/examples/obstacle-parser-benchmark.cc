@@ -0,0 +1,265 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Times the parsing of SUMO polygon files.
+ *
+ * "lines" replays the parser LoadBuildings used before SumoPolyParser:
+ * getline, find and substr on every line, then substr and atof on every
+ * vertex. "stream" is SumoPolyParser over the memory-mapped file. Both
+ * only parse (no obstacle is built); with --load=1 the time of a whole
+ * Topology::ReadBuildings (obstacles and indices) is printed too.
+ *
+ * The program runs on the given buildings file, if any, and on a
+ * synthetic file of --synthetic polygons that it writes first. Each
+ * parser runs --rounds times on each file, after one run that is not
+ * timed (it brings the file into the page cache): the median and the
+ * lowest times are printed.
+ *
+ * ./waf --run "obstacle-parser-benchmark --buildings=predios_unicamp_dataset.xml --synthetic=100000 --rounds=11"
+ *
+ * run-parser-benchmark.sh runs it on the Unicamp buildings and a
+ * synthetic file of 100000 polygons, on an optimized build.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/mapped-file.h"
+#include "ns3/sumo-poly-parser.h"
+#include "ns3/topology.h"
+
+using namespace ns3;
+
+// writes n random buildings (4 to 8 vertices each, closed as SUMO does)
+static void
+WriteSyntheticFile (std::string filename, uint32_t n)
+{
+  std::ofstream file (filename.c_str ());
+  if (!file.is_open ())
+    {
+      NS_FATAL_ERROR ("Could not write " << filename);
+    }
+  std::mt19937 rng (1);
+  uint32_t side = static_cast<uint32_t> (std::ceil (std::sqrt (n)));
+  std::uniform_real_distribution<double> size (5.0, 25.0);
+  std::uniform_real_distribution<double> height (3.0, 40.0);
+  std::uniform_int_distribution<int> nVertices (4, 8);
+
+  file << std::setprecision (16);
+  file << "<?xml version=\"1.0\" ?>\n<additional>\n";
+  for (uint32_t i = 0; i < n; i++)
+    {
+      double cx = (i % side) * 40.0;
+      double cy = (i / side) * 40.0;
+      double r = size (rng);
+      int k = nVertices (rng);
+      file << "\t<poly id=\"" << i << "\" type=\"building\" color=\"255.0,230.0,230.0\" layer=\"-1.0\" fill=\"1\" height=\""
+           << height (rng) << "\" shape=\"";
+      for (int v = 0; v <= k; v++)
+        {
+          double a = 2.0 * M_PI * (v % k) / k;
+          file << cx + r * std::cos (a) << "," << cy + r * std::sin (a) << " ";
+        }
+      file << "\"/>\n";
+    }
+  file << "</additional>\n";
+}
+
+// the line parser of LoadBuildings before SumoPolyParser
+static void
+ParseLines (std::string filename, uint64_t &nPolygons, uint64_t &nVertices, double &checksum)
+{
+  std::ifstream file (filename.c_str (), std::ios::in);
+  while (!file.eof ())
+    {
+      std::string line;
+      getline (file, line);
+      if ((line.find ("type=\"building") == std::string::npos) && (line.find ("type=\"unknown") == std::string::npos))
+        {
+          continue;
+        }
+      size_t pos = line.find ("id=\"");
+      size_t pos2 = line.find ("\"", pos + 4);
+      std::string polyid = line.substr (pos + 4, pos2 - (pos + 4));
+      pos = line.find ("shape=\"");
+      pos2 = line.find ("\"", pos + 8);
+      std::string shape = line.substr (pos + 7, pos2 - pos - 7);
+      pos = line.find ("height=\"");
+      pos2 = line.find ("\"", pos + 8);
+      std::string height = line.substr (pos + 8, pos2 - (pos + 8));
+      checksum += atof (height.c_str ());
+
+      size_t v1 = 0;
+      size_t v2 = shape.find (" ", v1);
+      while (v2 != std::string::npos)
+        {
+          std::string vertex = shape.substr (v1, v2 - v1);
+          size_t comma = vertex.find (",");
+          std::string x = vertex.substr (0, comma);
+          std::string y = vertex.substr (comma + 1);
+          checksum += atof (x.c_str ()) + atof (y.c_str ());
+          nVertices++;
+          v1 = v2 + 1;
+          v2 = shape.find (" ", v1);
+        }
+      nPolygons++;
+    }
+}
+
+// SumoPolyParser over the mapped file
+static void
+ParseStream (std::string filename, uint64_t &nPolygons, uint64_t &nVertices, double &checksum)
+{
+  MappedFile file;
+  if (!file.Open (filename))
+    {
+      NS_FATAL_ERROR ("Could not open " << filename);
+    }
+  SumoPolyParser parser (file.GetData (), file.GetData () + file.GetSize ());
+  SumoPoly poly;
+  std::vector<double> vx;
+  std::vector<double> vy;
+  while (parser.Next (poly))
+    {
+      SumoPolyParser::ParseShape (poly.shape, vx, vy);
+      checksum += poly.height;
+      for (size_t v = 0; v < vx.size (); v++)
+        {
+          checksum += vx[v] + vy[v];
+        }
+      nVertices += vx.size ();
+      nPolygons++;
+    }
+}
+
+// median and lowest of the times of the rounds
+static void
+PrintTimes (std::vector<double> &times, double megabytes)
+{
+  std::sort (times.begin (), times.end ());
+  double median = times[times.size () / 2];
+  std::cout << std::setw (12) << std::setprecision (2) << median * 1e3 << " ms (median)"
+            << std::setw (12) << times.front () * 1e3 << " ms (lowest)"
+            << std::setw (12) << megabytes / median << " MB/s";
+}
+
+static void
+Benchmark (std::string filename, bool load, uint32_t rounds)
+{
+  MappedFile file;
+  file.Open (filename);
+  double megabytes = file.GetSize () / 1e6;
+  file.Close ();
+
+  std::cout << filename << " (" << std::fixed << std::setprecision (1) << megabytes << " MB, "
+            << rounds << " rounds)" << std::endl;
+  for (uint32_t stream = 0; stream < 2; stream++)
+    {
+      uint64_t nPolygons = 0;
+      uint64_t nVertices = 0;
+      double checksum = 0.0;
+      std::vector<double> times;
+      // round 0 is not timed
+      for (uint32_t round = 0; round <= rounds; round++)
+        {
+          nPolygons = 0;
+          nVertices = 0;
+          checksum = 0.0;
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+          if (stream)
+            {
+              ParseStream (filename, nPolygons, nVertices, checksum);
+            }
+          else
+            {
+              ParseLines (filename, nPolygons, nVertices, checksum);
+            }
+          double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+          if (round > 0)
+            {
+              times.push_back (elapsed);
+            }
+        }
+      // the line parser keeps the closing vertex of every polygon
+      std::cout << std::setw (10) << (stream ? "stream" : "lines")
+                << std::setw (10) << nPolygons << " polygons" << std::setw (10) << nVertices << " vertices";
+      PrintTimes (times, megabytes);
+      std::cout << "   (checksum " << std::setprecision (0) << checksum << ")" << std::endl;
+    }
+
+  if (load)
+    {
+      uint32_t nObstacles = 0;
+      std::vector<double> times;
+      for (uint32_t round = 0; round <= rounds; round++)
+        {
+          Ptr<Topology> topology = CreateObject<Topology> ();
+          std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+          topology->ReadBuildings (filename);
+          double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+          if (round > 0)
+            {
+              times.push_back (elapsed);
+            }
+          nObstacles = topology->GetNObstacles ();
+          topology->Dispose ();
+        }
+      std::cout << std::setw (10) << "load" << std::setw (10) << nObstacles << " obstacles" << std::setw (19) << " ";
+      PrintTimes (times, megabytes);
+      std::cout << std::endl;
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string buildings = "";
+  uint32_t synthetic = 100000;
+  std::string syntheticFile = "synthetic-polygons.xml";
+  bool load = false;
+  uint32_t rounds = 11;
+
+  CommandLine cmd;
+  cmd.AddValue ("buildings", "Buildings file (SUMO poly XML)", buildings);
+  cmd.AddValue ("synthetic", "Number of polygons of the synthetic file (0 to skip)", synthetic);
+  cmd.AddValue ("syntheticFile", "Where to write the synthetic file", syntheticFile);
+  cmd.AddValue ("load", "Also time Topology::ReadBuildings", load);
+  cmd.AddValue ("rounds", "Timed runs of each parser on each file (at least 1)", rounds);
+  cmd.Parse (argc, argv);
+  rounds = std::max (rounds, 1u);
+
+  if (!buildings.empty ())
+    {
+      Benchmark (buildings, load, rounds);
+    }
+  if (synthetic > 0)
+    {
+      WriteSyntheticFile (syntheticFile, synthetic);
+      Benchmark (syntheticFile, load, rounds);
+    }
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Compiles a buildings file (SUMO poly XML) into a compiled topology,
+ * that Topology::ReadCompiled maps into memory without parsing. Only the
+ * XML parsing and the BVH build are saved: the polygons, the range tree,
+ * the edge table and the grid are built again when the file is loaded.
+ *
+ * The compiled file is then loaded back in a second topology: both
+ * load times are printed, and the losses of random links are compared
+ * between the two topologies, for each spatial index.
+ *
+ * ./waf --run "obstacle-topology-compiler --buildings=predios_unicamp_dataset.xml --output=predios_unicamp_dataset.topo"
+ */
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/topology.h"
+
+using namespace ns3;
+
+int
+main (int argc, char *argv[])
+{
+  std::string buildings = "";
+  std::string output = "";
+  uint32_t nLinks = 10000;
+  double radius = 200;
+
+  CommandLine cmd;
+  cmd.AddValue ("buildings", "Buildings file (SUMO poly XML)", buildings);
+  cmd.AddValue ("output", "Compiled topology to write", output);
+  cmd.AddValue ("links", "Number of random links compared after loading (0 to skip)", nLinks);
+  cmd.AddValue ("radius", "Limiting radius of the obstacles of a link, for every index (meters)", radius);
+  cmd.Parse (argc, argv);
+
+  if (buildings.empty () || output.empty ())
+    {
+      NS_FATAL_ERROR ("Usage: obstacle-topology-compiler --buildings=<file> --output=<file>");
+    }
+
+  Ptr<Topology> source = CreateObject<Topology> ();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
+  source->ReadBuildings (buildings);
+  double parseTime = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+  source->SaveCompiled (output);
+
+  // load the compiled file in a second topology
+  Ptr<Topology> compiled = CreateObject<Topology> ();
+  start = std::chrono::steady_clock::now ();
+  if (!compiled->ReadCompiled (output))
+    {
+      NS_FATAL_ERROR ("Could not load the compiled topology " << output);
+    }
+  double loadTime = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+
+  std::cout << source->GetNObstacles () << " obstacles written to " << output << "." << std::endl;
+  std::cout << "ReadBuildings: " << parseTime << " ms, ReadCompiled: " << loadTime << " ms." << std::endl;
+
+  if (compiled->GetNObstacles () != source->GetNObstacles ())
+    {
+      NS_FATAL_ERROR ("The compiled topology has " << compiled->GetNObstacles () << " obstacles");
+    }
+
+  // random links over the map, from street level to rooftops
+  std::mt19937 rng (1);
+  std::uniform_real_distribution<double> x (source->GetMinX (), source->GetMaxX ());
+  std::uniform_real_distribution<double> y (source->GetMinY (), source->GetMaxY ());
+  std::uniform_real_distribution<double> z (1.0, 30.0);
+  std::vector<std::pair<Vector, Vector> > links;
+  for (uint32_t i = 0; i < nLinks; i++)
+    {
+      links.push_back (std::make_pair (Vector (x (rng), y (rng), z (rng)), Vector (x (rng), y (rng), z (rng))));
+    }
+
+  const Topology::SpatialIndex indices[] = {Topology::INDEX_RANGE_TREE, Topology::INDEX_BVH, Topology::INDEX_GRID};
+  const char *names[] = {"RangeTree", "Bvh", "Grid"};
+  std::vector<uint32_t> candidates;
+  uint32_t mismatches = 0;
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      for (uint32_t l = 0; l < nLinks; l++)
+        {
+          double expected = source->ComputeObstructedLoss (links[l].first, links[l].second, radius,
+                                                           indices[i], Topology::ENGINE_EXACT, candidates);
+          double loss = compiled->ComputeObstructedLoss (links[l].first, links[l].second, radius,
+                                                         indices[i], Topology::ENGINE_EXACT, candidates);
+          if (loss != expected)
+            {
+              mismatches++;
+              std::cout << names[i] << ": link " << l << " loss " << loss << " dB, expected "
+                        << expected << " dB." << std::endl;
+            }
+        }
+    }
+  std::cout << nLinks << " links compared for each index, " << mismatches << " mismatches." << std::endl;
+
+  return (mismatches == 0) ? 0 : 1;
+}
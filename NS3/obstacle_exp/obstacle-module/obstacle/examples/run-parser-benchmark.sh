@@ -0,0 +1,28 @@
+#!/bin/sh
+
+# Times the SUMO polygon parsers (obstacle-parser-benchmark) on the
+# Unicamp buildings and a synthetic file of 100000 polygons. Run it from
+# $NS3-BASE-DIR, with predios_unicamp_dataset.xml (see
+# obstacle_exp/unicamp-osm-input-to-ns3) in the same directory.
+#
+# The times depend on the machine and the compiler: regenerate them on
+# an optimized build (./waf configure --build-profile=optimized) before
+# comparing the two parsers, and keep the output with any numbers quoted.
+
+BUILDINGS=predios_unicamp_dataset.xml
+SYNTHETIC=100000
+ROUNDS=11
+
+echo '\n[SHELL INFO] MACHINE'
+uname -srm
+grep -m 1 'model name' /proc/cpuinfo
+${CXX:-g++} --version | head -n 1
+
+if ! grep -qs "optimized" build/c4che/_cache.py; then
+  echo '\n[SHELL INFO] WARNING: not an optimized build, the times are not comparable'
+fi
+
+echo '\n[SHELL INFO] PARSERS - Unicamp buildings and a synthetic file'
+./waf --run "obstacle-parser-benchmark --buildings=$BUILDINGS --synthetic=$SYNTHETIC --rounds=$ROUNDS --load=1"
+
+echo '[SHELL INFO] BENCHMARK FINISHED!'
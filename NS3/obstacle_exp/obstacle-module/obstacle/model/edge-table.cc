@@ -0,0 +1,343 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "ns3/log.h"
+
+#include "edge-table.h"
+
+#if defined (__GNUC__) && defined (__x86_64__)
+#define EDGE_TABLE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("EdgeTable");
+
+namespace {
+
+// the segment: p[0..2] is p1, p[3..5] is p2, u = p2 - p1
+struct Ray
+{
+  double p[6];
+  double u[3];
+};
+
+struct EdgeColumns
+{
+  const double *x0;
+  const double *y0;
+  const double *x1;
+  const double *y1;
+  const double *h;
+};
+
+// one wall, in the same order of operations as the vector kernels
+inline void
+TestWall (const EdgeColumns &e, uint32_t i, const Ray &ray,
+          uint32_t &hits, double &tMin, double &tMax)
+{
+  double ex = e.x1[i] - e.x0[i];
+  double ey = e.y1[i] - e.y0[i];
+  double s1 = ex * (ray.p[1] - e.y0[i]) - ey * (ray.p[0] - e.x0[i]);
+  double s2 = ex * (ray.p[4] - e.y0[i]) - ey * (ray.p[3] - e.x0[i]);
+  // no point if the segment is on one side of the plane, or in it
+  if (((s1 > 0.0) && (s2 > 0.0)) || ((s1 < 0.0) && (s2 < 0.0)) || ((s1 == 0.0) && (s2 == 0.0)))
+    {
+      return;
+    }
+  double t = s1 / (s1 - s2);
+  double ipx = ray.p[0] + t * ray.u[0];
+  double ipy = ray.p[1] + t * ray.u[1];
+  double ipz = ray.p[2] + t * ray.u[2];
+  if ((ipx >= std::min (e.x0[i], e.x1[i])) && (ipx <= std::max (e.x0[i], e.x1[i]))
+      && (ipy >= std::min (e.y0[i], e.y1[i])) && (ipy <= std::max (e.y0[i], e.y1[i]))
+      && (ipz >= 0.0) && (ipz <= e.h[i]))
+    {
+      hits++;
+      tMin = std::min (tMin, t);
+      tMax = std::max (tMax, t);
+    }
+}
+
+#ifdef EDGE_TABLE_X86
+
+void
+IntersectSse2 (const EdgeColumns &e, uint32_t n, const Ray &ray,
+               uint32_t &hits, double &tMin, double &tMax)
+{
+  const __m128d zero = _mm_setzero_pd ();
+  const __m128d one = _mm_set1_pd (1.0);
+  const __m128d inf = _mm_set1_pd (HUGE_VAL);
+  const __m128d ninf = _mm_set1_pd (-HUGE_VAL);
+  const __m128d p1x = _mm_set1_pd (ray.p[0]);
+  const __m128d p1y = _mm_set1_pd (ray.p[1]);
+  const __m128d p1z = _mm_set1_pd (ray.p[2]);
+  const __m128d p2x = _mm_set1_pd (ray.p[3]);
+  const __m128d p2y = _mm_set1_pd (ray.p[4]);
+  const __m128d ux = _mm_set1_pd (ray.u[0]);
+  const __m128d uy = _mm_set1_pd (ray.u[1]);
+  const __m128d uz = _mm_set1_pd (ray.u[2]);
+
+  __m128d vHits = zero;
+  __m128d vMin = inf;
+  __m128d vMax = ninf;
+
+  uint32_t i = 0;
+  for (; i + 2 <= n; i += 2)
+    {
+      __m128d x0 = _mm_loadu_pd (e.x0 + i);
+      __m128d y0 = _mm_loadu_pd (e.y0 + i);
+      __m128d x1 = _mm_loadu_pd (e.x1 + i);
+      __m128d y1 = _mm_loadu_pd (e.y1 + i);
+      __m128d h = _mm_loadu_pd (e.h + i);
+
+      __m128d ex = _mm_sub_pd (x1, x0);
+      __m128d ey = _mm_sub_pd (y1, y0);
+      __m128d s1 = _mm_sub_pd (_mm_mul_pd (ex, _mm_sub_pd (p1y, y0)), _mm_mul_pd (ey, _mm_sub_pd (p1x, x0)));
+      __m128d s2 = _mm_sub_pd (_mm_mul_pd (ex, _mm_sub_pd (p2y, y0)), _mm_mul_pd (ey, _mm_sub_pd (p2x, x0)));
+
+      __m128d reject = _mm_or_pd (_mm_and_pd (_mm_cmpgt_pd (s1, zero), _mm_cmpgt_pd (s2, zero)),
+                                  _mm_or_pd (_mm_and_pd (_mm_cmplt_pd (s1, zero), _mm_cmplt_pd (s2, zero)),
+                                             _mm_and_pd (_mm_cmpeq_pd (s1, zero), _mm_cmpeq_pd (s2, zero))));
+
+      // rejected lanes may divide by zero, they are masked out below
+      __m128d t = _mm_div_pd (s1, _mm_sub_pd (s1, s2));
+      __m128d ipx = _mm_add_pd (p1x, _mm_mul_pd (t, ux));
+      __m128d ipy = _mm_add_pd (p1y, _mm_mul_pd (t, uy));
+      __m128d ipz = _mm_add_pd (p1z, _mm_mul_pd (t, uz));
+
+      __m128d inside = _mm_and_pd (_mm_cmpge_pd (ipx, _mm_min_pd (x0, x1)), _mm_cmple_pd (ipx, _mm_max_pd (x0, x1)));
+      inside = _mm_and_pd (inside, _mm_and_pd (_mm_cmpge_pd (ipy, _mm_min_pd (y0, y1)), _mm_cmple_pd (ipy, _mm_max_pd (y0, y1))));
+      inside = _mm_and_pd (inside, _mm_and_pd (_mm_cmpge_pd (ipz, zero), _mm_cmple_pd (ipz, h)));
+
+      __m128d hit = _mm_andnot_pd (reject, inside);
+      vHits = _mm_add_pd (vHits, _mm_and_pd (hit, one));
+      vMin = _mm_min_pd (vMin, _mm_or_pd (_mm_and_pd (hit, t), _mm_andnot_pd (hit, inf)));
+      vMax = _mm_max_pd (vMax, _mm_or_pd (_mm_and_pd (hit, t), _mm_andnot_pd (hit, ninf)));
+    }
+
+  double lanes[2];
+  _mm_storeu_pd (lanes, vHits);
+  hits += static_cast<uint32_t> (lanes[0] + lanes[1]);
+  _mm_storeu_pd (lanes, vMin);
+  tMin = std::min (tMin, std::min (lanes[0], lanes[1]));
+  _mm_storeu_pd (lanes, vMax);
+  tMax = std::max (tMax, std::max (lanes[0], lanes[1]));
+
+  for (; i < n; i++)
+    {
+      TestWall (e, i, ray, hits, tMin, tMax);
+    }
+}
+
+__attribute__ ((target ("avx2")))
+void
+IntersectAvx2 (const EdgeColumns &e, uint32_t n, const Ray &ray,
+               uint32_t &hits, double &tMin, double &tMax)
+{
+  const __m256d zero = _mm256_setzero_pd ();
+  const __m256d one = _mm256_set1_pd (1.0);
+  const __m256d inf = _mm256_set1_pd (HUGE_VAL);
+  const __m256d ninf = _mm256_set1_pd (-HUGE_VAL);
+  const __m256d p1x = _mm256_set1_pd (ray.p[0]);
+  const __m256d p1y = _mm256_set1_pd (ray.p[1]);
+  const __m256d p1z = _mm256_set1_pd (ray.p[2]);
+  const __m256d p2x = _mm256_set1_pd (ray.p[3]);
+  const __m256d p2y = _mm256_set1_pd (ray.p[4]);
+  const __m256d ux = _mm256_set1_pd (ray.u[0]);
+  const __m256d uy = _mm256_set1_pd (ray.u[1]);
+  const __m256d uz = _mm256_set1_pd (ray.u[2]);
+
+  __m256d vHits = zero;
+  __m256d vMin = inf;
+  __m256d vMax = ninf;
+
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+      __m256d x0 = _mm256_loadu_pd (e.x0 + i);
+      __m256d y0 = _mm256_loadu_pd (e.y0 + i);
+      __m256d x1 = _mm256_loadu_pd (e.x1 + i);
+      __m256d y1 = _mm256_loadu_pd (e.y1 + i);
+      __m256d h = _mm256_loadu_pd (e.h + i);
+
+      __m256d ex = _mm256_sub_pd (x1, x0);
+      __m256d ey = _mm256_sub_pd (y1, y0);
+      __m256d s1 = _mm256_sub_pd (_mm256_mul_pd (ex, _mm256_sub_pd (p1y, y0)), _mm256_mul_pd (ey, _mm256_sub_pd (p1x, x0)));
+      __m256d s2 = _mm256_sub_pd (_mm256_mul_pd (ex, _mm256_sub_pd (p2y, y0)), _mm256_mul_pd (ey, _mm256_sub_pd (p2x, x0)));
+
+      __m256d bothPos = _mm256_and_pd (_mm256_cmp_pd (s1, zero, _CMP_GT_OQ), _mm256_cmp_pd (s2, zero, _CMP_GT_OQ));
+      __m256d bothNeg = _mm256_and_pd (_mm256_cmp_pd (s1, zero, _CMP_LT_OQ), _mm256_cmp_pd (s2, zero, _CMP_LT_OQ));
+      __m256d bothZero = _mm256_and_pd (_mm256_cmp_pd (s1, zero, _CMP_EQ_OQ), _mm256_cmp_pd (s2, zero, _CMP_EQ_OQ));
+      __m256d reject = _mm256_or_pd (bothPos, _mm256_or_pd (bothNeg, bothZero));
+
+      // rejected lanes may divide by zero, they are masked out below
+      __m256d t = _mm256_div_pd (s1, _mm256_sub_pd (s1, s2));
+      __m256d ipx = _mm256_add_pd (p1x, _mm256_mul_pd (t, ux));
+      __m256d ipy = _mm256_add_pd (p1y, _mm256_mul_pd (t, uy));
+      __m256d ipz = _mm256_add_pd (p1z, _mm256_mul_pd (t, uz));
+
+      __m256d inside = _mm256_and_pd (_mm256_cmp_pd (ipx, _mm256_min_pd (x0, x1), _CMP_GE_OQ),
+                                      _mm256_cmp_pd (ipx, _mm256_max_pd (x0, x1), _CMP_LE_OQ));
+      inside = _mm256_and_pd (inside, _mm256_and_pd (_mm256_cmp_pd (ipy, _mm256_min_pd (y0, y1), _CMP_GE_OQ),
+                                                     _mm256_cmp_pd (ipy, _mm256_max_pd (y0, y1), _CMP_LE_OQ)));
+      inside = _mm256_and_pd (inside, _mm256_and_pd (_mm256_cmp_pd (ipz, zero, _CMP_GE_OQ),
+                                                     _mm256_cmp_pd (ipz, h, _CMP_LE_OQ)));
+
+      __m256d hit = _mm256_andnot_pd (reject, inside);
+      vHits = _mm256_add_pd (vHits, _mm256_and_pd (hit, one));
+      vMin = _mm256_min_pd (vMin, _mm256_blendv_pd (inf, t, hit));
+      vMax = _mm256_max_pd (vMax, _mm256_blendv_pd (ninf, t, hit));
+    }
+
+  double lanes[4];
+  _mm256_storeu_pd (lanes, vHits);
+  hits += static_cast<uint32_t> (lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+  _mm256_storeu_pd (lanes, vMin);
+  tMin = std::min (tMin, std::min (std::min (lanes[0], lanes[1]), std::min (lanes[2], lanes[3])));
+  _mm256_storeu_pd (lanes, vMax);
+  tMax = std::max (tMax, std::max (std::max (lanes[0], lanes[1]), std::max (lanes[2], lanes[3])));
+
+  for (; i < n; i++)
+    {
+      TestWall (e, i, ray, hits, tMin, tMax);
+    }
+}
+
+#else
+
+void
+IntersectScalar (const EdgeColumns &e, uint32_t n, const Ray &ray,
+                 uint32_t &hits, double &tMin, double &tMax)
+{
+  for (uint32_t i = 0; i < n; i++)
+    {
+      TestWall (e, i, ray, hits, tMin, tMax);
+    }
+}
+
+#endif /* EDGE_TABLE_X86 */
+
+typedef void (*Kernel) (const EdgeColumns &e, uint32_t n, const Ray &ray,
+                        uint32_t &hits, double &tMin, double &tMax);
+
+struct KernelChoice
+{
+  Kernel kernel;
+  const char *name;
+};
+
+const KernelChoice &
+GetKernel (void)
+{
+  static const KernelChoice choice = [] ()
+  {
+#ifdef EDGE_TABLE_X86
+    if (__builtin_cpu_supports ("avx2"))
+      {
+        return KernelChoice {&IntersectAvx2, "avx2"};
+      }
+    // SSE2 is part of x86-64
+    return KernelChoice {&IntersectSse2, "sse2"};
+#else
+    return KernelChoice {&IntersectScalar, "scalar"};
+#endif
+  } ();
+  return choice;
+}
+
+} // anonymous namespace
+
+EdgeTable::EdgeTable ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+EdgeTable::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_x0.clear ();
+  m_y0.clear ();
+  m_x1.clear ();
+  m_y1.clear ();
+  m_h.clear ();
+}
+
+void
+EdgeTable::AddPolygon (const std::vector<double> &vx, const std::vector<double> &vy, double height,
+                       uint32_t &first, uint32_t &count)
+{
+  NS_LOG_FUNCTION (this << vx.size () << height);
+
+  first = m_x0.size ();
+  size_t n = vx.size ();
+  for (size_t i = 0; i < n; i++)
+    {
+      size_t j = (i + 1 == n) ? 0 : i + 1;
+      if ((vx[i] == vx[j]) && (vy[i] == vy[j]))
+        {
+          // duplicate vertex (e.g., the closing vertex), no wall
+          continue;
+        }
+      m_x0.push_back (vx[i]);
+      m_y0.push_back (vy[i]);
+      m_x1.push_back (vx[j]);
+      m_y1.push_back (vy[j]);
+      m_h.push_back (height);
+    }
+  count = m_x0.size () - first;
+}
+
+uint32_t
+EdgeTable::GetSize (void) const
+{
+  return m_x0.size ();
+}
+
+void
+EdgeTable::Intersect (const Vector &p1, const Vector &p2, uint32_t first, uint32_t count,
+                      uint32_t &hits, double &tMin, double &tMax) const
+{
+  NS_ASSERT (first + count <= m_x0.size ());
+
+  hits = 0;
+  tMin = HUGE_VAL;
+  tMax = -HUGE_VAL;
+  if (count == 0)
+    {
+      return;
+    }
+
+  Ray ray = {{p1.x, p1.y, p1.z, p2.x, p2.y, p2.z},
+             {p2.x - p1.x, p2.y - p1.y, p2.z - p1.z}};
+  EdgeColumns columns = {&m_x0[first], &m_y0[first], &m_x1[first], &m_y1[first], &m_h[first]};
+  GetKernel ().kernel (columns, count, ray, hits, tMin, tMax);
+}
+
+const char *
+EdgeTable::GetKernelName (void)
+{
+  return GetKernel ().name;
+}
+
+} // namespace ns3
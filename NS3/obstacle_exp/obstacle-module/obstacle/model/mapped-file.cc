@@ -0,0 +1,106 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ns3/log.h"
+
+#include "mapped-file.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("MappedFile");
+
+MappedFile::MappedFile () :
+  m_data (0),
+  m_size (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+MappedFile::~MappedFile ()
+{
+  NS_LOG_FUNCTION (this);
+
+  Close ();
+}
+
+bool
+MappedFile::Open (const std::string &filename)
+{
+  NS_LOG_FUNCTION (this << filename);
+
+  Close ();
+
+  int fd = open (filename.c_str (), O_RDONLY);
+  if (fd < 0)
+    {
+      return false;
+    }
+  struct stat st;
+  if (fstat (fd, &st) != 0)
+    {
+      close (fd);
+      return false;
+    }
+  if (st.st_size > 0)
+    {
+      void *data = mmap (0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED)
+        {
+          close (fd);
+          return false;
+        }
+      // the file is read once, front to back
+      madvise (data, st.st_size, MADV_SEQUENTIAL);
+      m_data = data;
+      m_size = st.st_size;
+    }
+  // the mapping stays valid once the descriptor is closed
+  close (fd);
+  return true;
+}
+
+void
+MappedFile::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  if (m_data != 0)
+    {
+      munmap (m_data, m_size);
+    }
+  m_data = 0;
+  m_size = 0;
+}
+
+const char *
+MappedFile::GetData (void) const
+{
+  return static_cast<const char *> (m_data);
+}
+
+uint64_t
+MappedFile::GetSize (void) const
+{
+  return m_size;
+}
+
+} // namespace ns3
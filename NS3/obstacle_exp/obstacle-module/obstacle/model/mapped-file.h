@@ -0,0 +1,80 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdint.h>
+#include <string>
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief A file mapped read-only into memory, unmapped on destruction
+ */
+class MappedFile
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  MappedFile ();
+
+  /**
+   * \brief Destructor, unmaps the file
+   * \return none
+   */
+  ~MappedFile ();
+
+  /**
+   * \brief Maps a file. Any file mapped before is unmapped.
+   * \param filename the file to map
+   * \return false if the file cannot be opened or mapped
+   */
+  bool Open (const std::string &filename);
+
+  /**
+   * \brief Unmaps the file
+   * \return none
+   */
+  void Close (void);
+
+  /**
+   * \brief Gets the contents of the file
+   * \return the first byte of the file (0 if the file is empty)
+   */
+  const char *GetData (void) const;
+
+  /**
+   * \brief Gets the size of the file
+   * \return the size of the file in bytes
+   */
+  uint64_t GetSize (void) const;
+
+private:
+  MappedFile (const MappedFile &);
+  MappedFile &operator= (const MappedFile &);
+
+  void *m_data;
+  uint64_t m_size;
+};
+
+} // namespace ns3
+
+#endif /* MAPPED_FILE_H */
@@ -0,0 +1,117 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef OBSTACLE_BOX_H
+#define OBSTACLE_BOX_H
+
+#include <algorithm>
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief Axis-aligned bounding box of an obstacle footprint
+ */
+struct ObstacleBox
+{
+  double xMin;
+  double yMin;
+  double xMax;
+  double yMax;
+};
+
+/**
+ * \ingroup obstacle
+ * \brief Clips the 2D segment p + t d, t in [0, 1], against a box (slab test)
+ * \param px x of the first end of the segment
+ * \param py y of the first end of the segment
+ * \param dx x of the second end minus px
+ * \param dy y of the second end minus py
+ * \param box the box
+ * \param t0 filled with the parameter where the segment enters the box
+ * \param t1 filled with the parameter where the segment leaves the box
+ * \return true if the segment crosses or touches the box
+ */
+inline bool
+ClipSegmentToBox (double px, double py, double dx, double dy, const ObstacleBox &box,
+                  double &t0, double &t1)
+{
+  t0 = 0.0;
+  t1 = 1.0;
+
+  if (dx == 0.0)
+    {
+      if ((px < box.xMin) || (px > box.xMax))
+        {
+          return false;
+        }
+    }
+  else
+    {
+      double ta = (box.xMin - px) / dx;
+      double tb = (box.xMax - px) / dx;
+      t0 = std::max (t0, std::min (ta, tb));
+      t1 = std::min (t1, std::max (ta, tb));
+      if (t0 > t1)
+        {
+          return false;
+        }
+    }
+
+  if (dy == 0.0)
+    {
+      if ((py < box.yMin) || (py > box.yMax))
+        {
+          return false;
+        }
+    }
+  else
+    {
+      double ta = (box.yMin - py) / dy;
+      double tb = (box.yMax - py) / dy;
+      t0 = std::max (t0, std::min (ta, tb));
+      t1 = std::min (t1, std::max (ta, tb));
+      if (t0 > t1)
+        {
+          return false;
+        }
+    }
+
+  return true;
+}
+
+/**
+ * \ingroup obstacle
+ * \brief Tests if the 2D segment p + t d, t in [0, 1], crosses or touches a box
+ * \param px x of the first end of the segment
+ * \param py y of the first end of the segment
+ * \param dx x of the second end minus px
+ * \param dy y of the second end minus py
+ * \param box the box
+ * \return true if the segment crosses or touches the box
+ */
+inline bool
+SegmentCrossesBox (double px, double py, double dx, double dy, const ObstacleBox &box)
+{
+  double t0;
+  double t1;
+  return ClipSegmentToBox (px, py, dx, dy, box, t0, t1);
+}
+
+} // namespace ns3
+
+#endif /* OBSTACLE_BOX_H */
@@ -0,0 +1,195 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+
+#include "ns3/log.h"
+
+#include "obstacle-bvh.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ObstacleBvh");
+
+namespace {
+
+// at most this many obstacles per leaf
+const uint32_t LEAF_SIZE = 4;
+
+} // anonymous namespace
+
+ObstacleBvh::ObstacleBvh ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+ObstacleBvh::Build (const std::vector<Box> &boxes)
+{
+  NS_LOG_FUNCTION (this << boxes.size ());
+
+  m_boxes = boxes;
+  m_nodes.clear ();
+  m_order.resize (boxes.size ());
+  for (uint32_t i = 0; i < m_order.size (); i++)
+    {
+      m_order[i] = i;
+    }
+
+  if (!boxes.empty ())
+    {
+      // a binary tree with n / LEAF_SIZE leaves has less than
+      // 2 n / LEAF_SIZE nodes, plus some slack for partial leaves
+      m_nodes.reserve (2 * boxes.size () / LEAF_SIZE + 2);
+      BuildNode (boxes, 0, boxes.size ());
+    }
+
+  NS_LOG_INFO ("BVH of " << boxes.size () << " obstacles, " << m_nodes.size () << " nodes.");
+}
+
+uint32_t
+ObstacleBvh::BuildNode (const std::vector<Box> &boxes, uint32_t begin, uint32_t end)
+{
+  uint32_t index = m_nodes.size ();
+  m_nodes.push_back (Node ());
+
+  // bounds of the boxes, and of their centers
+  Box bounds = boxes[m_order[begin]];
+  double cxMin = 0.5 * (bounds.xMin + bounds.xMax);
+  double cxMax = cxMin;
+  double cyMin = 0.5 * (bounds.yMin + bounds.yMax);
+  double cyMax = cyMin;
+  for (uint32_t i = begin + 1; i < end; i++)
+    {
+      const Box &b = boxes[m_order[i]];
+      bounds.xMin = std::min (bounds.xMin, b.xMin);
+      bounds.yMin = std::min (bounds.yMin, b.yMin);
+      bounds.xMax = std::max (bounds.xMax, b.xMax);
+      bounds.yMax = std::max (bounds.yMax, b.yMax);
+      double cx = 0.5 * (b.xMin + b.xMax);
+      double cy = 0.5 * (b.yMin + b.yMax);
+      cxMin = std::min (cxMin, cx);
+      cxMax = std::max (cxMax, cx);
+      cyMin = std::min (cyMin, cy);
+      cyMax = std::max (cyMax, cy);
+    }
+  m_nodes[index].box = bounds;
+
+  if (end - begin <= LEAF_SIZE)
+    {
+      m_nodes[index].first = begin;
+      m_nodes[index].count = end - begin;
+      m_nodes[index].right = 0;
+      return index;
+    }
+
+  // split at the median center along the longest axis
+  bool alongX = (cxMax - cxMin) >= (cyMax - cyMin);
+  uint32_t middle = begin + (end - begin) / 2;
+  std::nth_element (m_order.begin () + begin, m_order.begin () + middle, m_order.begin () + end,
+                    [&boxes, alongX] (uint32_t a, uint32_t b)
+  {
+    const Box &ba = boxes[a];
+    const Box &bb = boxes[b];
+    return alongX ? (ba.xMin + ba.xMax) < (bb.xMin + bb.xMax)
+                  : (ba.yMin + ba.yMax) < (bb.yMin + bb.yMax);
+  });
+
+  m_nodes[index].first = 0;
+  m_nodes[index].count = 0;
+  BuildNode (boxes, begin, middle);
+  uint32_t right = BuildNode (boxes, middle, end);
+  m_nodes[index].right = right;
+  return index;
+}
+
+void
+ObstacleBvh::Query (double x1, double y1, double x2, double y2, std::vector<uint32_t> &result) const
+{
+  result.clear ();
+  if (m_nodes.empty ())
+    {
+      return;
+    }
+
+  double dx = x2 - x1;
+  double dy = y2 - y1;
+
+  // the depth is logarithmic in the number of obstacles,
+  // so a small fixed stack is enough
+  uint32_t stack[64];
+  uint32_t top = 0;
+  stack[top++] = 0;
+  while (top > 0)
+    {
+      const Node &node = m_nodes[stack[--top]];
+      if (!SegmentCrossesBox (x1, y1, dx, dy, node.box))
+        {
+          continue;
+        }
+      if (node.count > 0)
+        {
+          for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+              uint32_t obstacle = m_order[i];
+              if (SegmentCrossesBox (x1, y1, dx, dy, m_boxes[obstacle]))
+                {
+                  result.push_back (obstacle);
+                }
+            }
+        }
+      else
+        {
+          NS_ASSERT (top + 2 <= 64);
+          stack[top++] = node.right;
+          stack[top++] = &node - &m_nodes[0] + 1;
+        }
+    }
+
+  // report the obstacles in load order, whatever the traversal order
+  std::sort (result.begin (), result.end ());
+}
+
+void
+ObstacleBvh::Assign (const std::vector<Box> &boxes, const Node *nodes, uint32_t nNodes, const uint32_t *order)
+{
+  NS_LOG_FUNCTION (this << boxes.size () << nNodes);
+
+  m_boxes = boxes;
+  m_nodes.assign (nodes, nodes + nNodes);
+  m_order.assign (order, order + boxes.size ());
+}
+
+const std::vector<ObstacleBvh::Node> &
+ObstacleBvh::GetNodes (void) const
+{
+  return m_nodes;
+}
+
+const std::vector<uint32_t> &
+ObstacleBvh::GetOrder (void) const
+{
+  return m_order;
+}
+
+uint32_t
+ObstacleBvh::GetNNodes (void) const
+{
+  return m_nodes.size ();
+}
+
+} // namespace ns3
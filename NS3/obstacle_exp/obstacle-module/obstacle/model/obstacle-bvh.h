@@ -0,0 +1,125 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef OBSTACLE_BVH_H
+#define OBSTACLE_BVH_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "obstacle-box.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief Bounding volume hierarchy over the footprints of the obstacles
+ *
+ * Each obstacle is represented by the axis-aligned bounding box of its
+ * footprint. The boxes are split recursively at the median of their
+ * centers along the longest axis, down to a few boxes per leaf, and the
+ * nodes are stored in a flat array (depth first). A segment query walks
+ * only the nodes whose box the 2D projection of the segment crosses, and
+ * returns the obstacles whose own box it crosses: every obstacle that the
+ * segment may hit, and few others.
+ */
+class ObstacleBvh
+{
+public:
+  typedef ObstacleBox Box;
+
+  /**
+   * \brief A node of the hierarchy. Inner nodes: the left child follows
+   * the node, right is the right child and count is 0. Leaves: count
+   * obstacles, starting at first in the order array.
+   */
+  struct Node
+  {
+    Box box;
+    uint32_t first;
+    uint32_t count;
+    uint32_t right;
+  };
+
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  ObstacleBvh ();
+
+  /**
+   * \brief Builds the hierarchy. Any previous hierarchy is dropped.
+   * \param boxes the bounding box of every obstacle; the index of a box
+   * is the index reported by Query
+   * \return none
+   */
+  void Build (const std::vector<Box> &boxes);
+
+  /**
+   * \brief Sets a hierarchy built earlier (e.g., read from a compiled
+   * topology) instead of building it
+   * \param boxes the bounding box of every obstacle
+   * \param nodes the nodes, as returned by GetNodes
+   * \param nNodes the number of nodes
+   * \param order the obstacle order, as returned by GetOrder (one entry per box)
+   * \return none
+   */
+  void Assign (const std::vector<Box> &boxes, const Node *nodes, uint32_t nNodes, const uint32_t *order);
+
+  /**
+   * \brief Gets the nodes of the hierarchy, depth first
+   * \return the nodes
+   */
+  const std::vector<Node> &GetNodes (void) const;
+
+  /**
+   * \brief Gets the obstacle indices, grouped by leaf
+   * \return the obstacle order
+   */
+  const std::vector<uint32_t> &GetOrder (void) const;
+
+  /**
+   * \brief Finds the obstacles whose bounding box the 2D segment
+   * (x1, y1) - (x2, y2) crosses or touches
+   * \param x1 x of the first end of the segment
+   * \param y1 y of the first end of the segment
+   * \param x2 x of the second end of the segment
+   * \param y2 y of the second end of the segment
+   * \param result cleared, then filled with the indices of the obstacles,
+   * in increasing order
+   * \return none
+   */
+  void Query (double x1, double y1, double x2, double y2, std::vector<uint32_t> &result) const;
+
+  /**
+   * \brief Gets the number of nodes of the hierarchy
+   * \return the number of nodes
+   */
+  uint32_t GetNNodes (void) const;
+
+private:
+  // builds the subtree over m_order[begin, end), returns its node index
+  uint32_t BuildNode (const std::vector<Box> &boxes, uint32_t begin, uint32_t end);
+
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_order; // obstacle indices, grouped by leaf
+  std::vector<Box> m_boxes;      // obstacle boxes, by obstacle index
+};
+
+} // namespace ns3
+
+#endif /* OBSTACLE_BVH_H */
@@ -0,0 +1,288 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "ns3/log.h"
+
+#include "obstacle-grid.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ObstacleGrid");
+
+namespace {
+
+// upper bound on the number of cells, the cell size grows if needed
+const double MAX_CELLS = 16.0 * 1024 * 1024;
+
+// boxes are registered in the cells they overlap once grown by this
+// much (meters), so that a segment that touches a box exactly on a cell
+// border finds it in either cell
+const double REGISTRATION_MARGIN = 1e-6;
+
+// index of the cell holding coordinate v, clamped to the grid
+inline int32_t
+CellIndex (double v, double origin, double cellSize, uint32_t n)
+{
+  double i = std::floor ((v - origin) / cellSize);
+  if (i < 0.0)
+    {
+      return 0;
+    }
+  if (i >= n)
+    {
+      return n - 1;
+    }
+  return static_cast<int32_t> (i);
+}
+
+} // anonymous namespace
+
+ObstacleGrid::ObstacleGrid () :
+  m_cellSize (0.0),
+  m_nx (0),
+  m_ny (0)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_bounds.xMin = 0.0;
+  m_bounds.yMin = 0.0;
+  m_bounds.xMax = 0.0;
+  m_bounds.yMax = 0.0;
+}
+
+void
+ObstacleGrid::Build (const std::vector<ObstacleBox> &boxes, double cellSize)
+{
+  NS_LOG_FUNCTION (this << boxes.size () << cellSize);
+
+  m_boxes = boxes;
+  m_cellStart.clear ();
+  m_items.clear ();
+  m_cellSize = 0.0;
+  m_nx = 0;
+  m_ny = 0;
+  if (boxes.empty ())
+    {
+      return;
+    }
+
+  // bounds of the map, and mean side of the boxes
+  m_bounds = boxes[0];
+  double sides = 0.0;
+  for (std::vector<ObstacleBox>::const_iterator it = boxes.begin (); it != boxes.end (); ++it)
+    {
+      m_bounds.xMin = std::min (m_bounds.xMin, it->xMin);
+      m_bounds.yMin = std::min (m_bounds.yMin, it->yMin);
+      m_bounds.xMax = std::max (m_bounds.xMax, it->xMax);
+      m_bounds.yMax = std::max (m_bounds.yMax, it->yMax);
+      sides += 0.5 * ((it->xMax - it->xMin) + (it->yMax - it->yMin));
+    }
+  double width = m_bounds.xMax - m_bounds.xMin;
+  double height = m_bounds.yMax - m_bounds.yMin;
+
+  if (cellSize <= 0.0)
+    {
+      cellSize = 2.0 * sides / boxes.size ();
+    }
+  if (cellSize <= 0.0)
+    {
+      // only degenerate boxes
+      cellSize = std::max (1.0, std::max (width, height));
+    }
+  if ((width / cellSize + 1) * (height / cellSize + 1) > MAX_CELLS)
+    {
+      cellSize = std::sqrt (width * height / MAX_CELLS) + 1.0;
+      NS_LOG_WARN ("Too many grid cells, cell size raised to " << cellSize << " m.");
+    }
+  m_cellSize = cellSize;
+  m_nx = static_cast<uint32_t> (std::floor (width / cellSize)) + 1;
+  m_ny = static_cast<uint32_t> (std::floor (height / cellSize)) + 1;
+
+  // compressed lists: count, prefix sum, then fill
+  m_cellStart.assign (static_cast<size_t> (m_nx) * m_ny + 1, 0);
+  for (uint32_t pass = 0; pass < 2; pass++)
+    {
+      std::vector<uint32_t> next;
+      if (pass == 1)
+        {
+          for (size_t c = 1; c < m_cellStart.size (); c++)
+            {
+              m_cellStart[c] += m_cellStart[c - 1];
+            }
+          m_items.resize (m_cellStart.back ());
+          next.assign (m_cellStart.begin (), m_cellStart.end () - 1);
+        }
+      for (uint32_t i = 0; i < boxes.size (); i++)
+        {
+          const ObstacleBox &b = boxes[i];
+          int32_t ix0 = CellIndex (b.xMin - REGISTRATION_MARGIN, m_bounds.xMin, m_cellSize, m_nx);
+          int32_t ix1 = CellIndex (b.xMax + REGISTRATION_MARGIN, m_bounds.xMin, m_cellSize, m_nx);
+          int32_t iy0 = CellIndex (b.yMin - REGISTRATION_MARGIN, m_bounds.yMin, m_cellSize, m_ny);
+          int32_t iy1 = CellIndex (b.yMax + REGISTRATION_MARGIN, m_bounds.yMin, m_cellSize, m_ny);
+          for (int32_t iy = iy0; iy <= iy1; iy++)
+            {
+              for (int32_t ix = ix0; ix <= ix1; ix++)
+                {
+                  size_t c = static_cast<size_t> (iy) * m_nx + ix;
+                  if (pass == 0)
+                    {
+                      m_cellStart[c + 1]++;
+                    }
+                  else
+                    {
+                      m_items[next[c]++] = i;
+                    }
+                }
+            }
+        }
+    }
+
+  NS_LOG_INFO ("Grid of " << m_nx << "x" << m_ny << " cells of " << m_cellSize << " m, "
+               << m_items.size () << " entries for " << boxes.size () << " obstacles.");
+}
+
+void
+ObstacleGrid::VisitCell (int32_t ix, int32_t iy, double x1, double y1, double dx, double dy,
+                         std::vector<uint32_t> &result) const
+{
+  if ((ix < 0) || (iy < 0) || (ix >= static_cast<int32_t> (m_nx)) || (iy >= static_cast<int32_t> (m_ny)))
+    {
+      return;
+    }
+  size_t c = static_cast<size_t> (iy) * m_nx + ix;
+  for (uint32_t k = m_cellStart[c]; k < m_cellStart[c + 1]; k++)
+    {
+      uint32_t obstacle = m_items[k];
+      if (SegmentCrossesBox (x1, y1, dx, dy, m_boxes[obstacle]))
+        {
+          result.push_back (obstacle);
+        }
+    }
+}
+
+void
+ObstacleGrid::Query (double x1, double y1, double x2, double y2, std::vector<uint32_t> &result) const
+{
+  result.clear ();
+  if (m_items.empty ())
+    {
+      return;
+    }
+
+  double dx = x2 - x1;
+  double dy = y2 - y1;
+
+  // the part of the segment inside the grid
+  double t0;
+  double t1;
+  if (!ClipSegmentToBox (x1, y1, dx, dy, m_bounds, t0, t1))
+    {
+      return;
+    }
+
+  int32_t ix = CellIndex (x1 + t0 * dx, m_bounds.xMin, m_cellSize, m_nx);
+  int32_t iy = CellIndex (y1 + t0 * dy, m_bounds.yMin, m_cellSize, m_ny);
+  int32_t endIx = CellIndex (x1 + t1 * dx, m_bounds.xMin, m_cellSize, m_nx);
+  int32_t endIy = CellIndex (y1 + t1 * dy, m_bounds.yMin, m_cellSize, m_ny);
+
+  // DDA: tMaxX (tMaxY) is the parameter at which the segment crosses
+  // the next vertical (horizontal) cell border, tDeltaX (tDeltaY) the
+  // parameter increment between two such borders
+  int32_t stepX = (dx > 0.0) ? 1 : ((dx < 0.0) ? -1 : 0);
+  int32_t stepY = (dy > 0.0) ? 1 : ((dy < 0.0) ? -1 : 0);
+  double tMaxX = HUGE_VAL;
+  double tMaxY = HUGE_VAL;
+  double tDeltaX = HUGE_VAL;
+  double tDeltaY = HUGE_VAL;
+  if (stepX != 0)
+    {
+      double border = m_bounds.xMin + (ix + (stepX > 0 ? 1 : 0)) * m_cellSize;
+      tMaxX = (border - x1) / dx;
+      tDeltaX = m_cellSize / std::abs (dx);
+    }
+  if (stepY != 0)
+    {
+      double border = m_bounds.yMin + (iy + (stepY > 0 ? 1 : 0)) * m_cellSize;
+      tMaxY = (border - y1) / dy;
+      tDeltaY = m_cellSize / std::abs (dy);
+    }
+
+  while (true)
+    {
+      VisitCell (ix, iy, x1, y1, dx, dy, result);
+      if (((ix == endIx) && (iy == endIy)) || (std::min (tMaxX, tMaxY) > t1))
+        {
+          break;
+        }
+      if (tMaxX < tMaxY)
+        {
+          ix += stepX;
+          tMaxX += tDeltaX;
+        }
+      else if (tMaxY < tMaxX)
+        {
+          iy += stepY;
+          tMaxY += tDeltaY;
+        }
+      else
+        {
+          // through a cell corner: the two side cells are touched too
+          VisitCell (ix + stepX, iy, x1, y1, dx, dy, result);
+          VisitCell (ix, iy + stepY, x1, y1, dx, dy, result);
+          ix += stepX;
+          iy += stepY;
+          tMaxX += tDeltaX;
+          tMaxY += tDeltaY;
+        }
+      if ((ix < 0) || (iy < 0) || (ix >= static_cast<int32_t> (m_nx)) || (iy >= static_cast<int32_t> (m_ny)))
+        {
+          break;
+        }
+    }
+  // in case rounding stopped the walk one cell early
+  if ((ix != endIx) || (iy != endIy))
+    {
+      VisitCell (endIx, endIy, x1, y1, dx, dy, result);
+    }
+
+  // an obstacle that overlaps several cells is found once per cell
+  std::sort (result.begin (), result.end ());
+  result.erase (std::unique (result.begin (), result.end ()), result.end ());
+}
+
+double
+ObstacleGrid::GetCellSize (void) const
+{
+  return m_cellSize;
+}
+
+uint32_t
+ObstacleGrid::GetNx (void) const
+{
+  return m_nx;
+}
+
+uint32_t
+ObstacleGrid::GetNy (void) const
+{
+  return m_ny;
+}
+
+} // namespace ns3
@@ -0,0 +1,107 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef OBSTACLE_GRID_H
+#define OBSTACLE_GRID_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "obstacle-box.h"
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief Uniform 2D grid over the footprints of the obstacles
+ *
+ * The map is divided into square cells, and each cell lists the obstacles
+ * whose bounding box overlaps it (all the lists are stored back to back in
+ * one array). A segment query walks only the cells along the segment, with
+ * the 2D DDA of Amanatides and Woo ("A Fast Voxel Traversal Algorithm for
+ * Ray Tracing", 1987), so its cost grows with the length of the link and
+ * not with the number of obstacles.
+ */
+class ObstacleGrid
+{
+public:
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  ObstacleGrid ();
+
+  /**
+   * \brief Builds the grid. Any previous grid is dropped.
+   * \param boxes the bounding box of every obstacle; the index of a box
+   * is the index reported by Query
+   * \param cellSize the side of a cell in meters (0 means twice the mean
+   * side of the bounding boxes, so that an obstacle overlaps a few cells)
+   * \return none
+   */
+  void Build (const std::vector<ObstacleBox> &boxes, double cellSize);
+
+  /**
+   * \brief Finds the obstacles whose bounding box the 2D segment
+   * (x1, y1) - (x2, y2) crosses or touches
+   * \param x1 x of the first end of the segment
+   * \param y1 y of the first end of the segment
+   * \param x2 x of the second end of the segment
+   * \param y2 y of the second end of the segment
+   * \param result cleared, then filled with the indices of the obstacles,
+   * in increasing order
+   * \return none
+   */
+  void Query (double x1, double y1, double x2, double y2, std::vector<uint32_t> &result) const;
+
+  /**
+   * \brief Gets the side of a cell
+   * \return the side of a cell in meters (0 if the grid is empty)
+   */
+  double GetCellSize (void) const;
+
+  /**
+   * \brief Gets the number of cells along x
+   * \return the number of columns
+   */
+  uint32_t GetNx (void) const;
+
+  /**
+   * \brief Gets the number of cells along y
+   * \return the number of rows
+   */
+  uint32_t GetNy (void) const;
+
+private:
+  // appends the obstacles of a cell crossed by the segment
+  void VisitCell (int32_t ix, int32_t iy, double x1, double y1, double dx, double dy,
+                  std::vector<uint32_t> &result) const;
+
+  std::vector<ObstacleBox> m_boxes; // obstacle boxes, by obstacle index
+  ObstacleBox m_bounds;             // bounds of the grid
+  double m_cellSize;
+  uint32_t m_nx;
+  uint32_t m_ny;
+  // obstacles of cell c are m_items[m_cellStart[c]] to m_items[m_cellStart[c + 1] - 1];
+  // cell (ix, iy) is c = iy * m_nx + ix
+  std::vector<uint32_t> m_cellStart;
+  std::vector<uint32_t> m_items;
+};
+
+} // namespace ns3
+
+#endif /* OBSTACLE_GRID_H */
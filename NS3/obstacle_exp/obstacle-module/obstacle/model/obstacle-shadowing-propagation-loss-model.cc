@@ -20,10 +20,14 @@
  */
 
 #include "ns3/log.h"
+#include "ns3/boolean.h"
 #include "ns3/double.h"
 #include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/pointer.h"
 #include "ns3/mobility-model.h"
 #include <cmath>
+#include <limits>
 #include "ns3/topology.h"
 
 #include "obstacle-shadowing-propagation-loss-model.h"
@@ -42,18 +46,76 @@ ObstacleShadowingPropagationLossModel::GetTypeId (void)
   .SetParent<PropagationLossModel> ()
 	.SetGroupName ("Propagation")
   .AddConstructor<ObstacleShadowingPropagationLossModel> ()
+	.AddAttribute ("Topology",
+								 "Topology whose obstacles shadow the links; several models may share one. "
+								 "If not set, the default topology (Topology::GetTopology) is used",
+								 PointerValue (),
+								 MakePointerAccessor (&ObstacleShadowingPropagationLossModel::SetTopology,
+																			&ObstacleShadowingPropagationLossModel::GetTopology),
+								 MakePointerChecker<Topology> ())
 	.AddAttribute ("Radius",
-								 "Radius used for optimization (meters)",
+								 "Radius used for optimization (meters): only the obstacles whose center lies "
+								 "within Radius of both ends of a link shadow it (see LimitToRadius)",
 								 DoubleValue (200),
 								 MakeDoubleAccessor (&ObstacleShadowingPropagationLossModel::m_radius),
-								 MakeDoubleChecker<double> ());
+								 MakeDoubleChecker<double> ())
+	.AddAttribute ("LimitToRadius",
+								 "Apply the Radius heuristic of the original model, whatever the SpatialIndex "
+								 "(links longer than 2 Radius are then never shadowed). If false, every "
+								 "obstacle a link crosses shadows it, whatever its length",
+								 BooleanValue (true),
+								 MakeBooleanAccessor (&ObstacleShadowingPropagationLossModel::m_limitToRadius),
+								 MakeBooleanChecker ())
+	.AddAttribute ("CacheCapacity",
+								 "Maximum number of links whose obstructed loss is cached by the model "
+								 "(positions quantized to 0.1 m, least recently used links are evicted; 0 disables the cache)",
+								 UintegerValue (16384),
+								 MakeUintegerAccessor (&ObstacleShadowingPropagationLossModel::SetCacheCapacity,
+																			 &ObstacleShadowingPropagationLossModel::GetCacheCapacity),
+								 MakeUintegerChecker<uint32_t> ())
+	.AddAttribute ("Engine",
+								 "Engine used for the segment/obstacle intersection tests: exact (CGAL exact "
+								 "constructions) or inexact (double precision wall and roof tests, much faster)",
+								 EnumValue (Topology::ENGINE_EXACT),
+								 MakeEnumAccessor (&ObstacleShadowingPropagationLossModel::SetGeometryEngine,
+																	 &ObstacleShadowingPropagationLossModel::GetGeometryEngine),
+								 MakeEnumChecker (Topology::ENGINE_EXACT, "Exact",
+																	Topology::ENGINE_INEXACT, "Inexact"))
+	.AddAttribute ("SpatialIndex",
+								 "Index used to find the obstacles of a link: RangeTree (obstacle centers around "
+								 "the link), Bvh or Grid (obstacle bounding boxes crossed by the link; see the "
+								 "GridCellSize attribute of ns3::Topology). They give the same losses, except on links "
+								 "through several obstacles, where the last obstacle found gives the loss",
+								 EnumValue (Topology::INDEX_RANGE_TREE),
+								 MakeEnumAccessor (&ObstacleShadowingPropagationLossModel::SetSpatialIndex,
+																	 &ObstacleShadowingPropagationLossModel::GetSpatialIndex),
+								 MakeEnumChecker (Topology::INDEX_RANGE_TREE, "RangeTree",
+																	Topology::INDEX_BVH, "Bvh",
+																	Topology::INDEX_GRID, "Grid"))
+	.AddAttribute ("ValidationPeriod",
+								 "Evaluate one computed link out of this many with both engines and keep "
+								 "the maximum loss discrepancy (0 disables the validation)",
+								 UintegerValue (0),
+								 MakeUintegerAccessor (&ObstacleShadowingPropagationLossModel::SetValidationPeriod,
+																			 &ObstacleShadowingPropagationLossModel::GetValidationPeriod),
+								 MakeUintegerChecker<uint32_t> ());
 
   return tid;
 }
 
 ObstacleShadowingPropagationLossModel::ObstacleShadowingPropagationLossModel ()
-  : PropagationLossModel ()
+  : PropagationLossModel (),
+    m_limitToRadius (true),
+    m_topology (0),
+    m_cacheCapacity (16384),
+    m_engine (Topology::ENGINE_EXACT),
+    m_spatialIndex (Topology::INDEX_RANGE_TREE),
+    m_validationPeriod (0),
+    m_validationCounter (0),
+    m_validatedLinks (0),
+    m_maxLossDiscrepancy (0.0)
 {
+  m_cache.SetCapacity (m_cacheCapacity);
 }
 
 ObstacleShadowingPropagationLossModel::~ObstacleShadowingPropagationLossModel ()
@@ -63,37 +125,240 @@ ObstacleShadowingPropagationLossModel::~ObstacleShadowingPropagationLossModel ()
 double
 ObstacleShadowingPropagationLossModel::GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
 {
-  NS_LOG_FUNCTION (this);
+  // no logging here: the loss of several links may be asked
+  // from several threads at once
 
   // initialize = no loss
 
   double L_obs = 0.0;
 
   // get the topology instance, to search for obstacles
-  Topology * topology = Topology::GetTopology();
+  Topology * topology = GetTopologyInstance ();
   NS_ASSERT(topology != 0);
 
   if (topology->HasObstacles() == true)
     {
       // additional loss for obstacles
-      double p1_x = a->GetPosition ().x;
-      double p1_y = a->GetPosition ().y;
-			double p1_z = a->GetPosition ().z;
-      double p2_x = b->GetPosition ().x;
-      double p2_y = b->GetPosition ().y;
-			double p2_z = b->GetPosition ().z;
-      // for two points, p1 and p2
-      Point_3 p1(p1_x, p1_y, p1_z);
-      Point_3 p2(p2_x, p2_y, p2_z);
+      // for two points, p1 and p2 (plain doubles: no exact
+      // point is built unless the exact engine needs one)
+      Vector p1 = a->GetPosition ();
+      Vector p2 = b->GetPosition ();
+
+      // test first to see if we have a cached value
+      // for loss between these two points
+      // using their positions to the nearest 0.1m
+      // (B to A is same as A to B)
+      ObstructionCache::Key key = ObstructionCache::MakeKey (p1.x, p1.y, p1.z, p2.x, p2.y, p2.z);
+      {
+        std::lock_guard<std::mutex> lock (m_cacheMutex);
+        if (m_cache.Lookup (key, L_obs))
+          {
+            return L_obs;
+          }
+      }
 
       // and testing for obstacles within m_radius=200m
-      // get the obstructed loss, from the topology class
-      L_obs = topology->GetObstructedLossBetween(p1, p2, m_radius);
+      // get the obstructed loss, from the topology class, with the
+      // index and engine of this model (the topology is only read)
+      double radius = m_limitToRadius ? m_radius : std::numeric_limits<double>::infinity ();
+      static thread_local std::vector<uint32_t> candidates;
+      L_obs = topology->ComputeObstructedLoss (p1, p2, radius, m_spatialIndex, m_engine, candidates);
+
+      if ((m_validationPeriod > 0) && (m_validationCounter++ % m_validationPeriod == 0))
+        {
+          // evaluate the same link with the other engine
+          Topology::GeometryEngine other = (m_engine == Topology::ENGINE_EXACT)
+            ? Topology::ENGINE_INEXACT : Topology::ENGINE_EXACT;
+          double otherLoss = topology->GetCandidatesLoss (p1, p2, radius, candidates, other);
+          double discrepancy = std::abs (L_obs - otherLoss);
+
+          std::lock_guard<std::mutex> lock (m_validationMutex);
+          m_validatedLinks++;
+          if (discrepancy > m_maxLossDiscrepancy)
+            {
+              m_maxLossDiscrepancy = discrepancy;
+            }
+        }
+
+      {
+        std::lock_guard<std::mutex> lock (m_cacheMutex);
+        m_cache.Insert (key, L_obs);
+      }
     }
 
   return L_obs;
 }
 
+std::vector<double>
+ObstacleShadowingPropagationLossModel::ComputeLossMatrix (const std::vector<Vector> &positionsA,
+                                                          const std::vector<Vector> &positionsB,
+                                                          uint32_t nThreads) const
+{
+  NS_LOG_FUNCTION (this << positionsA.size () << positionsB.size () << nThreads);
+
+  Topology * topology = GetTopologyInstance ();
+  NS_ASSERT(topology != 0);
+
+  double radius = m_limitToRadius ? m_radius : std::numeric_limits<double>::infinity ();
+  std::vector<double> losses = topology->ComputeLossMatrix (positionsA, positionsB, radius,
+                                                            m_spatialIndex, m_engine, nThreads);
+
+  // as in GetLoss, the links are only cached if there are obstacles
+  if (topology->HasObstacles () && (m_cacheCapacity > 0))
+    {
+      uint64_t nB = positionsB.size ();
+      std::lock_guard<std::mutex> lock (m_cacheMutex);
+      // start from an empty cache: no link of the matrix is evicted
+      // before the capacity is reached
+      m_cache.Clear ();
+      for (uint64_t k = 0; k < losses.size (); k++)
+        {
+          const Vector &p1 = positionsA[k / nB];
+          const Vector &p2 = positionsB[k % nB];
+          m_cache.Insert (ObstructionCache::MakeKey (p1.x, p1.y, p1.z, p2.x, p2.y, p2.z), losses[k]);
+        }
+    }
+
+  return losses;
+}
+
+void
+ObstacleShadowingPropagationLossModel::SetTopology (Ptr<Topology> topology)
+{
+  NS_LOG_FUNCTION (this << topology);
+
+  m_topology = topology;
+
+  // the cached links belong to the previous topology
+  std::lock_guard<std::mutex> lock (m_cacheMutex);
+  m_cache.Clear ();
+}
+
+Ptr<Topology>
+ObstacleShadowingPropagationLossModel::GetTopology (void) const
+{
+  return m_topology;
+}
+
+Topology *
+ObstacleShadowingPropagationLossModel::GetTopologyInstance (void) const
+{
+  if (m_topology != 0)
+    {
+      return PeekPointer (m_topology);
+    }
+  return Topology::GetTopology ();
+}
+
+void
+ObstacleShadowingPropagationLossModel::SetCacheCapacity (uint32_t capacity)
+{
+  NS_LOG_FUNCTION (this << capacity);
+
+  m_cacheCapacity = capacity;
+  std::lock_guard<std::mutex> lock (m_cacheMutex);
+  if (m_cache.GetCapacity () != capacity)
+    {
+      m_cache.SetCapacity (capacity);
+    }
+}
+
+uint32_t
+ObstacleShadowingPropagationLossModel::GetCacheCapacity (void) const
+{
+  return m_cacheCapacity;
+}
+
+uint64_t
+ObstacleShadowingPropagationLossModel::GetCacheHits (void) const
+{
+  std::lock_guard<std::mutex> lock (m_cacheMutex);
+  return m_cache.GetHits ();
+}
+
+uint64_t
+ObstacleShadowingPropagationLossModel::GetCacheMisses (void) const
+{
+  std::lock_guard<std::mutex> lock (m_cacheMutex);
+  return m_cache.GetMisses ();
+}
+
+uint64_t
+ObstacleShadowingPropagationLossModel::GetCacheEvictions (void) const
+{
+  std::lock_guard<std::mutex> lock (m_cacheMutex);
+  return m_cache.GetEvictions ();
+}
+
+void
+ObstacleShadowingPropagationLossModel::SetGeometryEngine (Topology::GeometryEngine engine)
+{
+  NS_LOG_FUNCTION (this << engine);
+
+  if (engine != m_engine)
+    {
+      m_engine = engine;
+      // cached losses may come from the other engine
+      std::lock_guard<std::mutex> lock (m_cacheMutex);
+      m_cache.Clear ();
+    }
+}
+
+Topology::GeometryEngine
+ObstacleShadowingPropagationLossModel::GetGeometryEngine (void) const
+{
+  return m_engine;
+}
+
+void
+ObstacleShadowingPropagationLossModel::SetSpatialIndex (Topology::SpatialIndex index)
+{
+  NS_LOG_FUNCTION (this << index);
+
+  if (index != m_spatialIndex)
+    {
+      m_spatialIndex = index;
+      // links through several obstacles may get another loss
+      // with another index (see Topology::GetCandidatesLoss)
+      std::lock_guard<std::mutex> lock (m_cacheMutex);
+      m_cache.Clear ();
+    }
+}
+
+Topology::SpatialIndex
+ObstacleShadowingPropagationLossModel::GetSpatialIndex (void) const
+{
+  return m_spatialIndex;
+}
+
+void
+ObstacleShadowingPropagationLossModel::SetValidationPeriod (uint32_t period)
+{
+  NS_LOG_FUNCTION (this << period);
+
+  m_validationPeriod = period;
+}
+
+uint32_t
+ObstacleShadowingPropagationLossModel::GetValidationPeriod (void) const
+{
+  return m_validationPeriod;
+}
+
+uint64_t
+ObstacleShadowingPropagationLossModel::GetValidatedLinks (void) const
+{
+  std::lock_guard<std::mutex> lock (m_validationMutex);
+  return m_validatedLinks;
+}
+
+double
+ObstacleShadowingPropagationLossModel::GetMaxLossDiscrepancy (void) const
+{
+  std::lock_guard<std::mutex> lock (m_validationMutex);
+  return m_maxLossDiscrepancy;
+}
+
 double
 ObstacleShadowingPropagationLossModel::DoCalcRxPower (double txPowerDbm,
 						Ptr<MobilityModel> a,
@@ -23,6 +23,12 @@
 #define OBSTACLE_SHADOWING_PROPAGATION_LOSS_MODEL_H
 
 #include "ns3/propagation-loss-model.h"
+#include "ns3/topology.h"
+#include "ns3/obstruction-cache.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 namespace ns3 {
 
@@ -65,8 +71,131 @@ public:
    */
   double GetLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
 
+  /**
+   * \brief Computes the loss of every pair of positions on several
+   * threads, with the topology, radius, engine and index of the model
+   * (see Topology::ComputeLossMatrix: the exact engine runs serially).
+   * The losses replace the links held in the cache of the model, so
+   * that GetLoss finds them, as long as the cache can hold them all.
+   * The validation is not applied to these links.
+   * \param positionsA the first set of positions (e.g., end devices)
+   * \param positionsB the second set of positions (e.g., gateways)
+   * \param nThreads number of threads (0 means one per hardware thread)
+   * \return the losses (dB), row-major: entry i * positionsB.size () + j
+   * is the loss between positionsA[i] and positionsB[j]
+   */
+  std::vector<double> ComputeLossMatrix (const std::vector<Vector> &positionsA,
+                                         const std::vector<Vector> &positionsB,
+                                         uint32_t nThreads) const;
+
+  /**
+   * \brief Sets the topology whose obstacles shadow the links. The
+   * settings of the model (cache, engine, index and validation) are
+   * its own: they do not change the topology, which may be shared.
+   * The cached links are dropped.
+   * \param topology the topology (0 for the default topology, see
+   * Topology::GetTopology)
+   * \return none
+   */
+  void SetTopology (Ptr<Topology> topology);
+
+  /**
+   * \brief Gets the topology whose obstacles shadow the links
+   * \return the topology (0 if the model uses the default topology)
+   */
+  Ptr<Topology> GetTopology (void) const;
+
+  /**
+   * \brief Sets the maximum number of links kept in the obstruction cache
+   * of the model
+   * \param capacity the maximum number of links (0 disables the cache)
+   * \return none
+   */
+  void SetCacheCapacity (uint32_t capacity);
+
+  /**
+   * \brief Gets the maximum number of links kept in the obstruction cache
+   * \return the maximum number of links
+   */
+  uint32_t GetCacheCapacity (void) const;
+
+  /**
+   * \brief Gets the number of obstruction cache hits
+   * \return the number of links whose loss was found in the cache
+   */
+  uint64_t GetCacheHits (void) const;
+
+  /**
+   * \brief Gets the number of obstruction cache misses
+   * \return the number of links whose loss had to be computed
+   */
+  uint64_t GetCacheMisses (void) const;
+
+  /**
+   * \brief Gets the number of links evicted from the obstruction cache
+   * \return the number of evictions
+   */
+  uint64_t GetCacheEvictions (void) const;
+
+  /**
+   * \brief Sets the engine used by the model for the intersection tests
+   * \param engine the engine (exact or inexact)
+   * \return none
+   */
+  void SetGeometryEngine (Topology::GeometryEngine engine);
+
+  /**
+   * \brief Gets the engine used by the model for the intersection tests
+   * \return the engine
+   */
+  Topology::GeometryEngine GetGeometryEngine (void) const;
+
+  /**
+   * \brief Sets the index of the topology used by the model to find the
+   * obstacles on a link
+   * \param index the spatial index
+   * \return none
+   */
+  void SetSpatialIndex (Topology::SpatialIndex index);
+
+  /**
+   * \brief Gets the index of the topology used by the model to find the
+   * obstacles on a link
+   * \return the spatial index
+   */
+  Topology::SpatialIndex GetSpatialIndex (void) const;
+
+  /**
+   * \brief Sets how often a computed link is also evaluated with the other engine
+   * \param period one link out of period is validated (0 disables validation)
+   * \return none
+   */
+  void SetValidationPeriod (uint32_t period);
+
+  /**
+   * \brief Gets how often a computed link is also evaluated with the other engine
+   * \return the validation period (0 if disabled)
+   */
+  uint32_t GetValidationPeriod (void) const;
+
+  /**
+   * \brief Gets the number of links evaluated with both engines
+   * \return the number of validated links
+   */
+  uint64_t GetValidatedLinks (void) const;
+
+  /**
+   * \brief Gets the largest loss difference between both engines
+   * over the validated links
+   * \return the maximum absolute loss discrepancy (dB)
+   */
+  double GetMaxLossDiscrepancy (void) const;
+
 private:
 
+  // the topology in use: m_topology, or the default one
+  Topology *GetTopologyInstance (void) const;
+
   // inherited from PropagationLossModel
   virtual double DoCalcRxPower (double txPowerDbm,
                                 Ptr<MobilityModel> a,
@@ -74,6 +203,28 @@ private:
   virtual int64_t DoAssignStreams (int64_t stream);
 
 	double	m_radius;
+  bool m_limitToRadius;
+
+  Ptr<Topology> m_topology; // 0 for the default topology
+
+  // settings of the model; the topology is only read
+  uint32_t m_cacheCapacity;
+  Topology::GeometryEngine m_engine;
+  Topology::SpatialIndex m_spatialIndex;
+  uint32_t m_validationPeriod;
+
+  // losses of the links already computed by the model; the mutex
+  // serializes the accesses, so that GetLoss may be called from
+  // several threads
+  mutable ObstructionCache m_cache;
+  mutable std::mutex m_cacheMutex;
+
+  // validation of one engine against the other:
+  // one computed link out of m_validationPeriod is evaluated twice
+  mutable std::atomic<uint64_t> m_validationCounter;
+  mutable uint64_t m_validatedLinks;
+  mutable double m_maxLossDiscrepancy;
+  mutable std::mutex m_validationMutex;
 };
 
 } // namespace ns3
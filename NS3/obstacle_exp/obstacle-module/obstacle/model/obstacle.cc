@@ -35,7 +35,11 @@ Obstacle::Obstacle() :
   // Radio Shadowing in Urban Environments;
   m_beta(9.0),
   m_gamma(0.4),
-	m_height (0)
+	m_height (0),
+  m_centerX (0),
+  m_centerY (0),
+  m_firstEdge (0),
+  m_nEdges (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -59,8 +63,6 @@ Obstacle::GetId()
 Polygon_2 &
 Obstacle::GetPolygon()
 {
-  NS_LOG_FUNCTION (this);
-
   return m_obstacle;
 }
 
@@ -88,47 +90,96 @@ Obstacle::Locate()
   double cy = (double)(by + (bbox.ymax() - by));
 
   m_center = Point(cx, cy);
+  m_centerX = cx;
+  m_centerY = cy;
 
   m_radiusSq = (cx - bx) * (cx - bx) + (cy - by) * (cy - by);
+
+  // keep a double precision copy of the vertices,
+  // so that inexact tests do not touch the exact kernel
+  m_vx.clear ();
+  m_vy.clear ();
+  m_vx.reserve (m_obstacle.size ());
+  m_vy.reserve (m_obstacle.size ());
+  for (Polygon_2::Vertex_const_iterator it = m_obstacle.vertices_begin (); it != m_obstacle.vertices_end (); ++it)
+    {
+      m_vx.push_back (CGAL::to_double (it->x ()));
+      m_vy.push_back (CGAL::to_double (it->y ()));
+    }
+}
+
+const std::vector<double> &
+Obstacle::GetVerticesX()
+{
+  return m_vx;
+}
+
+const std::vector<double> &
+Obstacle::GetVerticesY()
+{
+  return m_vy;
+}
+
+void
+Obstacle::SetEdges(uint32_t first, uint32_t count)
+{
+  NS_LOG_FUNCTION (this << first << count);
+
+  m_firstEdge = first;
+  m_nEdges = count;
+}
+
+uint32_t
+Obstacle::GetFirstEdge()
+{
+  return m_firstEdge;
+}
+
+uint32_t
+Obstacle::GetNEdges()
+{
+  return m_nEdges;
 }
 
 const Point &
 Obstacle::GetCenter()
 {
-  NS_LOG_FUNCTION (this);
-
   return m_center;
 }
 
 double
-Obstacle::GetRadiusSq()
+Obstacle::GetCenterX()
 {
-  NS_LOG_FUNCTION (this);
+  return m_centerX;
+}
+
+double
+Obstacle::GetCenterY()
+{
+  return m_centerY;
+}
 
+double
+Obstacle::GetRadiusSq()
+{
   return m_radiusSq;
 }
 
 double
 Obstacle::GetBeta()
 {
-  NS_LOG_FUNCTION (this);
-
   return m_beta;
 }
 
 double
 Obstacle::GetGamma()
 {
-  NS_LOG_FUNCTION (this);
-
   return m_gamma;
 }
 
 double
 Obstacle::GetHeight()
 {
-  NS_LOG_FUNCTION (this);
-
   return m_height;
 }
 
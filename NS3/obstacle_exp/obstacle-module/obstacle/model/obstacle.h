@@ -25,6 +25,7 @@
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <vector>
 #include "ns3/core-module.h"
 
 // CGAL includes
@@ -60,6 +61,9 @@ namespace ns3 {
  * \brief The Obstacle class maintains the information for a
  * polygon representation of an Obstacle and per-wall and per-meter
  * attenuation values.
+ *
+ * The getters read by the loss queries do not log, since the
+ * queries may run on several threads at once.
  */
 class Obstacle
 {
@@ -107,6 +111,18 @@ public:
    */
   const Point &GetCenter();
 
+  /**
+   * \brief Get the x coordinate of the centerpoint, in double precision
+   * \return the x coordinate of the centerpoint
+   */
+  double GetCenterX();
+
+  /**
+   * \brief Get the y coordinate of the centerpoint, in double precision
+   * \return the y coordinate of the centerpoint
+   */
+  double GetCenterY();
+
   /**
    * \brief Gets the radius of the Obstacle3Ds region
    * (squared for performance optimizations)
@@ -122,6 +138,41 @@ public:
    */
   Polygon_2 &GetPolygon();
 
+  /**
+   * \brief Gets the x coordinates of the vertices, in double precision
+   * (filled in by Locate, for the inexact intersection tests)
+   * \return the x coordinates of the vertices, in polygon order
+   */
+  const std::vector<double> &GetVerticesX();
+
+  /**
+   * \brief Gets the y coordinates of the vertices, in double precision
+   * (filled in by Locate, for the inexact intersection tests)
+   * \return the y coordinates of the vertices, in polygon order
+   */
+  const std::vector<double> &GetVerticesY();
+
+  /**
+   * \brief Sets the range of the walls of the Obstacle in the edge table
+   * of the topology
+   * \param first index of the first wall
+   * \param count number of walls
+   * \return none
+   */
+  void SetEdges(uint32_t first, uint32_t count);
+
+  /**
+   * \brief Gets the index of the first wall of the Obstacle in the edge table
+   * \return the index of the first wall
+   */
+  uint32_t GetFirstEdge();
+
+  /**
+   * \brief Gets the number of walls of the Obstacle in the edge table
+   * \return the number of walls
+   */
+  uint32_t GetNEdges();
+
   /**
    * \brief Gets the value of beta, the per-wall
    * attenuation parameter
@@ -189,6 +240,16 @@ private:
   double m_gamma; // per-meter attenuation parameter
 
 	double m_height; // height of the obstacle [in meters]
+
+  // double precision copies of m_center and of the vertices of m_obstacle
+  double m_centerX;
+  double m_centerY;
+  std::vector<double> m_vx;
+  std::vector<double> m_vy;
+
+  // walls of the obstacle in the edge table of the topology
+  uint32_t m_firstEdge;
+  uint32_t m_nEdges;
 };
 
 }
@@ -0,0 +1,290 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <cmath>
+#include <utility>
+
+#include "ns3/log.h"
+
+#include "obstruction-cache.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("ObstructionCache");
+
+bool
+ObstructionCache::Key::operator== (const Key &other) const
+{
+  return q[0] == other.q[0] && q[1] == other.q[1] && q[2] == other.q[2]
+         && q[3] == other.q[3] && q[4] == other.q[4] && q[5] == other.q[5];
+}
+
+ObstructionCache::ObstructionCache () :
+  m_mask (0),
+  m_capacity (0),
+  m_size (0),
+  m_hand (0),
+  m_hits (0),
+  m_misses (0),
+  m_evictions (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+ObstructionCache::Key
+ObstructionCache::MakeKey (double p1x, double p1y, double p1z,
+                           double p2x, double p2y, double p2z)
+{
+  // two points that have not moved more than 0.1m
+  // share the same key
+  int64_t a[3] = {std::llround (p1x * 10.0), std::llround (p1y * 10.0), std::llround (p1z * 10.0)};
+  int64_t b[3] = {std::llround (p2x * 10.0), std::llround (p2y * 10.0), std::llround (p2z * 10.0)};
+
+  // B to A is same as A to B: lowest point goes first
+  bool swap = (b[0] < a[0])
+              || (b[0] == a[0] && b[1] < a[1])
+              || (b[0] == a[0] && b[1] == a[1] && b[2] < a[2]);
+  const int64_t *first = swap ? b : a;
+  const int64_t *second = swap ? a : b;
+
+  Key key;
+  key.q[0] = first[0];
+  key.q[1] = first[1];
+  key.q[2] = first[2];
+  key.q[3] = second[0];
+  key.q[4] = second[1];
+  key.q[5] = second[2];
+  return key;
+}
+
+uint32_t
+ObstructionCache::Hash (const Key &key)
+{
+  uint64_t h = 0x9e3779b97f4a7c15ULL;
+  for (int i = 0; i < 6; i++)
+    {
+      // splitmix64 finalizer on each coordinate
+      uint64_t v = static_cast<uint64_t> (key.q[i]) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+      v = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      v = (v ^ (v >> 27)) * 0x94d049bb133111ebULL;
+      h ^= v ^ (v >> 31);
+    }
+  return static_cast<uint32_t> (h ^ (h >> 32));
+}
+
+void
+ObstructionCache::SetCapacity (uint32_t capacity)
+{
+  NS_LOG_FUNCTION (this << capacity);
+
+  m_capacity = capacity;
+
+  // keep the load factor at or below 1/2, so that probe chains stay short
+  uint32_t slots = 0;
+  if (capacity > 0)
+    {
+      slots = 1;
+      while (slots < 2 * static_cast<uint64_t> (capacity))
+        {
+          slots <<= 1;
+        }
+    }
+  m_slots.assign (slots, Slot ());
+  m_mask = (slots > 0) ? slots - 1 : 0;
+  m_size = 0;
+  m_hand = 0;
+}
+
+uint32_t
+ObstructionCache::GetCapacity (void) const
+{
+  return m_capacity;
+}
+
+uint32_t
+ObstructionCache::GetSize (void) const
+{
+  return m_size;
+}
+
+bool
+ObstructionCache::Lookup (const Key &key, double &loss)
+{
+  if (m_slots.empty ())
+    {
+      m_misses++;
+      return false;
+    }
+
+  uint32_t hash = Hash (key);
+  uint32_t i = hash & m_mask;
+  while (m_slots[i].used)
+    {
+      Slot &slot = m_slots[i];
+      if (slot.hash == hash && slot.key == key)
+        {
+          slot.referenced = 1;
+          loss = slot.loss;
+          m_hits++;
+          return true;
+        }
+      i = (i + 1) & m_mask;
+    }
+  m_misses++;
+  return false;
+}
+
+void
+ObstructionCache::Insert (const Key &key, double loss)
+{
+  if (m_slots.empty ())
+    {
+      return;
+    }
+
+  uint32_t hash = Hash (key);
+  uint32_t i = hash & m_mask;
+  while (m_slots[i].used)
+    {
+      if (m_slots[i].hash == hash && m_slots[i].key == key)
+        {
+          // already cached, just refresh it
+          m_slots[i].loss = loss;
+          m_slots[i].referenced = 1;
+          return;
+        }
+      i = (i + 1) & m_mask;
+    }
+
+  if (m_size >= m_capacity)
+    {
+      EvictOne ();
+      // the eviction may have shifted the probe chain
+      i = hash & m_mask;
+      while (m_slots[i].used)
+        {
+          i = (i + 1) & m_mask;
+        }
+    }
+
+  Slot &slot = m_slots[i];
+  slot.key = key;
+  slot.loss = loss;
+  slot.hash = hash;
+  slot.used = 1;
+  slot.referenced = 1;
+  m_size++;
+}
+
+void
+ObstructionCache::EvictOne (void)
+{
+  // sweep the clock hand, giving a second chance to
+  // every entry that was referenced since the last sweep
+  while (true)
+    {
+      Slot &slot = m_slots[m_hand];
+      if (slot.used)
+        {
+          if (slot.referenced)
+            {
+              slot.referenced = 0;
+            }
+          else
+            {
+              // the hand stays here: EraseAt may move
+              // another entry into this slot
+              EraseAt (m_hand);
+              m_evictions++;
+              return;
+            }
+        }
+      m_hand = (m_hand + 1) & m_mask;
+    }
+}
+
+void
+ObstructionCache::EraseAt (uint32_t index)
+{
+  // backward-shift deletion, so that no tombstone is needed
+  uint32_t i = index;
+  uint32_t j = index;
+  while (true)
+    {
+      j = (j + 1) & m_mask;
+      if (!m_slots[j].used)
+        {
+          break;
+        }
+      uint32_t home = m_slots[j].hash & m_mask;
+      // move the entry at j into the hole at i, unless its
+      // home slot lies cyclically in (i, j]
+      bool move = (i <= j) ? ((home <= i) || (home > j)) : ((home <= i) && (home > j));
+      if (move)
+        {
+          m_slots[i] = m_slots[j];
+          i = j;
+        }
+    }
+  m_slots[i].used = 0;
+  m_slots[i].referenced = 0;
+  m_size--;
+}
+
+void
+ObstructionCache::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  for (std::vector<Slot>::iterator it = m_slots.begin (); it != m_slots.end (); ++it)
+    {
+      it->used = 0;
+      it->referenced = 0;
+    }
+  m_size = 0;
+  m_hand = 0;
+}
+
+uint64_t
+ObstructionCache::GetHits (void) const
+{
+  return m_hits;
+}
+
+uint64_t
+ObstructionCache::GetMisses (void) const
+{
+  return m_misses;
+}
+
+uint64_t
+ObstructionCache::GetEvictions (void) const
+{
+  return m_evictions;
+}
+
+void
+ObstructionCache::ResetCounters (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_hits = 0;
+  m_misses = 0;
+  m_evictions = 0;
+}
+
+} // namespace ns3
@@ -0,0 +1,165 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef OBSTRUCTION_CACHE_H
+#define OBSTRUCTION_CACHE_H
+
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief A fixed-capacity cache of obstructed losses between two points.
+ *
+ * Positions are quantized to 0.1 m and each pair of points is stored in
+ * canonical (unordered) form, so that the A to B and the B to A links
+ * share the same entry. Entries are kept in an open-addressing hash table
+ * with linear probing. Once the cache holds Capacity entries, an entry is
+ * evicted following the CLOCK (second chance) approximation of LRU.
+ */
+class ObstructionCache
+{
+public:
+  /**
+   * \brief A quantized, canonical pair of 3D points
+   */
+  struct Key
+  {
+    int64_t q[6]; //!< x, y, z of the lowest point, then x, y, z of the other
+
+    bool operator== (const Key &other) const;
+  };
+
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  ObstructionCache ();
+
+  /**
+   * \brief Build the key of the link between two points
+   * \param p1x x of point1
+   * \param p1y y of point1
+   * \param p1z z of point1
+   * \param p2x x of point2
+   * \param p2y y of point2
+   * \param p2z z of point2
+   * \return the key, identical for (p1, p2) and (p2, p1)
+   */
+  static Key MakeKey (double p1x, double p1y, double p1z,
+                      double p2x, double p2y, double p2z);
+
+  /**
+   * \brief Sets the maximum number of cached links. Any cached value is dropped.
+   * \param capacity the maximum number of entries (0 disables the cache)
+   * \return none
+   */
+  void SetCapacity (uint32_t capacity);
+
+  /**
+   * \brief Gets the maximum number of cached links
+   * \return the maximum number of entries
+   */
+  uint32_t GetCapacity (void) const;
+
+  /**
+   * \brief Gets the number of cached links
+   * \return the number of entries currently held
+   */
+  uint32_t GetSize (void) const;
+
+  /**
+   * \brief Looks a link up in the cache
+   * \param key the key of the link
+   * \param loss filled with the cached loss, if found
+   * \return true if the link was cached
+   */
+  bool Lookup (const Key &key, double &loss);
+
+  /**
+   * \brief Stores the loss of a link, evicting an entry if the cache is full
+   * \param key the key of the link
+   * \param loss the loss to be cached
+   * \return none
+   */
+  void Insert (const Key &key, double loss);
+
+  /**
+   * \brief Drops every cached link (counters are kept)
+   * \return none
+   */
+  void Clear (void);
+
+  /**
+   * \brief Gets the number of lookups that found the link
+   * \return the number of hits
+   */
+  uint64_t GetHits (void) const;
+
+  /**
+   * \brief Gets the number of lookups that did not find the link
+   * \return the number of misses
+   */
+  uint64_t GetMisses (void) const;
+
+  /**
+   * \brief Gets the number of entries evicted to make room for new ones
+   * \return the number of evictions
+   */
+  uint64_t GetEvictions (void) const;
+
+  /**
+   * \brief Resets hit, miss and eviction counters
+   * \return none
+   */
+  void ResetCounters (void);
+
+private:
+  // one entry of the hash table (64 bytes, i.e., one cache line)
+  struct Slot
+  {
+    Key key;
+    double loss;
+    uint32_t hash;
+    uint8_t used;       // slot holds an entry
+    uint8_t referenced; // CLOCK reference bit
+  };
+
+  static uint32_t Hash (const Key &key);
+
+  // remove the entry at index, shifting back the entries of its probe chain
+  void EraseAt (uint32_t index);
+
+  // evict one entry, following the CLOCK policy
+  void EvictOne (void);
+
+  std::vector<Slot> m_slots;
+  uint32_t m_mask;     // m_slots.size () - 1 (the size is a power of two)
+  uint32_t m_capacity; // maximum number of entries
+  uint32_t m_size;     // current number of entries
+  uint32_t m_hand;     // CLOCK hand
+
+  uint64_t m_hits;
+  uint64_t m_misses;
+  uint64_t m_evictions;
+};
+
+} // namespace ns3
+
+#endif /* OBSTRUCTION_CACHE_H */
@@ -0,0 +1,433 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ns3/log.h"
+#include "ns3/boolean.h"
+#include "ns3/pointer.h"
+#include "ns3/uinteger.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "precomputed-link-loss-model.h"
+#include "obstacle-shadowing-propagation-loss-model.h"
+
+NS_LOG_COMPONENT_DEFINE ("PrecomputedLinkLossModel");
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (PrecomputedLinkLossModel);
+
+namespace {
+
+// positions of the same allocator are bit for bit equal
+bool
+SamePosition (const Vector &a, const Vector &b)
+{
+  return (a.x == b.x) && (a.y == b.y) && (a.z == b.z);
+}
+
+std::tuple<double, double, double>
+PositionKey (const Vector &position)
+{
+  return std::make_tuple (position.x, position.y, position.z);
+}
+
+} // anonymous namespace
+
+TypeId
+PrecomputedLinkLossModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::PrecomputedLinkLossModel")
+
+  .SetParent<PropagationLossModel> ()
+	.SetGroupName ("Propagation")
+  .AddConstructor<PrecomputedLinkLossModel> ()
+	.AddAttribute ("DeterministicModel",
+								 "The deterministic loss model (or chain) evaluated once per link",
+								 PointerValue (),
+								 MakePointerAccessor (&PrecomputedLinkLossModel::SetDeterministicModel,
+																			&PrecomputedLinkLossModel::GetDeterministicModel),
+								 MakePointerChecker<PropagationLossModel> ())
+	.AddAttribute ("DeviceToDevice",
+								 "Also keep the end device to end device links, each one computed on its "
+								 "first use (memory grows with the square of the number of end devices)",
+								 BooleanValue (false),
+								 MakeBooleanAccessor (&PrecomputedLinkLossModel::m_deviceToDevice),
+								 MakeBooleanChecker ())
+	.AddAttribute ("Threads",
+								 "Number of threads computing the obstacle losses of the links in Precompute "
+								 "(0 means one per hardware thread; the exact engine of the obstacle "
+								 "models always runs on one thread)",
+								 UintegerValue (0),
+								 MakeUintegerAccessor (&PrecomputedLinkLossModel::m_nThreads),
+								 MakeUintegerChecker<uint32_t> ());
+
+  return tid;
+}
+
+PrecomputedLinkLossModel::PrecomputedLinkLossModel ()
+  : PropagationLossModel (),
+    m_deviceToDevice (false),
+    m_nThreads (0),
+    m_nEd (0),
+    m_nGw (0)
+{
+}
+
+PrecomputedLinkLossModel::~PrecomputedLinkLossModel ()
+{
+}
+
+void
+PrecomputedLinkLossModel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // releases the mobility models of the nodes
+  Clear ();
+  m_model = 0;
+  PropagationLossModel::DoDispose ();
+}
+
+void
+PrecomputedLinkLossModel::SetDeterministicModel (Ptr<PropagationLossModel> model)
+{
+  NS_LOG_FUNCTION (this << model);
+
+  m_model = model;
+  // values computed with another model are meaningless now
+  Clear ();
+}
+
+Ptr<PropagationLossModel>
+PrecomputedLinkLossModel::GetDeterministicModel (void) const
+{
+  return m_model;
+}
+
+double
+PrecomputedLinkLossModel::EvaluateLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+{
+  if (m_model == 0)
+    {
+      return 0.0;
+    }
+  // deterministic models are linear in the transmission power,
+  // so the loss is what is left of a 0 dBm transmission
+  return -m_model->CalcRxPower (0.0, a, b);
+}
+
+void
+PrecomputedLinkLossModel::Precompute (NodeContainer endDevices, NodeContainer gateways)
+{
+  NS_LOG_FUNCTION (this);
+
+  Clear ();
+
+  m_edMobility.reserve (endDevices.GetN ());
+  m_gwMobility.reserve (gateways.GetN ());
+
+  for (NodeContainer::Iterator it = endDevices.Begin (); it != endDevices.End (); ++it)
+    {
+      Ptr<MobilityModel> mobility = (*it)->GetObject<MobilityModel> ();
+      NS_ASSERT (mobility != 0);
+      m_edIndex[PeekPointer (mobility)] = m_edMobility.size ();
+      // nodes at the same position have the same links: keep the first
+      m_edByPosition.insert (std::make_pair (PositionKey (mobility->GetPosition ()), m_edMobility.size ()));
+      m_edPosition.push_back (mobility->GetPosition ());
+      m_edMobility.push_back (mobility);
+    }
+  for (NodeContainer::Iterator it = gateways.Begin (); it != gateways.End (); ++it)
+    {
+      Ptr<MobilityModel> mobility = (*it)->GetObject<MobilityModel> ();
+      NS_ASSERT (mobility != 0);
+      m_gwIndex[PeekPointer (mobility)] = m_gwMobility.size ();
+      m_gwByPosition.insert (std::make_pair (PositionKey (mobility->GetPosition ()), m_gwMobility.size ()));
+      m_gwPosition.push_back (mobility->GetPosition ());
+      m_gwMobility.push_back (mobility);
+    }
+  m_nEd = m_edMobility.size ();
+  m_nGw = m_gwMobility.size ();
+
+  // The obstacle stages of the wrapped chain are the costly part: their
+  // links are computed on several threads (see
+  // ObstacleShadowingPropagationLossModel::ComputeLossMatrix), a block of
+  // end devices at a time, into the cache of each stage. The chain is
+  // then evaluated on this thread, and its obstacle stages find every
+  // link of the block in their cache (B to A is the same entry as A to B).
+  std::vector<Ptr<ObstacleShadowingPropagationLossModel> > obstacleStages;
+  uint32_t blockSize = std::max (m_nEd, 1u);
+  for (Ptr<PropagationLossModel> stage = m_model; stage != 0; stage = stage->GetNext ())
+    {
+      Ptr<ObstacleShadowingPropagationLossModel> obstacle = DynamicCast<ObstacleShadowingPropagationLossModel> (stage);
+      // a cache smaller than the links of one end device is of no help
+      if ((obstacle != 0) && (m_nGw > 0) && (obstacle->GetCacheCapacity () >= m_nGw))
+        {
+          obstacleStages.push_back (obstacle);
+          blockSize = std::min (blockSize, obstacle->GetCacheCapacity () / m_nGw);
+        }
+    }
+
+  m_uplink.resize (static_cast<size_t> (m_nEd) * m_nGw);
+  m_downlink.resize (static_cast<size_t> (m_nGw) * m_nEd);
+  for (uint32_t first = 0; first < m_nEd; first += blockSize)
+    {
+      uint32_t last = std::min (first + blockSize, m_nEd);
+      if (!obstacleStages.empty ())
+        {
+          std::vector<Vector> block (m_edPosition.begin () + first, m_edPosition.begin () + last);
+          for (uint32_t s = 0; s < obstacleStages.size (); s++)
+            {
+              obstacleStages[s]->ComputeLossMatrix (block, m_gwPosition, m_nThreads);
+            }
+        }
+      for (uint32_t i = first; i < last; i++)
+        {
+          for (uint32_t j = 0; j < m_nGw; j++)
+            {
+              m_uplink[static_cast<size_t> (i) * m_nGw + j] = EvaluateLoss (m_edMobility[i], m_gwMobility[j]);
+              m_downlink[static_cast<size_t> (j) * m_nEd + i] = EvaluateLoss (m_gwMobility[j], m_edMobility[i]);
+            }
+        }
+    }
+
+  if (m_deviceToDevice)
+    {
+      // O(m_nEd^2) links, most of which are never used: each one is
+      // evaluated on its first use, in DoCalcRxPower
+      m_d2d.assign (static_cast<size_t> (m_nEd) * m_nEd, std::numeric_limits<float>::quiet_NaN ());
+    }
+
+  NS_LOG_INFO ("Precomputed " << GetNLinks () << " links (" << m_nEd << " end devices, "
+               << m_nGw << " gateways, "
+               << (m_uplink.size () + m_downlink.size () + m_d2d.size ()) * sizeof (float) / 1024
+               << " KiB).");
+}
+
+bool
+PrecomputedLinkLossModel::Bind (NodeContainer endDevices, NodeContainer gateways)
+{
+  NS_LOG_FUNCTION (this);
+
+  if ((endDevices.GetN () != m_nEd) || (gateways.GetN () != m_nGw))
+    {
+      NS_LOG_WARN ("Cannot bind " << endDevices.GetN () << " end devices and " << gateways.GetN ()
+                   << " gateways to a matrix of " << m_nEd << " x " << m_nGw << ".");
+      return false;
+    }
+
+  // check every position before touching the index maps
+  std::vector<Ptr<MobilityModel> > edMobility;
+  std::vector<Ptr<MobilityModel> > gwMobility;
+  edMobility.reserve (m_nEd);
+  gwMobility.reserve (m_nGw);
+  for (NodeContainer::Iterator it = endDevices.Begin (); it != endDevices.End (); ++it)
+    {
+      Ptr<MobilityModel> mobility = (*it)->GetObject<MobilityModel> ();
+      NS_ASSERT (mobility != 0);
+      if (!SamePosition (mobility->GetPosition (), m_edPosition[edMobility.size ()]))
+        {
+          NS_LOG_WARN ("End device " << edMobility.size () << " moved, cannot bind.");
+          return false;
+        }
+      edMobility.push_back (mobility);
+    }
+  for (NodeContainer::Iterator it = gateways.Begin (); it != gateways.End (); ++it)
+    {
+      Ptr<MobilityModel> mobility = (*it)->GetObject<MobilityModel> ();
+      NS_ASSERT (mobility != 0);
+      if (!SamePosition (mobility->GetPosition (), m_gwPosition[gwMobility.size ()]))
+        {
+          NS_LOG_WARN ("Gateway " << gwMobility.size () << " moved, cannot bind.");
+          return false;
+        }
+      gwMobility.push_back (mobility);
+    }
+
+  m_edIndex.clear ();
+  m_gwIndex.clear ();
+  for (uint32_t i = 0; i < m_nEd; i++)
+    {
+      m_edIndex[PeekPointer (edMobility[i])] = i;
+    }
+  for (uint32_t j = 0; j < m_nGw; j++)
+    {
+      m_gwIndex[PeekPointer (gwMobility[j])] = j;
+    }
+  m_edMobility.swap (edMobility);
+  m_gwMobility.swap (gwMobility);
+
+  NS_LOG_INFO ("Bound " << GetNLinks () << " precomputed links to new nodes.");
+  return true;
+}
+
+void
+PrecomputedLinkLossModel::Clear (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  m_edIndex.clear ();
+  m_gwIndex.clear ();
+  m_edMobility.clear ();
+  m_gwMobility.clear ();
+  m_edByPosition.clear ();
+  m_gwByPosition.clear ();
+  m_edPosition.clear ();
+  m_gwPosition.clear ();
+  m_nEd = 0;
+  m_nGw = 0;
+  std::vector<float> ().swap (m_uplink);
+  std::vector<float> ().swap (m_downlink);
+  std::lock_guard<std::mutex> lock (m_d2dMutex);
+  std::vector<float> ().swap (m_d2d);
+}
+
+uint64_t
+PrecomputedLinkLossModel::GetNLinks (void) const
+{
+  return m_uplink.size () + m_downlink.size () + m_d2d.size ();
+}
+
+PrecomputedLinkLossModel::LinkEnd
+PrecomputedLinkLossModel::FindEnd (Ptr<const MobilityModel> mobility) const
+{
+  LinkEnd end;
+  end.mobility = mobility;
+  end.role = ROLE_NONE;
+  end.node = 0;
+  IndexMap::const_iterator it = m_edIndex.find (PeekPointer (mobility));
+  if (it != m_edIndex.end ())
+    {
+      end.role = ROLE_END_DEVICE;
+      end.node = it->second;
+      return end;
+    }
+  it = m_gwIndex.find (PeekPointer (mobility));
+  if (it != m_gwIndex.end ())
+    {
+      end.role = ROLE_GATEWAY;
+      end.node = it->second;
+    }
+  return end;
+}
+
+bool
+PrecomputedLinkLossModel::FindNode (const LinkEnd &end, Role role, uint32_t &node) const
+{
+  if (end.role != ROLE_NONE)
+    {
+      // one of the nodes: it only has its own role
+      node = end.node;
+      return end.role == role;
+    }
+  const PositionMap &byPosition = (role == ROLE_END_DEVICE) ? m_edByPosition : m_gwByPosition;
+  PositionMap::const_iterator position = byPosition.find (PositionKey (end.mobility->GetPosition ()));
+  if (position != byPosition.end ())
+    {
+      node = position->second;
+      return true;
+    }
+  return false;
+}
+
+bool
+PrecomputedLinkLossModel::GetPrecomputedLoss (Ptr<const MobilityModel> a,
+                                              Ptr<const MobilityModel> b,
+                                              double &loss) const
+{
+  LinkEnd tx = FindEnd (a);
+  LinkEnd rx = FindEnd (b);
+  uint32_t i = 0;
+  uint32_t j = 0;
+  if (FindNode (tx, ROLE_END_DEVICE, i) && FindNode (rx, ROLE_GATEWAY, j))
+    {
+      // uplink
+      loss = m_uplink[static_cast<size_t> (i) * m_nGw + j];
+      return true;
+    }
+  if (FindNode (tx, ROLE_GATEWAY, i) && FindNode (rx, ROLE_END_DEVICE, j))
+    {
+      // downlink
+      loss = m_downlink[static_cast<size_t> (i) * m_nEd + j];
+      return true;
+    }
+  if (FindNode (tx, ROLE_END_DEVICE, i) && FindNode (rx, ROLE_END_DEVICE, j))
+    {
+      std::lock_guard<std::mutex> lock (m_d2dMutex);
+      if (m_d2d.empty ())
+        {
+          return false;
+        }
+      float value = m_d2d[static_cast<size_t> (i) * m_nEd + j];
+      if (std::isnan (value))
+        {
+          // not used yet
+          return false;
+        }
+      loss = value;
+      return true;
+    }
+  return false;
+}
+
+double
+PrecomputedLinkLossModel::DoCalcRxPower (double txPowerDbm,
+                                         Ptr<MobilityModel> a,
+                                         Ptr<MobilityModel> b) const
+{
+  double loss = 0.0;
+  if (!GetPrecomputedLoss (a, b, loss))
+    {
+      // not a precomputed link (e.g., a node created afterwards)
+      NS_LOG_DEBUG ("Link not precomputed, evaluating the deterministic model");
+      loss = EvaluateLoss (a, b);
+      StoreDeviceToDevice (a, b, loss);
+    }
+  return txPowerDbm - loss;
+}
+
+void
+PrecomputedLinkLossModel::StoreDeviceToDevice (Ptr<const MobilityModel> a,
+                                               Ptr<const MobilityModel> b,
+                                               double loss) const
+{
+  uint32_t i = 0;
+  uint32_t j = 0;
+  if (FindNode (FindEnd (a), ROLE_END_DEVICE, i) && FindNode (FindEnd (b), ROLE_END_DEVICE, j))
+    {
+      std::lock_guard<std::mutex> lock (m_d2dMutex);
+      if (!m_d2d.empty ())
+        {
+          m_d2d[static_cast<size_t> (i) * m_nEd + j] = loss;
+        }
+    }
+}
+
+int64_t
+PrecomputedLinkLossModel::DoAssignStreams (int64_t stream)
+{
+  if (m_model == 0)
+    {
+      return 0;
+    }
+  return m_model->AssignStreams (stream);
+}
+
+} // namespace ns3
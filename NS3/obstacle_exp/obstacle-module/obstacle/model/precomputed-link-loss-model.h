@@ -0,0 +1,215 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef PRECOMPUTED_LINK_LOSS_MODEL_H
+#define PRECOMPUTED_LINK_LOSS_MODEL_H
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/propagation-loss-model.h"
+#include "ns3/node-container.h"
+#include "ns3/vector.h"
+
+namespace ns3 {
+
+class MobilityModel;
+
+/**
+ * \ingroup obstacle
+ *
+ * \brief Serves a deterministic loss model from a precomputed link matrix
+ *
+ * For scenarios where nodes do not move (e.g., every node uses a
+ * ConstantPositionMobilityModel), the deterministic part of a loss chain
+ * (log-distance, Okumura-Hata, obstacle shadowing...) gives the same
+ * value on every transmission. This model evaluates the wrapped
+ * deterministic model once per link in Precompute (), for every end
+ * device to gateway pair, in both directions; the obstacle shadowing
+ * stages of the wrapped model are computed on several threads (see the
+ * Threads attribute). DoCalcRxPower is then a table lookup. End device
+ * to end device links are evaluated on the fly, unless DeviceToDevice is
+ * set: they are then kept in a matrix, filled as the links are used.
+ *
+ * Links are looked up by the mobility models of their ends, then by
+ * their positions: mobility models created elsewhere (e.g., the probes of
+ * LorawanMacHelper::SetSpreadingFactorsUpBatch), at the position of a
+ * precomputed node, are served from the matrix too. An end found by its
+ * mobility model keeps its role (end device or gateway), so that a gateway
+ * at the position of an end device is not taken for it; when neither end
+ * is found by its mobility model, the link is taken as an uplink, then as
+ * a downlink, then as an end device to end device link. The model holds
+ * the mobility models of the nodes, until Clear or the next Bind.
+ *
+ * Stochastic stages (e.g., NakagamiPropagationLossModel) must not be part
+ * of the wrapped model: chain them after this model with SetNext, so that
+ * they are still applied per call. Links that are not in the matrix are
+ * evaluated with the wrapped model on the fly.
+ *
+ * The matrix only depends on the node positions: a replication that
+ * recreates the same nodes at the same positions reuses it with Bind,
+ * instead of evaluating every link again.
+ */
+class PrecomputedLinkLossModel : public PropagationLossModel
+{
+public:
+  // inherited from Object
+  static TypeId GetTypeId (void);
+
+  /**
+   * \brief Constructor
+   * \return none
+   */
+  PrecomputedLinkLossModel ();
+
+  /**
+   * \brief Deconstructor
+   * \return none
+   */
+  virtual ~PrecomputedLinkLossModel ();
+
+  /**
+   * \brief Sets the deterministic loss model (or chain) to be precomputed
+   * \param model the deterministic loss model
+   * \return none
+   */
+  void SetDeterministicModel (Ptr<PropagationLossModel> model);
+
+  /**
+   * \brief Gets the deterministic loss model
+   * \return the deterministic loss model
+   */
+  Ptr<PropagationLossModel> GetDeterministicModel (void) const;
+
+  /**
+   * \brief Evaluates the deterministic model for every link between the
+   * given nodes. Any previously computed link is dropped.
+   * \param endDevices the end devices (must aggregate a MobilityModel)
+   * \param gateways the gateways (must aggregate a MobilityModel)
+   * \return none
+   */
+  void Precompute (NodeContainer endDevices, NodeContainer gateways);
+
+  /**
+   * \brief Attaches the precomputed links to another set of nodes, e.g.,
+   * the nodes of the next replication. The nodes must be at the same
+   * positions, in the same order, as the ones given to Precompute.
+   * \param endDevices the end devices (must aggregate a MobilityModel)
+   * \param gateways the gateways (must aggregate a MobilityModel)
+   * \return false (and the links are left as they were) if the nodes do
+   * not match the precomputed ones
+   */
+  bool Bind (NodeContainer endDevices, NodeContainer gateways);
+
+  /**
+   * \brief Drops every precomputed link
+   * \return none
+   */
+  void Clear (void);
+
+  /**
+   * \brief Gets the number of links held in the matrix
+   * \return the number of precomputed links
+   */
+  uint64_t GetNLinks (void) const;
+
+  /**
+   * \brief Gets the loss of a precomputed link
+   * \param a the mobility model of the transmitter
+   * \param b the mobility model of the receiver
+   * \param loss filled with the loss (dB), if the link was precomputed
+   * \return true if the link was precomputed
+   */
+  bool GetPrecomputedLoss (Ptr<const MobilityModel> a, Ptr<const MobilityModel> b, double &loss) const;
+
+private:
+  // inherited from Object
+  virtual void DoDispose (void);
+
+  // inherited from PropagationLossModel
+  virtual double DoCalcRxPower (double txPowerDbm,
+                                Ptr<MobilityModel> a,
+                                Ptr<MobilityModel> b) const;
+  virtual int64_t DoAssignStreams (int64_t stream);
+
+  // role of a node in the matrices
+  enum Role
+  {
+    ROLE_NONE,
+    ROLE_END_DEVICE,
+    ROLE_GATEWAY
+  };
+
+  // an end of a link: the role and row/column of its mobility model,
+  // if it is one of the nodes (ROLE_NONE otherwise)
+  struct LinkEnd
+  {
+    Ptr<const MobilityModel> mobility;
+    Role role;
+    uint32_t node;
+  };
+
+  // finds an end of a link by its mobility model
+  LinkEnd FindEnd (Ptr<const MobilityModel> mobility) const;
+
+  // row/column of an end as a node of the given role: the one of its
+  // mobility model if it has this role, else the one of its position if
+  // its mobility model is not one of the nodes
+  bool FindNode (const LinkEnd &end, Role role, uint32_t &node) const;
+
+  // loss (dB) of the wrapped model between two mobility models
+  double EvaluateLoss (Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
+
+  // keeps the loss of an end device to end device link, if both
+  // ends are end devices and the ED to ED matrix is in use
+  void StoreDeviceToDevice (Ptr<const MobilityModel> a, Ptr<const MobilityModel> b, double loss) const;
+
+  typedef std::unordered_map<const MobilityModel *, uint32_t> IndexMap;
+  typedef std::map<std::tuple<double, double, double>, uint32_t> PositionMap;
+
+  Ptr<PropagationLossModel> m_model; // the deterministic model
+  bool m_deviceToDevice;             // also keep the ED to ED links
+  uint32_t m_nThreads;               // threads of the obstacle loss matrices
+
+  std::vector<Ptr<MobilityModel> > m_edMobility; // end device mobility, by row/column
+  std::vector<Ptr<MobilityModel> > m_gwMobility; // gateway mobility, by row/column
+  IndexMap m_edIndex; // end device mobility -> row/column (held by m_edMobility)
+  IndexMap m_gwIndex; // gateway mobility -> row/column (held by m_gwMobility)
+  PositionMap m_edByPosition; // end device position -> row/column
+  PositionMap m_gwByPosition; // gateway position -> row/column
+  std::vector<Vector> m_edPosition; // end device positions, by row/column
+  std::vector<Vector> m_gwPosition; // gateway positions, by row/column
+  uint32_t m_nEd;
+  uint32_t m_nGw;
+
+  // dense matrices of losses (dB), row-major.
+  // float precision (~1e-5 dB at 150 dB) is plenty for path losses
+  // and halves the memory of the ED to ED matrix
+  std::vector<float> m_uplink;   // m_nEd x m_nGw, ED -> GW
+  std::vector<float> m_downlink; // m_nGw x m_nEd, GW -> ED
+  // m_nEd x m_nEd, ED -> ED, filled on first use (NaN until then); the
+  // mutex serializes its accesses, as links may be asked from several threads
+  mutable std::vector<float> m_d2d;
+  mutable std::mutex m_d2dMutex;
+};
+
+} // namespace ns3
+
+#endif // PRECOMPUTED_LINK_LOSS_MODEL_H
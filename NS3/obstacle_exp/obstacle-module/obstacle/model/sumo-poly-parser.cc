@@ -0,0 +1,292 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <charconv>
+#include <cstring>
+
+#include "ns3/log.h"
+
+#include "sumo-poly-parser.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("SumoPolyParser");
+
+namespace {
+
+inline bool
+IsSpace (char c)
+{
+  return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+inline const char *
+SkipSpaces (const char *p, const char *end)
+{
+  while ((p < end) && IsSpace (*p))
+    {
+      p++;
+    }
+  return p;
+}
+
+// true if [p, end) starts with the literal s
+inline bool
+StartsWith (const char *p, const char *end, const char *s)
+{
+  size_t n = std::strlen (s);
+  return (static_cast<size_t> (end - p) >= n) && (std::memcmp (p, s, n) == 0);
+}
+
+// reads a number at p, from_chars does not take a leading '+'
+inline bool
+ReadNumber (const char *&p, const char *end, double &number)
+{
+  if ((p < end) && (*p == '+'))
+    {
+      p++;
+    }
+  std::from_chars_result result = std::from_chars (p, end, number);
+  if (result.ec != std::errc ())
+    {
+      return false;
+    }
+  p = result.ptr;
+  return true;
+}
+
+} // anonymous namespace
+
+SumoPolyParser::SumoPolyParser (const char *begin, const char *end) :
+  m_begin (begin),
+  m_p (begin),
+  m_end (end),
+  m_nErrors (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+bool
+SumoPolyParser::Next (SumoPoly &poly)
+{
+  while (m_p < m_end)
+    {
+      const char *tag = static_cast<const char *> (std::memchr (m_p, '<', m_end - m_p));
+      if (tag == 0)
+        {
+          m_p = m_end;
+          break;
+        }
+      m_p = tag + 1;
+
+      if (StartsWith (tag, m_end, "<!--"))
+        {
+          // skip the comment, whatever it holds
+          const char *p = tag + 4;
+          while ((p < m_end) && !StartsWith (p, m_end, "-->"))
+            {
+              p++;
+            }
+          m_p = (p < m_end) ? p + 3 : m_end;
+          continue;
+        }
+      if (!StartsWith (tag, m_end, "<poly") || (tag + 5 == m_end)
+          || (!IsSpace (tag[5]) && (tag[5] != '/') && (tag[5] != '>')))
+        {
+          // another element (e.g., <polygon>, <param>, </poly>)
+          continue;
+        }
+
+      m_p = tag + 5;
+      if (ParseAttributes (poly))
+        {
+          return true;
+        }
+      m_nErrors++;
+      NS_LOG_WARN ("Skipping a malformed <poly> element at offset " << (tag - m_begin) << ".");
+    }
+  return false;
+}
+
+bool
+SumoPolyParser::ParseAttributes (SumoPoly &poly)
+{
+  poly.id = std::string_view ();
+  poly.type = std::string_view ();
+  poly.material = std::string_view ();
+  poly.shape = std::string_view ();
+  poly.hasHeight = false;
+  poly.height = 0.0;
+  poly.hasBeta = false;
+  poly.beta = 0.0;
+  poly.hasGamma = false;
+  poly.gamma = 0.0;
+
+  while (true)
+    {
+      m_p = SkipSpaces (m_p, m_end);
+      if (m_p == m_end)
+        {
+          return false;
+        }
+      if ((*m_p == '/') || (*m_p == '>'))
+        {
+          // end of the start tag; children, if any, are skipped by Next
+          m_p++;
+          return true;
+        }
+
+      // name = "value"
+      const char *name = m_p;
+      while ((m_p < m_end) && (*m_p != '=') && !IsSpace (*m_p) && (*m_p != '>') && (*m_p != '/'))
+        {
+          m_p++;
+        }
+      std::string_view key (name, m_p - name);
+      m_p = SkipSpaces (m_p, m_end);
+      if ((m_p == m_end) || (*m_p != '=') || key.empty ())
+        {
+          return false;
+        }
+      m_p = SkipSpaces (m_p + 1, m_end);
+      if ((m_p == m_end) || ((*m_p != '"') && (*m_p != '\'')))
+        {
+          return false;
+        }
+      char quote = *m_p++;
+      const char *close = static_cast<const char *> (std::memchr (m_p, quote, m_end - m_p));
+      if (close == 0)
+        {
+          return false;
+        }
+      std::string_view value (m_p, close - m_p);
+      m_p = close + 1;
+
+      if (key == "id")
+        {
+          poly.id = value;
+        }
+      else if (key == "type")
+        {
+          poly.type = value;
+        }
+      else if (key == "shape")
+        {
+          poly.shape = value;
+        }
+      else if (key == "material")
+        {
+          poly.material = value;
+        }
+      else if (key == "height")
+        {
+          poly.hasHeight = ParseNumber (value, poly.height);
+        }
+      else if (key == "beta")
+        {
+          poly.hasBeta = ParseNumber (value, poly.beta);
+        }
+      else if (key == "gamma")
+        {
+          poly.hasGamma = ParseNumber (value, poly.gamma);
+        }
+      else
+        {
+          continue;
+        }
+
+      if (((key == "height") && !poly.hasHeight)
+          || ((key == "beta") && !poly.hasBeta)
+          || ((key == "gamma") && !poly.hasGamma))
+        {
+          m_nErrors++;
+          NS_LOG_WARN ("Ignoring the malformed " << key << " attribute \"" << value << "\".");
+        }
+    }
+}
+
+uint32_t
+SumoPolyParser::GetNErrors (void) const
+{
+  return m_nErrors;
+}
+
+bool
+SumoPolyParser::ParseNumber (std::string_view value, double &number)
+{
+  const char *p = SkipSpaces (value.data (), value.data () + value.size ());
+  const char *end = value.data () + value.size ();
+  if (!ReadNumber (p, end, number))
+    {
+      return false;
+    }
+  return SkipSpaces (p, end) == end;
+}
+
+bool
+SumoPolyParser::ParseShape (std::string_view shape, std::vector<double> &x, std::vector<double> &y)
+{
+  x.clear ();
+  y.clear ();
+
+  const char *p = shape.data ();
+  const char *end = shape.data () + shape.size ();
+  while (true)
+    {
+      p = SkipSpaces (p, end);
+      if (p == end)
+        {
+          break;
+        }
+      double vx;
+      double vy;
+      if (!ReadNumber (p, end, vx))
+        {
+          return false;
+        }
+      p = SkipSpaces (p, end);
+      if ((p == end) || (*p != ','))
+        {
+          return false;
+        }
+      p = SkipSpaces (p + 1, end);
+      if (!ReadNumber (p, end, vy))
+        {
+          return false;
+        }
+      if ((p != end) && !IsSpace (*p))
+        {
+          return false;
+        }
+      // SUMO repeats the first vertex at the end, and some
+      // exports repeat other vertices too
+      if (!x.empty () && (vx == x.back ()) && (vy == y.back ()))
+        {
+          continue;
+        }
+      x.push_back (vx);
+      y.push_back (vy);
+    }
+  if ((x.size () > 1) && (x.back () == x.front ()) && (y.back () == y.front ()))
+    {
+      x.pop_back ();
+      y.pop_back ();
+    }
+  return true;
+}
+
+} // namespace ns3
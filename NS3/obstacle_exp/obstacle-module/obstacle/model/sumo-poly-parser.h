@@ -0,0 +1,113 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef SUMO_POLY_PARSER_H
+#define SUMO_POLY_PARSER_H
+
+#include <stdint.h>
+#include <string_view>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief The attributes of a \<poly\> element of a SUMO polygon file.
+ * The strings point into the parsed buffer.
+ */
+struct SumoPoly
+{
+  std::string_view id;       //!< id attribute
+  std::string_view type;     //!< type attribute (e.g., "building")
+  std::string_view material; //!< material attribute (empty if absent)
+  std::string_view shape;    //!< shape attribute, see SumoPolyParser::ParseShape
+  bool hasHeight;            //!< true if the height attribute is present
+  double height;             //!< height attribute (meters)
+  bool hasBeta;              //!< true if the beta attribute is present
+  double beta;               //!< beta attribute (per-wall attenuation, dB)
+  bool hasGamma;             //!< true if the gamma attribute is present
+  double gamma;              //!< gamma attribute (per-meter attenuation, dB/m)
+};
+
+/**
+ * \ingroup obstacle
+ * \brief Streaming parser of the \<poly\> elements of a SUMO polygon
+ * (additional) file held in memory
+ *
+ * The buffer is scanned once, without copying: an element may span
+ * several lines, its attributes may come in any order and be quoted
+ * with ' or ", and comments are skipped. Numbers are read with
+ * std::from_chars. Nothing is allocated.
+ */
+class SumoPolyParser
+{
+public:
+  /**
+   * \brief Constructor
+   * \param begin first character of the buffer
+   * \param end one past the last character of the buffer
+   * \return none
+   */
+  SumoPolyParser (const char *begin, const char *end);
+
+  /**
+   * \brief Reads the next \<poly\> element. Malformed elements are skipped
+   * (and counted, see GetNErrors).
+   * \param poly the attributes of the element
+   * \return false at the end of the buffer
+   */
+  bool Next (SumoPoly &poly);
+
+  /**
+   * \brief Gets the number of malformed elements or attributes met so far
+   * \return the number of errors
+   */
+  uint32_t GetNErrors (void) const;
+
+  /**
+   * \brief Reads the vertices of a shape attribute ("x1,y1 x2,y2 ...").
+   * Repeated vertices, and the last vertex when it closes the polygon
+   * (i.e., repeats the first one), are dropped.
+   * \param shape the shape attribute
+   * \param x cleared, then filled with the x coordinates
+   * \param y cleared, then filled with the y coordinates
+   * \return false if the shape is malformed
+   */
+  static bool ParseShape (std::string_view shape, std::vector<double> &x, std::vector<double> &y);
+
+  /**
+   * \brief Reads a number
+   * \param value the text of the number
+   * \param number the number read
+   * \return false if value is not exactly one number (surrounding
+   * spaces aside)
+   */
+  static bool ParseNumber (std::string_view value, double &number);
+
+private:
+  // parses the attributes of an element, p being just after "<poly"
+  bool ParseAttributes (SumoPoly &poly);
+
+  const char *m_begin;
+  const char *m_p; // next character to read
+  const char *m_end;
+  uint32_t m_nErrors;
+};
+
+} // namespace ns3
+
+#endif /* SUMO_POLY_PARSER_H */
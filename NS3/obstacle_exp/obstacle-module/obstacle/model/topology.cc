@@ -22,7 +22,19 @@
 // CGAL includes
 #include <CGAL/intersections.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "ns3/double.h"
+
 #include "topology.h"
+#include "mapped-file.h"
+#include "work-stealing-pool.h"
 
 using namespace ns3;
 
@@ -31,7 +43,191 @@ using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("topology");
 
+NS_OBJECT_ENSURE_REGISTERED (Topology);
+
+namespace {
+
+// output iterator for the range tree queries, that
+// keeps only the handle of each obstacle found
+class HandleInserter
+{
+public:
+  typedef std::output_iterator_tag iterator_category;
+  typedef void value_type;
+  typedef void difference_type;
+  typedef void pointer;
+  typedef void reference;
+
+  explicit HandleInserter (std::vector<uint32_t> &handles) : m_handles (&handles) {}
+  HandleInserter &operator* () { return *this; }
+  HandleInserter &operator++ () { return *this; }
+  HandleInserter operator++ (int) { return *this; }
+  HandleInserter &operator= (const Key &key)
+  {
+    m_handles->push_back (key.second);
+    return *this;
+  }
+
+private:
+  std::vector<uint32_t> *m_handles;
+};
+
+// Compiled topology file (SaveCompiled / ReadCompiled): a header,
+// then arrays, each starting at a multiple of 8 bytes:
+//   uint32_t firstVertex[nObstacles + 1]  vertices of obstacle i are
+//                                         firstVertex[i] to firstVertex[i + 1] - 1
+//   uint32_t idOffset[nObstacles + 1]     same, for the characters of the ids
+//   double height[nObstacles], beta[nObstacles], gamma[nObstacles]
+//   double vx[nVertices], vy[nVertices]
+//   ObstacleBvh::Node bvhNodes[nBvhNodes]
+//   uint32_t bvhOrder[nObstacles]
+//   char ids[idBytes]
+// Bump COMPILED_VERSION whenever this layout changes.
+const char COMPILED_MAGIC[8] = {'N', 'S', '3', 'O', 'B', 'S', 'T', 'C'};
+const uint32_t COMPILED_VERSION = 1;
+const uint32_t COMPILED_BYTE_ORDER = 0x01020304;
+
+struct CompiledHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;  // COMPILED_BYTE_ORDER, as written by the host
+  uint32_t nodeSize;   // sizeof (ObstacleBvh::Node), as written by the host
+  uint32_t nObstacles;
+  uint32_t nVertices;
+  uint32_t nBvhNodes;
+  uint64_t idBytes;
+  double minX;
+  double minY;
+  double maxX;
+  double maxY;
+};
+
+// offsets of the arrays of a compiled topology, in bytes from the start of the file
+struct CompiledLayout
+{
+  uint64_t firstVertex;
+  uint64_t idOffset;
+  uint64_t height;
+  uint64_t beta;
+  uint64_t gamma;
+  uint64_t vx;
+  uint64_t vy;
+  uint64_t bvhNodes;
+  uint64_t bvhOrder;
+  uint64_t ids;
+  uint64_t size;
+};
+
+// reserves size bytes at the next multiple of 8 after offset
+uint64_t
+Reserve (uint64_t &offset, uint64_t size)
+{
+  offset = (offset + 7) & ~static_cast<uint64_t> (7);
+  uint64_t start = offset;
+  offset += size;
+  return start;
+}
+
+CompiledLayout
+GetCompiledLayout (const CompiledHeader &header)
+{
+  CompiledLayout layout;
+  uint64_t offset = sizeof (CompiledHeader);
+  uint64_t n = header.nObstacles;
+  layout.firstVertex = Reserve (offset, (n + 1) * sizeof (uint32_t));
+  layout.idOffset = Reserve (offset, (n + 1) * sizeof (uint32_t));
+  layout.height = Reserve (offset, n * sizeof (double));
+  layout.beta = Reserve (offset, n * sizeof (double));
+  layout.gamma = Reserve (offset, n * sizeof (double));
+  layout.vx = Reserve (offset, static_cast<uint64_t> (header.nVertices) * sizeof (double));
+  layout.vy = Reserve (offset, static_cast<uint64_t> (header.nVertices) * sizeof (double));
+  layout.bvhNodes = Reserve (offset, static_cast<uint64_t> (header.nBvhNodes) * sizeof (ObstacleBvh::Node));
+  layout.bvhOrder = Reserve (offset, n * sizeof (uint32_t));
+  layout.ids = Reserve (offset, header.idBytes);
+  layout.size = offset;
+  return layout;
+}
+
+// checks that the offsets and indices of a compiled topology stay within
+// its arrays, so that a corrupted file cannot make the reader or the BVH
+// queries go out of bounds; error is filled with the first problem found
+bool
+CheckCompiled (const CompiledHeader &header, const uint32_t *firstVertex, const uint32_t *idOffset,
+               const ObstacleBvh::Node *bvhNodes, const uint32_t *bvhOrder, std::string &error)
+{
+  uint32_t n = header.nObstacles;
+  std::ostringstream problem;
+
+  if ((firstVertex[0] != 0) || (firstVertex[n] != header.nVertices))
+    {
+      problem << "the vertices of the obstacles do not span the " << header.nVertices << " vertices";
+    }
+  else if ((idOffset[0] != 0) || (idOffset[n] > header.idBytes))
+    {
+      problem << "the ids of the obstacles do not fit in " << header.idBytes << " bytes";
+    }
+  else if ((n > 0) && (header.nBvhNodes == 0))
+    {
+      problem << "the BVH is empty";
+    }
+  for (uint32_t i = 0; (i < n) && problem.str ().empty (); i++)
+    {
+      if (firstVertex[i + 1] <= firstVertex[i])
+        {
+          problem << "obstacle " << i << " has no vertex, or its vertex offset " << firstVertex[i + 1] << " goes back";
+        }
+      else if (idOffset[i + 1] < idOffset[i])
+        {
+          problem << "the id offset " << idOffset[i + 1] << " of obstacle " << i + 1 << " goes back";
+        }
+      else if (bvhOrder[i] >= n)
+        {
+          problem << "BVH entry " << i << " is obstacle " << bvhOrder[i] << " of " << n;
+        }
+    }
+
+  // children follow their parent (no cycle), and the depth stays
+  // within the traversal stack of ObstacleBvh::Query
+  std::vector<uint8_t> depth (header.nBvhNodes, 0);
+  for (uint32_t i = 0; (i < header.nBvhNodes) && problem.str ().empty (); i++)
+    {
+      const ObstacleBvh::Node &node = bvhNodes[i];
+      if (node.count > 0)
+        {
+          if (static_cast<uint64_t> (node.first) + node.count > n)
+            {
+              problem << "BVH leaf " << i << " holds entries " << node.first << " to "
+                      << static_cast<uint64_t> (node.first) + node.count << " of " << n;
+            }
+          continue;
+        }
+      if ((i + 1 >= header.nBvhNodes) || (node.right <= i + 1) || (node.right >= header.nBvhNodes))
+        {
+          problem << "BVH node " << i << " has children " << i + 1 << " and " << node.right
+                  << " of " << header.nBvhNodes;
+        }
+      else if (depth[i] >= 62)
+        {
+          problem << "BVH node " << i << " is too deep";
+        }
+      else
+        {
+          depth[i + 1] = std::max (depth[i + 1], static_cast<uint8_t> (depth[i] + 1));
+          depth[node.right] = std::max (depth[node.right], static_cast<uint8_t> (depth[i] + 1));
+        }
+    }
+
+  error = problem.str ();
+  return error.empty ();
+}
+
+} // anonymous namespace
+
 Topology::Topology () :
+  m_gridCellSize(0.0),
+  m_rangeTreeBuilt(false),
+  m_maxReach(0.0),
   // initially very large values
   // so that obstacle bounding box
   // updates will be made
@@ -43,6 +239,47 @@ Topology::Topology () :
   NS_LOG_FUNCTION (this);
 }
 
+Topology::~Topology ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+TypeId
+Topology::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::Topology")
+    .SetParent<Object> ()
+    .SetGroupName ("Obstacle")
+    .AddConstructor<Topology> ()
+    .AddAttribute ("GridCellSize",
+                   "Side of the cells of the Grid spatial index (meters); "
+                   "0 uses twice the mean side of the obstacle bounding boxes",
+                   DoubleValue (0.0),
+                   MakeDoubleAccessor (&Topology::SetGridCellSize,
+                                       &Topology::GetGridCellSize),
+                   MakeDoubleChecker<double> (0.0))
+  ;
+  return tid;
+}
+
+void
+Topology::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+
+  // release the obstacles and their indices
+  // (the range tree goes with the object)
+  std::vector<Obstacle> ().swap(m_obstacles);
+  std::vector<ObstacleBox> ().swap(m_boxes);
+  m_edgeTable = EdgeTable ();
+  m_bvh = ObstacleBvh ();
+  m_grid = ObstacleGrid ();
+  m_materials.clear();
+  m_rangeTreeBuilt = false;
+
+  Object::DoDispose ();
+}
+
 void Topology::CommandSetup (int argc, char **argv)
 {
   NS_LOG_FUNCTION (this);
@@ -60,28 +297,34 @@ Topology::Run ()
   NS_LOG_INFO ("Topology::Run()");
 }
 
-Topology **
+Ptr<Topology> *
 Topology::PeekTopology (void)
 {
-  // ensure no topology exists
-  static Topology *topo = 0;
+  // the default topology, released at exit
+  static Ptr<Topology> topo = 0;
   return &topo;
 }
 
 Topology *
 Topology::GetTopology (void)
 {
-  Topology **ptopo = PeekTopology ();
+  Ptr<Topology> *ptopo = PeekTopology ();
   /* Please, don't include any calls to logging macros in this function
    * or pay the price, that is, stack explosions.
    */
   if (*ptopo == 0)
     {
       // create the topology
-      *ptopo = new Topology();
+      *ptopo = CreateObject<Topology> ();
     }
 
-  return *ptopo;
+  return PeekPointer (*ptopo);
+}
+
+void
+Topology::SetTopology (Ptr<Topology> topology)
+{
+  *PeekTopology () = topology;
 }
 
 void
@@ -126,130 +369,320 @@ CreateVertex(Obstacle &obstacle, std::string vertex)
 void
 Topology::
 CreateShape(std::string id, std::string vertices, std::string height)
+{
+  SumoPoly poly = SumoPoly ();
+  poly.id = id;
+
+	// If height is defined, set it
+	if (!height.empty())
+		{
+			poly.hasHeight = true;
+			poly.height = atof(height.c_str ());
+		}
+
+  std::vector<double> vx;
+  std::vector<double> vy;
+  if (!SumoPolyParser::ParseShape(vertices, vx, vy))
+    {
+      NS_LOG_WARN ("Malformed shape for obstacle " << id << ".");
+    }
+  CreateShape(poly, vx, vy);
+}
+
+void
+Topology::
+CreateShape(const SumoPoly &poly, const std::vector<double> &vx, const std::vector<double> &vy)
 {
   // create an obstacle
   Obstacle obstacle;
   // name the obstacle
-  obstacle.SetId(id);
+  obstacle.SetId(std::string(poly.id));
 
 	// If height is defined, set it
-	if (!height.empty())
+	if (poly.hasHeight)
 		{
-			double h = std::abs(atof(height.c_str ()));
-			obstacle.SetHeight (h);
+			obstacle.SetHeight (std::abs(poly.height));
 		}
 
-  // tokenize each vertex
-  size_t pos1 = 0;
-  size_t pos2 = vertices.find(" ", pos1);
-  std::string vertex;
-  while (pos2 != std::string::npos)
+  // attenuation: from the material, then from the
+  // beta and gamma of the polygon, if any
+  if (!poly.material.empty())
     {
-      vertex = vertices.substr(pos1, pos2-pos1);
-
-      CreateVertex(obstacle, vertex);
-      pos1 = pos2 + 1;
-      pos2 = vertices.find(" ", pos1);
+      std::map<std::string, Material, std::less<> >::const_iterator it = m_materials.find(poly.material);
+      if (it != m_materials.end())
+        {
+          obstacle.SetBeta(it->second.beta);
+          obstacle.SetGamma(it->second.gamma);
+        }
+      else
+        {
+          NS_LOG_WARN ("Unknown material " << poly.material << " for obstacle " << poly.id << ", using the default attenuation.");
+        }
+    }
+  if (poly.hasBeta)
+    {
+      obstacle.SetBeta(poly.beta);
     }
+  if (poly.hasGamma)
+    {
+      obstacle.SetGamma(poly.gamma);
+    }
+
   // NOTE:  In OSM data, last vertex is dup of first
-  // so, we don't need to get it for polygonal obstacle
-  // get last vertex
+  // so it has already been dropped from vx, vy
+  for (size_t i = 0; i < vx.size(); i++)
+    {
+      obstacle.AddVertex(Point(vx[i], vy[i]));
+
+      // update topology bounding box values
+      m_minX = std::min(m_minX, vx[i]);
+      m_maxX = std::max(m_maxX, vx[i]);
+      m_minY = std::min(m_minY, vy[i]);
+      m_maxY = std::max(m_maxY, vy[i]);
+    }
 
   // calculate the obstacle center of
   // bounding box and radius(squared).
   obstacle.Locate();
 
-  // load centerpoint into Range Tree
-  Point c = obstacle.GetCenter();
-  Key k = Key(c, obstacle);
-
   // add the obstacle to the topolgoy
-  m_obstacles.push_back(k);
+  // (its centerpoint goes into the Range Tree in MakeRangeTree)
+  m_obstacles.push_back(obstacle);
 }
 
-// range tree (binary space partition, BSP)
-// for quickly searching for obstacles within a range
-static Range_tree_2_type m_rangeTree;
+void
+Topology::RegisterMaterial(std::string name, double beta, double gamma)
+{
+  NS_LOG_FUNCTION (this << name << beta << gamma);
+
+  Material material;
+  material.beta = beta;
+  material.gamma = gamma;
+  m_materials[name] = material;
+}
 
 void
 Topology::LoadBuildings(std::string bldgFilename)
 {
   NS_LOG_INFO ("Load buildings.");
 
+  Topology::GetTopology()->ReadBuildings(bldgFilename);
+}
+
+bool
+Topology::LoadCompiled(std::string compiledFilename)
+{
+  NS_LOG_INFO ("Load compiled topology.");
+
+  return Topology::GetTopology()->ReadCompiled(compiledFilename);
+}
+
+void
+Topology::ReadBuildings(std::string bldgFilename)
+{
+  NS_LOG_FUNCTION (this << bldgFilename);
+
 	uint32_t nBuildings = 0;
 
-  std::ifstream file (bldgFilename.c_str (), std::ios::in);
-  if (!(file.is_open ()))
+  MappedFile file;
+  if (!file.Open (bldgFilename))
     {
       NS_FATAL_ERROR("Could not open buildings file " << bldgFilename.c_str() << " for reading, aborting here \n");
     }
-  else
-    {
-      Topology * topology = Topology::GetTopology();
-      NS_ASSERT(topology != 0);
 
-      NS_LOG_DEBUG ("Reading file: " << bldgFilename);
-      while (!file.eof () )
+  NS_LOG_DEBUG ("Reading file: " << bldgFilename);
+  SumoPolyParser parser (file.GetData (), file.GetData () + file.GetSize ());
+  SumoPoly poly;
+  // vertices of the current polygon, reused from one polygon to the next
+  std::vector<double> vx;
+  std::vector<double> vy;
+  while (parser.Next (poly))
+    {
+      // found a building
+      if ((poly.type.substr (0, 8) != "building") && (poly.type.substr (0, 7) != "unknown"))
+        {
+          continue;
+        }
+      if (poly.id.empty () || !SumoPolyParser::ParseShape (poly.shape, vx, vy) || vx.empty ())
         {
-          std::string line;
+          NS_LOG_WARN ("Skipping building " << poly.id << ": missing id or malformed shape.");
+          continue;
+        }
 
-          getline (file, line);
+      CreateShape(poly, vx, vy);
+      nBuildings++;
+    }
+  if (parser.GetNErrors () > 0)
+    {
+      NS_LOG_WARN (parser.GetNErrors () << " malformed elements or attributes in " << bldgFilename << ".");
+    }
 
-          NS_LOG_DEBUG (line);
+	NS_LOG_INFO ("Number of buildings found: " << nBuildings << ".");
+  NS_LOG_INFO ("Topology buildings bounded by x:" << GetMinX() << "," << GetMaxX() << " y:" << GetMinY() << "," << GetMaxY() << ".");
+  // all obstacles have been loaded
+  // so now create a searchable range tree based on those obstacles
+  MakeRangeTree();
+}
 
-          size_t posB = line.find("type=\"building");
-          size_t posU = line.find("type=\"unknown");
-          if ((posB != std::string::npos) || (posU != std::string::npos))
-            {
-              // could *possibly* use XML-DOM here, but
-              // seems faster to just read through the file
-
-              // found a building
-              // get the building id (name) and shape (vertices)
-              std::string polyid;
-              std::string shape;
-							std::string height;
-              size_t posP = line.find("<poly");
-							size_t pos = line.find("id=\"");
-							if ((posP != std::string::npos) || (pos != std::string::npos))
-                {
-                  size_t pos2 = line.find("\"", pos + 4);
-                  if (pos2 != std::string::npos)
-                    {
-                      polyid = line.substr(pos + 4, pos2 - (pos + 4));
-                      pos = line.find("shape=\"");
-                      if (pos != std::string::npos)
-                      {
-                        size_t pos2 = line.find("\"", pos + 8);
-                        if (pos2 != std::string::npos)
-                        {
-                          shape = line.substr(pos + 7, pos2 - pos - 7);
-
-													// Search for the height value
-													pos = line.find("height=\"");
-		                      if (pos != std::string::npos)
-														{
-															size_t pos2 = line.find("\"", pos + 8);
-			                        if (pos2 != std::string::npos)
-			                        {
-			                          height = line.substr(pos + 8, pos2 - (pos + 8));
-															}
-														}
-
-													topology->CreateShape(polyid, shape, height);
-													nBuildings++;
-                        }
-                      }
-                    }
-                }
-            }
+bool
+Topology::ReadCompiled(std::string compiledFilename)
+{
+  NS_LOG_FUNCTION (this << compiledFilename);
+
+  MappedFile file;
+  if (!file.Open (compiledFilename))
+    {
+      NS_LOG_ERROR ("Could not open compiled topology " << compiledFilename << " for reading.");
+      return false;
+    }
+  if (file.GetSize () < sizeof (CompiledHeader))
+    {
+      NS_LOG_ERROR ("Compiled topology " << compiledFilename << " is truncated.");
+      return false;
+    }
+  const char *base = file.GetData ();
+
+  CompiledHeader header;
+  std::memcpy (&header, base, sizeof (header));
+  if ((std::memcmp (header.magic, COMPILED_MAGIC, sizeof (COMPILED_MAGIC)) != 0)
+      || (header.version != COMPILED_VERSION)
+      || (header.byteOrder != COMPILED_BYTE_ORDER)
+      || (header.nodeSize != sizeof (ObstacleBvh::Node)))
+    {
+      NS_LOG_ERROR ("File " << compiledFilename << " is not a compiled topology of version "
+                    << COMPILED_VERSION << " for this host (recompile it).");
+      return false;
+    }
+  CompiledLayout layout = GetCompiledLayout (header);
+  if (layout.size != file.GetSize ())
+    {
+      NS_LOG_ERROR ("Compiled topology " << compiledFilename << " has a wrong size.");
+      return false;
+    }
+
+  const uint32_t *firstVertex = reinterpret_cast<const uint32_t *> (base + layout.firstVertex);
+  const uint32_t *idOffset = reinterpret_cast<const uint32_t *> (base + layout.idOffset);
+  const double *height = reinterpret_cast<const double *> (base + layout.height);
+  const double *beta = reinterpret_cast<const double *> (base + layout.beta);
+  const double *gamma = reinterpret_cast<const double *> (base + layout.gamma);
+  const double *vx = reinterpret_cast<const double *> (base + layout.vx);
+  const double *vy = reinterpret_cast<const double *> (base + layout.vy);
+  const ObstacleBvh::Node *bvhNodes = reinterpret_cast<const ObstacleBvh::Node *> (base + layout.bvhNodes);
+  const uint32_t *bvhOrder = reinterpret_cast<const uint32_t *> (base + layout.bvhOrder);
+  const char *ids = base + layout.ids;
+
+  // nothing is loaded from a corrupted file
+  std::string error;
+  if (!CheckCompiled (header, firstVertex, idOffset, bvhNodes, bvhOrder, error))
+    {
+      NS_LOG_ERROR ("Compiled topology " << compiledFilename << " is corrupted: " << error << ".");
+      return false;
+    }
+
+  // the BVH of the file indexes the obstacles of the file only
+  bool prebuilt = !HasObstacles();
+
+  m_obstacles.reserve(m_obstacles.size() + header.nObstacles);
+  for (uint32_t i = 0; i < header.nObstacles; i++)
+    {
+      Obstacle obstacle;
+      obstacle.SetId(std::string (ids + idOffset[i], ids + idOffset[i + 1]));
+      obstacle.SetHeight(height[i]);
+      obstacle.SetBeta(beta[i]);
+      obstacle.SetGamma(gamma[i]);
+      for (uint32_t v = firstVertex[i]; v < firstVertex[i + 1]; v++)
+        {
+          obstacle.AddVertex(Point(vx[v], vy[v]));
         }
-			NS_LOG_INFO ("Number of buildings found: " << nBuildings << ".");
-      NS_LOG_INFO ("Topology buildings bounded by x:" << topology->GetMinX() << "," << topology->GetMaxX() << " y:" << topology->GetMinY() << "," << topology->GetMaxY() << ".");
-      // all obstacles have been loaded
-      // so now create a searchable range tree based on those obstacles
-      topology->MakeRangeTree();
+      obstacle.Locate();
+      m_obstacles.push_back(obstacle);
     }
+  m_minX = std::min(m_minX, header.minX);
+  m_minY = std::min(m_minY, header.minY);
+  m_maxX = std::max(m_maxX, header.maxX);
+  m_maxY = std::max(m_maxY, header.maxY);
+
+  NS_LOG_INFO ("Number of buildings found: " << header.nObstacles << ".");
+  NS_LOG_INFO ("Topology buildings bounded by x:" << GetMinX() << "," << GetMaxX() << " y:" << GetMinY() << "," << GetMaxY() << ".");
+
+  MakeIndices(!prebuilt);
+  if (prebuilt)
+    {
+      m_bvh.Assign(m_boxes, bvhNodes, header.nBvhNodes, bvhOrder);
+    }
+  return true;
+}
+
+void
+Topology::SaveCompiled(std::string compiledFilename)
+{
+  NS_LOG_FUNCTION (this << compiledFilename);
+
+  NS_ASSERT_MSG (m_rangeTreeBuilt, "MakeRangeTree must be called before SaveCompiled");
+
+  CompiledHeader header;
+  std::memset (&header, 0, sizeof (header));
+  std::memcpy (header.magic, COMPILED_MAGIC, sizeof (COMPILED_MAGIC));
+  header.version = COMPILED_VERSION;
+  header.byteOrder = COMPILED_BYTE_ORDER;
+  header.nodeSize = sizeof (ObstacleBvh::Node);
+  header.nObstacles = m_obstacles.size();
+  header.nBvhNodes = m_bvh.GetNodes().size();
+  header.minX = m_minX;
+  header.minY = m_minY;
+  header.maxX = m_maxX;
+  header.maxY = m_maxY;
+
+  std::vector<uint32_t> firstVertex (1, 0);
+  std::vector<uint32_t> idOffset (1, 0);
+  std::vector<double> height;
+  std::vector<double> beta;
+  std::vector<double> gamma;
+  std::vector<double> vx;
+  std::vector<double> vy;
+  std::string ids;
+  for (std::vector<Obstacle>::iterator it = m_obstacles.begin(); it != m_obstacles.end(); ++it)
+    {
+      vx.insert(vx.end(), it->GetVerticesX().begin(), it->GetVerticesX().end());
+      vy.insert(vy.end(), it->GetVerticesY().begin(), it->GetVerticesY().end());
+      firstVertex.push_back(vx.size());
+      ids += it->GetId();
+      idOffset.push_back(ids.size());
+      height.push_back(it->GetHeight());
+      beta.push_back(it->GetBeta());
+      gamma.push_back(it->GetGamma());
+    }
+  header.nVertices = vx.size();
+  header.idBytes = ids.size();
+  CompiledLayout layout = GetCompiledLayout (header);
+
+  // assembled in memory, then written at once
+  std::vector<char> blob (layout.size, 0);
+  std::memcpy (&blob[0], &header, sizeof (header));
+  std::memcpy (&blob[layout.firstVertex], firstVertex.data (), firstVertex.size () * sizeof (uint32_t));
+  std::memcpy (&blob[layout.idOffset], idOffset.data (), idOffset.size () * sizeof (uint32_t));
+  std::memcpy (&blob[layout.height], height.data (), height.size () * sizeof (double));
+  std::memcpy (&blob[layout.beta], beta.data (), beta.size () * sizeof (double));
+  std::memcpy (&blob[layout.gamma], gamma.data (), gamma.size () * sizeof (double));
+  std::memcpy (&blob[layout.vx], vx.data (), vx.size () * sizeof (double));
+  std::memcpy (&blob[layout.vy], vy.data (), vy.size () * sizeof (double));
+  std::memcpy (&blob[layout.bvhNodes], m_bvh.GetNodes ().data (), header.nBvhNodes * sizeof (ObstacleBvh::Node));
+  std::memcpy (&blob[layout.bvhOrder], m_bvh.GetOrder ().data (), m_bvh.GetOrder ().size () * sizeof (uint32_t));
+  std::memcpy (&blob[layout.ids], ids.data (), ids.size ());
+
+  std::ofstream file (compiledFilename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!(file.is_open ()))
+    {
+      NS_FATAL_ERROR("Could not open compiled topology " << compiledFilename << " for writing, aborting here \n");
+    }
+  file.write (blob.data (), blob.size ());
+  if (!file)
+    {
+      NS_FATAL_ERROR("Could not write compiled topology " << compiledFilename << ", aborting here \n");
+    }
+
+  NS_LOG_INFO ("Wrote " << header.nObstacles << " obstacles, " << header.nVertices << " vertices and "
+               << header.nBvhNodes << " BVH nodes (" << blob.size () << " bytes) to " << compiledFilename << ".");
 }
 
 void
@@ -257,13 +690,65 @@ Topology::MakeRangeTree()
 {
   NS_LOG_FUNCTION (this);
 
-  m_rangeTree.make_tree(m_obstacles.begin(), m_obstacles.end());
+  MakeIndices(true);
+}
+
+void
+Topology::MakeIndices(bool buildBvh)
+{
+  NS_LOG_FUNCTION (this << buildBvh);
+
+  // flatten the walls of every obstacle, and
+  // index each obstacle by its handle
+  m_edgeTable.Clear();
+  m_boxes.clear();
+  m_boxes.reserve(m_obstacles.size());
+  std::vector<Key> keys;
+  keys.reserve(m_obstacles.size());
+  m_maxReach = 0.0;
+  for (uint32_t handle = 0; handle < m_obstacles.size(); handle++)
+    {
+      Obstacle &obstacle = m_obstacles[handle];
+      keys.push_back(Key(Index_kernel::Point_2(obstacle.GetCenterX(), obstacle.GetCenterY()), handle));
+      // the center and the vertices are in the bounding box, whose
+      // diagonal is the radius of the obstacle
+      m_maxReach = std::max(m_maxReach, std::sqrt(obstacle.GetRadiusSq()));
+
+      uint32_t first;
+      uint32_t count;
+      m_edgeTable.AddPolygon(obstacle.GetVerticesX(), obstacle.GetVerticesY(), obstacle.GetHeight(), first, count);
+      obstacle.SetEdges(first, count);
+
+      // bounding box of the footprint, for the BVH and the grid
+      const std::vector<double> &vx = obstacle.GetVerticesX();
+      const std::vector<double> &vy = obstacle.GetVerticesY();
+      ObstacleBox box;
+      box.xMin = *std::min_element(vx.begin(), vx.end());
+      box.xMax = *std::max_element(vx.begin(), vx.end());
+      box.yMin = *std::min_element(vy.begin(), vy.end());
+      box.yMax = *std::max_element(vy.begin(), vy.end());
+      m_boxes.push_back(box);
+    }
+  NS_LOG_INFO ("Edge table: " << m_edgeTable.GetSize() << " walls, "
+               << EdgeTable::GetKernelName() << " kernel.");
+
+  if (buildBvh)
+    {
+      m_bvh.Build(m_boxes);
+    }
+  m_grid.Build(m_boxes, m_gridCellSize);
+
+  m_rangeTree.make_tree(keys.begin(), keys.end());
+
+  // from now on the query path only reads the tree
+  // and the obstacles, so it can run on several threads
+  m_rangeTreeBuilt = true;
 }
 
 void
 Topology::GetObstructedDistance(const Point_3 &p1, const Point_3 &p2, Obstacle &obs, double & obstructedDistance, int &intersections)
 {
-  NS_LOG_FUNCTION (this);
+  // no logging: called by the loss queries, possibly on several threads
 
   // initialize values as if no intersections found
   obstructedDistance = 0.0;
@@ -397,148 +882,318 @@ Topology::GetObstructedDistance(const Point_3 &p1, const Point_3 &p2, Obstacle &
     }
 }
 
-double
-Topology::GetObstructedLossBetween(const Point_3 &p1, const Point_3 &p2, double r)
+// Inexact counterpart of Topology::PointIsInPolygon: true if (x, y)
+// is inside the polygon or on its border (crossing number test)
+static bool
+PointIsInPolygonInexact(const std::vector<double> &vx, const std::vector<double> &vy, double x, double y)
 {
-  NS_LOG_FUNCTION (this);
-
-  // initially assume no loss
-  double obstructedLoss = 0.0;
+  bool inside = false;
+  size_t n = vx.size ();
+  for (size_t i = 0, j = n - 1; i < n; j = i++)
+    {
+      double ex = vx[i] - vx[j];
+      double ey = vy[i] - vy[j];
+      // on the border
+      if ((ex * (y - vy[j]) - ey * (x - vx[j]) == 0.0)
+          && (x >= std::min (vx[i], vx[j])) && (x <= std::max (vx[i], vx[j]))
+          && (y >= std::min (vy[i], vy[j])) && (y <= std::max (vy[i], vy[j])))
+        {
+          return true;
+        }
+      if (((vy[i] > y) != (vy[j] > y))
+          && (x < vx[j] + ex * (y - vy[j]) / ey))
+        {
+          inside = !inside;
+        }
+    }
+  return inside;
+}
 
-  double rSq = r * r;
+// Intersection of the segment p1 p2 with a plane, given the signed
+// (scaled) distances s1 and s2 of p1 and p2 to the plane.
+// Mirrors CGAL::intersection(plane, segment): a point only if the
+// segment crosses or touches the plane without lying in it.
+static bool
+CrossesPlane(double s1, double s2, double &t)
+{
+  if ((s1 == 0.0) && (s2 == 0.0))
+    {
+      // the segment lies in the plane
+      return false;
+    }
+  if (((s1 > 0.0) && (s2 > 0.0)) || ((s1 < 0.0) && (s2 < 0.0)))
+    {
+      return false;
+    }
+  t = s1 / (s1 - s2);
+  return true;
+}
 
-  double p1x = CGAL::to_double(p1.x());
-  double p1y = CGAL::to_double(p1.y());
-	double p1z = CGAL::to_double(p1.z());
-  double p2x = CGAL::to_double(p2.x());
-  double p2y = CGAL::to_double(p2.y());
-	double p2z = CGAL::to_double(p2.z());
+void
+Topology::GetObstructedDistanceInexact(const Vector &p1, const Vector &p2, Obstacle &obs, double & obstructedDistance, int &intersections)
+{
+  // no logging: called by the loss queries, possibly on several threads
 
-  // test first to see if we have a cached value
-  // for loss between these two points
-  // using their positions to the nearest 0.1m
+  // initialize values as if no intersections found
+  obstructedDistance = 0.0;
+  intersections = 0;
 
-  char buff[100];
-  sprintf(buff, "%010.1f %010.1f %010.1f", p1x, p1y, p1z);
-  std::string p1Pos = buff;
-  sprintf(buff, "%010.1f %010.1f %010.1f", p2x, p2y, p2z);
-  std::string p2Pos = buff;
-  sprintf(buff, "%s %s", p1Pos.c_str(), p2Pos.c_str());
-  std::string key = buff;
+  const std::vector<double> &vx = obs.GetVerticesX();
+  const std::vector<double> &vy = obs.GetVerticesY();
+  size_t n = vx.size();
+  double h = obs.GetHeight();
+
+  // walls: the vertical plane through each edge, bounded by the
+  // edge and by the height of the obstacle (see IsInRegion).
+  // Hits are given as parameters t along p1 p2, and the distance
+  // from p1 to a hit is t times the length of the segment
+  uint32_t hits;
+  double tMin;
+  double tMax;
+  m_edgeTable.Intersect(p1, p2, obs.GetFirstEdge(), obs.GetNEdges(), hits, tMin, tMax);
+  intersections = hits;
+
+  // roof: the horizontal plane at the height of the obstacle,
+  // which the exact engine builds from the first three vertices
+  double highestz = std::max (p1.z, p2.z);
+  if ((h != 0) && (highestz >= h) && (n >= 3)
+      && ((vx[1] - vx[0]) * (vy[2] - vy[0]) - (vy[1] - vy[0]) * (vx[2] - vx[0]) != 0.0))
+    {
+      double t;
+      if (CrossesPlane(p1.z - h, p2.z - h, t))
+        {
+          double ipx = p1.x + t * (p2.x - p1.x);
+          double ipy = p1.y + t * (p2.y - p1.y);
+          if (PointIsInPolygonInexact(vx, vy, ipx, ipy))
+            {
+              intersections++;
+              tMin = std::min (tMin, t);
+              tMax = std::max (tMax, t);
+            }
+        }
+    }
 
-  // check if cached
-  if (m_obstructedDistanceMap.count(key) > 0)
+  if ((intersections > 0) && (tMax > 0) && (tMin != tMax))
     {
-      // found it
-      TStrDblMap::iterator it;
-      it = m_obstructedDistanceMap.find(key);
-      obstructedLoss = it->second;
-      return obstructedLoss;
+      double length = CalculateDistance (p1, p2);
+      obstructedDistance = (tMax - tMin) * length;
     }
-  else
+}
+
+void
+Topology::SetGridCellSize(double cellSize)
+{
+  NS_LOG_FUNCTION (this << cellSize);
+
+  m_gridCellSize = cellSize;
+  if (m_rangeTreeBuilt)
     {
-      // B to A is same as A to B
-      sprintf(buff, "%s %s", p2Pos.c_str(), p1Pos.c_str());
-      std::string key = buff;
-      if (m_obstructedDistanceMap.count(key) > 0)
-        {
-          // found it
-          TStrDblMap::iterator it;
-          it = m_obstructedDistanceMap.find(key);
-          obstructedLoss = it->second;
-          return obstructedLoss;
-        }
+      m_grid.Build(m_boxes, m_gridCellSize);
     }
+}
 
-  // optimization
-  // only if dist between p1 and p2 < 2r
+double
+Topology::GetGridCellSize() const
+{
+  NS_LOG_FUNCTION (this);
+
+  return m_gridCellSize;
+}
+
+double
+Topology::GetObstructedLossBetween(const Point_3 &p1, const Point_3 &p2, double r)
+{
+  NS_LOG_FUNCTION (this);
+
+  // the index and the engine of the original module; the loss models
+  // cache the links they compute (see ObstacleShadowingPropagationLossModel)
+  Vector p1v(CGAL::to_double(p1.x()), CGAL::to_double(p1.y()), CGAL::to_double(p1.z()));
+  Vector p2v(CGAL::to_double(p2.x()), CGAL::to_double(p2.y()), CGAL::to_double(p2.z()));
+  std::vector<uint32_t> candidates;
+  return ComputeObstructedLoss(p1v, p2v, r, INDEX_RANGE_TREE, ENGINE_EXACT, candidates);
+}
+
+double
+Topology::ComputeObstructedLoss(const Vector &p1, const Vector &p2, double r, SpatialIndex index, GeometryEngine engine, std::vector<uint32_t> &candidates)
+{
+  // no logging here: this runs on the worker threads of ComputeLossMatrix
+
+  double p1x = p1.x;
+  double p1y = p1.y;
+  double p2x = p2.x;
+  double p2y = p2.y;
+
+  candidates.clear();
+
+  // Only the obstacles whose center lies within r of both ends count
+  // (see GetCandidatesLoss), whatever the index: links longer than 2r
+  // cross none of them. An infinite r keeps every obstacle on the link.
   double dx = p2x - p1x;
   double dy = p2y - p1y;
   double distP1toP2sq = dx * dx + dy * dy;
   // distance must be less then (2r)^2 = 4r^2
-  double x4rSq = 4.0 * rSq;
-  if (distP1toP2sq < x4rSq)
+  double x4rSq = 4.0 * r * r;
+  if (distP1toP2sq >= x4rSq)
+    {
+      return 0.0;
+    }
+
+  if (index == INDEX_BVH)
+    {
+      // obstacles whose bounding box the link crosses
+      m_bvh.Query(p1x, p1y, p2x, p2y, candidates);
+    }
+  else if (index == INDEX_GRID)
+    {
+      m_grid.Query(p1x, p1y, p2x, p2y, candidates);
+    }
+  else
     {
       // now search by range tree search
-      // get bounding box, and extend by r is all directions
-      double xmin = std::min(p1x, p2x) - r;
-      double xmax = std::max(p1x, p2x) + r;
-      double ymin = std::min(p1y, p2y) - r;
-      double ymax = std::max(p1y, p2y) + r;
-      Point pLow(xmin, ymin);
-      Point pHigh(xmax, ymax);
+      // get bounding box, and extend by r is all directions. Without a
+      // limiting radius, an obstacle crossed by the link has its center
+      // within m_maxReach of it, so there is no need to look further
+      double extent = std::isinf(r) ? m_maxReach : r;
+      double xmin = std::min(p1x, p2x) - extent;
+      double xmax = std::max(p1x, p2x) + extent;
+      double ymin = std::min(p1y, p2y) - extent;
+      double ymax = std::max(p1y, p2y) + extent;
+      Index_kernel::Point_2 pLow(xmin, ymin);
+      Index_kernel::Point_2 pHigh(xmax, ymax);
       Interval win(Interval(pLow, pHigh));
-      m_outputList.clear();
-      m_rangeTree.window_query(win, std::back_inserter(m_outputList));
-      std::vector<Key>::iterator current = m_outputList.begin();
-			uint32_t index = 0;	// another check
-			uint32_t limit = m_outputList.size ();
-      while (current != m_outputList.end() && index < limit)
-			// don't know why, but without the second condition it goes SIGSEGV
-			// because <current> goes off limits
-        {
-          Obstacle obstacle = (*current).second;
-          std::string id = obstacle.GetId();
-          Point center = obstacle.GetCenter();
+      m_rangeTree.window_query(win, HandleInserter(candidates));
+    }
 
-          double dx1 = CGAL::to_double(center.x()) - p1x;
-          double dy1 = CGAL::to_double(center.y()) - p1y;
-          double distCtoP1sq = dx1 * dx1 + dy1 * dy1;
+  return GetCandidatesLoss(p1, p2, r, candidates, engine);
+}
+
+double
+Topology::GetCandidatesLoss(const Vector &p1, const Vector &p2, double r, const std::vector<uint32_t> &candidates, GeometryEngine engine)
+{
+  // no logging here: this runs on the worker threads of ComputeLossMatrix
 
-          double dx2 = CGAL::to_double(center.x()) - p2x;
-          double dy2 = CGAL::to_double(center.y()) - p2y;
-          double distCtoP2sq = dx2 * dx2 + dy2 * dy2;
+  // initially assume no loss
+  double obstructedLoss = 0.0;
+
+  double rSq = r * r;
 
-          if (((distCtoP1sq - rSq) < 0)
-              && ((distCtoP2sq - rSq) < 0))
+  // The exact engine copies the reference-counted points of the shared
+  // polygons; the lock is taken before the exact points are built, so that
+  // they are also released under it
+  std::unique_lock<std::mutex> exactLock (m_exactMutex, std::defer_lock);
+  if (engine == ENGINE_EXACT)
+    {
+      exactLock.lock ();
+    }
+
+  // the exact engine works on exact points
+  Point_3 p1e;
+  Point_3 p2e;
+  if (engine == ENGINE_EXACT)
+    {
+      p1e = Point_3(p1.x, p1.y, p1.z);
+      p2e = Point_3(p2.x, p2.y, p2.z);
+    }
+
+  for (std::vector<uint32_t>::const_iterator current = candidates.begin(); current != candidates.end(); ++current)
+    {
+      // obstacles are stored once, in the arena
+      Obstacle &obstacle = m_obstacles[*current];
+
+      double dx1 = obstacle.GetCenterX() - p1.x;
+      double dy1 = obstacle.GetCenterY() - p1.y;
+      double distCtoP1sq = dx1 * dx1 + dy1 * dy1;
+
+      double dx2 = obstacle.GetCenterX() - p2.x;
+      double dy2 = obstacle.GetCenterY() - p2.y;
+      double distCtoP2sq = dx2 * dx2 + dy2 * dy2;
+
+      if (((distCtoP1sq - rSq) < 0)
+          && ((distCtoP2sq - rSq) < 0))
+        {
+          // obtstacle is within range
+
+          double obstructedDistanceBetween = 0.0;
+          int intersections = 0;
+
+					// if both points are over the top of the building, no loss
+					double minz = std::min(p1.z, p2.z);
+					if ((obstacle.GetHeight () > 0) && (minz >= obstacle.GetHeight ()))
+						{
+							noop;	// pass, do nothing
+						}
+					else if (engine == ENGINE_INEXACT)
+						{
+							GetObstructedDistanceInexact(p1, p2, obstacle, obstructedDistanceBetween, intersections);
+						}
+					else
+						{
+							GetObstructedDistance(p1e, p2e, obstacle, obstructedDistanceBetween, intersections);
+						}
+          // From C. Sommer et. al.:
+          // A Computationally Inexpensive Empirical Model of IEEE 802.11p
+          // Radio Shadowing in Urban Environments, 2011.
+          // Additional loss due to propagation through obstacles:
+          // Lobs = beta x n + gamma x d_m
+          // Where
+          // Lobs is the additional loss
+          // beta is a (constant) factor for the obstacle type
+          // n is the number of intersections through the obstacle
+          // gamma is a (constant) factor for the obstacle type
+          // d_m is the distance in meters of propagation through the obstacle
+          // As in the original module, the last obstructing candidate
+          // gives the loss of the link (see GetCandidatesLoss in topology.h).
+          if ((obstructedDistanceBetween > 0.0) && (intersections > 1))
             {
-              // obtstacle is within range
-
-              double obstructedDistanceBetween = 0.0;
-              int intersections = 0;
-
-							// if both points are over the top of the building, no loss
-							double minz = std::min(p1z, p2z);
-							if ((obstacle.GetHeight () > 0) && (minz >= obstacle.GetHeight ()))
-								{
-									noop;	// pass, do nothing
-								}
-							else
-								{
-									GetObstructedDistance(p1, p2, obstacle, obstructedDistanceBetween, intersections);
-								}
-              // From C. Sommer et. al.:
-              // A Computationally Inexpensive Empirical Model of IEEE 802.11p
-              // Radio Shadowing in Urban Environments, 2011.
-              // Additional loss due to propagation through obstacles:
-              // Lobs = beta x n + gamma x d_m
-              // Where
-              // Lobs is the additional loss
-              // beta is a (constant) factor for the obstacle type
-              // n is the number of intersections through the obstacle
-              // gamma is a (constant) factor for the obstacle type
-              // d_m is the distance in meters of propagation through the obstacle
-              if ((obstructedDistanceBetween > 0.0) && (intersections > 1))
-                {
-                  double beta = obstacle.GetBeta();
-                  double gamma = obstacle.GetGamma();
-                  obstructedLoss = beta * (double) intersections + gamma * obstructedDistanceBetween;
-                }
+              double beta = obstacle.GetBeta();
+              double gamma = obstacle.GetGamma();
+              obstructedLoss = beta * (double) intersections + gamma * obstructedDistanceBetween;
             }
-          current++;
-					index++;
         }
     }
 
-  // cache results
-  if (m_obstructedDistanceMap.size() > 1000)
+  return obstructedLoss;
+}
+
+std::vector<double>
+Topology::ComputeLossMatrix(const std::vector<Vector> &positionsA, const std::vector<Vector> &positionsB, double r, SpatialIndex index, GeometryEngine engine, uint32_t nThreads)
+{
+  NS_LOG_FUNCTION (this << positionsA.size () << positionsB.size () << r << index << engine << nThreads);
+
+  uint64_t nA = positionsA.size ();
+  uint64_t nB = positionsB.size ();
+  std::vector<double> losses (nA * nB, 0.0);
+
+  if (!HasObstacles ())
+    {
+      return losses;
+    }
+  NS_ASSERT_MSG (m_rangeTreeBuilt, "MakeRangeTree must be called before ComputeLossMatrix");
+
+  // the exact engine runs under a lock (see GetCandidatesLoss):
+  // more threads would only wait for it
+  if (engine == ENGINE_EXACT)
     {
-      // clear it every once in a while, to avoid bloat.
-      m_obstructedDistanceMap.clear();
+      nThreads = 1;
     }
-  m_obstructedDistanceMap.insert(TStrDblPair(key, obstructedLoss));
 
-  return obstructedLoss;
+  WorkStealingPool pool (nThreads);
+  // one scratch buffer per worker
+  std::vector<std::vector<uint32_t> > candidates (pool.GetNThreads ());
+
+  NS_LOG_INFO ("Computing " << nA << "x" << nB << " obstructed losses on "
+               << pool.GetNThreads () << " threads.");
+
+  // the workers do not log
+  pool.ParallelFor (nA * nB, 16, [&] (uint64_t begin, uint64_t end, uint32_t worker)
+  {
+    for (uint64_t k = begin; k < end; k++)
+      {
+        losses[k] = ComputeObstructedLoss (positionsA[k / nB], positionsB[k % nB], r, index, engine, candidates[worker]);
+      }
+  });
+
+  return losses;
 }
 
 double
@@ -573,10 +1228,26 @@ Topology::GetMaxY()
   return m_maxY;
 }
 
+uint32_t
+Topology::GetNObstacles()
+{
+  NS_LOG_FUNCTION (this);
+
+  return m_obstacles.size();
+}
+
+Obstacle &
+Topology::GetObstacle(uint32_t handle)
+{
+  NS_ASSERT (handle < m_obstacles.size());
+
+  return m_obstacles[handle];
+}
+
 bool
 Topology::HasObstacles()
 {
-  NS_LOG_FUNCTION (this);
+  // no logging: called by the loss queries, possibly on several threads
 
   bool HasObstacles = false;
 
@@ -591,7 +1262,7 @@ Topology::HasObstacles()
 bool
 Topology::PointIsInPolygon(const Polygon_2 &polygon, const Point_3 *ipoint)
 {
-	NS_LOG_FUNCTION (this);
+	// no logging: called by the loss queries, possibly on several threads
 
 	// Create the 2d point from a 3d point
 	Point ip(CGAL::to_double(ipoint->x ()), CGAL::to_double(ipoint->y ()));
@@ -613,7 +1284,7 @@ Topology::PointIsInPolygon(const Polygon_2 &polygon, const Point_3 *ipoint)
 bool
 Topology::IsInRegion(const Point &s1, const Point &s2, double h, const Point_3 &ip)
 {
-	NS_LOG_FUNCTION (this);
+	// no logging: called by the loss queries, possibly on several threads
 
 	double xMin = std::min (CGAL::to_double(s1.x ()), CGAL::to_double(s2.x ()));
 	double yMin = std::min (CGAL::to_double(s1.y ()), CGAL::to_double(s2.y ()));
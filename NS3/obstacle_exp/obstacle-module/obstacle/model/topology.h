@@ -22,32 +22,88 @@
 #ifndef TOPOLOGY_H
 #define TOPOLOGY_H
 
+#include <CGAL/Simple_cartesian.h>
+
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+
 #include "obstacle.h"
+#include "edge-table.h"
+#include "obstacle-bvh.h"
+#include "obstacle-grid.h"
+#include "sumo-poly-parser.h"
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <vector>
 
 namespace ns3 {
 
 // CGAL types
-typedef CGAL::Range_tree_map_traits_2<K, Obstacle> Traits;
+// The range tree maps the center of an obstacle to its handle, i.e.,
+// its index in the obstacle arena of the topology. Centers are plain
+// doubles, so the tree uses a double kernel: comparisons give the same
+// results as with the exact kernel, and queries allocate nothing.
+typedef CGAL::Simple_cartesian<double> Index_kernel;
+typedef CGAL::Range_tree_map_traits_2<Index_kernel, uint32_t> Traits;
 typedef CGAL::Range_tree_2<Traits> Range_tree_2_type;
 typedef Traits::Key Key;
 typedef Traits::Interval Interval;
-typedef std::map<std::string, double> TStrDblMap;
-typedef std::pair<std::string, double> TStrDblPair;
 
 /**
  * \ingroup obstacle
  * \brief The Topology class manages a list of obstacles
  * and can be used to load a set of obstacles from a file
+ *
+ * Topologies are ordinary ns-3 objects: several maps can be loaded in
+ * one process, and a loaded topology can be shared by several loss
+ * models (see the Topology attribute of
+ * ObstacleShadowingPropagationLossModel); once loaded, it is only read
+ * by the loss queries. GetTopology gives a default topology, used by
+ * the static loaders and by the loss models that are not given one.
  */
-class Topology
+class Topology : public Object
 {
 public:
+  /**
+   * \brief Engine used for the segment/obstacle intersection tests
+   */
+  enum GeometryEngine
+  {
+    ENGINE_EXACT,   //!< CGAL planes and intersections (exact constructions)
+    ENGINE_INEXACT  //!< hand-written wall and roof tests in double precision
+  };
+
+  /**
+   * \brief Index used to find the obstacles that may lie on a link
+   */
+  enum SpatialIndex
+  {
+    INDEX_RANGE_TREE, //!< range tree of the obstacle centers, searched around the link
+    INDEX_BVH,        //!< obstacle bounding boxes crossed by the link
+    INDEX_GRID        //!< same as INDEX_BVH, walking a uniform grid along the link
+  };
+
   /**
    * \brief Constructor
    * \return none
    */
   Topology ();
 
+  /**
+   * \brief Destructor
+   * \return none
+   */
+  virtual ~Topology ();
+
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
   /**
    * \brief Run
    * \return none
@@ -63,18 +119,77 @@ public:
   void CommandSetup (int argc, char **argv);
 
   /**
-   * \brief Gets the topology instance
-   * \return the topology instance
+   * \brief Gets the default topology instance (created if necessary)
+   * \return the default topology instance
    */
   static Topology * GetTopology();
 
   /**
-   * \brief Load buildings into the topology
+   * \brief Replaces the default topology instance
+   * \param topology the new default topology (0 to drop the current one;
+   * an empty one is created at the next GetTopology)
+   * \return none
+   */
+  static void SetTopology(Ptr<Topology> topology);
+
+  /**
+   * \brief Load buildings into the default topology (see ReadBuildings)
    * \param bldgFilename the filename that contains buildings data
    * \return none
    */
   static void LoadBuildings(std::string bldgFilename);
 
+  /**
+   * \brief Load a compiled topology (see SaveCompiled) into the topology.
+   * The file is memory-mapped and its arrays are copied: no text is
+   * parsed, and the BVH is not rebuilt if the topology was empty. The
+   * CGAL polygons, the range tree, the edge table and the grid are still
+   * built from the vertices, as after ReadBuildings.
+   * The offsets and indices of the file are checked before anything is
+   * loaded.
+   * \param compiledFilename the compiled topology file
+   * \return false (and the topology is left unchanged) if the file cannot
+   * be read, was compiled for another version or host, or is corrupted
+   */
+  bool ReadCompiled(std::string compiledFilename);
+
+  /**
+   * \brief Load buildings into the topology, from the \<poly\> elements
+   * of type building or unknown of a SUMO polygon file. Besides id, shape
+   * and height, a polygon may give its beta and gamma, or a material
+   * registered with RegisterMaterial.
+   * \param bldgFilename the filename that contains buildings data
+   * \return none
+   */
+  void ReadBuildings(std::string bldgFilename);
+
+  /**
+   * \brief Load a compiled topology into the default topology (see ReadCompiled)
+   * \param compiledFilename the compiled topology file
+   * \return false if the file could not be loaded
+   */
+  static bool LoadCompiled(std::string compiledFilename);
+
+  /**
+   * \brief Writes the obstacles and their BVH to a compiled topology file,
+   * to be loaded later with ReadCompiled. MakeRangeTree must have been called.
+   * The file uses the byte order and the floating point format of the host.
+   * \param compiledFilename the file to write
+   * \return none
+   */
+  void SaveCompiled(std::string compiledFilename);
+
+  /**
+   * \brief Registers a material, for the material attribute of the
+   * polygons loaded by ReadBuildings (beta and gamma attributes, if
+   * any, take precedence)
+   * \param name the name of the material
+   * \param beta the per-wall attenuation of the material
+   * \param gamma the per-meter attenuation of the material
+   * \return none
+   */
+  void RegisterMaterial(std::string name, double beta, double gamma);
+
   /**
    * \brief Gets the minimum X value of buildings in the topology
    * \return minimum X value of buildings in the topology
@@ -100,14 +215,103 @@ public:
   double GetMaxY();
 
   /**
-   * \brief Gets the obstructed propagation loss between two points
+   * \brief Gets the obstructed propagation loss between two points, with
+   * the range tree and the exact engine, as the original module did
+   * (nothing is cached: see ObstacleShadowingPropagationLossModel for the
+   * loss models, which keep their own cache, engine and index)
    * \param p1 point1
    * \param p2 point2
    * \param r limiting radius for obstacles between p1 and p2
-   * \return tbd
+   * \return the obstructed loss (dB)
    */
   double GetObstructedLossBetween(const Point_3 &p1, const Point_3 &p2, double r);
 
+  /**
+   * \brief Computes the obstructed propagation loss between two points,
+   * with the given index and engine. The topology keeps no cache and no
+   * setting of its own: the loss models choose the index and the engine.
+   * Once MakeRangeTree has been called, this only reads the topology: it
+   * does not log, and may be called from several threads at once, each
+   * with its own scratch buffer (the exact engine is then serialized, see
+   * GetCandidatesLoss).
+   * \param p1 point1
+   * \param p2 point2
+   * \param r limiting radius for obstacles between p1 and p2: only the
+   * obstacles whose center lies within r of both points count (infinity
+   * for every obstacle crossed by the link)
+   * \param index the index used to find the candidate obstacles
+   * \param engine the engine used for the intersection tests
+   * \param candidates scratch buffer for the handles of the obstacles
+   * found near p1 and p2
+   * \return the obstructed loss (dB)
+   */
+  double ComputeObstructedLoss(const Vector &p1, const Vector &p2, double r, SpatialIndex index, GeometryEngine engine, std::vector<uint32_t> &candidates);
+
+  /**
+   * \brief Computes the obstructed loss of every pair of points, in
+   * parallel, with the given index and engine (see ComputeObstructedLoss).
+   * With the exact engine, the pairs are computed serially, on the
+   * calling thread: the CGAL exact kernel is not thread-safe, so its
+   * intersection tests run under a lock anyway.
+   * \param positionsA the first set of points (e.g., end devices)
+   * \param positionsB the second set of points (e.g., gateways)
+   * \param r limiting radius for obstacles between two points
+   * \param index the index used to find the candidate obstacles
+   * \param engine the engine used for the intersection tests
+   * \param nThreads number of threads (0 means one per hardware thread),
+   * ignored with the exact engine
+   * \return the losses (dB), row-major: entry i * positionsB.size () + j
+   * is the loss between positionsA[i] and positionsB[j]
+   */
+  std::vector<double> ComputeLossMatrix(const std::vector<Vector> &positionsA, const std::vector<Vector> &positionsB, double r, SpatialIndex index, GeometryEngine engine, uint32_t nThreads);
+
+  /**
+   * \brief Computes the loss of the obstacles found near p1 and p2. As in
+   * the original module, the loss is the one of the last candidate that
+   * obstructs the link, not the sum over the obstacles crossed: the range
+   * tree gives its candidates in the order of its query, the BVH and the
+   * grid in increasing handle order, so the indices agree on the links
+   * through at most one obstacle.
+   * \param p1 point1
+   * \param p2 point2
+   * \param r limiting radius for obstacles between p1 and p2
+   * \param candidates the handles of the obstacles returned by the spatial
+   * index, in the order of the index
+   * \param engine the engine used for the intersection tests; the exact
+   * engine shares reference-counted CGAL objects between the obstacles,
+   * so it runs under a lock and the calls are serialized
+   * \return the obstructed loss (dB)
+   */
+  double GetCandidatesLoss(const Vector &p1, const Vector &p2, double r, const std::vector<uint32_t> &candidates, GeometryEngine engine);
+
+  /**
+   * \brief Sets the side of the cells of the uniform grid index.
+   * The grid is rebuilt if the obstacles are already indexed.
+   * \param cellSize the side of a cell in meters (0 means twice the mean
+   * side of the obstacle bounding boxes)
+   * \return none
+   */
+  void SetGridCellSize(double cellSize);
+
+  /**
+   * \brief Gets the requested side of the cells of the uniform grid index
+   * \return the side of a cell in meters (0 means automatic)
+   */
+  double GetGridCellSize() const;
+
+  /**
+   * \brief Gets the number of obstacles in the topology
+   * \return the number of obstacles (handles are in [0, n))
+   */
+  uint32_t GetNObstacles();
+
+  /**
+   * \brief Gets an obstacle from its handle
+   * \param handle the handle of the obstacle
+   * \return the obstacle
+   */
+  Obstacle &GetObstacle(uint32_t handle);
+
   /**
    * \brief Tests if the topology has any obstacles (loaded within it)
    * \return true if the topology has obstacles, false otherwise
@@ -116,16 +320,25 @@ public:
 
   /**
    * \brief Make a range tree (binary space partition, BSP) of obstacles, for searching.
+   * Also builds the edge table, the BVH and the grid of the obstacles.
    * Called after all obstacle have been loaded into the topology
    * \return none
    */
   void MakeRangeTree();
 
   /**
-   * \brief Get the topology instance (create if necessary)
-   * \return the topology instance
+   * \brief Same as MakeRangeTree, but the BVH can be left as is
+   * (e.g., when it has been read from a compiled topology)
+   * \param buildBvh true to build the BVH too
+   * \return none
    */
-  static Topology ** PeekTopology();
+  void MakeIndices(bool buildBvh);
+
+  /**
+   * \brief Get the default topology instance (not created if missing)
+   * \return where the default topology instance is kept
+   */
+  static Ptr<Topology> * PeekTopology();
 
   /**
    * \brief Create a shape for the topolgy
@@ -136,6 +349,15 @@ public:
    */
   void CreateShape(std::string id, std::string vertices, std::string height);
 
+  /**
+   * \brief Create a shape for the topology from a parsed polygon
+   * \param poly the attributes of the polygon (id, height, beta, gamma, material)
+   * \param vx the x coordinates of the vertices (see SumoPolyParser::ParseShape)
+   * \param vy the y coordinates of the vertices
+   * \return none
+   */
+  void CreateShape(const SumoPoly &poly, const std::vector<double> &vx, const std::vector<double> &vy);
+
   /**
    * \brief Create a vertex
    * \param obstacle the obstacle to which the vertex should be added
@@ -158,6 +380,22 @@ public:
    */
   void GetObstructedDistance(const Point_3 &p1b, const Point_3 &p2b, Obstacle &obs, double &obstructedDistanceBetween, int &intersections);
 
+  /**
+   * \brief Get the obstructed distance between two points, with double
+   * precision wall and roof tests. Same semantics as GetObstructedDistance,
+   * without building any exact plane or intersection point. The walls
+   * are tested in one pass over the edge table (see MakeRangeTree).
+   * \param p1 point1
+   * \param p2 point2
+   * \param obs obstacle that may lie between p1 and p2
+   * \param obstructedDistanceBetween the total length within obs
+   * traversed by a line between p1 and p2
+   * \param intersections the number of intersections of the obstacle for
+   * a line between p1 and p2
+   * \return none
+   */
+  void GetObstructedDistanceInexact(const Vector &p1, const Vector &p2, Obstacle &obs, double &obstructedDistanceBetween, int &intersections);
+
 	/**
 	 * \brief Check if a point is inside a special region
 	 * \param s1, the first point of the segment
@@ -178,15 +416,41 @@ public:
 	 */
 	bool PointIsInPolygon(const Polygon_2 &polygon, const Point_3 *ipoint);
 
-  // list of obstacles in the topology
-  std::vector<Key> m_obstacles;
+  // arena of the obstacles in the topology: every obstacle is
+  // stored once, the spatial indices and the queries use handles
+  // (indices in this vector)
+  std::vector<Obstacle> m_obstacles;
+
+  // attenuation of a material
+  struct Material
+  {
+    double beta;
+    double gamma;
+  };
 
-  // output list, used for sorting
-  std::vector<Key> m_outputList;
+  // materials known to ReadBuildings, by name
+  std::map<std::string, Material, std::less<> > m_materials;
 
   // BSP, for searching for obstacles
   Range_tree_2_type m_rangeTree;
 
+  // walls of every obstacle, for the inexact engine
+  EdgeTable m_edgeTable;
+
+  // bounding volume hierarchy of the obstacle footprints
+  ObstacleBvh m_bvh;
+
+  // uniform grid of the obstacle footprints
+  ObstacleGrid m_grid;
+  double m_gridCellSize; // requested cell size, 0 for automatic
+  std::vector<ObstacleBox> m_boxes; // footprint bounding boxes, for rebuilding the grid
+
+  // true once MakeRangeTree has been called
+  bool m_rangeTreeBuilt;
+
+  // largest distance between the center of an obstacle and its vertices
+  double m_maxReach;
+
   // minimum x value of obstacles in the topology
   double m_minX;
 
@@ -199,16 +463,12 @@ public:
   // maximum y value of obstacles in the topology
   double m_maxY;
 
-  // a cache of obstructed distances between two points
-  // (used for performance optimization).
-  // Assume that two points that have not moved more than
-  // 0.1m from their last locations will have the same
-  // line of sight obstacle intersections and interior
-  // distances.  This prevent these values from being
-  // recalculated deterministically at every evaluation,
-  // e.g., when nodes are stationary (obstacle are, too) so
-  // there is no change to previously calculated results.
-  TStrDblMap m_obstructedDistanceMap;
+  // serializes the exact engine: the lazy exact kernel shares
+  // reference-counted representations, which are not thread-safe
+  std::mutex m_exactMutex;
+
+protected:
+  virtual void DoDispose (void);
 };
 
 } // namespace ns3
@@ -0,0 +1,155 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ns3/log.h"
+
+#include "work-stealing-pool.h"
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("WorkStealingPool");
+
+namespace {
+
+// the part of the index space still owned by a worker
+struct WorkRange
+{
+  std::mutex mutex;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// take the next chunk of the own range
+bool
+TakeChunk (WorkRange &range, uint64_t grain, uint64_t &begin, uint64_t &end)
+{
+  std::lock_guard<std::mutex> lock (range.mutex);
+  if (range.begin >= range.end)
+    {
+      return false;
+    }
+  begin = range.begin;
+  end = std::min (range.begin + grain, range.end);
+  range.begin = end;
+  return true;
+}
+
+// move the upper half of the range of another worker into the own
+// range; the workers after the thief are tried in turn
+bool
+Steal (std::vector<WorkRange> &ranges, uint32_t thief, uint64_t grain)
+{
+  uint32_t n = ranges.size ();
+  for (uint32_t offset = 1; offset < n; offset++)
+    {
+      WorkRange &victim = ranges[(thief + offset) % n];
+      uint64_t begin;
+      uint64_t end;
+      {
+        std::lock_guard<std::mutex> lock (victim.mutex);
+        uint64_t remaining = victim.end - std::min (victim.begin, victim.end);
+        if (remaining == 0)
+          {
+            continue;
+          }
+        // the upper half of the remaining range; a remainder of one
+        // chunk or less is taken whole (the victim may then run out
+        // and steal in turn)
+        uint64_t half = (remaining > grain) ? remaining / 2 : remaining;
+        begin = victim.end - half;
+        end = victim.end;
+        victim.end = begin;
+      }
+      std::lock_guard<std::mutex> lock (ranges[thief].mutex);
+      ranges[thief].begin = begin;
+      ranges[thief].end = end;
+      return true;
+    }
+  return false;
+}
+
+} // anonymous namespace
+
+WorkStealingPool::WorkStealingPool (uint32_t nThreads) :
+  m_nThreads (nThreads)
+{
+  NS_LOG_FUNCTION (this << nThreads);
+
+  if (m_nThreads == 0)
+    {
+      m_nThreads = std::max (1u, std::thread::hardware_concurrency ());
+    }
+}
+
+uint32_t
+WorkStealingPool::GetNThreads (void) const
+{
+  return m_nThreads;
+}
+
+void
+WorkStealingPool::ParallelFor (uint64_t n, uint64_t grain, Body body) const
+{
+  NS_LOG_FUNCTION (this << n << grain);
+
+  if (n == 0)
+    {
+      return;
+    }
+  grain = std::max<uint64_t> (grain, 1);
+
+  // no point in starting more workers than there are chunks
+  uint64_t nChunks = (n + grain - 1) / grain;
+  uint32_t nWorkers = static_cast<uint32_t> (std::min<uint64_t> (m_nThreads, nChunks));
+
+  std::vector<WorkRange> ranges (nWorkers);
+  for (uint32_t w = 0; w < nWorkers; w++)
+    {
+      ranges[w].begin = n * w / nWorkers;
+      ranges[w].end = n * (w + 1) / nWorkers;
+    }
+
+  auto work = [&ranges, &body, grain] (uint32_t worker)
+  {
+    uint64_t begin;
+    uint64_t end;
+    while (TakeChunk (ranges[worker], grain, begin, end)
+           || (Steal (ranges, worker, grain) && TakeChunk (ranges[worker], grain, begin, end)))
+      {
+        body (begin, end, worker);
+      }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve (nWorkers - 1);
+  for (uint32_t w = 1; w < nWorkers; w++)
+    {
+      threads.emplace_back (work, w);
+    }
+  work (0);
+  for (std::vector<std::thread>::iterator it = threads.begin (); it != threads.end (); ++it)
+    {
+      it->join ();
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,79 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <stdint.h>
+#include <functional>
+
+namespace ns3 {
+
+/**
+ * \ingroup obstacle
+ * \brief Runs a loop over [0, n) on several threads, with work stealing
+ *
+ * The index space is split into one contiguous range per worker. Each
+ * worker consumes its own range in chunks of Grain indices; a worker that
+ * runs out of work steals the upper half of the remaining range of the
+ * first worker after it (in worker order) that has any left, or the whole
+ * remainder if it is at most one chunk. This keeps the load balanced when
+ * the cost per index varies a lot, e.g., links crossing the dense part of
+ * a map versus links in open areas. A worker stops when no other worker
+ * has indices left. The calling thread is worker 0; the other workers
+ * are threads started by each ParallelFor and joined before it returns.
+ *
+ * This is meant for setup-time work that does not touch the simulator
+ * (e.g., building link matrices); the body must be thread-safe.
+ */
+class WorkStealingPool
+{
+public:
+  /**
+   * \brief Loop body, called with a chunk [begin, end) and the worker index
+   */
+  typedef std::function<void (uint64_t begin, uint64_t end, uint32_t worker)> Body;
+
+  /**
+   * \brief Constructor
+   * \param nThreads number of workers (0 means one per hardware thread)
+   * \return none
+   */
+  explicit WorkStealingPool (uint32_t nThreads);
+
+  /**
+   * \brief Gets the number of workers
+   * \return the number of workers (worker indices are in [0, n))
+   */
+  uint32_t GetNThreads (void) const;
+
+  /**
+   * \brief Runs body over [0, n) and returns when every index is done
+   * \param n the number of indices
+   * \param grain the number of indices taken at once by a worker
+   * \param body the loop body
+   * \return none
+   */
+  void ParallelFor (uint64_t n, uint64_t grain, Body body) const;
+
+private:
+  uint32_t m_nThreads;
+};
+
+} // namespace ns3
+
+#endif /* WORK_STEALING_POOL_H */
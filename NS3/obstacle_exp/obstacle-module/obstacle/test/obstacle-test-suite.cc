@@ -0,0 +1,652 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+#include "ns3/test.h"
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/uinteger.h"
+#include "ns3/topology.h"
+#include "ns3/obstacle-shadowing-propagation-loss-model.h"
+#include "ns3/precomputed-link-loss-model.h"
+
+using namespace ns3;
+
+namespace {
+
+// default attenuation of an obstacle (see Obstacle::Obstacle)
+const double BETA = 9.0;
+const double GAMMA = 0.4;
+
+const double INF = std::numeric_limits<double>::infinity ();
+
+// adds an axis-aligned box to the topology
+void
+AddBox (Ptr<Topology> topology, std::string id, double x, double y, double w, double h, double height)
+{
+  std::ostringstream shape;
+  shape << x << "," << y << " " << x + w << "," << y << " "
+        << x + w << "," << y + h << " " << x << "," << y + h;
+  std::ostringstream z;
+  z << height;
+  topology->CreateShape (id, shape.str (), z.str ());
+}
+
+// a block of buildings of various sizes, heights and shapes
+Ptr<Topology>
+MakeCity (void)
+{
+  Ptr<Topology> topology = CreateObject<Topology> ();
+  for (uint32_t i = 0; i < 12; i++)
+    {
+      for (uint32_t j = 0; j < 12; j++)
+        {
+          std::ostringstream id;
+          id << "b" << i << "-" << j;
+          double x = i * 40.0;
+          double y = j * 40.0;
+          double w = 15.0 + (i * 7 + j * 3) % 15;
+          double h = 15.0 + (i * 5 + j * 11) % 15;
+          double height = 5.0 + ((i + j) % 7) * 5.0;
+          if ((i + j) % 3 == 0)
+            {
+              // a pentagon, so that not every wall is axis-aligned
+              std::ostringstream shape;
+              shape << x << "," << y << " " << x + w << "," << y + 3.0 << " "
+                    << x + w - 2.0 << "," << y + h << " " << x + w / 2.0 << "," << y + h + 6.0 << " "
+                    << x + 1.0 << "," << y + h - 4.0;
+              std::ostringstream z;
+              z << height;
+              topology->CreateShape (id.str (), shape.str (), z.str ());
+            }
+          else
+            {
+              AddBox (topology, id.str (), x, y, w, h, height);
+            }
+        }
+    }
+  topology->MakeRangeTree ();
+  return topology;
+}
+
+// deterministic link ends spread over the city and around it,
+// at the ground, at mid height and above most of the roofs
+std::vector<Vector>
+MakePoints (uint32_t n)
+{
+  std::vector<Vector> points;
+  uint64_t state = 12345;
+  const double heights[] = {1.5, 12.0, 32.0};
+  for (uint32_t k = 0; k < n; k++)
+    {
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      double x = -30.0 + (double) ((state >> 11) % 530000) / 1000.0;
+      state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+      double y = -30.0 + (double) ((state >> 11) % 530000) / 1000.0;
+      points.push_back (Vector (x, y, heights[k % 3]));
+    }
+  return points;
+}
+
+} // namespace
+
+/**
+ * \ingroup obstacle
+ * The loss of a link through one obstacle, and through two.
+ */
+class ObstacleLossTestCase : public TestCase
+{
+public:
+  ObstacleLossTestCase ();
+  virtual ~ObstacleLossTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+ObstacleLossTestCase::ObstacleLossTestCase ()
+  : TestCase ("Check the loss of the links through one and two obstacles")
+{
+}
+
+ObstacleLossTestCase::~ObstacleLossTestCase ()
+{
+}
+
+void
+ObstacleLossTestCase::DoRun (void)
+{
+  Ptr<Topology> topology = CreateObject<Topology> ();
+  AddBox (topology, "near", 0.0, 0.0, 10.0, 10.0, 20.0);
+  AddBox (topology, "far", 30.0, 0.0, 10.0, 10.0, 20.0);
+  topology->MakeRangeTree ();
+
+  std::vector<uint32_t> candidates;
+  const Topology::GeometryEngine engines[] = {Topology::ENGINE_EXACT, Topology::ENGINE_INEXACT};
+  for (uint32_t e = 0; e < 2; e++)
+    {
+      // two walls and 10 m through the first box
+      double loss = topology->ComputeObstructedLoss (Vector (-5.0, 5.0, 1.5), Vector (15.0, 5.0, 1.5), INF,
+                                                     Topology::INDEX_RANGE_TREE, engines[e], candidates);
+      NS_TEST_ASSERT_MSG_EQ_TOL (loss, 2 * BETA + 10.0 * GAMMA, 1e-9, "Wrong loss through one obstacle");
+
+      // both boxes: one of them gives the loss, as in the original
+      // module (the losses are not added up)
+      loss = topology->ComputeObstructedLoss (Vector (-5.0, 5.0, 1.5), Vector (45.0, 5.0, 1.5), INF,
+                                              Topology::INDEX_RANGE_TREE, engines[e], candidates);
+      NS_TEST_ASSERT_MSG_EQ_TOL (loss, 2 * BETA + 10.0 * GAMMA, 1e-9, "Wrong loss through two obstacles");
+
+      // above the roofs
+      loss = topology->ComputeObstructedLoss (Vector (-5.0, 5.0, 25.0), Vector (45.0, 5.0, 25.0), INF,
+                                              Topology::INDEX_RANGE_TREE, engines[e], candidates);
+      NS_TEST_ASSERT_MSG_EQ_TOL (loss, 0.0, 1e-9, "A link above the roofs is not shadowed");
+
+      // longer than twice the limiting radius
+      loss = topology->ComputeObstructedLoss (Vector (-5.0, 5.0, 1.5), Vector (45.0, 5.0, 1.5), 20.0,
+                                              Topology::INDEX_RANGE_TREE, engines[e], candidates);
+      NS_TEST_ASSERT_MSG_EQ_TOL (loss, 0.0, 1e-9, "The limiting radius is not applied");
+    }
+
+  topology->Dispose ();
+}
+
+/**
+ * \ingroup obstacle
+ * Every spatial index finds the obstacles of a link, with and without a
+ * limiting radius: the loss of a link is the one of one of the obstacles
+ * it crosses (the last one the index gives, in handle order for the BVH
+ * and the grid), and the parallel loss matrix gives the same losses.
+ */
+class ObstacleIndexEquivalenceTestCase : public TestCase
+{
+public:
+  ObstacleIndexEquivalenceTestCase ();
+  virtual ~ObstacleIndexEquivalenceTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+ObstacleIndexEquivalenceTestCase::ObstacleIndexEquivalenceTestCase ()
+  : TestCase ("Check that the range tree, the BVH and the grid find the obstacles of a link")
+{
+}
+
+ObstacleIndexEquivalenceTestCase::~ObstacleIndexEquivalenceTestCase ()
+{
+}
+
+void
+ObstacleIndexEquivalenceTestCase::DoRun (void)
+{
+  Ptr<Topology> topology = MakeCity ();
+  std::vector<Vector> points = MakePoints (400);
+
+  const Topology::SpatialIndex indices[] = {Topology::INDEX_RANGE_TREE, Topology::INDEX_BVH, Topology::INDEX_GRID};
+  const double radii[] = {50.0, 200.0, INF};
+  std::vector<uint32_t> candidates;
+  uint32_t shadowed = 0;
+  uint32_t severalObstacles = 0;
+  for (uint32_t ri = 0; ri < 3; ri++)
+    {
+      for (uint32_t k = 0; k + 1 < points.size (); k += 2)
+        {
+          // the exact engine is slow: one link out of 8
+          Topology::GeometryEngine engine = (k % 16 == 0) ? Topology::ENGINE_EXACT : Topology::ENGINE_INEXACT;
+
+          // the loss of each obstacle on its own
+          std::vector<double> obstacleLoss;
+          double lastLoss = 0.0;
+          for (uint32_t h = 0; h < topology->GetNObstacles (); h++)
+            {
+              double loss = topology->GetCandidatesLoss (points[k], points[k + 1], radii[ri],
+                                                         std::vector<uint32_t> (1, h), engine);
+              if (loss > 0.0)
+                {
+                  obstacleLoss.push_back (loss);
+                  lastLoss = loss;
+                }
+            }
+          if (!obstacleLoss.empty ())
+            {
+              shadowed++;
+            }
+          if (obstacleLoss.size () > 1)
+            {
+              severalObstacles++;
+            }
+
+          for (uint32_t i = 0; i < 3; i++)
+            {
+              double loss = topology->ComputeObstructedLoss (points[k], points[k + 1], radii[ri],
+                                                             indices[i], engine, candidates);
+              bool found = obstacleLoss.empty () ? (loss == 0.0) : false;
+              for (uint32_t o = 0; o < obstacleLoss.size (); o++)
+                {
+                  found = found || (std::abs (loss - obstacleLoss[o]) < 1e-9);
+                }
+              NS_TEST_ASSERT_MSG_EQ (found, true, "Index " << indices[i] << " gives a loss of " << loss
+                                     << " dB, of no obstacle of link " << points[k] << " - " << points[k + 1]
+                                     << ", radius " << radii[ri]);
+              if (indices[i] != Topology::INDEX_RANGE_TREE)
+                {
+                  NS_TEST_ASSERT_MSG_EQ_TOL (loss, lastLoss, 1e-9, "Index " << indices[i] << " does not give the loss "
+                                             "of the last obstacle of link " << points[k] << " - " << points[k + 1]
+                                             << ", radius " << radii[ri]);
+                }
+            }
+        }
+    }
+  NS_TEST_ASSERT_MSG_GT (shadowed, 100, "Too few shadowed links to compare the indices");
+  NS_TEST_ASSERT_MSG_GT (severalObstacles, 10, "Too few links through several obstacles");
+
+  // the loss matrix, on several threads, gives the same losses
+  std::vector<Vector> devices (points.begin (), points.begin () + 40);
+  std::vector<Vector> gateways (points.begin () + 40, points.begin () + 45);
+  std::vector<double> matrix = topology->ComputeLossMatrix (devices, gateways, INF, Topology::INDEX_GRID,
+                                                            Topology::ENGINE_INEXACT, 4);
+  NS_TEST_ASSERT_MSG_EQ (matrix.size (), devices.size () * gateways.size (), "Wrong size of the loss matrix");
+  for (uint32_t i = 0; i < devices.size (); i++)
+    {
+      for (uint32_t j = 0; j < gateways.size (); j++)
+        {
+          double expected = topology->ComputeObstructedLoss (devices[i], gateways[j], INF,
+                                                             Topology::INDEX_GRID, Topology::ENGINE_INEXACT,
+                                                             candidates);
+          NS_TEST_ASSERT_MSG_EQ_TOL (matrix[i * gateways.size () + j], expected, 1e-9, "Wrong loss matrix entry");
+        }
+    }
+
+  topology->Dispose ();
+}
+
+/**
+ * \ingroup obstacle
+ * The settings of a loss model do not change the other models that
+ * share its topology.
+ */
+class ObstacleModelSettingsTestCase : public TestCase
+{
+public:
+  ObstacleModelSettingsTestCase ();
+  virtual ~ObstacleModelSettingsTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+ObstacleModelSettingsTestCase::ObstacleModelSettingsTestCase ()
+  : TestCase ("Check that the loss models keep their own settings")
+{
+}
+
+ObstacleModelSettingsTestCase::~ObstacleModelSettingsTestCase ()
+{
+}
+
+void
+ObstacleModelSettingsTestCase::DoRun (void)
+{
+  Ptr<Topology> topology = CreateObject<Topology> ();
+  AddBox (topology, "box", 0.0, 0.0, 10.0, 10.0, 20.0);
+  topology->MakeRangeTree ();
+
+  Ptr<ObstacleShadowingPropagationLossModel> inexact = CreateObject<ObstacleShadowingPropagationLossModel> ();
+  inexact->SetGeometryEngine (Topology::ENGINE_INEXACT);
+  inexact->SetSpatialIndex (Topology::INDEX_BVH);
+  inexact->SetCacheCapacity (8);
+  inexact->SetTopology (topology);
+
+  // a second model, with the default settings, on the same topology
+  Ptr<ObstacleShadowingPropagationLossModel> exact = CreateObject<ObstacleShadowingPropagationLossModel> ();
+  exact->SetTopology (topology);
+
+  NS_TEST_ASSERT_MSG_EQ (inexact->GetGeometryEngine (), Topology::ENGINE_INEXACT, "The engine of a model was reset");
+  NS_TEST_ASSERT_MSG_EQ (inexact->GetSpatialIndex (), Topology::INDEX_BVH, "The index of a model was reset");
+  NS_TEST_ASSERT_MSG_EQ (exact->GetGeometryEngine (), Topology::ENGINE_EXACT, "A model changed the engine of another");
+  NS_TEST_ASSERT_MSG_EQ (exact->GetSpatialIndex (), Topology::INDEX_RANGE_TREE, "A model changed the index of another");
+  NS_TEST_ASSERT_MSG_EQ (exact->GetCacheCapacity (), 16384, "A model changed the cache of another");
+
+  Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  a->SetPosition (Vector (-5.0, 5.0, 1.5));
+  Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  b->SetPosition (Vector (15.0, 5.0, 1.5));
+
+  double expected = 2 * BETA + 10.0 * GAMMA;
+  NS_TEST_ASSERT_MSG_EQ_TOL (inexact->GetLoss (a, b), expected, 1e-9, "Wrong loss with the inexact engine");
+  NS_TEST_ASSERT_MSG_EQ_TOL (inexact->GetLoss (b, a), expected, 1e-9, "Wrong cached loss");
+  NS_TEST_ASSERT_MSG_EQ_TOL (exact->GetLoss (a, b), expected, 1e-9, "Wrong loss with the exact engine");
+  NS_TEST_ASSERT_MSG_EQ (inexact->GetCacheHits (), 1, "The reversed link was not found in the cache");
+  NS_TEST_ASSERT_MSG_EQ (exact->GetCacheHits (), 0, "The models share their cache");
+
+  topology->Dispose ();
+}
+
+/**
+ * \ingroup obstacle
+ * A compiled topology gives the same losses as the buildings it was
+ * compiled from, and a corrupted one is rejected.
+ */
+class ObstacleCompiledTopologyTestCase : public TestCase
+{
+public:
+  ObstacleCompiledTopologyTestCase ();
+  virtual ~ObstacleCompiledTopologyTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  // writes a copy of the compiled file with a uint32_t changed at offset
+  std::string Corrupt (const std::vector<char> &blob, uint64_t offset, uint32_t value, std::string name);
+};
+
+ObstacleCompiledTopologyTestCase::ObstacleCompiledTopologyTestCase ()
+  : TestCase ("Check the compiled topology files")
+{
+}
+
+ObstacleCompiledTopologyTestCase::~ObstacleCompiledTopologyTestCase ()
+{
+}
+
+std::string
+ObstacleCompiledTopologyTestCase::Corrupt (const std::vector<char> &blob, uint64_t offset, uint32_t value, std::string name)
+{
+  std::vector<char> copy (blob);
+  std::memcpy (&copy[offset], &value, sizeof (value));
+  std::string filename = CreateTempDirFilename (name);
+  std::ofstream file (filename.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write (copy.data (), copy.size ());
+  return filename;
+}
+
+void
+ObstacleCompiledTopologyTestCase::DoRun (void)
+{
+  Ptr<Topology> source = MakeCity ();
+  std::string filename = CreateTempDirFilename ("city.topo");
+  source->SaveCompiled (filename);
+
+  Ptr<Topology> compiled = CreateObject<Topology> ();
+  NS_TEST_ASSERT_MSG_EQ (compiled->ReadCompiled (filename), true, "Could not read the compiled topology");
+  NS_TEST_ASSERT_MSG_EQ (compiled->GetNObstacles (), source->GetNObstacles (), "Wrong number of obstacles");
+
+  // the BVH of the file gives the same losses as the one built from the buildings
+  std::vector<Vector> points = MakePoints (200);
+  std::vector<uint32_t> candidates;
+  for (uint32_t k = 0; k + 1 < points.size (); k += 2)
+    {
+      double expected = source->ComputeObstructedLoss (points[k], points[k + 1], INF, Topology::INDEX_RANGE_TREE,
+                                                       Topology::ENGINE_INEXACT, candidates);
+      double loss = compiled->ComputeObstructedLoss (points[k], points[k + 1], INF, Topology::INDEX_BVH,
+                                                     Topology::ENGINE_INEXACT, candidates);
+      NS_TEST_ASSERT_MSG_EQ_TOL (loss, expected, 1e-9, "The compiled topology gives another loss");
+    }
+
+  std::ifstream file (filename.c_str (), std::ios::in | std::ios::binary);
+  std::vector<char> blob ((std::istreambuf_iterator<char> (file)), std::istreambuf_iterator<char> ());
+
+  // offsets of the layout of the file (see SaveCompiled): a 72 byte
+  // header, then arrays aligned on 8 bytes
+  uint32_t nObstacles;
+  uint32_t nVertices;
+  std::memcpy (&nObstacles, &blob[20], sizeof (uint32_t));
+  std::memcpy (&nVertices, &blob[24], sizeof (uint32_t));
+  uint64_t firstVertex = 72;
+  uint64_t idOffset = (firstVertex + 4 * (nObstacles + 1) + 7) & ~7ULL;
+  uint64_t bvhNodes = ((idOffset + 4 * (nObstacles + 1) + 7) & ~7ULL) + 24 * nObstacles + 16 * (uint64_t) nVertices;
+  uint64_t rootRight = bvhNodes + sizeof (ObstacleBox) + 2 * sizeof (uint32_t);
+
+  Ptr<Topology> rejected = CreateObject<Topology> ();
+  NS_TEST_ASSERT_MSG_EQ (rejected->ReadCompiled (Corrupt (blob, firstVertex + 4, nVertices + 1, "vertex.topo")), false,
+                         "A vertex offset out of bounds was accepted");
+  NS_TEST_ASSERT_MSG_EQ (rejected->ReadCompiled (Corrupt (blob, idOffset + 4 * nObstacles, 0xffffffff, "id.topo")), false,
+                         "An id offset out of bounds was accepted");
+  NS_TEST_ASSERT_MSG_EQ (rejected->ReadCompiled (Corrupt (blob, rootRight, 0, "bvh.topo")), false,
+                         "A BVH cycle was accepted");
+  NS_TEST_ASSERT_MSG_EQ (rejected->GetNObstacles (), 0, "A corrupted file was partly loaded");
+
+  source->Dispose ();
+  compiled->Dispose ();
+  rejected->Dispose ();
+}
+
+/**
+ * \ingroup obstacle
+ * The precomputed links are found by the mobility models of the nodes,
+ * and by their positions from other mobility models.
+ */
+class PrecomputedLinkLossTestCase : public TestCase
+{
+public:
+  PrecomputedLinkLossTestCase ();
+  virtual ~PrecomputedLinkLossTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+PrecomputedLinkLossTestCase::PrecomputedLinkLossTestCase ()
+  : TestCase ("Check the lookup of the precomputed links")
+{
+}
+
+PrecomputedLinkLossTestCase::~PrecomputedLinkLossTestCase ()
+{
+}
+
+void
+PrecomputedLinkLossTestCase::DoRun (void)
+{
+  Ptr<Topology> topology = CreateObject<Topology> ();
+  AddBox (topology, "box", 0.0, 0.0, 10.0, 10.0, 20.0);
+  topology->MakeRangeTree ();
+  Ptr<ObstacleShadowingPropagationLossModel> obstacles = CreateObject<ObstacleShadowingPropagationLossModel> ();
+  obstacles->SetTopology (topology);
+
+  const Vector edPosition[] = {Vector (-5.0, 5.0, 1.5), Vector (-5.0, 20.0, 1.5)};
+  NodeContainer endDevices;
+  NodeContainer gateways;
+  endDevices.Create (2);
+  gateways.Create (2);
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (edPosition[i]);
+      endDevices.Get (i)->AggregateObject (mobility);
+    }
+  Ptr<ConstantPositionMobilityModel> gwMobility = CreateObject<ConstantPositionMobilityModel> ();
+  gwMobility->SetPosition (Vector (15.0, 5.0, 1.5));
+  gateways.Get (0)->AggregateObject (gwMobility);
+  // a gateway at the position of the first end device
+  Ptr<ConstantPositionMobilityModel> sharedMobility = CreateObject<ConstantPositionMobilityModel> ();
+  sharedMobility->SetPosition (edPosition[0]);
+  gateways.Get (1)->AggregateObject (sharedMobility);
+
+  Ptr<PrecomputedLinkLossModel> precomputed = CreateObject<PrecomputedLinkLossModel> ();
+  precomputed->SetDeterministicModel (obstacles);
+  precomputed->Precompute (endDevices, gateways);
+  NS_TEST_ASSERT_MSG_EQ (precomputed->GetNLinks (), 8, "Wrong number of precomputed links");
+
+  // the nodes' own mobility models
+  Ptr<MobilityModel> ed = endDevices.Get (0)->GetObject<MobilityModel> ();
+  double loss = 0.0;
+  NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (ed, gwMobility, loss), true, "Uplink not precomputed");
+  NS_TEST_ASSERT_MSG_EQ_TOL (loss, 2 * BETA + 10.0 * GAMMA, 1e-4, "Wrong precomputed uplink");
+  NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (gwMobility, ed, loss), true, "Downlink not precomputed");
+
+  // other mobility models, at the positions of the nodes
+  Ptr<ConstantPositionMobilityModel> edProbe = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> gwProbe = CreateObject<ConstantPositionMobilityModel> ();
+  gwProbe->SetPosition (gwMobility->GetPosition ());
+  for (uint32_t i = 0; i < 2; i++)
+    {
+      edProbe->SetPosition (edPosition[i]);
+      double expected = 0.0;
+      precomputed->GetPrecomputedLoss (endDevices.Get (i)->GetObject<MobilityModel> (), gwMobility, expected);
+      NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (edProbe, gwProbe, loss), true,
+                             "Uplink not found by the positions");
+      NS_TEST_ASSERT_MSG_EQ (loss, expected, "Wrong uplink found by the positions");
+    }
+
+  // the gateway sharing its position with an end device keeps its role, by
+  // its mobility model or by the position of a probe at the gateway end
+  Ptr<MobilityModel> otherEd = endDevices.Get (1)->GetObject<MobilityModel> ();
+  NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (sharedMobility, otherEd, loss), true,
+                         "Downlink of the gateway taken for an end device link");
+  NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (otherEd, sharedMobility, loss), true,
+                         "Uplink to the gateway taken for an end device link");
+  gwProbe->SetPosition (edPosition[0]);
+  NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (gwProbe, otherEd, loss), true,
+                         "Downlink of the gateway not found by its position");
+  NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (ed, otherEd, loss), false,
+                         "An end device link was found without DeviceToDevice");
+
+  // a position that was not precomputed
+  gwProbe->SetPosition (gwMobility->GetPosition ());
+  edProbe->SetPosition (Vector (-5.0, 6.0, 1.5));
+  NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (edProbe, gwProbe, loss), false,
+                         "A link between other positions was found");
+
+  topology->Dispose ();
+}
+
+/**
+ * \ingroup obstacle
+ * The obstacle losses computed on several threads by Precompute, a block
+ * of end devices at a time, are those of the wrapped chain.
+ */
+class PrecomputedLinkMatrixTestCase : public TestCase
+{
+public:
+  PrecomputedLinkMatrixTestCase ();
+  virtual ~PrecomputedLinkMatrixTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  // log-distance, then the obstacles of topology, with the inexact engine and the grid
+  Ptr<PropagationLossModel> MakeChain (Ptr<Topology> topology, uint32_t cacheCapacity);
+};
+
+PrecomputedLinkMatrixTestCase::PrecomputedLinkMatrixTestCase ()
+  : TestCase ("Check the links precomputed on several threads")
+{
+}
+
+PrecomputedLinkMatrixTestCase::~PrecomputedLinkMatrixTestCase ()
+{
+}
+
+Ptr<PropagationLossModel>
+PrecomputedLinkMatrixTestCase::MakeChain (Ptr<Topology> topology, uint32_t cacheCapacity)
+{
+  Ptr<ObstacleShadowingPropagationLossModel> obstacles = CreateObject<ObstacleShadowingPropagationLossModel> ();
+  obstacles->SetTopology (topology);
+  obstacles->SetGeometryEngine (Topology::ENGINE_INEXACT);
+  obstacles->SetSpatialIndex (Topology::INDEX_GRID);
+  obstacles->SetCacheCapacity (cacheCapacity);
+  Ptr<LogDistancePropagationLossModel> distance = CreateObject<LogDistancePropagationLossModel> ();
+  distance->SetNext (obstacles);
+  return distance;
+}
+
+void
+PrecomputedLinkMatrixTestCase::DoRun (void)
+{
+  Ptr<Topology> topology = MakeCity ();
+  std::vector<Vector> points = MakePoints (43);
+
+  NodeContainer endDevices;
+  NodeContainer gateways;
+  endDevices.Create (40);
+  gateways.Create (3);
+  std::vector<Ptr<MobilityModel> > mobility;
+  for (uint32_t k = 0; k < points.size (); k++)
+    {
+      Ptr<ConstantPositionMobilityModel> position = CreateObject<ConstantPositionMobilityModel> ();
+      position->SetPosition (points[k]);
+      (k < 40 ? endDevices.Get (k) : gateways.Get (k - 40))->AggregateObject (position);
+      mobility.push_back (position);
+    }
+
+  // room for the links of 7 end devices: the matrix is computed in 6 blocks
+  Ptr<PrecomputedLinkLossModel> precomputed = CreateObject<PrecomputedLinkLossModel> ();
+  precomputed->SetAttribute ("Threads", UintegerValue (4));
+  precomputed->SetDeterministicModel (MakeChain (topology, 21));
+  precomputed->Precompute (endDevices, gateways);
+
+  Ptr<PropagationLossModel> reference = MakeChain (topology, 0);
+  uint32_t shadowed = 0;
+  for (uint32_t i = 0; i < 40; i++)
+    {
+      for (uint32_t j = 40; j < 43; j++)
+        {
+          double expected = -reference->CalcRxPower (0.0, mobility[i], mobility[j]);
+          double loss = 0.0;
+          NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (mobility[i], mobility[j], loss), true,
+                                 "Uplink not precomputed");
+          NS_TEST_ASSERT_MSG_EQ_TOL (loss, expected, 1e-3, "Wrong uplink of end device " << i);
+          NS_TEST_ASSERT_MSG_EQ (precomputed->GetPrecomputedLoss (mobility[j], mobility[i], loss), true,
+                                 "Downlink not precomputed");
+          NS_TEST_ASSERT_MSG_EQ_TOL (loss, expected, 1e-3, "Wrong downlink of end device " << i);
+          if (reference->GetNext ()->CalcRxPower (0.0, mobility[i], mobility[j]) < 0.0)
+            {
+              shadowed++;
+            }
+        }
+    }
+  NS_TEST_ASSERT_MSG_GT (shadowed, 0, "No shadowed link to compare");
+
+  // the chain found every obstacle loss in the cache filled by the blocks
+  Ptr<ObstacleShadowingPropagationLossModel> obstacles =
+    DynamicCast<ObstacleShadowingPropagationLossModel> (precomputed->GetDeterministicModel ()->GetNext ());
+  NS_TEST_ASSERT_MSG_EQ (obstacles->GetCacheMisses (), 0, "Links of a block were not in the cache");
+  NS_TEST_ASSERT_MSG_EQ (obstacles->GetCacheHits (), 2 * 40 * 3, "Wrong number of cached links used");
+
+  topology->Dispose ();
+}
+
+/**
+ * \ingroup obstacle
+ * The obstacle test suite
+ */
+class ObstacleTestSuite : public TestSuite
+{
+public:
+  ObstacleTestSuite ();
+};
+
+ObstacleTestSuite::ObstacleTestSuite ()
+  : TestSuite ("obstacle", UNIT)
+{
+  AddTestCase (new ObstacleLossTestCase, TestCase::QUICK);
+  AddTestCase (new ObstacleIndexEquivalenceTestCase, TestCase::QUICK);
+  AddTestCase (new ObstacleModelSettingsTestCase, TestCase::QUICK);
+  AddTestCase (new ObstacleCompiledTopologyTestCase, TestCase::QUICK);
+  AddTestCase (new PrecomputedLinkLossTestCase, TestCase::QUICK);
+  AddTestCase (new PrecomputedLinkMatrixTestCase, TestCase::QUICK);
+}
+
+static ObstacleTestSuite obstacleTestSuite;
@@ -49,6 +49,7 @@
 // obstacle polygons model
 #include "ns3/topology.h"
 #include "ns3/obstacle-shadowing-propagation-loss-model.h"
+#include "ns3/async-record-writer.h"
 
 // mobilty
 #include "ns3/csv-reader.h"
@@ -81,6 +82,25 @@ struct unicamp_rssi{
     double z;
 };
 
+// a line of rssi_result_file
+struct rssi_record{
+    int id;
+    uint32_t gwId;
+    uint32_t nodeId;
+    double rxPower;
+    double rssi;
+    double distance;
+};
+
+// a line of network_result_file
+struct position_record{
+    uint32_t nodeId;
+    Vector3D pos;
+    uint32_t gwId;
+    Vector3D posgw;
+    double distance;
+};
+
 
 // Instantiate of data structures
 // uint8_t SF_QTD = 6; // EU 868 MHz
@@ -126,6 +146,11 @@ string per_result_file = "";
 int count_send_pkts = 0;
 int count_receiv_pkts = 0;
 
+// result files written by a background thread while the simulation runs,
+// complete once Simulator::Destroy returns
+AsyncRecordWriter rssi_writer;
+AsyncRecordWriter network_writer;
+
 /* -----------------------------------------------------------------------------
 *			MAIN
 * ------------------------------------------------------------------------------
@@ -170,10 +195,6 @@ void ChangeNodePosition(NodeContainer endDevices, double interval ){
 }
 
 void GetGWRSSI(NodeContainer endDevices, NodeContainer gateways,Ptr<LoraChannel> channel, double interval ){
-  ofstream os_rssi_file;
-  string logFile = output_results_path + rssi_result_file;
-  os_rssi_file.open (logFile.c_str (), std::ofstream::out | std::ofstream::app);
-
   for(NodeContainer::Iterator gw = gateways.Begin (); gw != gateways.End (); ++gw){
       uint32_t gwId = (*gw)->GetId(); 
       Ptr<MobilityModel> mobModelG = (*gw)->GetObject<MobilityModel>();
@@ -188,23 +209,21 @@ void GetGWRSSI(NodeContainer endDevices, NodeContainer gateways,Ptr<LoraChannel>
         // << position << std::endl ;
 
         vector<unicamp_rssi>::iterator i = unicamp_rssi_dataset.begin();
-        os_rssi_file <<  i->id << "," << gwId << "," << nodeId << "," << channel->GetRxPower(txEndDevice, mobModel, mobModelG) << "," <<  i->rssi << "," << position << "\n" ; 
+        rssi_record record = {i->id, gwId, nodeId, channel->GetRxPower(txEndDevice, mobModel, mobModelG), i->rssi, position};
+        rssi_writer.Write(&record);
       }
   } 
-  os_rssi_file.close();
   Simulator::Schedule(Seconds(interval), &GetGWRSSI, endDevices, gateways, channel, interval); // call every 5sec
 }
 
+void FormatRssiRecord(ostream &os, const void *r){
+  const rssi_record *record = static_cast<const rssi_record *>(r);
+  os <<  record->id << "," << record->gwId << "," << record->nodeId << "," << record->rxPower << "," <<  record->rssi << "," << record->distance << "\n" ; 
+}
+
 
 // Print and write in an output file the position of devices, distance from gateway and positions (x,y) per SF
 void Print(NodeContainer endDevices, NodeContainer gateways,  Ptr<PropagationDelayModel> delay, double interval){    
-    string logFile = output_results_path + network_result_file;
-    
-    // open log file for output
-    string sf;
-    ofstream os;
-    os.open (logFile.c_str (), std::ofstream::out | std::ofstream::app);
-        
     for(NodeContainer::Iterator gw = gateways.Begin (); gw != gateways.End (); ++gw){
         uint32_t gwId = (*gw)->GetId(); 
         Ptr<MobilityModel> mobModelG = (*gw)->GetObject<MobilityModel>();
@@ -216,37 +235,43 @@ void Print(NodeContainer endDevices, NodeContainer gateways,  Ptr<PropagationDel
           Vector3D pos = mobModel->GetPosition();
           double position = mobModel->GetDistanceFrom(mobModelG);  
           uint32_t nodeId = (*node)->GetId();
-        
-          // Prints position and velocities
-          // if(deviceList[nodeId].SF == 0){
-          //   sf = "12";
-          // }else if(deviceList[nodeId].SF == 1){
-          //   sf = "11";
-          // }else if(deviceList[nodeId].SF == 2){
-          //   sf = "10";
-          // }else if(deviceList[nodeId].SF == 3){
-          //   sf = "9";
-          // }else if(deviceList[nodeId].SF == 4){
-          //   sf = "8";
-          // }else{
-          //   sf = "7";
-          // }
-
-          // id ED, x,y,z ED, SF, id GW, x,y,z GW, distance
-          // os << nodeId << "," << pos.x << "," << pos.y << "," << pos.z << "," << sf << "," ;
-          // os << gwId << "," << posgw.x << "," << posgw.y << "," << posgw.z << ",";
-          // os << position << "\n" ; 
-
-          os << nodeId << "," << pos.x << "," << pos.y << "," << pos.z << "," ;
-          os << gwId << "," << posgw.x << "," << posgw.y << "," << posgw.z << ",";
-          os << position << "\n" ; 
+
+          position_record record = {nodeId, pos, gwId, posgw, position};
+          network_writer.Write(&record);
         }
      }
 
-    os.close();
     Simulator::Schedule(Seconds(interval), &Print, endDevices, gateways, delay, interval);
 }
 
+void FormatPositionRecord(ostream &os, const void *r){
+  const position_record *record = static_cast<const position_record *>(r);
+
+  // Prints position and velocities
+  // if(deviceList[nodeId].SF == 0){
+  //   sf = "12";
+  // }else if(deviceList[nodeId].SF == 1){
+  //   sf = "11";
+  // }else if(deviceList[nodeId].SF == 2){
+  //   sf = "10";
+  // }else if(deviceList[nodeId].SF == 3){
+  //   sf = "9";
+  // }else if(deviceList[nodeId].SF == 4){
+  //   sf = "8";
+  // }else{
+  //   sf = "7";
+  // }
+
+  // id ED, x,y,z ED, SF, id GW, x,y,z GW, distance
+  // os << nodeId << "," << pos.x << "," << pos.y << "," << pos.z << "," << sf << "," ;
+  // os << gwId << "," << posgw.x << "," << posgw.y << "," << posgw.z << ",";
+  // os << position << "\n" ; 
+
+  os << record->nodeId << "," << record->pos.x << "," << record->pos.y << "," << record->pos.z << "," ;
+  os << record->gwId << "," << record->posgw.x << "," << record->posgw.y << "," << record->posgw.z << ",";
+  os << record->distance << "\n" ; 
+}
+
 
 // https://www.nsnam.org/doxygen/classns3_1_1_csv_reader.html
 void read_rssi_dataset(const std::string &filepath){
@@ -484,6 +509,16 @@ LoraPacketTracker& runSimulation(){
   ApplicationContainer appContainer = appHelper.Install (endDevices);
 
   
+  // the writers are closed (every line written) by Simulator::Destroy
+  if (!rssi_writer.Open(output_results_path + rssi_result_file, sizeof(rssi_record), &FormatRssiRecord, true))
+    {
+      NS_FATAL_ERROR ("Could not open " << output_results_path + rssi_result_file << " for writing");
+    }
+  if (!network_writer.Open(output_results_path + network_result_file, sizeof(position_record), &FormatPositionRecord, true))
+    {
+      NS_FATAL_ERROR ("Could not open " << output_results_path + network_result_file << " for writing");
+    }
+
   // Start simulation
   Simulator::Stop (appStopTime);
   // Simulator::Schedule(Seconds(0.00), &Print, endDevices, gateways, delay, 10.0);